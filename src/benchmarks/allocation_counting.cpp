@@ -0,0 +1,68 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+#include "allocation_counting.h"
+
+namespace {
+	// Per-thread, so that benchmarks running in parallel do not see each other's allocations.
+	thread_local size_t allocations = 0;
+	thread_local std::ptrdiff_t live_bytes = 0;
+
+	void *counted(void *ptr) {
+		++allocations;
+		live_bytes += (std::ptrdiff_t) malloc_usable_size(ptr);
+		return ptr;
+	}
+
+	void counted_free(void *ptr) {
+		if (ptr) {
+			live_bytes -= (std::ptrdiff_t) malloc_usable_size(ptr);
+		}
+		std::free(ptr);
+	}
+}
+
+size_t mgodpl::thread_allocation_count() {
+	return allocations;
+}
+
+std::ptrdiff_t mgodpl::thread_live_heap_bytes() {
+	return live_bytes;
+}
+
+void *operator new(std::size_t size) {
+	if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+		return counted(ptr);
+	}
+	throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+	// aligned_alloc requires the size to be a multiple of the alignment.
+	std::size_t align = static_cast<std::size_t>(alignment);
+	if (void *ptr = std::aligned_alloc(align, size == 0 ? align : ((size + align - 1) / align) * align)) {
+		return counted(ptr);
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+	counted_free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+	counted_free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+	counted_free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept {
+	counted_free(ptr);
+}
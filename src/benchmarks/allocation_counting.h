@@ -0,0 +1,30 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#ifndef MGODPL_ALLOCATION_COUNTING_H
+#define MGODPL_ALLOCATION_COUNTING_H
+
+#include <cstddef>
+
+namespace mgodpl {
+	/**
+	 * @brief Returns the number of calls to the global operator new that the calling thread has made so far.
+	 *
+	 * The benchmarks executable replaces the global allocation functions with counting ones (see
+	 * allocation_counting.cpp), so that benchmarks can measure heap traffic by taking the difference of two
+	 * calls to this function around the code under test.
+	 */
+	size_t thread_allocation_count();
+
+	/**
+	 * @brief Returns the number of heap bytes allocated minus those freed by the calling thread so far, as reported
+	 * by malloc_usable_size; the difference of two calls is the net heap growth of the code in between.
+	 *
+	 * Memory freed by another thread than the one that allocated it is subtracted from the wrong thread, so this is
+	 * only meaningful around single-threaded code.
+	 */
+	std::ptrdiff_t thread_live_heap_bytes();
+}
+
+#endif //MGODPL_ALLOCATION_COUNTING_H
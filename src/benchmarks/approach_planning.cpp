@@ -3,7 +3,9 @@
 // All rights reserved.
 
 #include <execution>
+#include <limits>
 #include <random>
+#include <tbb/enumerable_thread_specific.h>
 #include <range/v3/view/transform.hpp>
 #include <range/v3/range/conversion.hpp>
 
@@ -16,6 +18,7 @@
 #include "../planning/goal_sampling.h"
 #include "../planning/probing_motions.h"
 #include "../planning/cgal_chull_shortest_paths.h"
+#include "../planning/tsp_over_prm.h"
 
 #include <CGAL/Side_of_triangle_mesh.h>
 
@@ -310,6 +313,88 @@ ApproachPlanningMethodFn rrt_from_goal_samples_with_bias(
 	};
 }
 
+/**
+ * @brief Function that uses a bidirectional RRT (RRT-Connect) to plan approach paths between valid goal samples and
+ * their projections onto the convex hull of the tree (the "shell states").
+ *
+ * Unlike `rrt_from_goal_samples`, which grows a single tree from the goal sample until it happens to leave the tree,
+ * this grows trees from both ends towards each other.
+ *
+ * @param max_goal_samples 		The maximum number of goal samples to be taken.
+ * @param max_rrt_iterations 	The maximum number of RRT-Connect iterations to be performed.
+ * @param sampler_margin 		The margin to be added to the calculated radii for the uniform sampler function.
+ * @return The benchmark solver function.
+ */
+ApproachPlanningMethodFn rrt_connect_from_goal_samples(
+	const int max_goal_samples = 1000,
+	const int max_rrt_iterations = 1000,
+	const double sampler_margin = 2.0
+) {
+	return [=](const ApproachPlanningProblem &problem,
+	           CollisionFunctions &collision_fns,
+	           random_numbers::RandomNumberGenerator &rng) -> ApproachPlanningResults {
+		// Allocate result vector and JSON annotations.
+		std::vector<std::optional<RobotPath> > paths;
+		Json::Value performance_annotations;
+
+		// Create an invocation-counting goal sampler.
+		calls_t goal_samples = 0;
+		auto sample_goal = wrap_invocation_counting(goal_region_sampler(problem.robot, rng), goal_samples);
+
+		// Create a uniform sampler function of the space around the tree.
+		auto sample_state = make_uniform_sampler_fn(problem.robot,
+		                                            rng,
+		                                            problem.tree_model.tree_mesh.leaves_mesh,
+		                                            sampler_margin);
+
+		for (const auto &target: problem.tree_model.target_points) {
+			// Create a sampler function that generates a random goal state.
+			std::function sample_goal_state = [&]() {
+				return sample_goal(target);
+			};
+
+			// Connect the shell state of the goal sample to the goal sample.
+			auto try_rrt_connect = [&](const RobotState &goal_sample) -> std::optional<RobotPath> {
+				auto shell_state = project_to_shell_state(goal_sample,
+				                                          *problem.tree_model.tree_convex_hull,
+				                                          problem.robot);
+
+				if (collision_fns.state_collides(shell_state)) {
+					return std::nullopt;
+				}
+
+				return rrt_connect(
+					shell_state,
+					goal_sample,
+					sample_state,
+					collision_fns.state_collides,
+					collision_fns.motion_collides,
+					equal_weights_distance,
+					max_rrt_iterations
+				);
+			};
+
+			// Try the RRT-Connect operation at valid goal samples.
+			auto result = try_at_valid_goal_samples<RobotPath>(
+				collision_fns.state_collides,
+				sample_goal_state,
+				max_goal_samples,
+				try_rrt_connect);
+
+			// Store the result in the paths vector (nullopt if no path was found, so we line up with the target index).
+			paths.push_back(result);
+		}
+
+		// Record the number of goal samples taken.
+		performance_annotations["goal_samples"] = goal_samples;
+
+		return {
+			.paths = paths,
+			.performance_annotations = performance_annotations
+		};
+	};
+}
+
 /**
  * This is a "quick and dirty" planning method. It runs in O(1) time.
  *
@@ -410,6 +495,9 @@ REGISTER_BENCHMARK(approach_planning_comparison) {
 		{"rrt_bias_100_bm", rrt_from_goal_samples_with_bias(1000, 100, 4.0)},
 		{"rrt_bias_10_bm", rrt_from_goal_samples_with_bias(1000, 10, 4.0)},
 		{"rrt_bias_1_bm", rrt_from_goal_samples_with_bias(1000, 1, 4.0)},
+		{"rrt_connect_10", rrt_connect_from_goal_samples(1000, 10, 2.0)},
+		{"rrt_connect_100", rrt_connect_from_goal_samples(1000, 100, 2.0)},
+		{"rrt_connect_1000", rrt_connect_from_goal_samples(1000, 1000, 2.0)},
 		{"straight_in", straight_in}
 	};
 
@@ -432,18 +520,33 @@ REGISTER_BENCHMARK(approach_planning_comparison) {
 
 		std::cout << "Checking goal reachability for " << tree_model.tree_model_name << std::endl;
 
-		auto sampler = goal_region_sampler(robot_model, rng);
+		// One collision model per thread, since the targets are sampled in parallel.
+		tbb::enumerable_thread_specific<RobotCollisionModel> collision_models([&robot_model]() {
+			return RobotCollisionModel(robot_model);
+		});
 
-		// For up to 1000 samples, check if the goal can even be sampled:
-		for (const auto &tgt: tree_model.target_points) {
-			int successful_samples = 0;
-			for (int attempt = 0; attempt < 1000; ++attempt) {
-				auto sample = sampler(tgt);
-				if (check_robot_collision(robot_model, *tree_model.tree_collision_object, sample)) {
-					successful_samples += 1;
-				}
-			}
-			problem_json["successful_samples"].append(successful_samples);
+		const auto &base_link = robot_model.findLinkByName("flying_base");
+		const auto &end_effector_link = robot_model.findLinkByName("end_effector");
+
+		// For 1000 samples per target, check if the goal can even be sampled: (Counting every collision-free one.)
+		const auto goal_samples = sample_goal_states_parallel(
+			tree_model.target_points.size(),
+			1000,
+			1000,
+			rng.uniformInteger(0, std::numeric_limits<int>::max()),
+			[&](size_t target_index, random_numbers::RandomNumberGenerator &target_rng) {
+				return genGoalStateUniform(target_rng,
+				                           tree_model.target_points[target_index],
+				                           robot_model,
+				                           base_link,
+				                           end_effector_link);
+			},
+			[&](const RobotState &state) {
+				return check_robot_collision(collision_models.local(), *tree_model.tree_collision_object, state);
+			});
+
+		for (size_t successful_samples: goal_samples.group_sizes) {
+			problem_json["successful_samples"].append((int) successful_samples);
 		}
 
 		results["problems"].append(problem_json);
@@ -569,6 +672,176 @@ REGISTER_BENCHMARK(approach_planning_comparison) {
 	              });
 }
 
+/**
+ * @brief Counts of motion checks, split by whether the motion was rejected, and the state checks they took.
+ */
+struct EdgeValidationCounts {
+	calls_t rejected_edges = 0;
+	calls_t states_in_rejected_edges = 0;
+	calls_t accepted_edges = 0;
+	calls_t states_in_accepted_edges = 0;
+
+	void record(bool collides, calls_t states_checked) {
+		if (collides) {
+			rejected_edges += 1;
+			states_in_rejected_edges += states_checked;
+		} else {
+			accepted_edges += 1;
+			states_in_accepted_edges += states_checked;
+		}
+	}
+
+	[[nodiscard]] Json::Value to_json() const {
+		Json::Value json;
+		json["rejected_edges"] = rejected_edges;
+		json["accepted_edges"] = accepted_edges;
+		json["avg_checks_per_rejected_edge"] = rejected_edges == 0
+			                                       ? 0.0
+			                                       : (double) states_in_rejected_edges / (double) rejected_edges;
+		json["avg_checks_per_accepted_edge"] = accepted_edges == 0
+			                                       ? 0.0
+			                                       : (double) states_in_accepted_edges / (double) accepted_edges;
+		return json;
+	}
+};
+
+/**
+ * This benchmark compares linear and bisection-order validation of motions, by the average number of
+ * state checks per rejected (and accepted) edge, on two workloads:
+ * - Approach planning (a subset of the methods from `approach_planning_comparison`).
+ * - TSP-over-PRM.
+ *
+ * In both, motions are validated at the same fixed resolution in either order, such that only the order differs.
+ * For reference, TSP-over-PRM is also run with its default linear conservative advancement.
+ */
+REGISTER_BENCHMARK(motion_validation_order_comparison) {
+	// Create a robot model.
+	robot_model::RobotModel robot_model = mgodpl::experiments::createProceduralRobotModel(
+		{
+			.total_arm_length = 1.0,
+			.joint_types = {experiments::JointType::HORIZONTAL},
+			.add_spherical_wrist = false
+		});
+
+	// Grab a list of all tree models:
+	auto tree_models = experiments::loadAllTreeBenchmarkData(results);
+
+	// If this is a debug build, drop all by the first two tree models:
+#ifndef NDEBUG
+	tree_models.resize(2);
+#endif
+
+	// The maximum number of targets to plan a TSP-over-PRM tour for, per tree.
+	const size_t MAX_TSP_TARGETS = 50;
+
+	std::vector<std::pair<std::string, MotionValidationOrder> > orders{
+		{"linear", MotionValidationOrder::LINEAR_FIXED_RESOLUTION},
+		{"bisection", MotionValidationOrder::BISECTION}
+	};
+
+	std::vector<std::pair<std::string, ApproachPlanningMethodFn> > methods{
+		{"pullout", probing_by_pullout},
+		{"rrt_100", rrt_from_goal_samples(1000, 100, 2.0)},
+		{"rrt_bias_100", rrt_from_goal_samples_with_bias(1000, 100, 2.0)},
+	};
+
+	for (const auto &tree_model: tree_models) {
+		// The approach planning workload only considers targets inside the tree, as in approach_planning_comparison.
+		CGAL::Side_of_triangle_mesh<cgal::Surface_mesh, cgal::K> inside_outside_check(
+			tree_model.tree_convex_hull->convex_hull);
+
+		auto approach_targets = tree_model.target_points;
+		erase_if(approach_targets,
+		         [&](const math::Vec3d &target) {
+			         return inside_outside_check(cgal::to_cgal_point(target)) == CGAL::ON_UNBOUNDED_SIDE;
+		         });
+
+		experiments::TreeModelBenchmarkData approach_tree_model = tree_model;
+		approach_tree_model.target_points = approach_targets;
+		ApproachPlanningProblem problem{robot_model, approach_tree_model};
+
+		Json::Value tree_json;
+		tree_json["tree_model"] = tree_model.tree_model_name;
+
+		// TSP-over-PRM workload, returning the edge validation counts.
+		auto run_tsp_over_prm = [&](MotionValidationOrder order) {
+			EdgeValidationCounts counts;
+
+			TspOverPrmHooks hooks;
+			hooks.on_motion_checked = [&](bool collides, size_t states_checked) {
+				counts.record(collides, states_checked);
+			};
+
+			std::vector<math::Vec3d> tsp_targets = tree_model.target_points;
+			if (tsp_targets.size() > MAX_TSP_TARGETS) {
+				tsp_targets.resize(MAX_TSP_TARGETS);
+			}
+
+			RobotState start_state{
+				.base_tf = math::Transformd::fromTranslation({-10, -10, 0}),
+				.joint_values = std::vector(robot_model.count_joint_variables(), 0.0)
+			};
+
+			random_numbers::RandomNumberGenerator rng(42);
+			plan_path_tsp_over_prm(start_state,
+			                       tsp_targets,
+			                       robot_model,
+			                       *tree_model.tree_collision_object,
+			                       TspOverPrmParameters{
+				                       .n_neighbours = 5,
+				                       .max_samples = 1000,
+				                       .goal_sample_params = GoalSampleParams{
+					                       .k_neighbors = 5,
+					                       .max_valid_samples = 1,
+					                       .max_attempts = 100
+				                       },
+				                       .motion_validation_order = order
+			                       },
+			                       rng,
+			                       hooks);
+
+			return counts.to_json();
+		};
+
+		for (const auto &[order_name, order]: orders) {
+			// Approach planning workload:
+			for (const auto &[method_name, method]: methods) {
+				EdgeValidationCounts counts;
+
+				// Count the state checks, so that we can attribute them to the motion checks.
+				calls_t state_checks = 0;
+				auto state_collides = collision_check_fn_in_environment({robot_model, *tree_model.tree_collision_object});
+				auto motion_collides = motion_collision_check_fn_from_state_collision(
+					wrap_invocation_counting(state_collides, state_checks),
+					order);
+
+				CollisionFunctions collision_fns{
+					state_collides,
+					[&](const RobotState &a, const RobotState &b) {
+						calls_t before = state_checks;
+						bool collides = motion_collides(a, b);
+						counts.record(collides, state_checks - before);
+						return collides;
+					}
+				};
+
+				random_numbers::RandomNumberGenerator rng(42);
+				method(problem, collision_fns, rng);
+
+				tree_json["approach_planning"][method_name][order_name] = counts.to_json();
+			}
+
+			tree_json["tsp_over_prm"][order_name] = run_tsp_over_prm(order);
+
+			std::cout << "Finished " << order_name << " validation for " << tree_model.tree_model_name << std::endl;
+		}
+
+		tree_json["tsp_over_prm"]["linear_conservative_advancement"] = run_tsp_over_prm(MotionValidationOrder::LINEAR);
+
+		results["trees"].append(tree_json);
+	}
+}
+
 /**
  * This becnhmark is meant to esablish the correlation between the dot product with the arm vector of a translational
  * movement, and the chance that the robot successfully escapes along that vector.
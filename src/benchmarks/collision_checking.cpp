@@ -0,0 +1,163 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "benchmark_function_macros.h"
+#include "allocation_counting.h"
+#include "../experiment_utils/tree_benchmark_data.h"
+#include "../experiment_utils/procedural_robot_models.h"
+#include "../planning/RandomNumberGenerator.h"
+#include "../planning/state_tools.h"
+#include "../planning/collision_detection.h"
+
+#include <fcl/narrowphase/collision_object.h>
+
+using namespace mgodpl;
+
+/**
+ * @brief Measures the heap allocations and time per state collision check, comparing the one-shot
+ * `check_robot_collision(RobotModel, ...)` (which builds its collision geometry on every call) against
+ * a RobotCollisionModel that is built once and reused for every check.
+ */
+REGISTER_BENCHMARK(collision_check_allocations) {
+	// Create a robot model.
+	robot_model::RobotModel robot = experiments::createProceduralRobotModel();
+
+	// Grab a list of all tree models:
+	auto tree_models = experiments::loadAllTreeBenchmarkData(results);
+
+	// How many states to check per tree:
+	const size_t N_STATES = 10000;
+
+	random_numbers::RandomNumberGenerator rng(42);
+
+	for (const auto &tree_model: tree_models) {
+		// Sample the states up-front, so the sampling itself does not count towards the allocations.
+		std::vector<RobotState> states;
+		states.reserve(N_STATES);
+		for (size_t i = 0; i < N_STATES; ++i) {
+			states.push_back(generateUniformRandomState(robot, rng, 5.0, 10.0));
+		}
+
+		// Measure a single method: returns the allocations and wall time for checking all states.
+		auto measure = [&](const auto &check_fn) {
+			size_t n_collisions = 0;
+			size_t allocations_before = thread_allocation_count();
+			auto start_time = std::chrono::high_resolution_clock::now();
+
+			for (const auto &state: states) {
+				n_collisions += check_fn(state) ? 1 : 0;
+			}
+
+			auto end_time = std::chrono::high_resolution_clock::now();
+			size_t allocations = thread_allocation_count() - allocations_before;
+
+			Json::Value method_json;
+			method_json["allocations_per_check"] = (double) allocations / (double) states.size();
+			method_json["time_ns_per_check"] = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(
+					end_time - start_time).count() / (double) states.size();
+			method_json["n_collisions"] = (int) n_collisions;
+			return method_json;
+		};
+
+		Json::Value tree_json;
+		tree_json["tree_model"] = tree_model.tree_model_name;
+
+		tree_json["per_call_geometry"] = measure([&](const RobotState &state) {
+			return check_robot_collision(robot, *tree_model.tree_collision_object, state);
+		});
+
+		RobotCollisionModel collision_model(robot);
+		tree_json["precompiled_model"] = measure([&](const RobotState &state) {
+			return check_robot_collision(collision_model, *tree_model.tree_collision_object, state);
+		});
+
+		std::cout << "Tree " << tree_model.tree_model_name
+				<< ": per-call geometry " << tree_json["per_call_geometry"]["allocations_per_check"].asDouble()
+				<< " allocations/check, precompiled model "
+				<< tree_json["precompiled_model"]["allocations_per_check"].asDouble()
+				<< " allocations/check" << std::endl;
+
+		results["trees"].append(tree_json);
+	}
+}
+
+/**
+ * @brief Compares the number of state queries (FK + collision or distance query) per motion check of the fixed-resolution
+ * sampler against the conservative-advancement motion checker, on random roadmap-like edges around every tree.
+ */
+REGISTER_BENCHMARK(motion_check_state_queries) {
+	// Create a robot model.
+	robot_model::RobotModel robot = experiments::createProceduralRobotModel();
+
+	// Grab a list of all tree models:
+	auto tree_models = experiments::loadAllTreeBenchmarkData(results);
+
+	// How many edges to check per tree, and their maximum length (in equal_weights_distance):
+	const size_t N_EDGES = 1000;
+	const double MAX_EDGE_LENGTH = 2.0;
+
+	random_numbers::RandomNumberGenerator rng(42);
+
+	for (const auto &tree_model: tree_models) {
+		// Sample edges up-front, so both methods get exactly the same ones.
+		std::vector<std::pair<RobotState, RobotState> > edges;
+		edges.reserve(N_EDGES);
+		for (size_t i = 0; i < N_EDGES; ++i) {
+			RobotState a = generateUniformRandomState(robot, rng, 5.0, 10.0);
+			RobotState b = generateUniformRandomState(robot, rng, 5.0, 10.0);
+			double d = equal_weights_distance(a, b);
+			edges.emplace_back(a, interpolate(a, b, std::min(1.0, MAX_EDGE_LENGTH / d)));
+		}
+
+		// Run a single motion checker over all edges, recording the verdicts.
+		auto measure = [&](const auto &check_fn, std::vector<bool> &verdicts) {
+			RobotCollisionModel collision_model(robot);
+
+			auto start_time = std::chrono::high_resolution_clock::now();
+			for (const auto &[a, b]: edges) {
+				double toi;
+				verdicts.push_back(check_fn(collision_model, a, b, toi));
+			}
+			auto end_time = std::chrono::high_resolution_clock::now();
+
+			Json::Value method_json;
+			method_json["state_queries_per_edge"] =
+					(double) collision_model.getStateQueries() / (double) edges.size();
+			method_json["time_us_per_edge"] = (double) std::chrono::duration_cast<std::chrono::microseconds>(
+					end_time - start_time).count() / (double) edges.size();
+			method_json["n_colliding"] = (int) std::count(verdicts.begin(), verdicts.end(), true);
+			return method_json;
+		};
+
+		std::vector<bool> sampled_verdicts, ca_verdicts;
+
+		Json::Value tree_json;
+		tree_json["tree_model"] = tree_model.tree_model_name;
+		tree_json["sampled"] = measure([&](RobotCollisionModel &model, const RobotState &a, const RobotState &b, double &toi) {
+			return check_motion_collides_sampled(model, *tree_model.tree_collision_object, a, b, toi);
+		}, sampled_verdicts);
+		tree_json["conservative_advancement"] = measure([&](RobotCollisionModel &model, const RobotState &a, const RobotState &b, double &toi) {
+			return check_motion_collides(model, *tree_model.tree_collision_object, a, b, toi);
+		}, ca_verdicts);
+
+		// Edges where the sampler missed a collision that conservative advancement caught, or vice versa.
+		size_t disagreements = 0;
+		for (size_t i = 0; i < edges.size(); ++i) {
+			disagreements += sampled_verdicts[i] != ca_verdicts[i] ? 1 : 0;
+		}
+		tree_json["disagreements"] = (int) disagreements;
+
+		std::cout << "Tree " << tree_model.tree_model_name
+				<< ": sampled " << tree_json["sampled"]["state_queries_per_edge"].asDouble()
+				<< " states/edge, conservative advancement "
+				<< tree_json["conservative_advancement"]["state_queries_per_edge"].asDouble()
+				<< " states/edge" << std::endl;
+
+		results["trees"].append(tree_json);
+	}
+}
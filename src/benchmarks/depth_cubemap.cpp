@@ -0,0 +1,108 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <chrono>
+#include <iostream>
+
+#include "benchmark_function_macros.h"
+#include "../experiment_utils/TreeMeshes.h"
+#include "../planning/MeshOcclusionModel.h"
+#include "../planning/depth_cubemap.h"
+#include "../planning/RandomNumberGenerator.h"
+
+using namespace mgodpl;
+
+/**
+ * @brief Compares occlusion checking through a depth cube map (render once per viewpoint, then one lookup per point)
+ * against ray casting through MeshOcclusionModel, on the leaves of every tree model and at several cube map
+ * resolutions; reports the time spent and how often the approximate answer differs from the exact one.
+ */
+REGISTER_BENCHMARK(depth_cubemap_vs_ray_casting) {
+	const size_t N_VIEWPOINTS = 50;
+	const size_t N_POINTS_PER_VIEWPOINT = 10000;
+	const double MARGIN = 0.01;
+	const std::vector<size_t> RESOLUTIONS = {256, 512, 1024};
+
+	random_numbers::RandomNumberGenerator rng(42);
+
+	auto time_ms = [](const auto &fn) {
+		auto start_time = std::chrono::high_resolution_clock::now();
+		fn();
+		auto end_time = std::chrono::high_resolution_clock::now();
+		return (double) std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count() /
+			   1000.0;
+	};
+
+	for (const auto &tree_model_name: tree_meshes::getTreeModelNames()) {
+		const auto tree_model = tree_meshes::loadTreeMeshes(tree_model_name);
+		const Mesh &leaves = tree_model.leaves_mesh;
+		const math::AABBd aabb = mesh_aabb(leaves);
+		const math::Vec3d size = aabb.size();
+
+		Json::Value tree_json;
+		tree_json["tree_model"] = tree_model_name;
+		tree_json["n_triangles"] = (int) leaves.triangles.size();
+
+		// Viewpoints around the canopy, each looking at points inside of it.
+		std::vector<math::Vec3d> viewpoints;
+		std::vector<std::vector<math::Vec3d> > points(N_VIEWPOINTS);
+		for (size_t i = 0; i < N_VIEWPOINTS; ++i) {
+			viewpoints.emplace_back(
+					aabb.min().x() + rng.uniformReal(-0.5, 1.5) * size.x(),
+					aabb.min().y() + rng.uniformReal(-0.5, 1.5) * size.y(),
+					aabb.min().z() + rng.uniformReal(0.0, 1.0) * size.z());
+			for (size_t j = 0; j < N_POINTS_PER_VIEWPOINT; ++j) {
+				points[i].emplace_back(
+						aabb.min().x() + rng.uniform01() * size.x(),
+						aabb.min().y() + rng.uniform01() * size.y(),
+						aabb.min().z() + rng.uniform01() * size.z());
+			}
+		}
+
+		// The exact answers, by ray casting.
+		MeshOcclusionModel ray_cast_model(leaves, MARGIN);
+		std::vector<std::vector<bool> > exact(N_VIEWPOINTS);
+		tree_json["ray_cast_query_ms"] = time_ms([&]() {
+			for (size_t i = 0; i < N_VIEWPOINTS; ++i) {
+				ray_cast_model.checkOcclusion(points[i], viewpoints[i], exact[i]);
+			}
+		});
+
+		for (size_t resolution: RESOLUTIONS) {
+			DepthCubemap cubemap(resolution, MARGIN);
+
+			double render_ms = 0.0;
+			double query_ms = 0.0;
+			int false_occluded = 0;
+			int false_visible = 0;
+
+			std::vector<bool> occluded;
+			for (size_t i = 0; i < N_VIEWPOINTS; ++i) {
+				render_ms += time_ms([&]() { cubemap.render(leaves, viewpoints[i]); });
+				query_ms += time_ms([&]() { cubemap.checkOcclusion(points[i], viewpoints[i], occluded); });
+
+				for (size_t j = 0; j < N_POINTS_PER_VIEWPOINT; ++j) {
+					false_occluded += occluded[j] && !exact[i][j];
+					false_visible += !occluded[j] && exact[i][j];
+				}
+			}
+
+			Json::Value resolution_json;
+			resolution_json["resolution"] = (int) resolution;
+			resolution_json["render_ms"] = render_ms;
+			resolution_json["query_ms"] = query_ms;
+			resolution_json["false_occluded"] = false_occluded;
+			resolution_json["false_visible"] = false_visible;
+
+			std::cout << "Tree " << tree_model_name << ", resolution " << resolution << ": render " << render_ms
+					<< " ms, query " << query_ms << " ms (ray casting " << tree_json["ray_cast_query_ms"].asDouble()
+					<< " ms), " << false_occluded << " false occluded, " << false_visible << " false visible"
+					<< std::endl;
+
+			tree_json["cubemap"].append(resolution_json);
+		}
+
+		results["trees"].append(tree_json);
+	}
+}
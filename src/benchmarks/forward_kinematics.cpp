@@ -0,0 +1,112 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include "benchmark_function_macros.h"
+#include "../experiment_utils/procedural_robot_models.h"
+#include "../planning/RandomNumberGenerator.h"
+#include "../planning/state_tools.h"
+#include "../planning/batched_forward_kinematics.h"
+
+using namespace mgodpl;
+
+/**
+ * @brief Compares the time per state of forward kinematics through repeated scalar `forwardKinematics` calls,
+ * through a precompiled KinematicPlan, and through the batched (SIMD) `forwardKinematicsBatch`, for a range of
+ * procedural robots.
+ */
+REGISTER_BENCHMARK(batched_forward_kinematics) {
+	const auto robot_params = experiments::generateRobotArmParameters(
+			{
+					.arm_lengths = {0.25, 0.5, 0.75, 1.0},
+					.max_links = 3,
+					.include_all_horizontal = true,
+					.include_all_vertical = true,
+					.include_alternating_horizontal_vertical = true
+			});
+
+	// How many states to evaluate per robot, and how many times to repeat it (to get measurable times):
+	const size_t N_STATES = 10000;
+	const size_t N_REPETITIONS = 10;
+
+	random_numbers::RandomNumberGenerator rng(42);
+
+	for (const auto &robot_param: robot_params) {
+		const auto robot = experiments::createProceduralRobotModel(robot_param);
+		const auto base_link = robot.findLinkByName("flying_base");
+		const auto plan = robot_model::compileKinematicPlan(robot, base_link);
+
+		std::vector<RobotState> states;
+		states.reserve(N_STATES);
+		for (size_t i = 0; i < N_STATES; ++i) {
+			states.push_back(generateUniformRandomState(robot, rng, 5.0, 10.0));
+		}
+
+		// Time a single method, returning the time per state in nanoseconds.
+		auto time_ns_per_state = [&](const auto &fn) {
+			auto start_time = std::chrono::high_resolution_clock::now();
+			for (size_t rep = 0; rep < N_REPETITIONS; ++rep) {
+				fn();
+			}
+			auto end_time = std::chrono::high_resolution_clock::now();
+			return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count() /
+				   (double) (N_REPETITIONS * N_STATES);
+		};
+
+		// Sum up a translation coordinate, so the optimizer cannot drop the computations.
+		double checksum = 0.0;
+
+		Json::Value robot_json;
+		robot_json["robot"] = robot_param.short_designator();
+		robot_json["n_links"] = (int) robot.getLinks().size();
+
+		robot_json["scalar_ns_per_state"] = time_ns_per_state([&]() {
+			for (const auto &state: states) {
+				const auto &fk = robot_model::forwardKinematics(robot, state.joint_values, base_link, state.base_tf);
+				checksum += fk.link_transforms.back().translation.x();
+			}
+		});
+
+		std::vector<math::Transformd> link_transforms(plan.n_links);
+		robot_json["precompiled_plan_ns_per_state"] = time_ns_per_state([&]() {
+			for (const auto &state: states) {
+				robot_model::forwardKinematics(plan, state.joint_values.data(), state.base_tf, link_transforms.data());
+				checksum += link_transforms.back().translation.x();
+			}
+		});
+
+		// The transposition into structure-of-arrays is done once, up-front; callers that produce states in batches
+		// would write them in that layout directly.
+		const auto batch = robot_model::RobotStateBatch::fromStates(states);
+		robot_model::BatchedForwardKinematicsResult batch_result;
+		robot_json["batched_ns_per_state"] = time_ns_per_state([&]() {
+			robot_model::forwardKinematicsBatch(plan, batch, batch_result);
+			checksum += batch_result.link_transforms.back().get(0).translation.x();
+		});
+
+		// Check that the batched version agrees with the scalar one.
+		double max_translation_error = 0.0;
+		for (size_t i = 0; i < states.size(); ++i) {
+			const auto &fk = robot_model::forwardKinematics(robot, states[i].joint_values, base_link, states[i].base_tf);
+			for (size_t link = 0; link < robot.getLinks().size(); ++link) {
+				max_translation_error = std::max(max_translation_error,
+												  (fk.forLink(link).translation -
+												   batch_result.forLink(link, i).translation).norm());
+			}
+		}
+		robot_json["max_translation_error"] = max_translation_error;
+		robot_json["checksum"] = checksum;
+
+		std::cout << "Robot " << robot_param.short_designator()
+				<< ": scalar " << robot_json["scalar_ns_per_state"].asDouble()
+				<< " ns/state, precompiled plan " << robot_json["precompiled_plan_ns_per_state"].asDouble()
+				<< " ns/state, batched " << robot_json["batched_ns_per_state"].asDouble()
+				<< " ns/state" << std::endl;
+
+		results["robots"].append(robot_json);
+	}
+}
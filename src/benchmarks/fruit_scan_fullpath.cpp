@@ -958,9 +958,9 @@ REGISTER_VISUALIZATION(orbit_tree) {
 		// Update the visibility of the scannable points
 		for (size_t fruit_i = 0; fruit_i < all_scannable_points.size(); ++fruit_i) {
 			for (size_t i = 0; i < all_scannable_points[fruit_i].surface_points.size(); ++i) {
-				if (!ever_seen[fruit_i].ever_seen[i] &&
+				if (!ever_seen[fruit_i].is_seen(i) &&
 				    is_visible(all_scannable_points[fruit_i], i, end_effector_position)) {
-					ever_seen[fruit_i].ever_seen[i] = true;
+					ever_seen[fruit_i].mark_seen(i);
 
 					// Add the sightline to the sightlines_data vector
 					sightlines_data.push_back({
@@ -976,10 +976,8 @@ REGISTER_VISUALIZATION(orbit_tree) {
 		size_t unique_total = 0;
 
 		for (size_t fruit_i = 0; fruit_i < all_scannable_points.size(); ++fruit_i) {
-			seen_total += std::count(ever_seen[fruit_i].ever_seen.begin(), ever_seen[fruit_i].ever_seen.end(), true);
-			unique_total += std::any_of(ever_seen[fruit_i].ever_seen.begin(),
-			                            ever_seen[fruit_i].ever_seen.end(),
-			                            [](bool b) { return b; });
+			seen_total += ever_seen[fruit_i].count_seen();
+			unique_total += ever_seen[fruit_i].count_seen() > 0;
 		}
 
 		// Calculate metrics
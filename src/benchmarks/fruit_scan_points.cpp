@@ -298,8 +298,7 @@ ParametricPathEval evaluate_path(
             // Check if the point is visible from the current eye position and direction
             if (sensor_model.is_visible(eye_position, eye_forward, points[i])) {
                 // If the point has not been seen before, mark it as seen and increment the seen count
-                if (!ever_seen.ever_seen[i]) {
-                    ever_seen.ever_seen[i] = true;
+                if (ever_seen.mark_seen(i)) {
                     ++n_seen;
                 }
                 // Increment the visible count for the current position
@@ -447,9 +446,9 @@ void visualize_paths(
 
         // Update the visibility of the scannable points
         for (size_t i = 0; i < points.size(); ++i) {
-            if (!ever_seen.ever_seen[i] && sensor_model.
+            if (!ever_seen.is_seen(i) && sensor_model.
                 is_visible(eye_position, -eye_position.normalized(), points[i])) {
-                ever_seen.ever_seen[i] = true;
+                ever_seen.mark_seen(i);
             }
         }
 
@@ -0,0 +1,115 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <tbb/enumerable_thread_specific.h>
+
+#include "benchmark_function_macros.h"
+#include "../experiment_utils/procedural_robot_models.h"
+#include "../experiment_utils/tree_benchmark_data.h"
+#include "../planning/RandomNumberGenerator.h"
+#include "../planning/collision_detection.h"
+#include "../planning/goal_sampling.h"
+
+#include <fcl/narrowphase/collision_object.h>
+
+using namespace mgodpl;
+
+/**
+ * @brief Compares sampling goal states for all fruit of every tree model one fruit and one attempt at a time, as the
+ * planners used to, against sampling them in parallel batches with sample_goal_states_parallel; reports the time
+ * taken, and the number of goal states found and candidates considered by each.
+ */
+REGISTER_BENCHMARK(goal_sampling_throughput) {
+	const size_t MAX_VALID_SAMPLES = 2;
+	const std::vector<size_t> MAX_ATTEMPTS = {100, 1000};
+
+	robot_model::RobotModel robot = experiments::createProceduralRobotModel();
+	const auto base_link = robot.findLinkByName("flying_base");
+	const auto end_effector_link = robot.findLinkByName("end_effector");
+
+	auto tree_models = experiments::loadAllTreeBenchmarkData(results);
+
+	auto time_ms = [](const auto &fn) {
+		auto start_time = std::chrono::high_resolution_clock::now();
+		fn();
+		auto end_time = std::chrono::high_resolution_clock::now();
+		return (double) std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count() /
+			   1000.0;
+	};
+
+	random_numbers::RandomNumberGenerator rng(42);
+
+	for (const auto &tree_model: tree_models) {
+		const auto &targets = tree_model.target_points;
+
+		Json::Value tree_json;
+		tree_json["tree_model"] = tree_model.tree_model_name;
+		tree_json["n_targets"] = (int) targets.size();
+
+		for (size_t max_attempts: MAX_ATTEMPTS) {
+			Json::Value attempts_json;
+			attempts_json["max_attempts"] = (int) max_attempts;
+
+			// One fruit and one attempt at a time.
+			size_t serial_found = 0, serial_attempts = 0;
+			attempts_json["serial_ms"] = time_ms([&]() {
+				RobotCollisionModel collision_model(robot);
+				for (const auto &target: targets) {
+					size_t found = 0;
+					for (size_t attempt = 0; attempt < max_attempts && found < MAX_VALID_SAMPLES; ++attempt) {
+						RobotState state = genGoalStateUniform(rng, target, robot, base_link, end_effector_link);
+						++serial_attempts;
+						if (!check_robot_collision(collision_model, *tree_model.tree_collision_object, state)) {
+							++found;
+						}
+					}
+					serial_found += found;
+				}
+			});
+			attempts_json["serial_found"] = (Json::UInt64) serial_found;
+			attempts_json["serial_attempts"] = (Json::UInt64) serial_attempts;
+
+			// All fruit in parallel, in batches.
+			tbb::enumerable_thread_specific<RobotCollisionModel> collision_models([&robot]() {
+				return RobotCollisionModel(robot);
+			});
+			GoalSampleSet goal_samples;
+			attempts_json["parallel_ms"] = time_ms([&]() {
+				goal_samples = sample_goal_states_parallel(
+						targets.size(),
+						MAX_VALID_SAMPLES,
+						max_attempts,
+						rng.uniformInteger(0, std::numeric_limits<int>::max()),
+						[&](size_t target_index, random_numbers::RandomNumberGenerator &target_rng) {
+							return genGoalStateUniform(target_rng, targets[target_index], robot, base_link,
+													   end_effector_link);
+						},
+						[&](const RobotState &state) {
+							return check_robot_collision(collision_models.local(),
+														 *tree_model.tree_collision_object,
+														 state);
+						});
+			});
+
+			size_t parallel_attempts = 0;
+			for (size_t attempts: goal_samples.attempts) {
+				parallel_attempts += attempts;
+			}
+			attempts_json["parallel_found"] = (Json::UInt64) goal_samples.states.size();
+			attempts_json["parallel_attempts"] = (Json::UInt64) parallel_attempts;
+
+			std::cout << "Tree " << tree_model.tree_model_name << ", " << max_attempts << " attempts: serial "
+					<< attempts_json["serial_ms"].asDouble() << " ms (" << serial_found << " found), parallel "
+					<< attempts_json["parallel_ms"].asDouble() << " ms (" << goal_samples.states.size() << " found)"
+					<< std::endl;
+
+			tree_json["max_attempts"].append(attempts_json);
+		}
+
+		results["trees"].append(tree_json);
+	}
+}
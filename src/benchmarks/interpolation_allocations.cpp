@@ -0,0 +1,141 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <cmath>
+#include <iostream>
+
+#include "benchmark_function_macros.h"
+#include "allocation_counting.h"
+#include "../experiment_utils/declarative_environment.h"
+#include "../experiment_utils/point_scanning_evaluation.h"
+#include "../experiment_utils/procedural_robot_models.h"
+#include "../experiment_utils/tree_benchmark_data.h"
+#include "../planning/RandomNumberGenerator.h"
+#include "../planning/collision_detection.h"
+#include "../planning/distance.h"
+#include "../planning/state_tools.h"
+
+#include <fcl/narrowphase/collision_object.h>
+
+using namespace mgodpl;
+
+/**
+ * @brief Measures the heap allocations of interpolating between robot states, both on its own and as part of
+ * `check_motion_collides`, per interpolated state; with inline joint storage in RobotState, these should be zero.
+ */
+REGISTER_BENCHMARK(interpolation_allocations) {
+	// Create a robot model.
+	robot_model::RobotModel robot = experiments::createProceduralRobotModel();
+
+	// Grab a list of all tree models:
+	auto tree_models = experiments::loadAllTreeBenchmarkData(results);
+
+	// How many edges to check per tree:
+	const size_t N_EDGES = 1000;
+	const size_t N_STEPS_PER_EDGE = 100;
+
+	random_numbers::RandomNumberGenerator rng(42);
+
+	for (const auto &tree_model: tree_models) {
+		std::vector<std::pair<RobotState, RobotState> > edges;
+		edges.reserve(N_EDGES);
+		for (size_t i = 0; i < N_EDGES; ++i) {
+			edges.emplace_back(generateUniformRandomState(robot, rng, 5.0, 10.0),
+							   generateUniformRandomState(robot, rng, 5.0, 10.0));
+		}
+
+		Json::Value tree_json;
+		tree_json["tree_model"] = tree_model.tree_model_name;
+
+		// Plain interpolation and distance computation.
+		double checksum = 0.0;
+		size_t allocations_before = thread_allocation_count();
+		for (const auto &[a, b]: edges) {
+			for (size_t step_i = 0; step_i <= N_STEPS_PER_EDGE; ++step_i) {
+				RobotState state = interpolate(a, b, (double) step_i / (double) N_STEPS_PER_EDGE);
+				checksum += equal_weights_distance(a, state);
+			}
+		}
+		tree_json["interpolate_allocations_per_state"] =
+				(double) (thread_allocation_count() - allocations_before) / (double) (N_EDGES * (N_STEPS_PER_EDGE + 1));
+		tree_json["checksum"] = checksum;
+
+		// Motion collision checks; every state the checker visits is counted as a state query.
+		RobotCollisionModel collision_model(robot);
+		size_t n_colliding = 0;
+		allocations_before = thread_allocation_count();
+		for (const auto &[a, b]: edges) {
+			double toi;
+			n_colliding += check_motion_collides(collision_model, *tree_model.tree_collision_object, a, b, toi) ? 1 : 0;
+		}
+		tree_json["motion_check_allocations_per_state"] =
+				(double) (thread_allocation_count() - allocations_before) / (double) collision_model.getStateQueries();
+		tree_json["n_colliding"] = (int) n_colliding;
+
+		std::cout << "Tree " << tree_model.tree_model_name
+				<< ": interpolation " << tree_json["interpolate_allocations_per_state"].asDouble()
+				<< " allocations/state, motion check " << tree_json["motion_check_allocations_per_state"].asDouble()
+				<< " allocations/state" << std::endl;
+
+		results["trees"].append(tree_json);
+	}
+}
+
+/**
+ * @brief Measures the heap allocations of `eval_static_path` per interpolated state, along a circular orbit around
+ * the tree. The fixed set-up cost is cancelled out by evaluating the same path at two interpolation speeds and
+ * dividing the difference in allocations by the difference in the number of frames.
+ */
+REGISTER_BENCHMARK(eval_static_path_allocations) {
+	const size_t N_ORBIT_STATES = 100;
+	const std::vector<double> INTERPOLATION_SPEEDS = {0.1, 0.01};
+
+	const declarative::PointScanEvalParameters eval_params{
+			.tree_params = declarative::TreeModelParameters{
+					.name = "appletree",
+					.leaf_scale = 1.0,
+					.fruit_subset = declarative::Unchanged{},
+					.seed = 42
+			},
+			.sensor_params = declarative::SensorScalarParameters{
+					.maxViewDistance = INFINITY,
+					.minViewDistance = 0.0,
+					.fieldOfViewAngle = M_PI / 3.0,
+					.maxScanAngle = M_PI / 3.0,
+			}
+	};
+
+	experiments::TreeModelCache cache;
+	const declarative::PointScanEnvironment env = declarative::create_environment(eval_params, cache);
+
+	// A circular orbit around the canopy, facing its center.
+	const math::Vec3d center = env.tree_model->leaves_aabb.center();
+	const double radius = env.tree_model->canopy_radius + 0.5;
+
+	RobotPath path;
+	for (size_t i = 0; i <= N_ORBIT_STATES; ++i) {
+		const double angle = 2.0 * M_PI * (double) i / (double) N_ORBIT_STATES;
+		const math::Vec3d offset(std::cos(angle) * radius, std::sin(angle) * radius, 0.0);
+		path.append(fromEndEffectorAndVector(env.robot, center + offset, -offset));
+	}
+
+	std::vector<size_t> allocations, frames;
+	for (double interpolation_speed: INTERPOLATION_SPEEDS) {
+		const size_t allocations_before = thread_allocation_count();
+		const auto trace = eval_static_path(path, interpolation_speed, eval_params, env, TraceRecording::DELTAS);
+		allocations.push_back(thread_allocation_count() - allocations_before);
+		frames.push_back(trace.frames.size());
+
+		Json::Value speed_json;
+		speed_json["interpolation_speed"] = interpolation_speed;
+		speed_json["n_frames"] = (Json::UInt64) trace.frames.size();
+		speed_json["allocations"] = (Json::UInt64) allocations.back();
+		results["speeds"].append(speed_json);
+	}
+
+	const double marginal = ((double) allocations[1] - (double) allocations[0]) / ((double) frames[1] - (double) frames[0]);
+	results["allocations_per_state"] = marginal;
+
+	std::cout << "eval_static_path: " << marginal << " allocations per interpolated state" << std::endl;
+}
@@ -0,0 +1,170 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <optional>
+
+#include "benchmark_function_macros.h"
+#include "allocation_counting.h"
+#include "../experiment_utils/procedural_robot_models.h"
+#include "../planning/RandomNumberGenerator.h"
+#include "../planning/distance.h"
+#include "../planning/state_tools.h"
+#include "../planning/nearest_neighbours/GreedyKCenters.h"
+#include "../planning/nearest_neighbours/IndexedGNAT.h"
+#include "../planning/nearest_neighbours/NearestNeighborsGNAT.h"
+
+using namespace mgodpl;
+
+/**
+ * @brief Compares the GNAT over (state, vertex) copies that the PRM used to keep, with a std::function distance, to
+ * the IndexedGNAT over indices into the state array, built both incrementally and in bulk; reports the heap memory,
+ * build time and k-NN query throughput of each, and how many queries each gets wrong against a brute-force search.
+ */
+REGISTER_BENCHMARK(gnat_index_vs_state_copies) {
+	const std::vector<size_t> N_POINTS = {1000, 10000, 50000};
+	const size_t N_QUERIES = 1000;
+	const size_t K = 10;
+
+	robot_model::RobotModel robot = experiments::createProceduralRobotModel();
+	random_numbers::RandomNumberGenerator rng(42);
+
+	auto time_ms = [](const auto &fn) {
+		auto start_time = std::chrono::high_resolution_clock::now();
+		fn();
+		auto end_time = std::chrono::high_resolution_clock::now();
+		return (double) std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count() /
+			   1000.0;
+	};
+
+	// Measure the time and net heap growth of building an index.
+	auto measure_build = [&](Json::Value &json, const auto &build_fn) {
+		const std::ptrdiff_t bytes_before = thread_live_heap_bytes();
+		json["build_ms"] = time_ms(build_fn);
+		json["heap_bytes"] = (Json::Int64) (thread_live_heap_bytes() - bytes_before);
+	};
+
+	for (size_t n_points: N_POINTS) {
+		std::vector<RobotState> states;
+		states.reserve(n_points);
+		for (size_t i = 0; i < n_points; ++i) {
+			states.push_back(generateUniformRandomState(robot, rng, 5.0, 10.0));
+		}
+
+		std::vector<RobotState> queries;
+		for (size_t i = 0; i < N_QUERIES; ++i) {
+			queries.push_back(generateUniformRandomState(robot, rng, 5.0, 10.0));
+		}
+
+		auto state_of = [&](size_t i) -> const RobotState & {
+			return states[i];
+		};
+
+		// Brute-force ground truth, nearest first, ties broken on index like both indices do.
+		std::vector<std::vector<size_t> > exact_results(N_QUERIES);
+		for (size_t q = 0; q < N_QUERIES; ++q) {
+			std::vector<std::pair<double, size_t> > distances;
+			distances.reserve(n_points);
+			for (size_t i = 0; i < n_points; ++i) {
+				distances.emplace_back(equal_weights_distance(queries[q], states[i]), i);
+			}
+			std::partial_sort(distances.begin(), distances.begin() + K, distances.end());
+			for (size_t i = 0; i < K; ++i) {
+				exact_results[q].push_back(distances[i].second);
+			}
+		}
+
+		// Count the queries whose k nearest neighbours differ from the brute-force ones (by distance, so that ties
+		// between equidistant points are not counted).
+		auto count_wrong = [&](const std::vector<std::vector<size_t> > &found) {
+			int n_wrong = 0;
+			for (size_t q = 0; q < N_QUERIES; ++q) {
+				bool wrong = found[q].size() != exact_results[q].size();
+				for (size_t i = 0; !wrong && i < found[q].size(); ++i) {
+					wrong = equal_weights_distance(queries[q], states[found[q][i]]) !=
+							equal_weights_distance(queries[q], states[exact_results[q][i]]);
+				}
+				n_wrong += wrong ? 1 : 0;
+			}
+			return n_wrong;
+		};
+
+		Json::Value n_json;
+		n_json["n_points"] = (int) n_points;
+		n_json["state_bytes"] = (Json::UInt64) (n_points * sizeof(RobotState));
+
+		// The old index, as set up by the PRM: copies of the states, and the distance through a std::function.
+		using Entry = std::pair<RobotState, size_t>;
+		std::optional<ompl::NearestNeighborsGNAT<Entry> > copies;
+		random_numbers::RandomNumberGenerator pivot_rng(42);
+		std::function copies_distance = [](const Entry &a, const Entry &b) {
+			return equal_weights_distance(a.first, b.first);
+		};
+
+		Json::Value copies_json;
+		measure_build(copies_json, [&]() {
+			copies.emplace([&](const std::vector<Entry> &data, unsigned int k) {
+				return greedy_k_centers<Entry>(data, k, copies_distance, pivot_rng);
+			});
+			copies->setDistanceFunction(copies_distance);
+			for (size_t i = 0; i < n_points; ++i) {
+				copies->add({states[i], i});
+			}
+		});
+
+		std::vector<std::vector<size_t> > copies_results(N_QUERIES);
+		copies_json["query_ms"] = time_ms([&]() {
+			std::vector<Entry> neighbours;
+			for (size_t q = 0; q < N_QUERIES; ++q) {
+				copies->nearestK({queries[q], 0}, K, neighbours);
+				for (const auto &[state, index]: neighbours) {
+					copies_results[q].push_back(index);
+				}
+			}
+		});
+		copies_json["n_wrong"] = count_wrong(copies_results);
+		n_json["copies"] = copies_json;
+
+		// The new index, built incrementally (as the PRM does) and in bulk.
+		for (const bool bulk: {false, true}) {
+			std::optional<IndexedGNAT<RobotState, EqualWeightsDistance> > indexed;
+
+			Json::Value indexed_json;
+			measure_build(indexed_json, [&]() {
+				indexed.emplace();
+				if (bulk) {
+					std::vector<size_t> indices(n_points);
+					std::iota(indices.begin(), indices.end(), 0);
+					indexed->build(std::move(indices), state_of);
+				} else {
+					for (size_t i = 0; i < n_points; ++i) {
+						indexed->add(i, state_of);
+					}
+				}
+			});
+			indexed_json["size_bytes"] = (Json::UInt64) indexed->size_bytes();
+
+			std::vector<std::vector<size_t> > indexed_results(N_QUERIES);
+			indexed_json["query_ms"] = time_ms([&]() {
+				for (size_t q = 0; q < N_QUERIES; ++q) {
+					indexed->nearestK(queries[q], K, state_of, indexed_results[q]);
+				}
+			});
+			indexed_json["n_wrong"] = count_wrong(indexed_results);
+
+			n_json[bulk ? "indexed_bulk" : "indexed_incremental"] = indexed_json;
+
+			std::cout << n_points << " points: copies " << copies_json["heap_bytes"].asInt64() << " B / "
+					<< copies_json["query_ms"].asDouble() << " ms, indexed (" << (bulk ? "bulk" : "incremental") << ") "
+					<< indexed_json["heap_bytes"].asInt64() << " B / " << indexed_json["query_ms"].asDouble() << " ms, "
+					<< indexed_json["n_wrong"].asInt() << "/" << copies_json["n_wrong"].asInt() << " wrong queries"
+					<< std::endl;
+		}
+
+		results["sizes"].append(n_json);
+	}
+}
@@ -0,0 +1,155 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <chrono>
+#include <iostream>
+#include <optional>
+
+#include <CGAL/Simple_cartesian.h>
+#include <CGAL/AABB_tree.h>
+#include <CGAL/AABB_traits.h>
+#include <CGAL/AABB_triangle_primitive.h>
+
+#include "benchmark_function_macros.h"
+#include "../experiment_utils/TreeMeshes.h"
+#include "../planning/MeshOcclusionModel.h"
+#include "../planning/RandomNumberGenerator.h"
+
+using namespace mgodpl;
+
+/**
+ * @brief The occlusion check as MeshOcclusionModel used to do it: one CGAL AABB_tree segment query per point.
+ */
+class CgalOcclusionModel {
+	using K = CGAL::Simple_cartesian<double>;
+	using Segment = K::Segment_3;
+	using Point = K::Point_3;
+	using Triangle = K::Triangle_3;
+	using Iterator = std::vector<Triangle>::iterator;
+	using Primitive = CGAL::AABB_triangle_primitive<K, Iterator>;
+	using AABB_triangle_traits = CGAL::AABB_traits<K, Primitive>;
+	using Tree = CGAL::AABB_tree<AABB_triangle_traits>;
+
+	std::vector<Triangle> triangles;
+	Tree tree;
+	double margin;
+
+public:
+	CgalOcclusionModel(const Mesh &mesh, double margin) : margin(margin) {
+		for (const auto &triangle: mesh.triangles) {
+			const auto &p1 = mesh.vertices[triangle[0]];
+			const auto &p2 = mesh.vertices[triangle[1]];
+			const auto &p3 = mesh.vertices[triangle[2]];
+			Triangle t(Point(p1.x(), p1.y(), p1.z()), Point(p2.x(), p2.y(), p2.z()), Point(p3.x(), p3.y(), p3.z()));
+			if (!t.is_degenerate()) {
+				triangles.push_back(t);
+			}
+		}
+		tree.insert(triangles.begin(), triangles.end());
+	}
+
+	[[nodiscard]] bool checkOcclusion(const math::Vec3d &point, const math::Vec3d &viewpoint) const {
+		const auto offsetPoint = point - (point - viewpoint).normalized() * margin;
+		return tree.do_intersect(Segment(Point(viewpoint.x(), viewpoint.y(), viewpoint.z()),
+										 Point(offsetPoint.x(), offsetPoint.y(), offsetPoint.z())));
+	}
+};
+
+/**
+ * @brief Compares the build time and query throughput of the CGAL-based occlusion check against the custom BVH
+ * in MeshOcclusionModel (both one query at a time and as packets of segments sharing a viewpoint), on the leaves
+ * of every tree model.
+ */
+REGISTER_BENCHMARK(occlusion_bvh_vs_cgal) {
+	const size_t N_VIEWPOINTS = 100;
+	const size_t N_POINTS_PER_VIEWPOINT = 1000;
+	const double MARGIN = 0.0;
+
+	random_numbers::RandomNumberGenerator rng(42);
+
+	for (const auto &tree_model_name: tree_meshes::getTreeModelNames()) {
+		const auto tree_model = tree_meshes::loadTreeMeshes(tree_model_name);
+		const Mesh &leaves = tree_model.leaves_mesh;
+		const math::AABBd aabb = mesh_aabb(leaves);
+
+		auto time_ms = [](const auto &fn) {
+			auto start_time = std::chrono::high_resolution_clock::now();
+			fn();
+			auto end_time = std::chrono::high_resolution_clock::now();
+			return (double) std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count() /
+				   1000.0;
+		};
+
+		Json::Value tree_json;
+		tree_json["tree_model"] = tree_model_name;
+		tree_json["n_triangles"] = (int) leaves.triangles.size();
+
+		std::optional<CgalOcclusionModel> cgal_model;
+		std::optional<MeshOcclusionModel> bvh_model;
+		tree_json["cgal_build_ms"] = time_ms([&]() { cgal_model.emplace(leaves, MARGIN); });
+		tree_json["bvh_build_ms"] = time_ms([&]() { bvh_model.emplace(leaves, MARGIN); });
+
+		// Viewpoints around the canopy, each looking at points inside of it.
+		std::vector<math::Vec3d> viewpoints;
+		std::vector<std::vector<math::Vec3d> > points(N_VIEWPOINTS);
+		for (size_t i = 0; i < N_VIEWPOINTS; ++i) {
+			const math::Vec3d size = aabb.size();
+			viewpoints.emplace_back(
+					aabb.min().x() + rng.uniformReal(-0.5, 1.5) * size.x(),
+					aabb.min().y() + rng.uniformReal(-0.5, 1.5) * size.y(),
+					aabb.min().z() + rng.uniformReal(0.0, 1.0) * size.z());
+			for (size_t j = 0; j < N_POINTS_PER_VIEWPOINT; ++j) {
+				points[i].emplace_back(
+						aabb.min().x() + rng.uniform01() * size.x(),
+						aabb.min().y() + rng.uniform01() * size.y(),
+						aabb.min().z() + rng.uniform01() * size.z());
+			}
+		}
+
+		std::vector<std::vector<bool> > cgal_occluded(N_VIEWPOINTS);
+		std::vector<std::vector<bool> > bvh_occluded(N_VIEWPOINTS);
+		std::vector<std::vector<bool> > packet_occluded(N_VIEWPOINTS);
+
+		tree_json["cgal_query_ms"] = time_ms([&]() {
+			for (size_t i = 0; i < N_VIEWPOINTS; ++i) {
+				for (const auto &point: points[i]) {
+					cgal_occluded[i].push_back(cgal_model->checkOcclusion(point, viewpoints[i]));
+				}
+			}
+		});
+
+		tree_json["bvh_query_ms"] = time_ms([&]() {
+			for (size_t i = 0; i < N_VIEWPOINTS; ++i) {
+				for (const auto &point: points[i]) {
+					bvh_occluded[i].push_back(bvh_model->checkOcclusion(point, viewpoints[i]));
+				}
+			}
+		});
+
+		tree_json["bvh_packet_query_ms"] = time_ms([&]() {
+			for (size_t i = 0; i < N_VIEWPOINTS; ++i) {
+				bvh_model->checkOcclusion(points[i], viewpoints[i], packet_occluded[i]);
+			}
+		});
+
+		// The results should agree, up to segments grazing a triangle edge or lying in its plane.
+		int disagreements = 0;
+		int packet_disagreements = 0;
+		for (size_t i = 0; i < N_VIEWPOINTS; ++i) {
+			for (size_t j = 0; j < N_POINTS_PER_VIEWPOINT; ++j) {
+				disagreements += cgal_occluded[i][j] != bvh_occluded[i][j];
+				packet_disagreements += bvh_occluded[i][j] != packet_occluded[i][j];
+			}
+		}
+		tree_json["disagreements"] = disagreements;
+		tree_json["packet_disagreements"] = packet_disagreements;
+
+		std::cout << "Tree " << tree_model_name << ": CGAL " << tree_json["cgal_query_ms"].asDouble()
+				<< " ms, BVH " << tree_json["bvh_query_ms"].asDouble()
+				<< " ms, BVH packets " << tree_json["bvh_packet_query_ms"].asDouble()
+				<< " ms, " << disagreements << " disagreements" << std::endl;
+
+		results["trees"].append(tree_json);
+	}
+}
@@ -0,0 +1,98 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <chrono>
+#include <iostream>
+#include <optional>
+
+#include "benchmark_function_macros.h"
+#include "../experiment_utils/TreeMeshes.h"
+#include "../math/AABBGrid.h"
+#include "../math/Triangle.h"
+#include "../visibility/GridVec.h"
+#include "../visibility/octree_visibility.h"
+#include "../visibility/voxel_visibility.h"
+
+using namespace mgodpl;
+
+/**
+ * @brief Compares occlusion casting of the leaves of every tree model into a dense Grid3D against casting into a
+ * linear octree (both the divide-and-conquer and the sorted-batches variant), at 128³ and 256³ cells; reports the
+ * time and memory used, the number of occluded cells, and how many cells the octree disagrees with the grid on.
+ */
+REGISTER_BENCHMARK(octree_vs_dense_occlusion) {
+	const std::vector<unsigned> DEPTHS = {7, 8};
+
+	auto time_ms = [](const auto &fn) {
+		auto start_time = std::chrono::high_resolution_clock::now();
+		fn();
+		auto end_time = std::chrono::high_resolution_clock::now();
+		return (double) std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count() /
+			   1000.0;
+	};
+
+	for (const auto &tree_model_name: tree_meshes::getTreeModelNames()) {
+		const auto tree_model = tree_meshes::loadTreeMeshes(tree_model_name);
+		const Mesh &leaves = tree_model.leaves_mesh;
+		const math::AABBd aabb = mesh_aabb(leaves);
+
+		std::vector<math::Triangle> triangles;
+		triangles.reserve(leaves.triangles.size());
+		for (const auto &triangle: leaves.triangles) {
+			triangles.emplace_back(leaves.vertices[triangle[0]],
+								   leaves.vertices[triangle[1]],
+								   leaves.vertices[triangle[2]]);
+		}
+
+		// An eye to the side of the canopy, at half its height.
+		const math::Vec3d eye = aabb.center() + math::Vec3d(aabb.size().x(), 0.0, 0.0);
+
+		Json::Value tree_json;
+		tree_json["tree_model"] = tree_model_name;
+		tree_json["n_triangles"] = (int) triangles.size();
+
+		for (unsigned depth: DEPTHS) {
+			const size_t resolution = size_t(1) << depth;
+			const math::AABBGrid grid(aabb, resolution, resolution, resolution);
+
+			std::optional<Grid3D<bool> > dense;
+			std::optional<visibility::VisibilityOctree> dnc, sorting;
+
+			const double dense_ms = time_ms([&]() {
+				dense = voxel_visibility::cast_occlusion(grid, triangles, eye);
+			});
+			const double dnc_ms = time_ms([&]() {
+				dnc = visibility::cast_occlusion_batch_dnc(aabb, triangles, eye, depth);
+			});
+			const double sorting_ms = time_ms([&]() {
+				sorting = visibility::cast_occlusion_batch_sorting(aabb, triangles, eye, depth);
+			});
+
+			Grid3D<bool> common = visibility::to_grid(*dnc);
+			common &= *dense;
+			const size_t n_dense = dense->count();
+			const size_t n_octree = visibility::count_occluded(*dnc);
+
+			Json::Value depth_json;
+			depth_json["resolution"] = (int) resolution;
+			depth_json["dense_ms"] = dense_ms;
+			depth_json["octree_dnc_ms"] = dnc_ms;
+			depth_json["octree_sorting_ms"] = sorting_ms;
+			depth_json["dense_bytes"] = (Json::UInt64) (dense->data().size() * sizeof(BitGrid3D::Word));
+			depth_json["octree_bytes"] = (Json::UInt64) dnc->size_bytes();
+			depth_json["octree_leaves"] = (Json::UInt64) dnc->leaves().size();
+			depth_json["dense_occluded"] = (Json::UInt64) n_dense;
+			depth_json["octree_occluded"] = (Json::UInt64) n_octree;
+			depth_json["n_different"] = (Json::UInt64) (n_dense + n_octree - 2 * common.count());
+
+			std::cout << "Tree " << tree_model_name << ", " << resolution << "^3: dense " << dense_ms << " ms / "
+					<< depth_json["dense_bytes"].asUInt64() << " B, octree " << dnc_ms << " ms (sorting "
+					<< sorting_ms << " ms) / " << depth_json["octree_bytes"].asUInt64() << " B" << std::endl;
+
+			tree_json["grids"].append(depth_json);
+		}
+
+		results["trees"].append(tree_json);
+	}
+}
@@ -741,6 +741,9 @@ REGISTER_VISUALIZATION(scanning_motions_for_each_fruit) {
 			M_PI_2
 	);
 
+	// Index the points once, for the repeated evaluations below.
+	const ScanEvaluationIndex scan_index(scan_points);
+
 	std::vector<SeenPoints> ever_seen;
 	ever_seen.reserve(scan_points.size());
 	for (const auto &scannable_points: scan_points) {
@@ -799,7 +802,7 @@ REGISTER_VISUALIZATION(scanning_motions_for_each_fruit) {
 	if (POST_OPTIMIZE) {
 
 		double length_before = pathLength(path, equal_weights_distance);
-		auto scanned_before = count_scanned_points(robot_model, path, scan_points, 0.05);
+		auto scanned_before = count_scanned_points(robot_model, path, scan_points, scan_index, 0.05);
 		double length_after_unassociated, length_after_associated, length_after_shortcutting;
 		PointScanStats scanned_after_unassociated, scanned_after_associated, scanned_after_shortcutting;
 
@@ -834,17 +837,17 @@ REGISTER_VISUALIZATION(scanning_motions_for_each_fruit) {
 						},
 						.end_deleting_unassociated_waypoints = [&](const RobotPath &path) {
 							length_after_unassociated = pathLength(path, equal_weights_distance);
-							scanned_after_unassociated = count_scanned_points(robot_model, path, scan_points, 0.05);
+							scanned_after_unassociated = count_scanned_points(robot_model, path, scan_points, scan_index, 0.05);
 						},
 						.begin_deleting_associated_waypoints = []() {
 						},
 						.end_deleting_associated_waypoints = [&](const RobotPath &path) {
 							length_after_associated = pathLength(path, equal_weights_distance);
-							scanned_after_associated = count_scanned_points(robot_model, path, scan_points, 0.05);
+							scanned_after_associated = count_scanned_points(robot_model, path, scan_points, scan_index, 0.05);
 						},
 						.end_shortcutting = [&](const RobotPath &path) {
 							length_after_shortcutting = pathLength(path, equal_weights_distance);
-							scanned_after_shortcutting = count_scanned_points(robot_model, path, scan_points, 0.05);
+							scanned_after_shortcutting = count_scanned_points(robot_model, path, scan_points, scan_index, 0.05);
 						}
 				});
 		double length_after = pathLength(path, equal_weights_distance);
@@ -871,7 +874,7 @@ REGISTER_VISUALIZATION(scanning_motions_for_each_fruit) {
 			  << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count()
 			  << "ms" << std::endl;
 
-	auto eval = count_scanned_points(robot_model, path, scan_points, 0.05);
+	auto eval = count_scanned_points(robot_model, path, scan_points, scan_index, 0.05);
 	size_t total_points = 0;
 	for (const auto &scannable_points: scan_points) {
 		total_points += scannable_points.surface_points.size();
@@ -106,8 +106,8 @@ REGISTER_VISUALIZATION(single_start_straight_arm_single_target) {
 
 			size_t points_seen = 0;
 			for (size_t pt_i = 0; pt_i < points.size(); ++pt_i) {
-				if (!ever_seen.ever_seen[pt_i] && sensor_model.is_visible(ee_pos, ray, points[pt_i])) {
-					ever_seen.ever_seen[pt_i] = true;
+				if (!ever_seen.is_seen(pt_i) && sensor_model.is_visible(ee_pos, ray, points[pt_i])) {
+					ever_seen.mark_seen(pt_i);
 					points_seen++;
 				}
 			}
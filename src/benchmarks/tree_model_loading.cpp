@@ -0,0 +1,62 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <chrono>
+#include <iostream>
+
+#include "benchmark_function_macros.h"
+#include "../experiment_utils/TreeMeshes.h"
+#include "../experiment_utils/leaf_scaling.h"
+#include "../experiment_utils/tree_mesh_cache.h"
+#include "../planning/cgal_chull_shortest_paths.h"
+
+using namespace mgodpl;
+
+/**
+ * @brief Compares loading every tree model from its COLLADA source files (and deriving the fruit positions, leaf
+ * root points and convex hull) against loading it from the binary tree model cache; reports the time taken by each.
+ */
+REGISTER_BENCHMARK(tree_model_loading) {
+	auto time_ms = [](const auto &fn) {
+		auto start_time = std::chrono::high_resolution_clock::now();
+		fn();
+		auto end_time = std::chrono::high_resolution_clock::now();
+		return (double) std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count() /
+			   1000.0;
+	};
+
+	for (const auto &tree_model_name: tree_meshes::getTreeModelNames()) {
+		Json::Value tree_json;
+		tree_json["tree_model"] = tree_model_name;
+
+		size_t n_fruit = 0;
+		tree_json["source_ms"] = time_ms([&]() {
+			const auto meshes = tree_meshes::loadTreeMeshesFromDae(tree_model_name);
+			const auto fruit_positions = tree_meshes::computeFruitPositions(meshes);
+			const auto root_points = leaf_root_points(meshes);
+			const auto convex_hull = cgal::cgal_convex_hull_around_leaves(meshes.leaves_mesh);
+			n_fruit = fruit_positions.size();
+		});
+
+		// The first load through the cache (re-)generates it if the source files changed, so time a second one.
+		tree_meshes::loadCachedTreeModel(tree_model_name);
+
+		size_t n_cached_fruit = 0;
+		tree_json["hash_ms"] = time_ms([&]() {
+			tree_meshes::hash_tree_model_sources(tree_model_name);
+		});
+		tree_json["cached_ms"] = time_ms([&]() {
+			n_cached_fruit = tree_meshes::loadCachedTreeModel(tree_model_name).fruit_centers.size();
+		});
+
+		tree_json["n_fruit"] = (int) n_fruit;
+		tree_json["n_cached_fruit"] = (int) n_cached_fruit;
+
+		std::cout << "Tree " << tree_model_name << ": source " << tree_json["source_ms"].asDouble() << " ms, cached "
+				<< tree_json["cached_ms"].asDouble() << " ms (of which hashing " << tree_json["hash_ms"].asDouble()
+				<< " ms)" << std::endl;
+
+		results["trees"].append(tree_json);
+	}
+}
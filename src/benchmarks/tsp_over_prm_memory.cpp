@@ -0,0 +1,134 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "benchmark_function_macros.h"
+#include "../experiment_utils/tree_benchmark_data.h"
+#include "../experiment_utils/procedural_robot_models.h"
+#include "../planning/RandomNumberGenerator.h"
+#include "../planning/tsp_over_prm.h"
+
+using namespace mgodpl;
+
+/**
+ * @brief Read the peak resident set size of this process, in kilobytes, from /proc/self/status.
+ */
+static size_t peak_rss_kb() {
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.rfind("VmHWM:", 0) == 0) {
+			return std::stoul(line.substr(6));
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Reset the peak resident set size to the current one. (Linux-specific; silently does nothing elsewhere.)
+ */
+static void reset_peak_rss() {
+	std::ofstream clear_refs("/proc/self/clear_refs");
+	clear_refs << "5";
+}
+
+/**
+ * @brief The heap size of the goal-to-goal search results, in bytes.
+ */
+static size_t goal_to_goal_table_bytes(const GoalToGoalPathResults &results) {
+	size_t bytes = results.goal_distance_matrix.capacity() * sizeof(double) +
+				   results.start_goal_distances.capacity() * sizeof(double) +
+				   results.start_to_goals_distances.capacity() * sizeof(double) +
+				   results.start_to_goals_predecessors.capacity() * sizeof(PRMGraph::vertex_descriptor);
+	for (const auto &row: results.distance_lookup) {
+		bytes += row.capacity() * sizeof(double);
+	}
+	for (const auto &row: results.predecessor_lookup) {
+		bytes += row.capacity() * sizeof(PRMGraph::vertex_descriptor);
+	}
+	return bytes;
+}
+
+/**
+ * @brief Compares the memory use (goal-to-goal table size and process peak RSS) and run time of TSP-over-PRM with
+ * the full goal-to-goal predecessor tables against the compact distance matrix with lazy path recovery.
+ */
+REGISTER_BENCHMARK(tsp_over_prm_goal_table_memory) {
+	// Create a robot model.
+	robot_model::RobotModel robot = experiments::createProceduralRobotModel();
+
+	// Grab a list of all tree models:
+	auto tree_models = experiments::loadAllTreeBenchmarkData(results);
+
+	const std::vector<std::pair<GoalToGoalStorage, std::string> > storage_modes = {
+			{GoalToGoalStorage::FULL, "full"},
+			{GoalToGoalStorage::COMPACT, "compact"}
+	};
+
+	for (const auto &tree_model: tree_models) {
+		Json::Value tree_json;
+		tree_json["tree_model"] = tree_model.tree_model_name;
+		tree_json["n_targets"] = (int) tree_model.target_points.size();
+
+		for (const auto &[storage, storage_name]: storage_modes) {
+			size_t table_bytes = 0;
+
+			TspOverPrmHooks hooks;
+			hooks.on_goal_to_goal_paths_calculated = [&](const GoalToGoalPathResults &goal_to_goal_paths) {
+				table_bytes = goal_to_goal_table_bytes(goal_to_goal_paths);
+			};
+
+			RobotState start_state{
+					.base_tf = math::Transformd::fromTranslation({-10, -10, 0}),
+					.joint_values = std::vector(robot.count_joint_variables(), 0.0)
+			};
+
+			// Same seed for both modes, so they build the same roadmap.
+			random_numbers::RandomNumberGenerator rng(42);
+
+			reset_peak_rss();
+			size_t rss_before = peak_rss_kb();
+			auto start_time = std::chrono::high_resolution_clock::now();
+
+			RobotPath path = plan_path_tsp_over_prm(start_state,
+													tree_model.target_points,
+													robot,
+													*tree_model.tree_collision_object,
+													TspOverPrmParameters{
+															.n_neighbours = 5,
+															.max_samples = 1000,
+															.goal_sample_params = GoalSampleParams{
+																	.k_neighbors = 5,
+																	.max_valid_samples = 2,
+																	.max_attempts = 100
+															},
+															.goal_to_goal_storage = storage
+													},
+													rng,
+													hooks);
+
+			auto end_time = std::chrono::high_resolution_clock::now();
+
+			Json::Value mode_json;
+			mode_json["goal_to_goal_table_bytes"] = (Json::UInt64) table_bytes;
+			mode_json["peak_rss_kb"] = (Json::UInt64) peak_rss_kb();
+			mode_json["peak_rss_increase_kb"] = (Json::UInt64) (peak_rss_kb() - rss_before);
+			mode_json["time_ms"] = (int) std::chrono::duration_cast<std::chrono::milliseconds>(
+					end_time - start_time).count();
+			mode_json["path_length"] = (int) path.states.size();
+
+			std::cout << "Tree " << tree_model.tree_model_name << ", " << storage_name << " tables: "
+					<< table_bytes / 1024 << " KiB, peak RSS increase "
+					<< mode_json["peak_rss_increase_kb"].asUInt64() << " KiB" << std::endl;
+
+			tree_json[storage_name] = mode_json;
+		}
+
+		results["trees"].append(tree_json);
+	}
+}
@@ -0,0 +1,111 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include "benchmark_function_macros.h"
+#include "../math/Vec3.h"
+#include "../planning/traveling_salesman.h"
+
+using namespace mgodpl;
+
+/**
+ * @brief Compares tour length and run time of the native TSP solver against OR-tools, on random Euclidean instances
+ * of increasing size, both ungrouped and grouped (1-3 items per group).
+ */
+REGISTER_BENCHMARK(tsp_solver_comparison) {
+	const std::vector<size_t> instance_sizes = {10, 50, 100, 200, 500};
+
+	const std::vector<std::pair<TspSolver, std::string> > solvers = {
+			{TspSolver::NATIVE, "native"},
+			{TspSolver::OR_TOOLS, "or_tools"}
+	};
+
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<double> coordinate(-10.0, 10.0);
+	std::uniform_int_distribution<size_t> group_size(1, 3);
+
+	for (size_t n: instance_sizes) {
+
+		// Ungrouped instance: n points.
+		std::vector<math::Vec3d> points;
+		for (size_t i = 0; i < n; ++i) {
+			points.emplace_back(coordinate(rng), coordinate(rng), coordinate(rng));
+		}
+
+		// Grouped instance: n groups of 1-3 points each.
+		std::vector<size_t> sizes;
+		std::vector<std::vector<math::Vec3d> > groups;
+		for (size_t i = 0; i < n; ++i) {
+			sizes.push_back(group_size(rng));
+			groups.emplace_back();
+			for (size_t j = 0; j < sizes.back(); ++j) {
+				groups.back().emplace_back(coordinate(rng), coordinate(rng), coordinate(rng));
+			}
+		}
+
+		Json::Value instance_json;
+		instance_json["n"] = (int) n;
+
+		for (const auto &[solver, solver_name]: solvers) {
+			Json::Value solver_json;
+
+			{
+				auto start_time = std::chrono::high_resolution_clock::now();
+				auto tour = tsp_open_end(
+						[&](size_t i) { return points[i].norm(); },
+						[&](size_t i, size_t j) { return (points[i] - points[j]).norm(); },
+						n,
+						solver);
+				auto end_time = std::chrono::high_resolution_clock::now();
+
+				double length = 0.0;
+				math::Vec3d previous{0, 0, 0};
+				for (size_t i: tour) {
+					length += (points[i] - previous).norm();
+					previous = points[i];
+				}
+
+				solver_json["ungrouped"]["tour_length"] = length;
+				solver_json["ungrouped"]["time_ms"] = (double) std::chrono::duration_cast<std::chrono::microseconds>(
+						end_time - start_time).count() / 1000.0;
+			}
+
+			{
+				auto start_time = std::chrono::high_resolution_clock::now();
+				auto tour = tsp_open_end_grouped(
+						[&](std::pair<size_t, size_t> a) { return groups[a.first][a.second].norm(); },
+						[&](std::pair<size_t, size_t> a, std::pair<size_t, size_t> b) {
+							return (groups[a.first][a.second] - groups[b.first][b.second]).norm();
+						},
+						sizes,
+						solver);
+				auto end_time = std::chrono::high_resolution_clock::now();
+
+				double length = 0.0;
+				math::Vec3d previous{0, 0, 0};
+				for (const auto &[group, item]: tour) {
+					length += (groups[group][item] - previous).norm();
+					previous = groups[group][item];
+				}
+
+				solver_json["grouped"]["tour_length"] = length;
+				solver_json["grouped"]["time_ms"] = (double) std::chrono::duration_cast<std::chrono::microseconds>(
+						end_time - start_time).count() / 1000.0;
+			}
+
+			std::cout << "n = " << n << ", " << solver_name
+					<< ": ungrouped " << solver_json["ungrouped"]["tour_length"].asDouble()
+					<< " (" << solver_json["ungrouped"]["time_ms"].asDouble() << " ms)"
+					<< ", grouped " << solver_json["grouped"]["tour_length"].asDouble()
+					<< " (" << solver_json["grouped"]["time_ms"].asDouble() << " ms)" << std::endl;
+
+			instance_json[solver_name] = solver_json;
+		}
+
+		results["instances"].append(instance_json);
+	}
+}
@@ -0,0 +1,85 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <chrono>
+#include <iostream>
+#include <optional>
+
+#include "benchmark_function_macros.h"
+#include "../experiment_utils/TreeMeshes.h"
+#include "../math/AABBGrid.h"
+#include "../math/Triangle.h"
+#include "../visibility/GridVec.h"
+#include "../visibility/voxel_visibility.h"
+
+using namespace mgodpl;
+
+/**
+ * @brief Times voxel occlusion casting of the leaves of every tree model into 128³ and 256³ grids, cast as a single
+ * chunk versus in parallel chunks; reports the number of occluded cells for both, and how many cells they disagree on.
+ */
+REGISTER_BENCHMARK(voxel_cast_occlusion) {
+	const std::vector<size_t> RESOLUTIONS = {128, 256};
+
+	auto time_ms = [](const auto &fn) {
+		auto start_time = std::chrono::high_resolution_clock::now();
+		fn();
+		auto end_time = std::chrono::high_resolution_clock::now();
+		return (double) std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count() /
+			   1000.0;
+	};
+
+	for (const auto &tree_model_name: tree_meshes::getTreeModelNames()) {
+		const auto tree_model = tree_meshes::loadTreeMeshes(tree_model_name);
+		const Mesh &leaves = tree_model.leaves_mesh;
+		const math::AABBd aabb = mesh_aabb(leaves);
+
+		std::vector<math::Triangle> triangles;
+		triangles.reserve(leaves.triangles.size());
+		for (const auto &triangle: leaves.triangles) {
+			triangles.emplace_back(leaves.vertices[triangle[0]],
+								   leaves.vertices[triangle[1]],
+								   leaves.vertices[triangle[2]]);
+		}
+
+		// An eye to the side of the canopy, at half its height.
+		const math::Vec3d eye = aabb.center() + math::Vec3d(aabb.size().x(), 0.0, 0.0);
+
+		Json::Value tree_json;
+		tree_json["tree_model"] = tree_model_name;
+		tree_json["n_triangles"] = (int) triangles.size();
+
+		for (size_t resolution: RESOLUTIONS) {
+			const math::AABBGrid grid(aabb, resolution, resolution, resolution);
+
+			std::optional<Grid3D<bool> > serial, parallel;
+			const double serial_ms = time_ms([&]() {
+				serial = voxel_visibility::cast_occlusion(grid, triangles, eye, 1);
+			});
+			const double parallel_ms = time_ms([&]() {
+				parallel = voxel_visibility::cast_occlusion(grid, triangles, eye);
+			});
+
+			Grid3D<bool> common = *serial;
+			common &= *parallel;
+			const size_t n_common = common.count();
+
+			Json::Value resolution_json;
+			resolution_json["resolution"] = (int) resolution;
+			resolution_json["serial_ms"] = serial_ms;
+			resolution_json["parallel_ms"] = parallel_ms;
+			resolution_json["serial_occluded"] = (Json::UInt64) serial->count();
+			resolution_json["parallel_occluded"] = (Json::UInt64) parallel->count();
+			resolution_json["n_different"] = (Json::UInt64) (serial->count() + parallel->count() - 2 * n_common);
+
+			std::cout << "Tree " << tree_model_name << ", " << resolution << "^3: serial " << serial_ms
+					<< " ms, parallel " << parallel_ms << " ms, " << serial->count() << " vs " << parallel->count()
+					<< " occluded cells" << std::endl;
+
+			tree_json["grids"].append(resolution_json);
+		}
+
+		results["trees"].append(tree_json);
+	}
+}
@@ -9,6 +9,7 @@
 #include "TreeMeshes.h"
 #include "mesh_connected_components.h"
 #include "mesh_from_dae.h"
+#include "tree_mesh_cache.h"
 
 namespace mgodpl::tree_meshes {
 	/**
@@ -25,7 +26,7 @@ namespace mgodpl::tree_meshes {
 	 * @param treeName	The name of the tree to load.
 	 * @return			The tree meshes, separated by trunk, leaves, and fruit (fruit further broken down into individual fruit).
 	 */
-	TreeMeshes loadTreeMeshes(const std::string &treeName) {
+	TreeMeshes loadTreeMeshesFromDae(const std::string &treeName) {
 		TreeMeshes meshes;
 
 		meshes.tree_name = treeName;
@@ -47,6 +48,7 @@ namespace mgodpl::tree_meshes {
 		size_t n_before = meshes.fruit_meshes.size();
 
 		// Some meshes are actually tiny sliver triangles that represent the "Stem" of the fruit. WE should ignore these.
+		// (The result is cached; bump TREE_CACHE_PROCESSING_VERSION when changing this filter.)
 		meshes.fruit_meshes
 				.erase(std::remove_if(meshes.fruit_meshes.begin(),
 				                      meshes.fruit_meshes.end(),
@@ -65,6 +67,10 @@ namespace mgodpl::tree_meshes {
 		return meshes;
 	}
 
+	TreeMeshes loadTreeMeshes(const std::string &treeName) {
+		return loadCachedTreeModel(treeName).meshes;
+	}
+
 	std::vector<std::string> getTreeModelNames() {
 		std::string root(MYSOURCE_ROOT);
 
@@ -29,11 +29,22 @@ namespace mgodpl::tree_meshes {
 	 * This function loads the meshes for the leaves, trunk, and fruit of the given tree from the specific directory.
 	 * The fruit meshes are further broken down into individual fruit.
 	 *
+	 * The meshes are read from the binary tree model cache (see loadCachedTreeModel), which is generated from the
+	 * source files on first use, and whenever they change.
+	 *
 	 * @param treeName The name of the tree to load the meshes for.
 	 * @return The loaded meshes.
 	 */
 	TreeMeshes loadTreeMeshes(const std::string &treeName);
 
+	/**
+	 * @brief Loads the meshes for the given tree from its source (.dae) files, bypassing the binary cache.
+	 *
+	 * @param treeName The name of the tree to load the meshes for.
+	 * @return The loaded meshes.
+	 */
+	TreeMeshes loadTreeMeshesFromDae(const std::string &treeName);
+
 	/**
 	 * @brief Fetches the names of all tree models present in the specified directory.
 	 *
@@ -105,6 +116,11 @@ namespace mgodpl::tree_meshes {
 	 */
 	SimplifiedOrchard makeSingleRowOrchard(std::vector<TreeMeshes> &tree_models);
 
+	/**
+	 * @brief The center of the bounding box of every fruit mesh.
+	 *
+	 * Stored in the binary tree model cache; bump TREE_CACHE_PROCESSING_VERSION if this changes.
+	 */
 	std::vector<math::Vec3d> computeFruitPositions(const TreeMeshes &tree_meshes);
 
 }
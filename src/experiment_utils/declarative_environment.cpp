@@ -12,17 +12,18 @@
 #include "procedural_fruit_placement.h"
 #include "procedural_robot_models.h"
 #include "LoadedTreeModel.h"
+#include "tree_mesh_cache.h"
 #include "../planning/state_tools.h"
 
 mgodpl::experiments::LoadedTreeModel mgodpl::experiments::LoadedTreeModel::from_name(const std::string &name) {
-	const auto meshes = mgodpl::tree_meshes::loadTreeMeshes(name);
-	const auto root_points = leaf_root_points(meshes);
-	const auto leaves_aabb = mesh_aabb(meshes.leaves_mesh);
+	// The leaf root points are expensive to compute, so they come from the binary tree model cache as well.
+	auto cached = mgodpl::tree_meshes::loadCachedTreeModel(name);
+	const auto leaves_aabb = mesh_aabb(cached.meshes.leaves_mesh);
 	const auto canopy_radius = std::min(leaves_aabb.size().x(), leaves_aabb.size().y()) / 2.0;
 
 	return {
-		.meshes = meshes,
-		.root_points = root_points,
+		.meshes = std::move(cached.meshes),
+		.root_points = std::move(cached.leaf_root_points),
 		.leaves_aabb = leaves_aabb,
 		.canopy_radius = canopy_radius
 	};
@@ -163,9 +164,13 @@ std::vector<std::vector<mgodpl::SurfacePoint> > mgodpl::declarative::generate_sc
 }
 
 
+/// Where create_environment keeps the horizon maps it computed, relative to the working directory.
+static const char *HORIZON_MAP_CACHE_DIRECTORY = "horizon_map_cache";
+
 mgodpl::declarative::PointScanEnvironment
 mgodpl::declarative::create_environment(const mgodpl::declarative::PointScanEvalParameters &params,
-                                        experiments::TreeModelCache &tree_model_cache) {
+                                        experiments::TreeModelCache &tree_model_cache,
+                                        OcclusionBackend occlusion_backend) {
 	random_numbers::RandomNumberGenerator rng(params.tree_params.seed);
 
 	// Load the tree model
@@ -177,11 +182,57 @@ mgodpl::declarative::create_environment(const mgodpl::declarative::PointScanEval
 
 	const auto all_scannable_points = generate_scannable_points(fruit_models, params.n_scannable_points_per_fruit, rng);
 
+	// Store the points structure-of-arrays, for the vectorized visibility checks.
+	std::vector<SurfacePointCloud> all_point_clouds;
+	all_point_clouds.reserve(all_scannable_points.size());
+	for (const auto &fruit_points: all_scannable_points) {
+		all_point_clouds.push_back(SurfacePointCloud::fromPoints(fruit_points));
+	}
+
+	// Index them once, so that every frame only touches the points within sensor range.
+	auto point_index = std::make_shared<ScannablePointIndex>(all_point_clouds, params.sensor_params.maxViewDistance);
+
+	// Classify the points as interior (the surface normal points towards the middle of the leaves) once, up front.
+	const math::Vec3d leaves_center = tree_model->leaves_aabb.center();
+	std::vector<PointMask> interior_points;
+	interior_points.reserve(all_scannable_points.size());
+	for (const auto &fruit_points: all_scannable_points) {
+		PointMask interior((fruit_points.size() + 63) / 64, 0);
+		for (size_t i = 0; i < fruit_points.size(); ++i) {
+			if ((fruit_points[i].position - leaves_center).dot(fruit_points[i].normal) > 0) {
+				interior[i / 64] |= uint64_t(1) << (i % 64);
+			}
+		}
+		interior_points.push_back(std::move(interior));
+	}
+
 	// Scale the leaves
 	const auto scaled_leaves = scale_leaves(tree_model->meshes,
 	                                        tree_model->root_points,
 	                                        params.tree_params.leaf_scale);
 
+	// The horizon maps only depend on the points, the leaves and the sensor, so they are cached on disk across runs.
+	std::shared_ptr<const OcclusionHorizonMaps> horizon_maps;
+	if (occlusion_backend == OcclusionBackend::HORIZON_MAPS) {
+		// Beyond the extent of the leaves and points together, a ray can't hit anything anymore.
+		math::AABBd extent = mesh_aabb(scaled_leaves);
+		for (const auto &fruit_points: all_scannable_points) {
+			for (const auto &point: fruit_points) {
+				extent.expand(point.position);
+			}
+		}
+
+		horizon_maps = std::make_shared<OcclusionHorizonMaps>(OcclusionHorizonMaps::load_or_build(
+				HORIZON_MAP_CACHE_DIRECTORY,
+				all_point_clouds,
+				scaled_leaves,
+				{
+						.max_distance = std::min(params.sensor_params.maxViewDistance, extent.size().norm()),
+						.max_scan_angle = params.sensor_params.maxScanAngle,
+						.margin = 0.0
+				}));
+	}
+
 	robot_model::RobotModel robot = experiments::createProceduralRobotModel();
 
 	RobotState initial_state = fromEndEffectorAndVector(robot, {0, 5, 5}, {0, 1, 1});
@@ -192,8 +243,12 @@ mgodpl::declarative::create_environment(const mgodpl::declarative::PointScanEval
 		.tree_model = tree_model,
 		.scaled_leaves = scaled_leaves,
 		.fruit_models = fruit_models,
-		.scannable_points = all_scannable_points,
+		.scannable_points = std::move(all_point_clouds),
+		.scannable_point_index = std::move(point_index),
+		.interior_points = std::move(interior_points),
 		.mesh_occlusion_model = std::make_shared<MeshOcclusionModel>(scaled_leaves, 0.0),
-		.initial_state = initial_state
+		.initial_state = initial_state,
+		.occlusion_backend = occlusion_backend,
+		.occlusion_horizon_maps = std::move(horizon_maps)
 	};
 }
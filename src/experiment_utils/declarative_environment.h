@@ -15,12 +15,27 @@
 #include "../math/AABB.h"
 #include "declarative/SensorModelParameters.h"
 #include "../planning/RobotModel.h"
+#include "../planning/occlusion_horizon_maps.h"
+#include "../planning/scannable_point_index.h"
+#include "../planning/surface_point_cloud.h"
 #include "tree_models.h"
 #include "LoadedTreeModel.h"
 #include "declarative/PointScanExperiment.h"
 
 namespace mgodpl::declarative {
 
+	/**
+	 * How to check whether scannable points are occluded by the leaves.
+	 */
+	enum class OcclusionBackend {
+		/// Exact: cast a ray (segment) through the MeshOcclusionModel for every point.
+		RAY_CAST,
+		/// Approximate: rasterize the leaves into a DepthCubemap once per eye position, then do a depth lookup per point.
+		DEPTH_CUBEMAP,
+		/// Approximate: precompute OcclusionHorizonMaps for all points once (cached on disk), then do a table lookup.
+		HORIZON_MAPS
+	};
+
 	/**
 	 * An instantiation of PointScanEvalParameters, providing a full environment for a point scanning experiment,
 	 * including the robot model, the tree model, the fruit models, and the scannable points.
@@ -36,12 +51,22 @@ namespace mgodpl::declarative {
 		const Mesh scaled_leaves;
 		/// The centers of all the fruits.
 		const FruitModels fruit_models;
-		/// The scannable points per fruit, including surface normal. One vector per fruit mesh, corresponding to tree_model.
-		const std::vector<std::vector<SurfacePoint>> scannable_points;
+		/// The scannable points per fruit, including surface normal. One point cloud per fruit mesh, corresponding to tree_model.
+		const std::vector<SurfacePointCloud> scannable_points;
+		/// A spatial index over all scannable points, with a cell size equal to the maximum view distance.
+		const std::shared_ptr<const ScannablePointIndex> scannable_point_index;
+		/// Per fruit, a mask (one bit per scannable point) of the points whose normal faces towards the center of the leaves.
+		const std::vector<PointMask> interior_points;
 		/// The occlusion model to use to accelerate occlusion checks.
 		const std::shared_ptr<const MeshOcclusionModel> mesh_occlusion_model;
 		/// The initial state of the robot.
 		const RobotState initial_state;
+		/// How to check occlusion during evaluation.
+		const OcclusionBackend occlusion_backend = OcclusionBackend::RAY_CAST;
+		/// The resolution of each face of the depth cube map, if that backend is used.
+		const size_t depth_cubemap_resolution = 1024;
+		/// The horizon maps of all scannable points, if that backend is used; null otherwise.
+		const std::shared_ptr<const OcclusionHorizonMaps> occlusion_horizon_maps = nullptr;
 	};
 
 	std::vector<std::vector<SurfacePoint>> generate_scannable_points(const FruitModels &fruit_models,
@@ -59,9 +84,12 @@ namespace mgodpl::declarative {
 	 *
 	 * @param params 		The parameters to use to create the environment.
 	 * @param rng 			A random number generator to use for sampling points.
+	 * @param occlusion_backend How to check occlusion during evaluation.
 	 * @return 				A PointScanEnvironment instance for the given parameters.
 	 */
-	PointScanEnvironment create_environment(const PointScanEvalParameters &params, experiments::TreeModelCache &tree_model_cache);
+	PointScanEnvironment create_environment(const PointScanEvalParameters &params,
+											experiments::TreeModelCache &tree_model_cache,
+											OcclusionBackend occlusion_backend = OcclusionBackend::RAY_CAST);
 }
 
 #endif //MGODPL_DECLARATIVE_ENVIRONMENT_H
@@ -22,8 +22,8 @@ namespace mgodpl {
 		double translation_distance;
 		/// The distance between the base rotations (in ra
 		double rotation_distance;
-		/// The distance between the angular positions of each joint (absolute value)
-		std::vector<double> joint_distances;
+		/// The distance between the angular positions of each joint (absolute value); stored inline like the joint values.
+		JointValues joint_distances;
 	};
 
 	/**
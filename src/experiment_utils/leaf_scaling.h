@@ -18,6 +18,9 @@ namespace mgodpl {
 
 	/**
 	 * @brief finds the closest point on the trunk for every leaf of the tree and assigns a Vec3d with the coordinates of that root point to every other vertex of the leaf.
+	 *
+	 * The result is stored in the binary tree model cache (see tree_mesh_cache.h); changes here require bumping
+	 * TREE_CACHE_PROCESSING_VERSION.
 	 */
 	std::vector<math::Vec3d> leaf_root_points(const mgodpl::tree_meshes::TreeMeshes &tree_meshes);
 
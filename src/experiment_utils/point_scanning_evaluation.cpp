@@ -6,23 +6,196 @@
 // Created by werner on 3/11/24.
 //
 
+#include <optional>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
 #include <range/v3/view/transform.hpp>
 #include "point_scanning_evaluation.h"
 
 using namespace mgodpl;
 
+/**
+ * Append a frame to an evaluation trace, reading the number of points seen per fruit off the counters.
+ *
+ * @param trace 				The trace to append to.
+ * @param joint_distances 		The joint distances moved during the frame.
+ * @param ever_seen 			The seen status per fruit, as of the end of the frame.
+ * @param last_seen_counts 		The number of points seen per fruit as of the previous frame; updated.
+ */
+static void record_frame(EvaluationTrace &trace,
+						 const JointDistances &joint_distances,
+						 const std::vector<SeenPoints> &ever_seen,
+						 std::vector<size_t> &last_seen_counts) {
+	EvaluationTrace::Frame frame{joint_distances};
+	for (size_t fruit_i = 0; fruit_i < ever_seen.size(); ++fruit_i) {
+		const size_t seen = ever_seen[fruit_i].count_seen();
+		const size_t interior_seen = ever_seen[fruit_i].count_interior_seen();
+		if (!trace.deltas_only) {
+			frame.pts_seen.push_back(seen);
+			frame.interior_pts_seen.push_back(interior_seen);
+		} else if (seen != last_seen_counts[fruit_i]) {
+			// Points never become unseen, and interior points are a subset, so a change shows up in `seen`.
+			frame.changed.push_back({fruit_i, seen, interior_seen});
+		}
+		last_seen_counts[fruit_i] = seen;
+	}
+	trace.frames.push_back(std::move(frame));
+}
+
+/**
+ * The body of the update_seen overloads that use a ScannablePointIndex, generic over the occlusion check.
+ *
+ * @param check_occlusion 	Called as check_occlusion(unseen, positions, eye_position, occluded) for the batch of
+ * 							candidates that weren't seen before (as indices into `point_index`, and their positions);
+ * 							must fill in `occluded`.
+ * @param on_newly_seen 	Called with the index (in `point_index`) of every point that is marked seen.
+ */
+template<typename CheckOcclusion, typename OnNewlySeen>
+static void update_seen_indexed(const declarative::SensorScalarParameters &sensor_params,
+								const CheckOcclusion &check_occlusion,
+								const math::Vec3d &eye_position,
+								const math::Vec3d &eye_forward,
+								const ScannablePointIndex &point_index,
+								std::vector<SeenPoints> &ever_seen,
+								const OnNewlySeen &on_newly_seen) {
+	thread_local std::vector<size_t> candidates;
+	point_index.query(eye_position,
+					  eye_forward,
+					  {
+							  .min_distance = sensor_params.minViewDistance,
+							  .max_distance = sensor_params.maxViewDistance,
+							  .max_scan_angle = sensor_params.maxScanAngle,
+							  .fov_angle = sensor_params.fieldOfViewAngle
+					  },
+					  candidates);
+
+	// Gather the candidates that weren't seen before, and check their occlusion as a batch.
+	thread_local std::vector<size_t> unseen;
+	thread_local std::vector<math::Vec3d> positions;
+	thread_local std::vector<bool> occluded;
+	unseen.clear();
+	positions.clear();
+	for (size_t candidate: candidates) {
+		const auto &[fruit_i, i] = point_index.origin(candidate);
+		if (!ever_seen[fruit_i].is_seen(i)) {
+			unseen.push_back(candidate);
+			positions.push_back(point_index.point(candidate).position);
+		}
+	}
+
+	if (positions.empty()) {
+		return;
+	}
+
+	check_occlusion(unseen, positions, eye_position, occluded);
+
+	for (size_t j = 0; j < unseen.size(); ++j) {
+		if (!occluded[j]) {
+			const auto &[fruit_i, i] = point_index.origin(unseen[j]);
+			ever_seen[fruit_i].mark_seen(i);
+			on_newly_seen(unseen[j]);
+		}
+	}
+}
+
+/**
+ * Check occlusion for a batch of points in a ScannablePointIndex through the horizon maps; the batch form of
+ * OcclusionHorizonMaps::checkOcclusion, matching the interface of the other occlusion checks.
+ */
+static void check_occlusion(const OcclusionHorizonMaps &horizon_maps,
+							const ScannablePointIndex &point_index,
+							const std::vector<size_t> &points,
+							const std::vector<math::Vec3d> &positions,
+							const math::Vec3d &eye_position,
+							std::vector<bool> &occluded) {
+	occluded.resize(points.size());
+	for (size_t j = 0; j < points.size(); ++j) {
+		const auto &[fruit_i, i] = point_index.origin(points[j]);
+		occluded[j] = horizon_maps.checkOcclusion(fruit_i, i, positions[j], eye_position);
+	}
+}
+
+/**
+ * Update the seen status for a single eye pose, checking occlusion with whichever backend the environment selects.
+ *
+ * @param depth_cubemap 	The cube map storage to use with the DEPTH_CUBEMAP backend; allocated on first use.
+ * @param on_newly_seen 	Called with the index (in the environment's point index) of every point that is marked seen.
+ */
+template<typename OnNewlySeen>
+static void update_seen_in_environment(const declarative::PointScanEnvironment &env,
+									   const declarative::SensorScalarParameters &sensor_params,
+									   std::optional<DepthCubemap> &depth_cubemap,
+									   const math::Vec3d &eye_position,
+									   const math::Vec3d &eye_forward,
+									   std::vector<SeenPoints> &ever_seen,
+									   const OnNewlySeen &on_newly_seen) {
+	const ScannablePointIndex &point_index = *env.scannable_point_index;
+
+	switch (env.occlusion_backend) {
+		case declarative::OcclusionBackend::RAY_CAST:
+			update_seen_indexed(sensor_params,
+								[&](const auto &, const auto &positions, const auto &eye, auto &occluded) {
+									env.mesh_occlusion_model->checkOcclusion(positions, eye, occluded);
+								},
+								eye_position,
+								eye_forward,
+								point_index,
+								ever_seen,
+								on_newly_seen);
+			break;
+		case declarative::OcclusionBackend::DEPTH_CUBEMAP:
+			if (!depth_cubemap.has_value()) {
+				depth_cubemap.emplace(env.depth_cubemap_resolution, env.mesh_occlusion_model->getMargin());
+			}
+			update_seen_indexed(sensor_params,
+								[&](const auto &, const auto &positions, const auto &eye, auto &occluded) {
+									// Only rasterize if there is anything to check at all.
+									depth_cubemap->render(env.scaled_leaves, eye);
+									depth_cubemap->checkOcclusion(positions, eye, occluded);
+								},
+								eye_position,
+								eye_forward,
+								point_index,
+								ever_seen,
+								on_newly_seen);
+			break;
+		case declarative::OcclusionBackend::HORIZON_MAPS:
+			assert(env.occlusion_horizon_maps);
+			update_seen_indexed(sensor_params,
+								[&](const auto &unseen, const auto &positions, const auto &eye, auto &occluded) {
+									check_occlusion(*env.occlusion_horizon_maps, point_index, unseen, positions, eye, occluded);
+								},
+								eye_position,
+								eye_forward,
+								point_index,
+								ever_seen,
+								on_newly_seen);
+			break;
+	}
+}
+
 mgodpl::EvaluationTrace mgodpl::eval_static_path(const mgodpl::RobotPath &path,
 												 double interpolation_speed,
 												 const declarative::PointScanEvalParameters &params,
-												 const declarative::PointScanEnvironment &env) {
+												 const declarative::PointScanEnvironment &env,
+												 TraceRecording recording) {
 
 	// Define the current position on the path
 	PathPoint path_point = {0, 0.0};
 
-	std::vector<std::vector<bool>> ever_seen = init_seen_status(env.scannable_points);
+	std::vector<SeenPoints> ever_seen = init_seen_status(env.scannable_points, env.interior_points);
 
 	// Initialize an empty JSON object to store the statistics
 	EvaluationTrace stats;
+	stats.deltas_only = recording == TraceRecording::DELTAS;
+	stats.n_fruits = env.scannable_points.size();
+
+	// The counts as of the previous frame, to detect which fruits changed.
+	std::vector<size_t> last_seen_counts(env.scannable_points.size(), 0);
+
+	// With the depth cube map backend, the storage is allocated on first use and re-rendered for every frame.
+	std::optional<DepthCubemap> depth_cubemap;
 
 	// Put the robot at the current point (the start of the path)
 	RobotState last_state = interpolate(path_point, path);
@@ -41,38 +214,16 @@ mgodpl::EvaluationTrace mgodpl::eval_static_path(const mgodpl::RobotPath &path,
 		math::Vec3d end_effector_forward = interpolated_state.base_tf.orientation.rotate(math::Vec3d(0, 1, 0));
 
 		// Update the visibility of the scannable points
-		update_seen(
-				params.sensor_params,
-				env.mesh_occlusion_model,
-				end_effector_position,
-				end_effector_forward,
-				env.scannable_points,
-				ever_seen);
-
-		// Count the number of points seen for each fruit so far.
-		std::vector<size_t> seen_counts;
-		for (size_t fruit_i = 0; fruit_i < env.scannable_points.size(); ++fruit_i) {
-			seen_counts.push_back(std::count(ever_seen[fruit_i].begin(), ever_seen[fruit_i].end(), true));
-		}
+		update_seen_in_environment(env,
+								   params.sensor_params,
+								   depth_cubemap,
+								   end_effector_position,
+								   end_effector_forward,
+								   ever_seen,
+								   [](size_t) {});
 
-		const math::Vec3d center = env.tree_model->leaves_aabb.center();
-
-		std::vector<size_t> interior_seen_counts;
-		for (size_t fruit_i = 0; fruit_i < env.scannable_points.size(); ++fruit_i) {
-			size_t count = 0;
-			for (size_t i = 0; i < env.scannable_points[fruit_i].size(); ++i) {
-				// Count only if the surface normal points towards the middle of the leaves.
-				if (ever_seen[fruit_i][i] &&
-					(env.scannable_points[fruit_i][i].position - center).dot(env.scannable_points[fruit_i][i].normal) >
-					0) {
-					count++;
-				}
-			}
-			interior_seen_counts.push_back(count);
-		}
-
-		// Add the current frame to the statistics
-		stats.frames.push_back({jd, seen_counts, interior_seen_counts});
+		// Record the number of points seen for each fruit so far.
+		record_frame(stats, jd, ever_seen, last_seen_counts);
 
 		// Update the last state
 		last_state = interpolated_state;
@@ -82,22 +233,114 @@ mgodpl::EvaluationTrace mgodpl::eval_static_path(const mgodpl::RobotPath &path,
 	return stats;
 }
 
+mgodpl::EvaluationTrace mgodpl::eval_static_path_parallel(const mgodpl::RobotPath &path,
+														  double interpolation_speed,
+														  const declarative::PointScanEvalParameters &params,
+														  const declarative::PointScanEnvironment &env,
+														  TraceRecording recording,
+														  size_t n_chunks) {
+
+	// Sample all states along the path up front; this is cheap compared to the visibility checks.
+	PathPoint path_point = {0, 0.0};
+	std::vector<RobotState> states{interpolate(path_point, path)};
+	while (!advancePathPointClamp(path, path_point, interpolation_speed, equal_weights_max_distance)) {
+		states.push_back(interpolate(path_point, path));
+	}
+
+	// Frame i is the step from states[i] to states[i + 1].
+	const size_t n_frames = states.size() - 1;
+
+	if (n_chunks == 0) {
+		n_chunks = (size_t) tbb::this_task_arena::max_concurrency();
+	}
+	n_chunks = std::clamp(n_chunks, (size_t) 1, std::max(n_frames, (size_t) 1));
+
+	// Per frame, the points (as indices into the point index) that became visible, relative to the earlier frames
+	// of the same chunk. Every chunk starts out with nothing seen, so these are a superset of the globally new points.
+	std::vector<std::vector<size_t> > newly_visible(n_frames);
+
+	// One cube map per worker thread rather than per chunk, since each is large; every frame re-renders it anyway.
+	tbb::enumerable_thread_specific<std::optional<DepthCubemap> > depth_cubemaps;
+
+	tbb::parallel_for(size_t(0), n_chunks, [&](size_t chunk_i) {
+		const size_t chunk_begin = n_frames * chunk_i / n_chunks;
+		const size_t chunk_end = n_frames * (chunk_i + 1) / n_chunks;
+
+		std::vector<SeenPoints> chunk_seen = init_seen_status(env.scannable_points);
+
+		std::optional<DepthCubemap> &depth_cubemap = depth_cubemaps.local();
+
+		for (size_t frame_i = chunk_begin; frame_i < chunk_end; ++frame_i) {
+			const RobotState &state = states[frame_i + 1];
+			const math::Vec3d &end_effector_position = state.base_tf.translation;
+			const math::Vec3d end_effector_forward = state.base_tf.orientation.rotate(math::Vec3d(0, 1, 0));
+
+			update_seen_in_environment(env,
+									   params.sensor_params,
+									   depth_cubemap,
+									   end_effector_position,
+									   end_effector_forward,
+									   chunk_seen,
+									   [&](size_t point_i) {
+										   newly_visible[frame_i].push_back(point_i);
+									   });
+		}
+	});
+
+	// Merge the chunks in path order: a point is seen as of a frame iff it was visible in that frame or any earlier
+	// one, so OR-ing the per-frame sets into a running status yields exactly the counts of the sequential evaluation.
+	std::vector<SeenPoints> ever_seen = init_seen_status(env.scannable_points, env.interior_points);
+
+	EvaluationTrace stats;
+	stats.deltas_only = recording == TraceRecording::DELTAS;
+	stats.n_fruits = env.scannable_points.size();
+
+	std::vector<size_t> last_seen_counts(env.scannable_points.size(), 0);
+
+	for (size_t frame_i = 0; frame_i < n_frames; ++frame_i) {
+		for (size_t point_i: newly_visible[frame_i]) {
+			const auto &[fruit_i, i] = env.scannable_point_index->origin(point_i);
+			ever_seen[fruit_i].mark_seen(i);
+		}
+
+		record_frame(stats, calculateJointDistances(states[frame_i], states[frame_i + 1]), ever_seen, last_seen_counts);
+	}
+
+	return stats;
+}
+
 Json::Value mgodpl::toJson(const mgodpl::EvaluationTrace &trace) {
 	Json::Value json;
 	json["frames"] = Json::arrayValue;
+	if (trace.deltas_only) {
+		json["deltas_only"] = true;
+		json["n_fruits"] = trace.n_fruits;
+	}
 	for (const auto &frame: trace.frames) {
 		Json::Value frame_json;
 
 		frame_json["joint_distances"] = toJson(frame.joint_distances);
 
-		frame_json["pts_seen"] = Json::arrayValue;
-		for (size_t pts_seen: frame.pts_seen) {
-			frame_json["pts_seen"].append(pts_seen);
-		}
+		if (trace.deltas_only) {
+			// Each change as a [fruit_index, pts_seen, interior_pts_seen] triple.
+			frame_json["changed"] = Json::arrayValue;
+			for (const auto &change: frame.changed) {
+				Json::Value change_json;
+				change_json.append(change.fruit_index);
+				change_json.append(change.pts_seen);
+				change_json.append(change.interior_pts_seen);
+				frame_json["changed"].append(change_json);
+			}
+		} else {
+			frame_json["pts_seen"] = Json::arrayValue;
+			for (size_t pts_seen: frame.pts_seen) {
+				frame_json["pts_seen"].append(pts_seen);
+			}
 
-		frame_json["interior_pts_seen"] = Json::arrayValue;
-		for (size_t interior_pts_seen: frame.interior_pts_seen) {
-			frame_json["interior_pts_seen"].append(interior_pts_seen);
+			frame_json["interior_pts_seen"] = Json::arrayValue;
+			for (size_t interior_pts_seen: frame.interior_pts_seen) {
+				frame_json["interior_pts_seen"].append(interior_pts_seen);
+			}
 		}
 
 		json["frames"].append(frame_json);
@@ -105,12 +348,39 @@ Json::Value mgodpl::toJson(const mgodpl::EvaluationTrace &trace) {
 	return json;
 }
 
-std::vector<std::vector<bool>>
-mgodpl::init_seen_status(const std::vector<std::vector<SurfacePoint>> &all_scannable_points) {
-	std::vector<std::vector<bool>> ever_seen;
+mgodpl::EvaluationTrace mgodpl::expand_deltas(const mgodpl::EvaluationTrace &trace) {
+	if (!trace.deltas_only) {
+		return trace;
+	}
+
+	EvaluationTrace expanded;
+	expanded.n_fruits = trace.n_fruits;
+
+	std::vector<size_t> pts_seen(trace.n_fruits, 0);
+	std::vector<size_t> interior_pts_seen(trace.n_fruits, 0);
+
+	for (const auto &frame: trace.frames) {
+		for (const auto &change: frame.changed) {
+			pts_seen[change.fruit_index] = change.pts_seen;
+			interior_pts_seen[change.fruit_index] = change.interior_pts_seen;
+		}
+		expanded.frames.push_back({frame.joint_distances, pts_seen, interior_pts_seen});
+	}
+
+	return expanded;
+}
+
+std::vector<SeenPoints>
+mgodpl::init_seen_status(const std::vector<SurfacePointCloud> &all_scannable_points,
+						 const std::vector<PointMask> &interior_points) {
+	assert(interior_points.empty() || interior_points.size() == all_scannable_points.size());
+	std::vector<SeenPoints> ever_seen;
 	ever_seen.reserve(all_scannable_points.size());
-	for (const auto &scannable_points: all_scannable_points) {
-		ever_seen.emplace_back(scannable_points.size(), false);
+	for (size_t fruit_i = 0; fruit_i < all_scannable_points.size(); ++fruit_i) {
+		ever_seen.emplace_back(all_scannable_points[fruit_i].size);
+		if (!interior_points.empty()) {
+			ever_seen.back().set_interior(interior_points[fruit_i]);
+		}
 	}
 	return ever_seen;
 }
@@ -119,54 +389,171 @@ void mgodpl::update_seen(const declarative::SensorScalarParameters &sensor_param
 						 const std::shared_ptr<const MeshOcclusionModel> &mesh_occlusion_model,
 						 const math::Vec3d &eye_position,
 						 const math::Vec3d &eye_forward,
-						 const std::vector<std::vector<SurfacePoint>> &all_scannable_points,
-						 std::vector<std::vector<bool>> &ever_seen) {
+						 const std::vector<SurfacePointCloud> &all_scannable_points,
+						 std::vector<SeenPoints> &ever_seen) {
+
+	const VisibilityThresholds thresholds{
+			.min_distance = sensor_params.minViewDistance,
+			.max_distance = sensor_params.maxViewDistance,
+			.max_scan_angle = sensor_params.maxScanAngle,
+			.fov_angle = sensor_params.fieldOfViewAngle
+	};
+
+	PointMask candidates;
+	std::vector<size_t> unseen;
+	std::vector<math::Vec3d> positions;
+	std::vector<bool> occluded;
+
 	for (size_t fruit_i = 0; fruit_i < all_scannable_points.size(); ++fruit_i) {
-		for (size_t i = 0; i < all_scannable_points[fruit_i].size(); ++i) {
-			if (!ever_seen[fruit_i][i] &&
-				is_visible(all_scannable_points[fruit_i][i],
-						   eye_position,
-						   eye_forward,
-						   sensor_params.maxViewDistance,
-						   sensor_params.minViewDistance,
-						   sensor_params.maxScanAngle,
-						   sensor_params.fieldOfViewAngle,
-						   *mesh_occlusion_model)) {
-				ever_seen[fruit_i][i] = true;
+		visibility_candidates(all_scannable_points[fruit_i], eye_position, eye_forward, thresholds, candidates);
+
+		// Gather the candidates that weren't seen before, and check their occlusion as a batch.
+		unseen.clear();
+		positions.clear();
+		for_each_set_bit(candidates, [&](size_t i) {
+			if (!ever_seen[fruit_i].is_seen(i)) {
+				unseen.push_back(i);
+				positions.push_back(all_scannable_points[fruit_i].get(i).position);
+			}
+		});
+
+		mesh_occlusion_model->checkOcclusion(positions, eye_position, occluded);
+
+		for (size_t j = 0; j < unseen.size(); ++j) {
+			if (!occluded[j]) {
+				ever_seen[fruit_i].mark_seen(unseen[j]);
 			}
 		}
 	}
 }
 
-PointScanStats mgodpl::count_scanned_points(const mgodpl::robot_model::RobotModel robot_model,
+void mgodpl::update_seen(const declarative::SensorScalarParameters &sensor_params,
+						 const std::shared_ptr<const MeshOcclusionModel> &mesh_occlusion_model,
+						 const math::Vec3d &eye_position,
+						 const math::Vec3d &eye_forward,
+						 const ScannablePointIndex &point_index,
+						 std::vector<SeenPoints> &ever_seen) {
+	update_seen_indexed(sensor_params,
+						[&](const auto &, const auto &positions, const auto &eye, auto &occluded) {
+							mesh_occlusion_model->checkOcclusion(positions, eye, occluded);
+						},
+						eye_position,
+						eye_forward,
+						point_index,
+						ever_seen,
+						[](size_t) {});
+}
+
+void mgodpl::update_seen(const declarative::SensorScalarParameters &sensor_params,
+						 DepthCubemap &depth_cubemap,
+						 const Mesh &occluding_mesh,
+						 const math::Vec3d &eye_position,
+						 const math::Vec3d &eye_forward,
+						 const ScannablePointIndex &point_index,
+						 std::vector<SeenPoints> &ever_seen) {
+	update_seen_indexed(sensor_params,
+						[&](const auto &, const auto &positions, const auto &eye, auto &occluded) {
+							// Only rasterize if there is anything to check at all.
+							depth_cubemap.render(occluding_mesh, eye);
+							depth_cubemap.checkOcclusion(positions, eye, occluded);
+						},
+						eye_position,
+						eye_forward,
+						point_index,
+						ever_seen,
+						[](size_t) {});
+}
+
+void mgodpl::update_seen(const declarative::SensorScalarParameters &sensor_params,
+						 const OcclusionHorizonMaps &horizon_maps,
+						 const math::Vec3d &eye_position,
+						 const math::Vec3d &eye_forward,
+						 const ScannablePointIndex &point_index,
+						 std::vector<SeenPoints> &ever_seen) {
+	update_seen_indexed(sensor_params,
+						[&](const auto &unseen, const auto &positions, const auto &eye, auto &occluded) {
+							check_occlusion(horizon_maps, point_index, unseen, positions, eye, occluded);
+						},
+						eye_position,
+						eye_forward,
+						point_index,
+						ever_seen,
+						[](size_t) {});
+}
+
+/**
+ * The loosest thresholds of all clusters: the smallest minimum distance, and the largest maximum distance and angle.
+ */
+static VisibilityThresholds loosest_thresholds(const std::vector<ScannablePoints> &scannable_points) {
+	VisibilityThresholds loosest{
+			.min_distance = INFINITY,
+			.max_distance = 0.0,
+			.max_scan_angle = 0.0
+	};
+	for (const auto &cluster: scannable_points) {
+		loosest.min_distance = std::min(loosest.min_distance, cluster.min_distance);
+		loosest.max_distance = std::max(loosest.max_distance, cluster.max_distance);
+		loosest.max_scan_angle = std::max(loosest.max_scan_angle, cluster.max_angle);
+	}
+	return loosest;
+}
+
+/**
+ * Index the point clouds of all clusters, with cells as large as the loosest maximum distance.
+ */
+static ScannablePointIndex index_clusters(const std::vector<ScannablePoints> &scannable_points,
+										  const VisibilityThresholds &loosest) {
+	std::vector<SurfacePointCloud> clouds;
+	clouds.reserve(scannable_points.size());
+	for (const auto &cluster: scannable_points) {
+		clouds.push_back(cluster.point_cloud);
+	}
+
+	// With an infinite scan range, every query visits all cells anyway, so the cell size hardly matters.
+	const double cell_size = std::isfinite(loosest.max_distance) && loosest.max_distance > 0.0
+								 ? loosest.max_distance
+								 : 1.0;
+	return {clouds, cell_size};
+}
+
+mgodpl::ScanEvaluationIndex::ScanEvaluationIndex(const std::vector<ScannablePoints> &scannable_points)
+	: loosest(loosest_thresholds(scannable_points)),
+	  index(index_clusters(scannable_points, loosest)) {
+}
+
+PointScanStats mgodpl::count_scanned_points(const mgodpl::robot_model::RobotModel &robot_model,
 											const RobotPath &path,
 											const std::vector<ScannablePoints> &scannable_points,
 											double step_size) {
+	return count_scanned_points(robot_model, path, scannable_points, ScanEvaluationIndex(scannable_points), step_size);
+}
 
+PointScanStats mgodpl::count_scanned_points(const mgodpl::robot_model::RobotModel &robot_model,
+											const RobotPath &path,
+											const std::vector<ScannablePoints> &scannable_points,
+											const ScanEvaluationIndex &index,
+											double step_size) {
 	std::vector<SeenPoints> ever_seen;
 	for (const auto &cluster: scannable_points) {
 		ever_seen.push_back(SeenPoints::create_all_unseen(cluster));
 	}
 
-	PathPoint path_point{0, 0.0};
+	const auto end_effector = robot_model.findLinkByName("end_effector");
 
-	// Compute the AABB of each cluster of points
-	std::vector<math::AABBd> aabbs(scannable_points.size(), math::AABBd::inverted_infinity());
-	for (size_t cluster_i = 0; cluster_i < scannable_points.size(); cluster_i++) {
-		for (const auto &point: scannable_points[cluster_i].surface_points) {
-			aabbs[cluster_i].expand(point.position);
-		}
-	}
+	std::vector<size_t> candidates;
+
+	PathPoint path_point{0, 0.0};
 
 	do {
 		auto state = interpolate(path_point, path);
-		auto ee_pos = forwardKinematics(robot_model,
-										state).forLink(robot_model.findLinkByName("end_effector")).translation;
+		auto ee_pos = forwardKinematics(robot_model, state).forLink(end_effector).translation;
+
+		index.index.query(ee_pos, {0, 0, 0}, index.loosest, candidates);
 
-		for (size_t cluster_i = 0; cluster_i < scannable_points.size(); cluster_i++) {
-			// Skip the cluster if the end effector is not within the AABB (inflated by the scan radius)
-			if (aabbs[cluster_i].inflated(scannable_points[cluster_i].max_distance).contains(ee_pos)) {
-				update_visibility(scannable_points[cluster_i], ee_pos, ever_seen[cluster_i]);
+		for (size_t candidate: candidates) {
+			const auto &[cluster_i, i] = index.index.origin(candidate);
+			if (!ever_seen[cluster_i].is_seen(i) && is_visible(scannable_points[cluster_i], i, ee_pos)) {
+				ever_seen[cluster_i].mark_seen(i);
 			}
 		}
 
@@ -14,24 +14,64 @@
 #include "surface_points.h"
 #include "declarative/SensorModelParameters.h"
 #include "../planning/MeshOcclusionModel.h"
+#include "../planning/depth_cubemap.h"
+#include "../planning/occlusion_horizon_maps.h"
 #include "joint_distances.h"
 #include "declarative_environment.h"
 
 namespace mgodpl {
 
+	/**
+	 * The number of points seen per fruit, frame by frame, as recorded by eval_static_path.
+	 *
+	 * Either every frame holds the counts for all fruits, or (with `deltas_only`) every frame only holds the fruits
+	 * whose counts changed during it; see expand_deltas to convert the latter into the former.
+	 */
 	struct EvaluationTrace {
 
+		/// The new counts of a fruit whose counts changed during a frame.
+		struct FruitCounts {
+			size_t fruit_index;
+			size_t pts_seen;
+			size_t interior_pts_seen;
+		};
+
 		struct Frame {
 			JointDistances joint_distances;
+			/// The number of points seen so far, per fruit; empty if `deltas_only`.
 			std::vector<size_t> pts_seen;
+			/// The number of interior points seen so far, per fruit; empty if `deltas_only`.
 			std::vector<size_t> interior_pts_seen;
+			/// The fruits whose counts changed during this frame; only filled in if `deltas_only`.
+			std::vector<FruitCounts> changed;
 		};
 
+		/// Whether frames record only the changes (in `changed`) instead of all counts.
+		bool deltas_only = false;
+		/// The number of fruits.
+		size_t n_fruits = 0;
+
 		std::vector<Frame> frames;
 	};
 
+	/// What eval_static_path records in the EvaluationTrace for each frame.
+	enum class TraceRecording {
+		/// The counts for all fruits.
+		FULL,
+		/// Only the counts of fruits that changed.
+		DELTAS
+	};
+
 	Json::Value toJson(const EvaluationTrace &trace);
 
+	/**
+	 * Convert a trace that records only deltas into one that records the counts for all fruits in every frame.
+	 *
+	 * @param trace 	The trace; returned as-is if it already records all counts.
+	 * @return 			The equivalent full trace.
+	 */
+	EvaluationTrace expand_deltas(const EvaluationTrace &trace);
+
 	/**
 	 * Evaluate a (static) path by simulating a robot moving along it and scanning the environment.
 	 *
@@ -42,24 +82,54 @@ namespace mgodpl {
 	 * @param all_scannable_points 			The scannable points for each fruit.
 	 * @param sensor_params 				The parameters for the sensor.
 	 * @param mesh_occlusion_model 			The occlusion model for the mesh.
+	 * @param recording 					Whether to record the counts of all fruits in every frame, or only the changes.
 	 * @return 								A trace of the evaluation containing statistics for each frame.
 	 */
 	EvaluationTrace eval_static_path(const RobotPath &path,
 									 double interpolation_speed,
 									 const declarative::PointScanEvalParameters &params,
-									 const declarative::PointScanEnvironment &env);
+									 const declarative::PointScanEnvironment &env,
+									 TraceRecording recording = TraceRecording::FULL);
+
+	/**
+	 * Same as eval_static_path, and producing the exact same trace, but evaluating the frames in parallel.
+	 *
+	 * Only the "first time seen" bookkeeping depends on earlier frames; visibility itself does not. So the frames are
+	 * split into contiguous chunks, each chunk is evaluated on the thread pool (skipping only points already seen
+	 * earlier within that chunk), and the per-frame results are then OR-ed into the seen status in path order.
+	 *
+	 * More chunks means more parallelism but also more duplicated work, since points seen in an earlier chunk
+	 * are checked again in later ones.
+	 *
+	 * @param path 							The path to evaluate.
+	 * @param interpolation_speed 			The step size to use when moving along the path and evaluating the seen points.
+	 * @param params 						The parameters of the scenario.
+	 * @param env 							The environment of the scenario.
+	 * @param recording 					Whether to record the counts of all fruits in every frame, or only the changes.
+	 * @param n_chunks 						The number of chunks to split the frames into; 0 for one per worker thread.
+	 * @return 								A trace of the evaluation containing statistics for each frame.
+	 */
+	EvaluationTrace eval_static_path_parallel(const RobotPath &path,
+											  double interpolation_speed,
+											  const declarative::PointScanEvalParameters &params,
+											  const declarative::PointScanEnvironment &env,
+											  TraceRecording recording = TraceRecording::FULL,
+											  size_t n_chunks = 0);
 
 	/**
 	 * Creates a seen/unseen status for each scannable point, initialized to false.
 	 * @param all_scannable_points 		The scannable points for each fruit.
-	 * @return 							A vector of vectors booleans, same structure as all_scannable_points, initialized to false.
+	 * @param interior_points 			Optionally, per fruit, the mask of interior points (see SeenPoints::set_interior).
+	 * @return 							One SeenPoints per fruit, same structure as all_scannable_points, all unseen.
 	 */
-	std::vector<std::vector<bool>> init_seen_status(const std::vector<std::vector<SurfacePoint>> &all_scannable_points);
+	std::vector<SeenPoints> init_seen_status(const std::vector<SurfacePointCloud> &all_scannable_points,
+											 const std::vector<PointMask> &interior_points = {});
 
 	/**
 	 * Set the seen/unseen status for each scannable point to true if it is visible from the current end effector position.
 	 *
-	 * Points that are already seen are not updated nor re-evaluated.
+	 * Points that are already seen are not updated nor re-evaluated. The distance and angle tests are evaluated for
+	 * each fruit at once (see visibility_candidates); only the surviving points go through the occlusion check.
 	 *
 	 * @param sensor_params 				The scalar parameters for the sensor model.
 	 * @param mesh_occlusion_model 			The datastructure to use to check for clear sightlines.
@@ -72,14 +142,85 @@ namespace mgodpl {
 					 const std::shared_ptr<const MeshOcclusionModel> &mesh_occlusion_model,
 					 const math::Vec3d &eye_position,
 					 const math::Vec3d &eye_forward,
-					 const std::vector<std::vector<SurfacePoint>> &all_scannable_points,
-					 std::vector<std::vector<bool>> &ever_seen);
+					 const std::vector<SurfacePointCloud> &all_scannable_points,
+					 std::vector<SeenPoints> &ever_seen);
+
+	/**
+	 * Same as above, but only considering the points returned by a spatial index query, so that the cost scales with
+	 * the number of points near the eye rather than the total number of points.
+	 *
+	 * @param sensor_params 				The scalar parameters for the sensor model.
+	 * @param mesh_occlusion_model 			The datastructure to use to check for clear sightlines.
+	 * @param eye_position 					The position of the sensor/eye.
+	 * @param eye_forward 					The forward vector of the sensor/eye.
+	 * @param point_index 					The spatial index over the scannable points for each fruit.
+	 * @param ever_seen 					The seen/unseen status for each scannable point.
+	 */
+	void update_seen(const declarative::SensorScalarParameters &sensor_params,
+					 const std::shared_ptr<const MeshOcclusionModel> &mesh_occlusion_model,
+					 const math::Vec3d &eye_position,
+					 const math::Vec3d &eye_forward,
+					 const ScannablePointIndex &point_index,
+					 std::vector<SeenPoints> &ever_seen);
+
+	/**
+	 * Same as above, but checking occlusion with a depth cube map instead of ray casting; the cube map is rendered
+	 * from the eye position (if there are any points left to check), overwriting its previous contents.
+	 *
+	 * @param sensor_params 				The scalar parameters for the sensor model.
+	 * @param depth_cubemap 				The depth cube map to render into and check occlusion with.
+	 * @param occluding_mesh 				The mesh to render into the cube map.
+	 * @param eye_position 					The position of the sensor/eye.
+	 * @param eye_forward 					The forward vector of the sensor/eye.
+	 * @param point_index 					The spatial index over the scannable points for each fruit.
+	 * @param ever_seen 					The seen/unseen status for each scannable point.
+	 */
+	void update_seen(const declarative::SensorScalarParameters &sensor_params,
+					 DepthCubemap &depth_cubemap,
+					 const Mesh &occluding_mesh,
+					 const math::Vec3d &eye_position,
+					 const math::Vec3d &eye_forward,
+					 const ScannablePointIndex &point_index,
+					 std::vector<SeenPoints> &ever_seen);
+
+	/**
+	 * Same as above, but checking occlusion with precomputed horizon maps (see OcclusionHorizonMaps) instead of ray
+	 * casting: a table lookup per point.
+	 *
+	 * @param sensor_params 				The scalar parameters for the sensor model.
+	 * @param horizon_maps 					The horizon maps, built over the same point clouds as `point_index`.
+	 * @param eye_position 					The position of the sensor/eye.
+	 * @param eye_forward 					The forward vector of the sensor/eye.
+	 * @param point_index 					The spatial index over the scannable points for each fruit.
+	 * @param ever_seen 					The seen/unseen status for each scannable point.
+	 */
+	void update_seen(const declarative::SensorScalarParameters &sensor_params,
+					 const OcclusionHorizonMaps &horizon_maps,
+					 const math::Vec3d &eye_position,
+					 const math::Vec3d &eye_forward,
+					 const ScannablePointIndex &point_index,
+					 std::vector<SeenPoints> &ever_seen);
 
 	struct PointScanStats {
 		std::vector<int> seen_per_fruit;
 		int total_seen = 0;
 	};
 
+	/**
+	 * A spatial index over all points of a vector of ScannablePoints, for count_scanned_points.
+	 *
+	 * Build it once per set of clusters and reuse it for every path that is evaluated against them.
+	 */
+	struct ScanEvaluationIndex {
+		/// The loosest thresholds of all clusters, to query the index with; every candidate is then checked exactly
+		/// against the thresholds and occlusion model of its own cluster.
+		VisibilityThresholds loosest;
+		/// The index over the point clouds of all clusters.
+		ScannablePointIndex index;
+
+		explicit ScanEvaluationIndex(const std::vector<ScannablePoints> &scannable_points);
+	};
+
 	/**
 	 * Given a path and a vector of ScannablePoints, this function will count the number of points that have been seen
 	 * in each cluster, as well as the total number of points seen.
@@ -87,11 +228,21 @@ namespace mgodpl {
 	 * @param robot_model 		The robot model.
 	 * @param path 				The path the robot has taken.
 	 * @param scannable_points 	The scannable points for each fruit.
+	 * @param index 			The index over `scannable_points`.
 	 * @param step_size 		The step size for the path.
 	 *
 	 * @return The number of points seen in each cluster, and the total number of points seen.
 	 */
-	PointScanStats count_scanned_points(const mgodpl::robot_model::RobotModel robot_model,
+	PointScanStats count_scanned_points(const mgodpl::robot_model::RobotModel &robot_model,
+										const RobotPath &path,
+										const std::vector<ScannablePoints> &scannable_points,
+										const ScanEvaluationIndex &index,
+										double step_size);
+
+	/**
+	 * Same as above, but indexing the points first; prefer the above when evaluating several paths.
+	 */
+	PointScanStats count_scanned_points(const mgodpl::robot_model::RobotModel &robot_model,
 										const RobotPath &path,
 										const std::vector<ScannablePoints> &scannable_points,
 										double step_size);
@@ -10,10 +10,6 @@
 #include "../math/Triangle.h"
 
 namespace mgodpl {
-	size_t SeenPoints::count_seen() const {
-		return std::count(ever_seen.begin(), ever_seen.end(), true);
-	}
-
 	math::Vec3d random_barycentric(random_numbers::RandomNumberGenerator &rng) {
 		double r1 = rng.uniform01();
 		double r2 = rng.uniform01();
@@ -179,11 +175,9 @@ namespace mgodpl {
 			return false;
 		}
 
-		// Calculate the angle between the point's normal and the vector from the point to the eye
-		double angle = std::acos(point.normal.dot(delta) / distance);
-
-		// If the angle is greater than the maximum angle, the point is not visible
-		if (angle > scannable_points.max_angle) {
+		// If the angle between the point's normal and the vector from the point to the eye is greater than the
+		// maximum angle, the point is not visible. (Compared through the cosine, to avoid the acos.)
+		if (point.normal.dot(delta) < std::cos(scannable_points.max_angle) * distance) {
 			return false;
 		}
 
@@ -199,10 +193,43 @@ namespace mgodpl {
 	size_t update_visibility(const ScannablePoints &scannable_points,
 	                         const math::Vec3d &eye_position,
 	                         SeenPoints &seen_points) {
+		assert(scannable_points.point_cloud.size == scannable_points.surface_points.size());
+
+		// Run the cheap tests on all points at once...
+		thread_local PointMask candidates;
+		visibility_candidates(scannable_points.point_cloud,
+		                      eye_position,
+		                      {0, 0, 0},
+		                      {
+				                      .min_distance = scannable_points.min_distance,
+				                      .max_distance = scannable_points.max_distance,
+				                      .max_scan_angle = scannable_points.max_angle
+		                      },
+		                      candidates);
+
+		// ...and the occlusion check only on the survivors that were not seen before, as a batch.
+		thread_local std::vector<size_t> unseen;
+		thread_local std::vector<math::Vec3d> positions;
+		thread_local std::vector<bool> occluded;
+		unseen.clear();
+		positions.clear();
+		for_each_set_bit(candidates, [&](size_t i) {
+			if (!seen_points.is_seen(i)) {
+				unseen.push_back(i);
+				positions.push_back(scannable_points.surface_points[i].position);
+			}
+		});
+
+		if (scannable_points.occlusion_model.has_value()) {
+			(*scannable_points.occlusion_model)->checkOcclusion(positions, eye_position, occluded);
+		} else {
+			occluded.assign(unseen.size(), false);
+		}
+
 		size_t n_seen = 0;
-		for (size_t i = 0; i < scannable_points.surface_points.size(); ++i) {
-			if (!seen_points.ever_seen[i] && is_visible(scannable_points, i, eye_position)) {
-				seen_points.ever_seen[i] = true;
+		for (size_t j = 0; j < unseen.size(); ++j) {
+			if (!occluded[j]) {
+				seen_points.mark_seen(unseen[j]);
 				++n_seen;
 			}
 		}
@@ -242,10 +269,11 @@ namespace mgodpl {
 		// 2. The angle between the point's normal and the vector from the point to the eye position is less than or equal to the maximum scan angle.
 		// 3. The angle between the eye forward direction and the vector from the point to the eye position is less than or equal to the field of view angle.
 		// 4. The point is not occluded according to the mesh occlusion model. (most expensive, so last)
+		// The angle checks compare cosines instead, to avoid the acos: acos(a / d) <= theta iff a >= cos(theta) * d.
 		return distance <= max_distance &&
 		       distance >= min_distance &&
-		       std::acos(point.normal.dot(delta) / distance) <= max_scan_angle &&
-		       std::acos(eye_forward.dot(-delta) / distance) <= fov_angle &&
+		       point.normal.dot(delta) >= std::cos(max_scan_angle) * distance &&
+		       eye_forward.dot(-delta) >= std::cos(fov_angle) * distance &&
 		       !mesh_occlusion_model.checkOcclusion(point.position, eye_pos);
 	}
 
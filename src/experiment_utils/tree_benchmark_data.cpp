@@ -8,6 +8,7 @@
 
 #include <iostream>
 #include "tree_benchmark_data.h"
+#include "tree_mesh_cache.h"
 #include "../planning/fcl_utils.h"
 #include <fcl/narrowphase/collision_object.h>
 #include <fcl/geometry/bvh/BVH_model.h>
@@ -39,21 +40,20 @@ namespace mgodpl::experiments {
 	TreeModelBenchmarkData
 	loadBenchmarkTreemodelData(const std::string &tree_model_name) {
 		std::string local_tree_model_name = tree_model_name;
-		auto local_tree_mesh = mgodpl::tree_meshes::loadTreeMeshes(tree_model_name);
+		// The convex hull and fruit positions come from the binary tree model cache, along with the meshes.
+		auto cached = mgodpl::tree_meshes::loadCachedTreeModel(tree_model_name);
 		std::cout << "Creating collision object for tree model " << tree_model_name << std::endl;
 		auto local_tree_collision_object = std::make_shared<fcl::CollisionObjectd>(mgodpl::fcl_utils::meshToFclBVH(
-				local_tree_mesh.trunk_mesh));
-		std::cout << "Creating convex hull for tree model " << tree_model_name << std::endl;
-		auto local_tree_convex_hull = std::make_shared<mgodpl::cgal::CgalMeshData>(local_tree_mesh.leaves_mesh);
-
-		auto fruit_positions = computeFruitPositions(local_tree_mesh);
+				cached.meshes.trunk_mesh));
+		auto local_tree_convex_hull = std::make_shared<mgodpl::cgal::CgalMeshData>(
+				mgodpl::cgal::meshToCgalMesh(cached.leaves_convex_hull));
 
 		return {
 				local_tree_model_name,
-				local_tree_mesh,
+				std::move(cached.meshes),
 				local_tree_collision_object,
 				local_tree_convex_hull,
-				fruit_positions
+				std::move(cached.fruit_centers)
 		};
 	}
 
@@ -0,0 +1,323 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tree_mesh_cache.h"
+#include "leaf_scaling.h"
+#include "../planning/cgal_chull_shortest_paths.h"
+
+namespace mgodpl::tree_meshes {
+
+	// The arrays are stored as raw bytes, so their elements must be plain data of a fixed size.
+	static_assert(std::is_trivially_copyable_v<math::Vec3d> && sizeof(math::Vec3d) == 3 * sizeof(double));
+	static_assert(std::is_trivially_copyable_v<std::array<size_t, 3> > && sizeof(size_t) == sizeof(uint64_t));
+
+	/// Identifies a file as a binary tree model cache.
+	constexpr char TREE_CACHE_MAGIC[8] = {'M', 'G', 'O', 'D', 'P', 'L', 'T', 'M'};
+
+	/**
+	 * @brief The header of a binary tree model cache file.
+	 */
+	struct TreeCacheHeader {
+		char magic[8];
+		uint32_t format_version;
+		uint32_t reserved;
+		uint64_t source_hash;
+		/// The size of the whole file, to detect truncation.
+		uint64_t file_size;
+	};
+
+	static_assert(sizeof(TreeCacheHeader) % 8 == 0);
+
+	/**
+	 * @brief The paths of the source files of a tree model.
+	 */
+	static std::vector<std::string> tree_model_source_paths(const std::string &tree_name) {
+		const std::string base = "3d-models/" + tree_name;
+
+		// Due to legacy reasons, some fruit files are named "fruit" others are named "apples"; see loadTreeMeshesFromDae.
+		const std::string fruit_path = std::filesystem::exists(base + "_fruit.dae")
+									   ? base + "_fruit.dae"
+									   : base + "_apples.dae";
+
+		return {base + "_trunk.dae", base + "_leaves.dae", fruit_path};
+	}
+
+	uint64_t hash_tree_model_sources(const std::string &tree_name) {
+		// 64-bit FNV-1a.
+		uint64_t hash = 14695981039346656037ull;
+		auto hash_bytes = [&](const char *bytes, size_t n) {
+			for (size_t i = 0; i < n; ++i) {
+				hash = (hash ^ (uint8_t) bytes[i]) * 1099511628211ull;
+			}
+		};
+
+		// The cached data depends on the processing as much as on the sources.
+		const uint32_t processing_version = TREE_CACHE_PROCESSING_VERSION;
+		hash_bytes(reinterpret_cast<const char *>(&processing_version), sizeof(processing_version));
+
+		std::vector<char> buffer(1 << 16);
+
+		for (const auto &path: tree_model_source_paths(tree_name)) {
+			std::ifstream file(path, std::ios::binary);
+			if (!file) {
+				throw std::runtime_error("Could not open tree model source file " + path);
+			}
+
+			while (file) {
+				file.read(buffer.data(), (std::streamsize) buffer.size());
+				hash_bytes(buffer.data(), (size_t) file.gcount());
+			}
+		}
+
+		return hash;
+	}
+
+	std::filesystem::path tree_model_cache_path(const std::string &tree_name) {
+		const std::filesystem::path source_directory =
+				std::filesystem::absolute(tree_model_source_paths(tree_name).front()).parent_path();
+		return source_directory / TREE_CACHE_SUBDIRECTORY / (tree_name + ".bin");
+	}
+
+	/**
+	 * @brief Writes the arrays of a cache file, each as a 64-bit element count followed by the raw elements.
+	 */
+	class CacheWriter {
+		std::ofstream &out;
+
+	public:
+		explicit CacheWriter(std::ofstream &out) : out(out) {
+		}
+
+		void count(uint64_t count) {
+			out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+		}
+
+		template<typename T>
+		void array(const std::vector<T> &values) {
+			count(values.size());
+			out.write(reinterpret_cast<const char *>(values.data()), (std::streamsize) (values.size() * sizeof(T)));
+		}
+
+		void mesh(const Mesh &mesh) {
+			array(mesh.vertices);
+			array(mesh.triangles);
+		}
+	};
+
+	/**
+	 * @brief Reads the arrays of a cache file from memory, checking that they lie within the file.
+	 */
+	class CacheReader {
+		const char *cursor;
+		const char *end;
+
+	public:
+		CacheReader(const char *begin, const char *end) : cursor(begin), end(end) {
+		}
+
+		/// Read an element count; returns false if the file is too short.
+		[[nodiscard]] bool count(uint64_t &count) {
+			if ((size_t) (end - cursor) < sizeof(count)) {
+				return false;
+			}
+			std::memcpy(&count, cursor, sizeof(count));
+			cursor += sizeof(count);
+			return true;
+		}
+
+		/// Read an array into the given vector; returns false if the file is too short.
+		template<typename T>
+		[[nodiscard]] bool array(std::vector<T> &values) {
+			uint64_t count;
+			if (!this->count(count) || count > (size_t) (end - cursor) / sizeof(T)) {
+				return false;
+			}
+			values.resize(count);
+			std::memcpy(values.data(), cursor, count * sizeof(T));
+			cursor += count * sizeof(T);
+			return true;
+		}
+
+		[[nodiscard]] bool mesh(Mesh &mesh) {
+			return array(mesh.vertices) && array(mesh.triangles);
+		}
+
+		[[nodiscard]] bool at_end() const {
+			return cursor == end;
+		}
+	};
+
+	/**
+	 * @brief A read-only memory mapping of a whole file, unmapped on destruction.
+	 */
+	class MappedFile {
+		void *data_ = MAP_FAILED;
+		size_t size_ = 0;
+
+	public:
+		explicit MappedFile(const std::string &path) {
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0) {
+				return;
+			}
+			struct stat st{};
+			if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+				size_ = (size_t) st.st_size;
+				data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+			}
+			// The mapping stays valid after closing the file.
+			::close(fd);
+		}
+
+		MappedFile(const MappedFile &) = delete;
+
+		MappedFile &operator=(const MappedFile &) = delete;
+
+		~MappedFile() {
+			if (data_ != MAP_FAILED) {
+				::munmap(data_, size_);
+			}
+		}
+
+		[[nodiscard]] bool valid() const {
+			return data_ != MAP_FAILED;
+		}
+
+		[[nodiscard]] const char *data() const {
+			return static_cast<const char *>(data_);
+		}
+
+		[[nodiscard]] size_t size() const {
+			return size_;
+		}
+	};
+
+	void write_tree_model_cache(const std::string &path, uint64_t source_hash, const CachedTreeModel &model) {
+		// Write to a name unique to this process and thread, so that concurrent writers don't interfere.
+		const std::string tmp_path = path + ".tmp." + std::to_string(::getpid()) + "." +
+									 std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+		{
+			std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+			if (!out) {
+				throw std::runtime_error("Could not open tree model cache file " + tmp_path + " for writing");
+			}
+
+			TreeCacheHeader header{};
+			std::memcpy(header.magic, TREE_CACHE_MAGIC, sizeof(header.magic));
+			header.format_version = TREE_CACHE_FORMAT_VERSION;
+			header.source_hash = source_hash;
+			// The file size is filled in at the end.
+			out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+			CacheWriter writer(out);
+			writer.mesh(model.meshes.leaves_mesh);
+			writer.mesh(model.meshes.trunk_mesh);
+			writer.count(model.meshes.fruit_meshes.size());
+			for (const auto &fruit_mesh: model.meshes.fruit_meshes) {
+				writer.mesh(fruit_mesh);
+			}
+			writer.array(model.fruit_centers);
+			writer.array(model.leaf_root_points);
+			writer.mesh(model.leaves_convex_hull);
+
+			header.file_size = (uint64_t) out.tellp();
+			out.seekp(0);
+			out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+			if (!out) {
+				out.close();
+				std::filesystem::remove(tmp_path);
+				throw std::runtime_error("Could not write tree model cache file " + tmp_path);
+			}
+		}
+
+		std::filesystem::rename(tmp_path, path);
+	}
+
+	std::optional<CachedTreeModel> read_tree_model_cache(const std::string &path, uint64_t source_hash) {
+		const MappedFile file(path);
+		if (!file.valid() || file.size() < sizeof(TreeCacheHeader)) {
+			return std::nullopt;
+		}
+
+		TreeCacheHeader header{};
+		std::memcpy(&header, file.data(), sizeof(header));
+		if (std::memcmp(header.magic, TREE_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+			header.format_version != TREE_CACHE_FORMAT_VERSION ||
+			header.source_hash != source_hash ||
+			header.file_size != file.size()) {
+			return std::nullopt;
+		}
+
+		CachedTreeModel model;
+		CacheReader reader(file.data() + sizeof(header), file.data() + file.size());
+
+		uint64_t n_fruit;
+		if (!reader.mesh(model.meshes.leaves_mesh) ||
+			!reader.mesh(model.meshes.trunk_mesh) ||
+			!reader.count(n_fruit) ||
+			n_fruit > file.size()) {
+			return std::nullopt;
+		}
+
+		model.meshes.fruit_meshes.resize(n_fruit);
+		for (auto &fruit_mesh: model.meshes.fruit_meshes) {
+			if (!reader.mesh(fruit_mesh)) {
+				return std::nullopt;
+			}
+		}
+
+		if (!reader.array(model.fruit_centers) ||
+			!reader.array(model.leaf_root_points) ||
+			!reader.mesh(model.leaves_convex_hull) ||
+			!reader.at_end()) {
+			return std::nullopt;
+		}
+
+		return model;
+	}
+
+	CachedTreeModel loadCachedTreeModel(const std::string &tree_name) {
+		const uint64_t source_hash = hash_tree_model_sources(tree_name);
+		const std::filesystem::path cache_path = tree_model_cache_path(tree_name);
+
+		if (auto cached = read_tree_model_cache(cache_path, source_hash)) {
+			cached->meshes.tree_name = tree_name;
+			return std::move(*cached);
+		}
+
+		std::cout << "Generating binary cache for tree model " << tree_name << std::endl;
+
+		CachedTreeModel model;
+		model.meshes = loadTreeMeshesFromDae(tree_name);
+		model.fruit_centers = computeFruitPositions(model.meshes);
+		model.leaf_root_points = leaf_root_points(model.meshes);
+		model.leaves_convex_hull = cgal::cgalMeshToMesh(cgal::cgal_convex_hull_around_leaves(model.meshes.leaves_mesh));
+
+		try {
+			std::filesystem::create_directories(cache_path.parent_path());
+			write_tree_model_cache(cache_path, source_hash, model);
+		} catch (const std::exception &e) {
+			std::cerr << "Could not write the binary cache for tree model " << tree_name << ": " << e.what()
+					<< std::endl;
+		}
+
+		return model;
+	}
+
+}
@@ -0,0 +1,106 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#ifndef MGODPL_TREE_MESH_CACHE_H
+#define MGODPL_TREE_MESH_CACHE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "TreeMeshes.h"
+
+namespace mgodpl::tree_meshes {
+
+	/// The version of the binary tree model cache format; bump it whenever the layout of the file changes.
+	constexpr uint32_t TREE_CACHE_FORMAT_VERSION = 1;
+
+	/**
+	 * The version of the processing that derives the cached data from the source files: the stem filtering in
+	 * loadTreeMeshesFromDae, computeFruitPositions, leaf_root_points and cgal_convex_hull_around_leaves.
+	 *
+	 * Bump it whenever any of those change, so that caches made by the old code are regenerated; it is folded into
+	 * the source hash (see hash_tree_model_sources), since the source files alone do not capture it.
+	 */
+	constexpr uint32_t TREE_CACHE_PROCESSING_VERSION = 1;
+
+	/// The name of the directory, next to the source files of the tree models, in which the caches are stored.
+	constexpr const char *TREE_CACHE_SUBDIRECTORY = "cache";
+
+	/**
+	 * @brief A tree model, together with the properties that are expensive to derive from its source files.
+	 *
+	 * This is what the binary tree model cache stores: the meshes as loadTreeMeshesFromDae returns them (that is,
+	 * with the fruit broken down into components and the stems removed), and the properties derived from them.
+	 */
+	struct CachedTreeModel {
+		TreeMeshes meshes;
+		/// The center of the bounding box of every fruit mesh, as computeFruitPositions returns them.
+		std::vector<math::Vec3d> fruit_centers;
+		/// The root point of every leaf vertex, as leaf_root_points returns them.
+		std::vector<math::Vec3d> leaf_root_points;
+		/// The convex hull around the leaves.
+		Mesh leaves_convex_hull;
+	};
+
+	/**
+	 * @brief Compute a hash over the contents of the source (.dae) files of a tree model.
+	 *
+	 * @param tree_name		The name of the tree model.
+	 * @return The 64-bit FNV-1a hash of TREE_CACHE_PROCESSING_VERSION, followed by the trunk, leaves and fruit files,
+	 * 		   in that order.
+	 */
+	uint64_t hash_tree_model_sources(const std::string &tree_name);
+
+	/**
+	 * @brief The path of the binary cache file of a tree model.
+	 *
+	 * The cache lives in TREE_CACHE_SUBDIRECTORY next to the source files of the model, as an absolute path; it thus
+	 * does not depend on the working directory beyond where the source files are found.
+	 *
+	 * @param tree_name		The name of the tree model.
+	 * @return The path of the cache file.
+	 */
+	std::filesystem::path tree_model_cache_path(const std::string &tree_name);
+
+	/**
+	 * @brief Write a tree model to a binary cache file.
+	 *
+	 * The file consists of a fixed-size header, followed by a sequence of arrays, each a 64-bit element count and
+	 * then the raw elements; everything is 8-byte aligned, so the file can be mapped into memory and read in place.
+	 * The file is written under a temporary name and then renamed, so readers never see a partial file.
+	 *
+	 * @param path			The path of the cache file.
+	 * @param source_hash	The hash of the source files the model was loaded from.
+	 * @param model			The tree model to write.
+	 */
+	void write_tree_model_cache(const std::string &path, uint64_t source_hash, const CachedTreeModel &model);
+
+	/**
+	 * @brief Read a tree model from a binary cache file, by mapping it into memory.
+	 *
+	 * @param path			The path of the cache file.
+	 * @param source_hash	The hash of the current source files.
+	 * @return The tree model, or nullopt if the file does not exist, is of another format version, was made from
+	 * 		   other source files, or is truncated.
+	 */
+	std::optional<CachedTreeModel> read_tree_model_cache(const std::string &path, uint64_t source_hash);
+
+	/**
+	 * @brief Load a tree model through the binary cache.
+	 *
+	 * If there is an up-to-date cache file for the tree, the model is read from it; otherwise, the model is loaded
+	 * from its source files, its derived properties are computed, and the cache file is (re-)generated. Failing to
+	 * write the cache is not an error; the model is then simply loaded from the source files again next time.
+	 *
+	 * @param tree_name		The name of the tree model.
+	 * @return The tree model.
+	 */
+	CachedTreeModel loadCachedTreeModel(const std::string &tree_name);
+
+}
+
+#endif //MGODPL_TREE_MESH_CACHE_H
@@ -0,0 +1,57 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#ifndef MGODPL_MORTON_H
+#define MGODPL_MORTON_H
+
+#include <array>
+#include <cstdint>
+
+/**
+ * Morton (Z-order) codes for 3D integer coordinates: the bits of x, y and z interleaved, with x in the lowest bit.
+ *
+ * Sorting cells by their Morton code visits them depth-first through an octree, with the children of every node in
+ * the order of the child indices used throughout the visibility code (bit 0: x, bit 1: y, bit 2: z).
+ */
+namespace mgodpl::math::morton {
+
+	/// The number of bits per coordinate that fit in a 64-bit code.
+	constexpr unsigned MAX_BITS = 21;
+
+	/// Spread the lower 21 bits of a value out to every third bit.
+	constexpr uint64_t spread_bits(uint32_t value) {
+		uint64_t x = value & 0x1fffff;
+		x = (x | x << 32) & 0x1f00000000ffffull;
+		x = (x | x << 16) & 0x1f0000ff0000ffull;
+		x = (x | x << 8) & 0x100f00f00f00f00full;
+		x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+		x = (x | x << 2) & 0x1249249249249249ull;
+		return x;
+	}
+
+	/// The inverse of spread_bits: gather every third bit into the lower 21 bits.
+	constexpr uint32_t compact_bits(uint64_t value) {
+		uint64_t x = value & 0x1249249249249249ull;
+		x = (x | x >> 2) & 0x10c30c30c30c30c3ull;
+		x = (x | x >> 4) & 0x100f00f00f00f00full;
+		x = (x | x >> 8) & 0x1f0000ff0000ffull;
+		x = (x | x >> 16) & 0x1f00000000ffffull;
+		x = (x | x >> 32) & 0x1fffff;
+		return (uint32_t) x;
+	}
+
+	/// The Morton code of a cell.
+	constexpr uint64_t encode(uint32_t x, uint32_t y, uint32_t z) {
+		return spread_bits(x) | spread_bits(y) << 1 | spread_bits(z) << 2;
+	}
+
+	/// The cell of a Morton code, as {x, y, z}.
+	constexpr std::array<uint32_t, 3> decode(uint64_t code) {
+		return {compact_bits(code), compact_bits(code >> 1), compact_bits(code >> 2)};
+	}
+
+	static_assert(decode(encode(5, 1234567, 2097151)) == std::array<uint32_t, 3>{5, 1234567, 2097151});
+}
+
+#endif //MGODPL_MORTON_H
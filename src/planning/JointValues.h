@@ -0,0 +1,159 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace mgodpl {
+
+	/// The maximum number of joint variables a RobotState can hold; our procedural arms use at most about ten.
+	constexpr size_t MAX_JOINT_VARIABLES = 16;
+
+	/**
+	 * @brief The joint values of a robot state, stored inline in a fixed-capacity buffer.
+	 *
+	 * This behaves like a std::vector<double> with a capacity of MAX_JOINT_VARIABLES, but never touches the heap:
+	 * copying, interpolating and comparing states is allocation-free, and containers of states are contiguous.
+	 * Growing beyond the capacity throws a std::length_error.
+	 */
+	class JointValues {
+	public:
+		using value_type = double;
+		using size_type = size_t;
+		using iterator = double *;
+		using const_iterator = const double *;
+
+		JointValues() = default;
+
+		/// Create n joint values, all equal to the given value.
+		explicit JointValues(size_t n, double value = 0.0) {
+			resize(n, value);
+		}
+
+		JointValues(std::initializer_list<double> values) : JointValues(values.begin(), values.end()) {
+		}
+
+		template<typename It>
+		JointValues(It first, It last) {
+			for (; first != last; ++first) {
+				push_back(*first);
+			}
+		}
+
+		/// Implicit, so that code building the joint values in a std::vector keeps working.
+		JointValues(const std::vector<double> &values) : JointValues(values.begin(), values.end()) {
+		}
+
+		[[nodiscard]] size_t size() const {
+			return _size;
+		}
+
+		[[nodiscard]] bool empty() const {
+			return _size == 0;
+		}
+
+		[[nodiscard]] static constexpr size_t capacity() {
+			return MAX_JOINT_VARIABLES;
+		}
+
+		[[nodiscard]] double *data() {
+			return _values.data();
+		}
+
+		[[nodiscard]] const double *data() const {
+			return _values.data();
+		}
+
+		double &operator[](size_t i) {
+			return _values[i];
+		}
+
+		const double &operator[](size_t i) const {
+			return _values[i];
+		}
+
+		[[nodiscard]] iterator begin() {
+			return data();
+		}
+
+		[[nodiscard]] iterator end() {
+			return data() + _size;
+		}
+
+		[[nodiscard]] const_iterator begin() const {
+			return data();
+		}
+
+		[[nodiscard]] const_iterator end() const {
+			return data() + _size;
+		}
+
+		double &front() {
+			return _values[0];
+		}
+
+		[[nodiscard]] const double &front() const {
+			return _values[0];
+		}
+
+		double &back() {
+			return _values[_size - 1];
+		}
+
+		[[nodiscard]] const double &back() const {
+			return _values[_size - 1];
+		}
+
+		void push_back(double value) {
+			reserve(_size + 1);
+			_values[_size++] = value;
+		}
+
+		double &emplace_back(double value) {
+			push_back(value);
+			return back();
+		}
+
+		void pop_back() {
+			--_size;
+		}
+
+		void resize(size_t n, double value = 0.0) {
+			reserve(n);
+			std::fill(_values.begin() + (ptrdiff_t) std::min(_size, n), _values.begin() + (ptrdiff_t) n, value);
+			_size = n;
+		}
+
+		/// Does not allocate; only checks that n values fit.
+		void reserve(size_t n) const {
+			if (n > MAX_JOINT_VARIABLES) {
+				throw std::length_error("More joint variables than MAX_JOINT_VARIABLES.");
+			}
+		}
+
+		void clear() {
+			_size = 0;
+		}
+
+		operator std::span<const double>() const {
+			return {data(), _size};
+		}
+
+		[[nodiscard]] bool operator==(const JointValues &other) const {
+			return std::equal(begin(), end(), other.begin(), other.end());
+		}
+
+	private:
+		std::array<double, MAX_JOINT_VARIABLES> _values{};
+		size_t _size = 0;
+	};
+
+}
@@ -2,82 +2,85 @@
 // Created by werner on 27-2-23.
 //
 
-#include <random>
-#include "MeshOcclusionModel.h"
-
-namespace mgodpl {
-
-	MeshOcclusionModel::MeshOcclusionModel(const Mesh &mesh, double margin) : margin(margin) {
-
-		// Use CGAL to create an AABB tree of the mesh's triangles.
-
-		for (const auto &triangle: mesh.triangles) {
-			const auto &p1 = mesh.vertices[triangle[0]];
-			const auto &p2 = mesh.vertices[triangle[1]];
-			const auto &p3 = mesh.vertices[triangle[2]];
-
-			// Skip degenerate triangles:
-			Point a(p1.x(), p1.y(), p1.z());
-			Point b(p2.x(), p2.y(), p2.z());
-			Point c(p3.x(), p3.y(), p3.z());
+#include <algorithm>
 
-			Triangle t(a, b, c);
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 
-			if (!t.is_degenerate()) {
-				triangles.push_back(t);
-			}
-		}
+#include "MeshOcclusionModel.h"
+#include "spherical_geometry.h"
 
-		tree.insert(triangles.begin(), triangles.end());
+namespace mgodpl {
 
+	MeshOcclusionModel::MeshOcclusionModel(const Mesh &mesh, double margin) : bvh(mesh), margin(margin) {
 	}
 
-	bool MeshOcclusionModel::checkOcclusion(const math::Vec3d &point, const math::Vec3d &viewpoint) const {
-
+	OcclusionBvh::Segment MeshOcclusionModel::occlusionSegment(const math::Vec3d &point,
+	                                                           const math::Vec3d &viewpoint) const {
 		// Actually check a point that's `margin` away from the point, in the direction of the viewpoint.
 		// This is to prevent the point from being occluded by accidentally being inside of the mesh.
-
-		// Create a segment from the viewpoint to the point.
 		const auto direction = (point - viewpoint).normalized();
 		const auto offset = direction * margin;
-		const auto offsetPoint = point - offset;
+		return {viewpoint, point - offset};
+	}
 
-		Segment segment(Point(viewpoint.x(), viewpoint.y(), viewpoint.z()),
-						Point(offsetPoint.x(), offsetPoint.y(), offsetPoint.z()));
+	bool MeshOcclusionModel::checkOcclusion(const math::Vec3d &point, const math::Vec3d &viewpoint) const {
+		// Check if the segment from the viewpoint to the point intersects the mesh.
+		return bvh.intersects(occlusionSegment(point, viewpoint));
+	}
 
-		// Check if the line intersects the mesh.
-		return tree.do_intersect(segment);
+	void MeshOcclusionModel::checkOcclusion(const std::vector<math::Vec3d> &points,
+	                                        const math::Vec3d &viewpoint,
+	                                        std::vector<bool> &occluded) const {
+		thread_local std::vector<OcclusionBvh::Segment> segments;
+		segments.clear();
+		for (const auto &point: points) {
+			segments.push_back(occlusionSegment(point, viewpoint));
+		}
+		bvh.intersects(segments, occluded);
+	}
 
+	double MeshOcclusionModel::exteriorVisibilityScore(const math::Vec3d &apple, const int n_samples) const {
+		return exteriorVisibilityScore(apple, spherical_geometry::fibonacci_sphere(n_samples));
 	}
 
-	double MeshOcclusionModel::exteriorVisibilityScore(const math::Vec3d &apple, const int n_samples) {
-		// Create a random number generator and a normal distribution
-		std::random_device rd;
-		std::mt19937 gen(rd());
-		std::normal_distribution<> d(0, 1);
+	double MeshOcclusionModel::exteriorVisibilityScore(const math::Vec3d &apple,
+	                                                   const std::vector<math::Vec3d> &directions,
+	                                                   double ray_length) const {
+		if (directions.empty()) {
+			return 0.0;
+		}
+
+		// All segments start near the apple, so they are checked as a batch.
+		thread_local std::vector<OcclusionBvh::Segment> segments;
+		thread_local std::vector<bool> occluded;
 
-		// Initialize a counter for the number of unoccluded lines
-		double visibility_factor = 0;
+		segments.clear();
+		for (const auto &direction: directions) {
+			// The segment between the apple and a point along the direction vector
+			segments.push_back(occlusionSegment(apple, apple + direction * ray_length));
+		}
 
-		// Loop through 1000 randomly generated directions and test for occlusion
-		for (int i = 0; i < n_samples; i++) {
-			// Generate a random direction vector and normalize it
-			math::Vec3d direction(d(gen), d(gen), d(gen));
-			direction.normalize();
+		bvh.intersects(segments, occluded);
 
-			// Scale the direction vector to a length of 10
-			direction *= 10.0;
+		// Count the unoccluded lines, and normalize by the number of tests.
+		const auto n_visible = std::count(occluded.begin(), occluded.end(), false);
+		return (double) n_visible / (double) directions.size();
+	}
 
-			// Test for occlusion between the apple and a point along the direction vector
-			bool occluded = checkOcclusion(apple, apple + direction);
+	std::vector<double> MeshOcclusionModel::exteriorVisibilityScores(const std::vector<math::Vec3d> &apples,
+	                                                                 const std::vector<math::Vec3d> &directions,
+	                                                                 double ray_length) const {
+		std::vector<double> scores(apples.size());
 
-			// Increment the counter if the line is unoccluded
-			visibility_factor += occluded ? 0 : 1;
-		}
+		// Every apple writes only its own score, so the result doesn't depend on how the work is split.
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, apples.size()), [&](const auto &range) {
+			for (size_t i = range.begin(); i < range.end(); ++i) {
+				scores[i] = exteriorVisibilityScore(apples[i], directions, ray_length);
+			}
+		});
 
-		// Normalize the visibility factor by the number of tests and return it
-		visibility_factor /= 1000.0;
-		return visibility_factor;
+		return scores;
 	}
 
 }
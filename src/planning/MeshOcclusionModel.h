@@ -9,37 +9,28 @@
 #ifndef NEW_PLANNERS_MESHOCCLUSIONMODEL_H
 #define NEW_PLANNERS_MESHOCCLUSIONMODEL_H
 
-#include <Eigen/Core>
-
-#include <CGAL/Simple_cartesian.h>
-#include <CGAL/AABB_tree.h>
-#include <CGAL/AABB_traits.h>
-#include <CGAL/AABB_triangle_primitive.h>
+#include <vector>
 
 #include "../math/Vec3.h"
 #include "Mesh.h"
+#include "occlusion_bvh.h"
 
 namespace mgodpl {
 	class MeshOcclusionModel {
 
-		using K = CGAL::Simple_cartesian<double>;
-		using FT = K::FT;
-		using Ray = K::Ray_3;
-		using Segment = K::Segment_3;
-		using Point = K::Point_3;
-		using Triangle = K::Triangle_3;
-		using Iterator = std::vector<Triangle>::iterator;
-		using Primitive = CGAL::AABB_triangle_primitive<K, Iterator>;
-		using AABB_triangle_traits = CGAL::AABB_traits<K, Primitive>;
-		using Tree = CGAL::AABB_tree<AABB_triangle_traits>;
-
-		Tree tree;
-		std::vector<Triangle> triangles;
+		OcclusionBvh bvh;
 
 		double margin = 0.05;
 
+		/// The segment actually checked for a point: from the viewpoint to `margin` short of the point.
+		[[nodiscard]] OcclusionBvh::Segment occlusionSegment(const math::Vec3d &point,
+		                                                     const math::Vec3d &viewpoint) const;
+
 	public:
 
+		/// The default length of the lines tested by exteriorVisibilityScore.
+		static constexpr double EXTERIOR_RAY_LENGTH = 10.0;
+
 		/**
 		 * Constructor. Creates a mesh occlusion model from a mesh.
 		 *
@@ -58,12 +49,62 @@ namespace mgodpl {
 		 */
 		[[nodiscard]] bool checkOcclusion(const math::Vec3d &point, const math::Vec3d &viewpoint) const;
 
+		/**
+		 * Checks, for a batch of points, whether each is occluded by the mesh from a shared viewpoint.
+		 *
+		 * Equivalent to calling checkOcclusion on every point, but the segments are traversed as packets,
+		 * which is considerably faster for large batches.
+		 *
+		 * @param points The points to check
+		 * @param viewpoint The viewpoint from which to check occlusion
+		 * @param occluded Output: one value per point, true if it is occluded
+		 */
+		void checkOcclusion(const std::vector<math::Vec3d> &points,
+		                    const math::Vec3d &viewpoint,
+		                    std::vector<bool> &occluded) const;
+
 		/**
 		 * Computes the exterior visibility score of an apple based on occlusion tests
+		 *
+		 * The sample directions are a Fibonacci lattice with a fixed seed, so the score is deterministic.
+		 *
 		 * @param apple - the position of the apple in 3D space
-		 * @return a score between 0 and 1 representing the fraction of random lines from the apple that are not occluded
+		 * @param n_samples - the number of directions to test
+		 * @return a score between 0 and 1 representing the fraction of lines from the apple that are not occluded
+		 */
+		[[nodiscard]] double exteriorVisibilityScore(const math::Vec3d &apple, int n_samples) const;
+
+		/**
+		 * Computes the exterior visibility score of an apple against a given set of directions, such as one
+		 * generated once with spherical_geometry::fibonacci_sphere and shared between many apples.
+		 *
+		 * @param apple The position of the apple
+		 * @param directions The unit directions to test
+		 * @param ray_length The length of the line tested in every direction
+		 * @return The fraction of the directions in which the line from the apple is not occluded
 		 */
-		double exteriorVisibilityScore(const math::Vec3d &apple, const int n_samples);
+		[[nodiscard]] double exteriorVisibilityScore(const math::Vec3d &apple,
+		                                             const std::vector<math::Vec3d> &directions,
+		                                             double ray_length = EXTERIOR_RAY_LENGTH) const;
+
+		/**
+		 * Computes the exterior visibility scores of many apples against one shared set of directions, in parallel.
+		 *
+		 * The result depends only on the inputs, not on the number of threads.
+		 *
+		 * @param apples The positions of the apples
+		 * @param directions The unit directions to test
+		 * @param ray_length The length of the line tested in every direction
+		 * @return One score per apple; see exteriorVisibilityScore
+		 */
+		[[nodiscard]] std::vector<double> exteriorVisibilityScores(const std::vector<math::Vec3d> &apples,
+		                                                           const std::vector<math::Vec3d> &directions,
+		                                                           double ray_length = EXTERIOR_RAY_LENGTH) const;
+
+		/// The margin by which checked segments are shortened; see checkOcclusion.
+		[[nodiscard]] double getMargin() const {
+			return margin;
+		}
 
 	};
 }
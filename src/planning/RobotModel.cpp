@@ -8,35 +8,39 @@
 
 #include "RobotModel.h"
 
+#include <algorithm>
+#include <cassert>
+#include <mutex>
 #include <numeric>
+#include <optional>
 
 #include "RobotState.h"
 
 namespace mgodpl::robot_model {
 
-	ForwardKinematicsResult forwardKinematics(const RobotModel &model,
-											  const std::vector<double> &joint_values,
-											  const RobotModel::LinkId &root_link,
-											  const math::Transformd &root_link_transform) {
-
-		// Allocate a result with all identity transforms.
-		ForwardKinematicsResult result{
-				.link_transforms = std::vector<math::Transformd>(model.getLinks().size(), root_link_transform)};
+	KinematicPlan compileKinematicPlan(const RobotModel &model, RobotModel::LinkId root_link) {
+		KinematicPlan plan{
+				.root_link = root_link,
+				.n_links = model.getLinks().size(),
+				.n_variables = 0,
+				.steps = {}
+		};
 
 		// Keep a vector to track which links have been visited, since a robot may contain cycles.
 		std::vector<bool> visited(model.getLinks().size(), false);
 
-		// Keep a stack of links to visit, and push the root link.
-		// Every entry in the stack is a pair of a link and its transform relative to the root_link.
-		std::vector<std::pair<RobotModel::LinkId, math::Transformd>> stack{{root_link, root_link_transform}};
+		// Keep a stack of links to visit, and push the root link. Every entry in the stack is the step that reaches
+		// it (or nullopt for the root); steps are only emitted when a link is first popped, so a link's parent always
+		// precedes it in the plan.
+		std::vector<std::pair<RobotModel::LinkId, std::optional<KinematicPlan::Step>>> stack{{root_link, std::nullopt}};
 
-		// Keep track of the index in the joint_values vector; this induces the DFS order.
+		// Keep track of the index in the joint values; this induces the DFS order.
 		size_t variable_index = 0;
 
 		while (!stack.empty()) {
 
 			// Pop the top of the stack.
-			auto [link, transform] = stack.back();
+			auto [link, step] = stack.back();
 			stack.pop_back();
 
 			// If we have already visited this link, skip it.
@@ -46,54 +50,140 @@ namespace mgodpl::robot_model {
 			// Mark the link as visited.
 			visited[link] = true;
 
-			// Update the transform for this link.
-			result.link_transforms[link] = transform;
+			// Emit the step that computes this link's transform.
+			if (step)
+				plan.steps.push_back(*step);
 
-			// For all children, if not already visited, compute their transform and push them on the stack.
-			for (const auto &joint: model.getLinks()[link].joints) {
+			// For all children, if not already visited, compile the step to them and push them on the stack.
+			for (const auto &joint_id: model.getLinks()[link].joints) {
+				const auto &joint = model.getJoints()[joint_id];
 
 				// If the other link is already visited, skip it.
-				if (visited[model.getJoints()[joint].linkB])
+				if (visited[joint.linkB])
 					continue;
 
-				// Compute the transform from the link to the joint.
-				math::Transformd local_to_joint = model.getJoints()[joint].linkA == link
-														  ? model.getJoints()[joint].attachmentA
-														  : model.getJoints()[joint].attachmentB;
+				bool forward = joint.linkA == link;
+
+				KinematicPlan::Step next{
+						.parent = link,
+						.link = forward ? joint.linkB : joint.linkA,
+						.kind = KinematicPlan::StepKind::FIXED,
+						.parent_to_joint = forward ? joint.attachmentA : joint.attachmentB,
+						.joint_to_link = (forward ? joint.attachmentB : joint.attachmentA).inverse(),
+						.axis = {0, 0, 0},
+						.variable_offset = variable_index
+				};
+
+				switch (joint.type_specific.index()) {
+					case 0: {
+						const auto &revolute_joint = std::get<RobotModel::RevoluteJoint>(joint.type_specific);
+						next.kind = KinematicPlan::StepKind::REVOLUTE;
+						// Traversing the joint backwards inverts the rotation.
+						next.axis = forward ? revolute_joint.axis : -revolute_joint.axis;
+						break;
+					}
+					case 1: {
+						// Nothing variable in between; fold the two constant transforms together.
+						next.parent_to_joint = next.parent_to_joint.then(next.joint_to_link);
+						next.joint_to_link = math::Transformd::identity();
+						break;
+					}
+					default:
+						throw std::runtime_error("Unknown joint type");
+				}
+
+				variable_index += RobotModel::n_variables(joint.type_specific);
 
-				// Compute the transform induced by the variable part of the joint.
-				math::Transformd joint_transform = RobotModel::variableTransform(model.getJoints()[joint].type_specific,
-																				 joint_values.data() + variable_index);
-				if (model.getJoints()[joint].linkB == link)
-					joint_transform = joint_transform.inverse();
-				variable_index += RobotModel::n_variables(model.getJoints()[joint].type_specific);
+				// Push the next link on the stack.
+				stack.emplace_back(next.link, next);
+			}
+		}
 
-				// Compute the transform from the joint to the link.
-				math::Transformd after_joint_frame =
-						(model.getJoints()[joint].linkA == link ? model.getJoints()[joint].attachmentB
-																: model.getJoints()[joint].attachmentA)
-								.inverse();
+		plan.n_variables = variable_index;
 
-				// Compute the transform from the link to the next link.
-				math::Transformd next_link_transform =
-						transform.then(local_to_joint).then(joint_transform).then(after_joint_frame);
+		return plan;
+	}
 
-				// Push the next link on the stack.
-				stack.emplace_back(model.getJoints()[joint].linkA == link ? model.getJoints()[joint].linkB
-																		  : model.getJoints()[joint].linkA,
-								   next_link_transform);
+	void forwardKinematics(const KinematicPlan &plan,
+						   const double *joint_values,
+						   const math::Transformd &root_link_transform,
+						   math::Transformd *link_transforms) {
+
+		// Unreachable links (and the root) get the root transform.
+		std::fill(link_transforms, link_transforms + plan.n_links, root_link_transform);
+
+		for (const auto &step: plan.steps) {
+			const math::Transformd &parent_tf = link_transforms[step.parent];
+
+			switch (step.kind) {
+				case KinematicPlan::StepKind::REVOLUTE: {
+					math::Transformd joint_tf = math::Transformd::fromRotation(
+							math::Quaterniond::fromAxisAngle(step.axis, joint_values[step.variable_offset]));
+					link_transforms[step.link] = parent_tf.then(step.parent_to_joint).then(joint_tf).then(step.joint_to_link);
+					break;
+				}
+				case KinematicPlan::StepKind::FIXED:
+					link_transforms[step.link] = parent_tf.then(step.parent_to_joint);
+					break;
 			}
 		}
+	}
+
+	ForwardKinematicsResult forwardKinematics(const RobotModel &model,
+											  std::span<const double> joint_values,
+											  const RobotModel::LinkId &root_link,
+											  const math::Transformd &root_link_transform) {
+
+		const KinematicPlan &plan = model.kinematicPlan(root_link);
+
+		assert(joint_values.size() >= plan.n_variables);
+
+		ForwardKinematicsResult result{.link_transforms = std::vector<math::Transformd>(plan.n_links)};
+
+		forwardKinematics(plan, joint_values.data(), root_link_transform, result.link_transforms.data());
 
 		// Return the result.
 		return result;
 	}
+
 	ForwardKinematicsResult
 	forwardKinematics(const RobotModel &model, const RobotState &state, const RobotModel::LinkId &root_link) {
 		return forwardKinematics(model, state.joint_values, root_link, state.base_tf);
 	}
 
+	const KinematicPlan &RobotModel::kinematicPlan(LinkId root_link) const {
+		{
+			std::shared_lock lock(kinematic_plans.mutex);
+			if (root_link < kinematic_plans.plans.size() && kinematic_plans.plans[root_link]) {
+				return *kinematic_plans.plans[root_link];
+			}
+		}
+
+		// Compile outside the lock; if another thread compiled the same plan in the meantime, theirs is kept.
+		auto plan = std::make_unique<const KinematicPlan>(compileKinematicPlan(*this, root_link));
+
+		std::unique_lock lock(kinematic_plans.mutex);
+		if (kinematic_plans.plans.size() <= root_link) {
+			kinematic_plans.plans.resize(root_link + 1);
+		}
+		if (!kinematic_plans.plans[root_link]) {
+			kinematic_plans.plans[root_link] = std::move(plan);
+		}
+		return *kinematic_plans.plans[root_link];
+	}
+
+	// Out of line, since KinematicPlan is incomplete in the header.
+	RobotModel::KinematicPlanCache &RobotModel::KinematicPlanCache::operator=(const KinematicPlanCache &) {
+		plans.clear();
+		return *this;
+	}
+
+	RobotModel::KinematicPlanCache::~KinematicPlanCache() = default;
+
 	RobotModel::LinkId RobotModel::insertLink(const RobotModel::Link &link) {
+		// The cached plans no longer cover the whole model.
+		kinematic_plans.plans.clear();
+
 		// Just push the link onto the vector, and return the index.
 		links.push_back(link);
 
@@ -101,6 +191,9 @@ namespace mgodpl::robot_model {
 	}
 
 	RobotModel::JointId RobotModel::insertJoint(const RobotModel::Joint &joint) {
+		// The cached plans no longer match the joint graph.
+		kinematic_plans.plans.clear();
+
 		// Just push the joint onto the vector, and return the index.
 		joints.push_back(joint);
 
@@ -9,6 +9,9 @@
 #ifndef MGODPL_ROBOTMODEL_H
 #define MGODPL_ROBOTMODEL_H
 
+#include <memory>
+#include <shared_mutex>
+#include <span>
 #include <string>
 #include <variant>
 #include <vector>
@@ -27,6 +30,8 @@ namespace mgodpl {
  */
 namespace mgodpl::robot_model {
 
+	struct KinematicPlan;
+
 	/**
 	 * @brief A robot model, consisting of links and joints.
 	 *
@@ -187,12 +192,44 @@ namespace mgodpl::robot_model {
 			return joints;
 		}
 
+		/**
+		 * @brief Returns the compiled kinematic plan from the given root link, compiling it on first use.
+		 *
+		 * This is safe to call from multiple threads concurrently. The plan stays valid until the next
+		 * insertLink or insertJoint, or until the model is destroyed.
+		 *
+		 * @param root_link 	The link from which to compute the forward kinematics.
+		 * @return 				The compiled plan.
+		 */
+		[[nodiscard]] const KinematicPlan &kinematicPlan(LinkId root_link) const;
+
 	private:
 		/// The links in the model.
 		std::vector<Link> links;
 
 		/// The joints in the model.
 		std::vector<Joint> joints;
+
+		/**
+		 * @brief The compiled kinematic plans, indexed by root link; filled on first use by kinematicPlan.
+		 *
+		 * A copy of a model starts with an empty cache, since the mutex cannot be copied.
+		 */
+		struct KinematicPlanCache {
+			std::shared_mutex mutex;
+			std::vector<std::unique_ptr<const KinematicPlan> > plans;
+
+			KinematicPlanCache() = default;
+
+			KinematicPlanCache(const KinematicPlanCache &) {
+			}
+
+			KinematicPlanCache &operator=(const KinematicPlanCache &);
+
+			~KinematicPlanCache();
+		};
+
+		mutable KinematicPlanCache kinematic_plans;
 	};
 
 	/**
@@ -212,10 +249,92 @@ namespace mgodpl::robot_model {
 		}
 	};
 
+	/**
+	 * @brief A precomputed traversal of a robot model's joint graph from a given root link.
+	 *
+	 * Computing the forward kinematics of a model requires a traversal of the joint graph; since that traversal only
+	 * depends on the model and the root link, it can be compiled once into a flat list of steps, in an order such that
+	 * every link's parent is computed before the link itself. Forward kinematics is then a single linear pass.
+	 */
+	struct KinematicPlan {
+
+		/// The kind of joint that a step traverses; this replaces the dispatch on the JointTypeSpecific variant.
+		enum class StepKind {
+			REVOLUTE,
+			FIXED
+		};
+
+		/**
+		 * @brief A single step of the plan, computing the transform of one link from that of its parent.
+		 *
+		 * The transform of the link is computed as:
+		 * `parent.then(parent_to_joint).then(rotation around axis by joint_values[variable_offset]).then(joint_to_link)`,
+		 * where the rotation is omitted for fixed joints (whose constant parts are pre-multiplied into parent_to_joint).
+		 */
+		struct Step {
+			/// The link whose transform this step reads.
+			RobotModel::LinkId parent;
+			/// The link whose transform this step writes.
+			RobotModel::LinkId link;
+			/// The kind of joint traversed.
+			StepKind kind;
+			/// The transform from the parent link's frame to the joint's frame.
+			math::Transformd parent_to_joint;
+			/// The transform from the joint's frame to the link's frame. (Identity for fixed joints.)
+			math::Transformd joint_to_link;
+			/// The axis of rotation for a revolute joint.
+			math::Vec3d axis;
+			/// The index of the joint's variable in the joint values.
+			size_t variable_offset;
+		};
+
+		/// The link from which the forward kinematics are computed.
+		RobotModel::LinkId root_link;
+
+		/// The number of links in the model; the size of the transform buffer that forwardKinematics writes to.
+		size_t n_links;
+
+		/// The number of joint variables consumed by the plan.
+		size_t n_variables;
+
+		/// The steps, in topological order.
+		std::vector<Step> steps;
+	};
+
+	/**
+	 * @brief Compiles the kinematic traversal of a model from a given root link into a KinematicPlan.
+	 *
+	 * The traversal, and therefore the order of the joint values, is the same as that of `forwardKinematics`.
+	 *
+	 * @param model 		The robot model. The plan does not refer back to it.
+	 * @param root_link 	The link from which to compute the forward kinematics.
+	 * @return 				The compiled plan.
+	 */
+	KinematicPlan compileKinematicPlan(const RobotModel &model, RobotModel::LinkId root_link);
+
+	/**
+	 * @brief Computes the forward kinematics from a compiled plan, writing into a caller-provided buffer.
+	 *
+	 * This function does not allocate.
+	 *
+	 * @param plan 					The compiled kinematic plan.
+	 * @param joint_values 			The joint values; at least `plan.n_variables` of them.
+	 * @param root_link_transform 	The transform of the root link.
+	 * @param link_transforms 		The output buffer, of at least `plan.n_links` transforms, indexed by LinkId.
+	 * 								Links not reachable from the root get the root link's transform.
+	 */
+	void forwardKinematics(const KinematicPlan &plan,
+						   const double *joint_values,
+						   const math::Transformd &root_link_transform,
+						   math::Transformd *link_transforms);
+
 	/**
 	 * @brief Computes the forward kinematics of a robot model, given a set of joint values and a link from which to
 	 * compute the forward kinematics.
 	 *
+	 * The kinematic plan is compiled once per model and root link, and cached in the model (see
+	 * RobotModel::kinematicPlan); only the result is allocated per call.
+	 *
 	 * @param model 				The robot model.
 	 * @param joint_values 			The joint values (in DFS order from the root_link).
 	 * @param root_link 			The link from which to compute the forward kinematics.
@@ -225,7 +344,7 @@ namespace mgodpl::robot_model {
 	 */
 	ForwardKinematicsResult
 	forwardKinematics(const RobotModel &model,
-					  const std::vector<double> &joint_values,
+					  std::span<const double> joint_values,
 					  const RobotModel::LinkId &root_link,
 					  const math::Transformd &from_link_transform = math::Transformd::identity());
 
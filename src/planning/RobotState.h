@@ -8,14 +8,14 @@
 
 #pragma once
 
-#include <vector>
 #include "../math/Transform.h"
+#include "JointValues.h"
 
 namespace mgodpl {
 
 	struct RobotState {
 		math::Transformd base_tf;
-		std::vector<double> joint_values;
+		JointValues joint_values;
 
 		[[nodiscard]] bool operator==(const RobotState &other) const {
 			return base_tf == other.base_tf && joint_values == other.joint_values;
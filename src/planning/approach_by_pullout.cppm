@@ -9,6 +9,7 @@
 module;
 
 #include <optional>
+#include <tbb/enumerable_thread_specific.h>
 #include "ApproachPath.h"
 #include "fcl_forward_declarations.h"
 #include "cgal_chull_shortest_paths.h"
@@ -58,43 +59,56 @@ export namespace mgodpl::approach_planning {
 		const auto &base_link = robot.findLinkByName("flying_base");
 		const auto &end_effector_link = robot.findLinkByName("end_effector");
 
-		// Take 1000 goal samples:
-		for (size_t i = 0; i < max_goal_samples; ++i) {
-
-			auto sample = mgodpl::genGoalStateUniform(
-					rng,
-					target_point,
-					distance_from_target,
-					robot,
-					base_link,
-					end_effector_link
-			);
-
-			bool collision_free = !check_robot_collision(robot, obstacle, sample);
-
-			if (hooks) hooks->sampled_state(sample, collision_free);
-
-			// Check collisions:
-			if (collision_free) {
-				const auto &path = straightout(
-						robot,
-						sample,
-						chull_shell.tree,
-						chull_shell.mesh_path
-				);
-
-				bool path_collision_free = !check_path_collides(robot, obstacle, path.path);
-
-				if (hooks) hooks->pullout_motion_considered(path, path_collision_free);
-
-				if (path_collision_free) {
-					return path;
-				}
-			}
-		}
-
-		return std::nullopt;
+		// One collision model per thread, since the goal samples are checked in parallel batches.
+		tbb::enumerable_thread_specific<RobotCollisionModel> collision_models([&robot]() {
+			return RobotCollisionModel(robot);
+		});
+
+		std::optional<ApproachPath> result;
+
+		// Take up to max_goal_samples goal samples, and try to pull out of every valid one, in the order sampled:
+		sample_and_check_in_batches(
+				max_goal_samples,
+				rng,
+				[&](random_numbers::RandomNumberGenerator &candidate_rng) {
+					return mgodpl::genGoalStateUniform(
+							candidate_rng,
+							target_point,
+							distance_from_target,
+							robot,
+							base_link,
+							end_effector_link
+					);
+				},
+				[&](const RobotState &sample) {
+					return check_robot_collision(collision_models.local(), obstacle, sample);
+				},
+				[&](const RobotState &sample, bool collision_free) {
+					if (hooks) hooks->sampled_state(sample, collision_free);
+
+					if (!collision_free) {
+						return false;
+					}
+
+					const auto &path = straightout(
+							robot,
+							sample,
+							chull_shell.tree,
+							chull_shell.mesh_path
+					);
+
+					bool path_collision_free = !check_path_collides(collision_models.local(), obstacle, path.path);
+
+					if (hooks) hooks->pullout_motion_considered(path, path_collision_free);
+
+					if (path_collision_free) {
+						result = path;
+					}
+
+					return path_collision_free;
+				});
+
+		return result;
 	}
 
 }
-
@@ -0,0 +1,223 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include "batched_forward_kinematics.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "simd_lanes.h"
+
+namespace mgodpl::robot_model {
+
+	namespace {
+		using simd::Lanes;
+
+		/// A vector of Lanes, one Vec3d per lane.
+		struct Vec3L {
+			Lanes x, y, z;
+		};
+
+		/// A quaternion of Lanes, one Quaterniond per lane.
+		struct QuatL {
+			Lanes x, y, z, w;
+
+			/// Same as Quaterniond::operator*.
+			QuatL operator*(const QuatL &o) const {
+				return {
+						.x = w * o.x + x * o.w + y * o.z - z * o.y,
+						.y = w * o.y - x * o.z + y * o.w + z * o.x,
+						.z = w * o.z + x * o.y - y * o.x + z * o.w,
+						.w = w * o.w - x * o.x - y * o.y - z * o.z
+				};
+			}
+
+			/// Same as Quaterniond::rotate, i.e. q * v * q^-1.
+			Vec3L rotate(const Vec3L &v) const {
+				const Lanes zero = Lanes::broadcast(0.0);
+				QuatL r = *this * QuatL{v.x, v.y, v.z, zero} * QuatL{zero - x, zero - y, zero - z, w};
+				return {r.x, r.y, r.z};
+			}
+		};
+
+		/// A transform of Lanes, one Transformd per lane.
+		struct TransformL {
+			Vec3L translation;
+			QuatL orientation;
+
+			static TransformL load(const TransformBatch &batch, size_t i) {
+				using C = TransformBatch::Component;
+				return {
+						.translation = {
+								Lanes::load(batch.component(C::TX) + i),
+								Lanes::load(batch.component(C::TY) + i),
+								Lanes::load(batch.component(C::TZ) + i)
+						},
+						.orientation = {
+								Lanes::load(batch.component(C::QX) + i),
+								Lanes::load(batch.component(C::QY) + i),
+								Lanes::load(batch.component(C::QZ) + i),
+								Lanes::load(batch.component(C::QW) + i)
+						}
+				};
+			}
+
+			static TransformL broadcast(const math::Transformd &tf) {
+				return {
+						.translation = {
+								Lanes::broadcast(tf.translation.x()),
+								Lanes::broadcast(tf.translation.y()),
+								Lanes::broadcast(tf.translation.z())
+						},
+						.orientation = {
+								Lanes::broadcast(tf.orientation.x),
+								Lanes::broadcast(tf.orientation.y),
+								Lanes::broadcast(tf.orientation.z),
+								Lanes::broadcast(tf.orientation.w)
+						}
+				};
+			}
+
+			void store(TransformBatch &batch, size_t i) const {
+				using C = TransformBatch::Component;
+				translation.x.store(batch.component(C::TX) + i);
+				translation.y.store(batch.component(C::TY) + i);
+				translation.z.store(batch.component(C::TZ) + i);
+				orientation.x.store(batch.component(C::QX) + i);
+				orientation.y.store(batch.component(C::QY) + i);
+				orientation.z.store(batch.component(C::QZ) + i);
+				orientation.w.store(batch.component(C::QW) + i);
+			}
+
+			/// Same as Transformd::then.
+			TransformL then(const TransformL &other) const {
+				Vec3L rotated = orientation.rotate(other.translation);
+				return {
+						.translation = {
+								translation.x + rotated.x,
+								translation.y + rotated.y,
+								translation.z + rotated.z
+						},
+						.orientation = orientation * other.orientation
+				};
+			}
+		};
+	}
+
+	TransformBatch::TransformBatch(size_t size)
+		: size(size), stride(simd::padded_stride(size)), data(N_COMPONENTS * stride, 0.0) {
+		std::fill(component(QW), component(QW) + stride, 1.0);
+	}
+
+	math::Transformd TransformBatch::get(size_t i) const {
+		return {
+				.translation = {component(TX)[i], component(TY)[i], component(TZ)[i]},
+				.orientation = {component(QX)[i], component(QY)[i], component(QZ)[i], component(QW)[i]}
+		};
+	}
+
+	void TransformBatch::set(size_t i, const math::Transformd &tf) {
+		component(TX)[i] = tf.translation.x();
+		component(TY)[i] = tf.translation.y();
+		component(TZ)[i] = tf.translation.z();
+		component(QX)[i] = tf.orientation.x;
+		component(QY)[i] = tf.orientation.y;
+		component(QZ)[i] = tf.orientation.z;
+		component(QW)[i] = tf.orientation.w;
+	}
+
+	RobotStateBatch RobotStateBatch::fromStates(const std::vector<RobotState> &states) {
+		RobotStateBatch batch{
+				.base_tfs = TransformBatch(states.size()),
+				.n_variables = states.empty() ? 0 : states[0].joint_values.size(),
+				.joint_values = {}
+		};
+
+		batch.joint_values.resize(batch.n_variables * batch.base_tfs.stride, 0.0);
+
+		for (size_t i = 0; i < states.size(); ++i) {
+			assert(states[i].joint_values.size() == batch.n_variables);
+			batch.base_tfs.set(i, states[i].base_tf);
+			for (size_t v = 0; v < batch.n_variables; ++v) {
+				batch.joint_values[v * batch.base_tfs.stride + i] = states[i].joint_values[v];
+			}
+		}
+
+		return batch;
+	}
+
+	void forwardKinematicsBatch(const KinematicPlan &plan,
+								const RobotStateBatch &states,
+								BatchedForwardKinematicsResult &result) {
+
+		assert(states.n_variables >= plan.n_variables);
+
+		const size_t n = states.size();
+		const size_t stride = states.base_tfs.stride;
+
+		// (Re-)shape the result if needed.
+		if (result.link_transforms.size() != plan.n_links ||
+			(!result.link_transforms.empty() && result.link_transforms[0].size != n)) {
+			result.link_transforms.assign(plan.n_links, TransformBatch(n));
+		}
+
+		// Unreachable links (and the root) get the root transform.
+		for (auto &link_batch: result.link_transforms) {
+			link_batch.data = states.base_tfs.data;
+		}
+
+		// The joint rotations; the sines and cosines are computed per lane, the rest is vectorized.
+		alignas(32) double sin_half[Lanes::WIDTH];
+		alignas(32) double cos_half[Lanes::WIDTH];
+
+		for (const auto &step: plan.steps) {
+			const TransformBatch &parent_batch = result.link_transforms[step.parent];
+			TransformBatch &link_batch = result.link_transforms[step.link];
+
+			const TransformL parent_to_joint = TransformL::broadcast(step.parent_to_joint);
+
+			switch (step.kind) {
+				case KinematicPlan::StepKind::REVOLUTE: {
+					const TransformL joint_to_link = TransformL::broadcast(step.joint_to_link);
+					const Lanes axis_x = Lanes::broadcast(step.axis.x());
+					const Lanes axis_y = Lanes::broadcast(step.axis.y());
+					const Lanes axis_z = Lanes::broadcast(step.axis.z());
+					const double *values = states.variable(step.variable_offset);
+
+					for (size_t i = 0; i < stride; i += Lanes::WIDTH) {
+						for (size_t lane = 0; lane < Lanes::WIDTH; ++lane) {
+							double half_angle = values[i + lane] / 2.0;
+							sin_half[lane] = std::sin(half_angle);
+							cos_half[lane] = std::cos(half_angle);
+						}
+
+						// Same as Quaterniond::fromAxisAngle.
+						const Lanes s = Lanes::load(sin_half);
+						const QuatL joint_rotation{axis_x * s, axis_y * s, axis_z * s, Lanes::load(cos_half)};
+
+						TransformL at_joint = TransformL::load(parent_batch, i).then(parent_to_joint);
+
+						// Pure rotation, so the translation is unaffected.
+						at_joint.orientation = at_joint.orientation * joint_rotation;
+
+						at_joint.then(joint_to_link).store(link_batch, i);
+					}
+					break;
+				}
+				case KinematicPlan::StepKind::FIXED:
+					for (size_t i = 0; i < stride; i += Lanes::WIDTH) {
+						TransformL::load(parent_batch, i).then(parent_to_joint).store(link_batch, i);
+					}
+					break;
+			}
+		}
+	}
+
+	BatchedForwardKinematicsResult forwardKinematicsBatch(const KinematicPlan &plan, const RobotStateBatch &states) {
+		BatchedForwardKinematicsResult result;
+		forwardKinematicsBatch(plan, states, result);
+		return result;
+	}
+}
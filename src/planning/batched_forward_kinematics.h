@@ -0,0 +1,140 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#ifndef MGODPL_BATCHED_FORWARD_KINEMATICS_H
+#define MGODPL_BATCHED_FORWARD_KINEMATICS_H
+
+#include <vector>
+
+#include "RobotModel.h"
+#include "RobotState.h"
+
+namespace mgodpl::robot_model {
+
+	/**
+	 * @brief A batch of transforms, stored structure-of-arrays.
+	 *
+	 * The data holds seven arrays (translation x, y, z and orientation x, y, z, w) of `stride` doubles each, back to
+	 * back. The stride is the size rounded up to the SIMD width, so that kernels never need a scalar tail; the padding
+	 * lanes hold identity transforms.
+	 */
+	struct TransformBatch {
+
+		/// The index of each component array in the data.
+		enum Component {
+			TX = 0, TY, TZ, QX, QY, QZ, QW, N_COMPONENTS
+		};
+
+		/// The number of transforms in the batch.
+		size_t size = 0;
+
+		/// The length of each component array; `size` rounded up to the SIMD width.
+		size_t stride = 0;
+
+		/// The component arrays, back to back.
+		std::vector<double> data;
+
+		/**
+		 * @brief Create a batch of identity transforms.
+		 *
+		 * @param size 		The number of transforms.
+		 */
+		explicit TransformBatch(size_t size = 0);
+
+		/// The array of a single component.
+		[[nodiscard]] double *component(Component c) {
+			return data.data() + c * stride;
+		}
+
+		/// The array of a single component.
+		[[nodiscard]] const double *component(Component c) const {
+			return data.data() + c * stride;
+		}
+
+		/// Gather the i-th transform.
+		[[nodiscard]] math::Transformd get(size_t i) const;
+
+		/// Scatter a transform into the i-th position.
+		void set(size_t i, const math::Transformd &tf);
+	};
+
+	/**
+	 * @brief A batch of robot states, stored structure-of-arrays.
+	 */
+	struct RobotStateBatch {
+
+		/// The base transforms of the states.
+		TransformBatch base_tfs;
+
+		/// The number of joint variables per state.
+		size_t n_variables = 0;
+
+		/// The joint values, variable-major: variable `v` of state `i` is at `v * base_tfs.stride + i`.
+		std::vector<double> joint_values;
+
+		/**
+		 * @brief Transpose a vector of states into a batch.
+		 *
+		 * @param states 	The states; all must have the same number of joint values.
+		 * @return 			The batch.
+		 */
+		static RobotStateBatch fromStates(const std::vector<RobotState> &states);
+
+		/// The number of states in the batch.
+		[[nodiscard]] size_t size() const {
+			return base_tfs.size;
+		}
+
+		/// The array of values of a single joint variable.
+		[[nodiscard]] const double *variable(size_t v) const {
+			return joint_values.data() + v * base_tfs.stride;
+		}
+	};
+
+	/**
+	 * @brief The result of a batched forward kinematics computation: one TransformBatch per link.
+	 */
+	struct BatchedForwardKinematicsResult {
+		std::vector<TransformBatch> link_transforms;
+
+		/**
+		 * @brief Returns the transform of a link in a given state.
+		 *
+		 * @param link 		The ID of the link.
+		 * @param state 	The index of the state in the batch.
+		 * @return 			The transform of the link.
+		 */
+		[[nodiscard]] math::Transformd forLink(RobotModel::LinkId link, size_t state) const {
+			return link_transforms[link].get(state);
+		}
+	};
+
+	/**
+	 * @brief Compute the forward kinematics of a whole batch of states at once.
+	 *
+	 * The computation is the same as applying the scalar `forwardKinematics(plan, ...)` to every state, but vectorized
+	 * across states: with AVX2 enabled (see the MGODPL_AVX2 CMake option), four states are processed per instruction,
+	 * otherwise a scalar fallback is used. Results agree with the scalar version up to floating-point rounding.
+	 *
+	 * @param plan 		The compiled kinematic plan.
+	 * @param states 	The batch of states; must have at least `plan.n_variables` joint variables.
+	 * @param result 	The result; its storage is reused if it already has the right shape, so a caller that keeps it
+	 * 					around between batches of the same size does not allocate.
+	 */
+	void forwardKinematicsBatch(const KinematicPlan &plan,
+								const RobotStateBatch &states,
+								BatchedForwardKinematicsResult &result);
+
+	/**
+	 * @brief Compute the forward kinematics of a whole batch of states at once. (Allocating variant.)
+	 *
+	 * @param plan 		The compiled kinematic plan.
+	 * @param states 	The batch of states.
+	 * @return 			The link transforms of all states.
+	 */
+	BatchedForwardKinematicsResult forwardKinematicsBatch(const KinematicPlan &plan, const RobotStateBatch &states);
+
+}
+
+#endif //MGODPL_BATCHED_FORWARD_KINEMATICS_H
@@ -27,8 +27,12 @@ namespace mgodpl::cgal {
 	}
 
 	CgalMeshData::CgalMeshData(const Mesh &leaves_mesh)
-			: convex_hull(cgal_convex_hull_around_leaves(leaves_mesh)),
-			  mesh_path(convex_hull),
+			: CgalMeshData(cgal_convex_hull_around_leaves(leaves_mesh)) {
+	}
+
+	CgalMeshData::CgalMeshData(Surface_mesh convex_hull)
+			: convex_hull(std::move(convex_hull)),
+			  mesh_path(this->convex_hull),
 			  tree()
 	{
 		mesh_path.build_aabb_tree(tree);
@@ -95,4 +99,20 @@ namespace mgodpl::cgal {
 
 		return mesh;
 	}
+
+	Surface_mesh meshToCgalMesh(const Mesh &mesh) {
+		Surface_mesh cgal_mesh;
+
+		for (const auto &vertex: mesh.vertices) {
+			cgal_mesh.add_vertex(to_cgal_point(vertex));
+		}
+
+		for (const auto &triangle: mesh.triangles) {
+			cgal_mesh.add_face(Surface_mesh::Vertex_index(triangle[0]),
+							   Surface_mesh::Vertex_index(triangle[1]),
+							   Surface_mesh::Vertex_index(triangle[2]));
+		}
+
+		return cgal_mesh;
+	}
 }
@@ -77,6 +77,9 @@ namespace mgodpl::cgal {
 	 * This function takes a mesh representing the leaves of a tree and computes the convex hull around them.
 	 * The convex hull is represented as a CGAL Surface_mesh.
 	 *
+	 * The hull of every tree model is stored in the binary tree model cache; if the computation changes, bump
+	 * TREE_CACHE_PROCESSING_VERSION in experiment_utils/tree_mesh_cache.h.
+	 *
 	 * @param leaves_mesh The mesh representing the leaves of the tree.
 	 * @return The convex hull around the leaves as a CGAL Surface_mesh.
 	 */
@@ -105,6 +108,13 @@ namespace mgodpl::cgal {
 		 * @param tree_model The tree model from which to compute the mesh data.
 		 */
 		explicit CgalMeshData(const Mesh &leaves_mesh);
+
+		/**
+		 * @brief Constructor for the CgalMeshData struct, from a previously computed convex hull.
+		 *
+		 * @param convex_hull The convex hull around the leaves of the tree.
+		 */
+		explicit CgalMeshData(Surface_mesh convex_hull);
 	};
 
 	Surface_mesh_shortest_path::Face_location locate_nearest(const math::Vec3d &pt, const CgalMeshData &data);
@@ -124,6 +134,14 @@ namespace mgodpl::cgal {
 	 * @return The converted Mesh object.
 	 */
 	Mesh cgalMeshToMesh(const cgal::Surface_mesh &cgal_mesh);
+
+	/**
+	 * @brief Converts a Mesh to a CGAL Surface_mesh; the inverse of cgalMeshToMesh.
+	 *
+	 * @param mesh The Mesh to be converted.
+	 * @return The converted CGAL Surface_mesh, with the vertices and faces in the same order.
+	 */
+	cgal::Surface_mesh meshToCgalMesh(const Mesh &mesh);
 }
 
 #endif //MGODPL_CGAL_CHULL_SHORTEST_PATHS_H
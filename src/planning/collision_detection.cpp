@@ -7,12 +7,278 @@
 //
 
 #include <fcl/common/types.h>
+#include <fcl/geometry/bvh/BVH_model.h>
 #include <fcl/geometry/shape/box.h>
+#include <fcl/math/bv/OBB.h>
+#include <fcl/math/bv/OBBRSS.h>
 #include <fcl/narrowphase/collision_request.h>
 #include <fcl/narrowphase/collision.h>
+#include <fcl/narrowphase/collision_object.h>
+#include <fcl/narrowphase/distance.h>
+
+#include <cassert>
+#include <limits>
 
 #include "collision_detection.h"
 
+namespace mgodpl {
+	/**
+	 * Convert a math::Transformd into the equivalent FCL transform.
+	 */
+	static fcl::Transform3d to_fcl_transform(const math::Transformd &tf) {
+		fcl::Transform3d fcl_tf;
+		fcl_tf.setIdentity();
+		fcl_tf.translation() = fcl::Vector3d(tf.translation.x(), tf.translation.y(), tf.translation.z());
+		fcl_tf.rotate(fcl::Quaterniond(tf.orientation.w, tf.orientation.x, tf.orientation.y, tf.orientation.z));
+		return fcl_tf;
+	}
+
+	/// The maximum number of boxes that the obstacle is covered with for clearance culling.
+	static constexpr size_t MAX_OBSTACLE_BOUNDS = 64;
+
+	static math::AABBd to_math_aabb(const fcl::AABBd &aabb) {
+		return {
+			{aabb.min_.x(), aabb.min_.y(), aabb.min_.z()},
+			{aabb.max_.x(), aabb.max_.y(), aabb.max_.z()}
+		};
+	}
+
+	/**
+	 * The Euclidean distance between two boxes; zero if they overlap.
+	 */
+	static double aabb_distance(const math::AABBd &a, const math::AABBd &b) {
+		const math::Vec3d gap = (a.min() - b.max()).max(b.min() - a.max()).max(math::Vec3d(0.0, 0.0, 0.0));
+		return gap.norm();
+	}
+
+	static const fcl::OBBd &as_obb(const fcl::OBBd &bv) {
+		return bv;
+	}
+
+	static const fcl::OBBd &as_obb(const fcl::OBBRSSd &bv) {
+		return bv.obb;
+	}
+
+	/**
+	 * If the obstacle is a BVHModel over the given bounding volume type, cover it with the world-space bounding boxes
+	 * of the nodes in a breadth-first cut through its hierarchy, of at most MAX_OBSTACLE_BOUNDS nodes.
+	 *
+	 * @return 	False if the obstacle is not such a model; `bounds` is then left untouched.
+	 */
+	template<typename BV>
+	static bool collect_bvh_bounds(const fcl::CollisionObjectd &obstacle, std::vector<math::AABBd> &bounds) {
+		const auto *model = dynamic_cast<const fcl::BVHModel<BV> *>(obstacle.collisionGeometry().get());
+		if (model == nullptr || model->getNumBVs() == 0) {
+			return false;
+		}
+
+		// Expand a level at a time, as long as the cut stays within the limit.
+		std::vector<int> cut{0}, next;
+		while (true) {
+			next.clear();
+			for (int node: cut) {
+				if (model->getBV(node).isLeaf()) {
+					next.push_back(node);
+				} else {
+					next.push_back(model->getBV(node).leftChild());
+					next.push_back(model->getBV(node).rightChild());
+				}
+			}
+			if (next.size() == cut.size() || next.size() > MAX_OBSTACLE_BOUNDS) {
+				break;
+			}
+			std::swap(cut, next);
+		}
+
+		const fcl::Transform3d &tf = obstacle.getTransform();
+
+		bounds.clear();
+		for (int node: cut) {
+			const fcl::OBBd &obb = as_obb(model->getBV(node).bv);
+			const fcl::Vector3d center = tf * obb.To;
+			const fcl::Vector3d half_size = (tf.linear() * obb.axis).cwiseAbs() * obb.extent;
+			bounds.emplace_back(math::Vec3d(center.x() - half_size.x(), center.y() - half_size.y(), center.z() - half_size.z()),
+								math::Vec3d(center.x() + half_size.x(), center.y() + half_size.y(), center.z() + half_size.z()));
+		}
+
+		return true;
+	}
+
+	struct RobotCollisionModel::LinkShape {
+		/// The transform of the shape relative to the link's frame of reference.
+		math::Transformd local_tf;
+		/// The persistent collision object; only its transform changes between queries.
+		std::unique_ptr<fcl::CollisionObjectd> object;
+	};
+
+	RobotCollisionModel::RobotCollisionModel(const robot_model::RobotModel &robot)
+		: robot(&robot),
+		  base_link(robot.findLinkByName("flying_base")),
+		  kinematic_plan(robot_model::compileKinematicPlan(robot, base_link)),
+		  link_transforms(kinematic_plan.n_links),
+		  collision_result(std::make_unique<fcl::CollisionResultd>()) {
+		link_shape_offsets.reserve(robot.getLinks().size() + 1);
+
+		for (const auto &link: robot.getLinks()) {
+			link_shape_offsets.push_back(shapes.size());
+
+			for (const auto &collision_geometry: link.collision_geometry) {
+				if (const auto &box = std::get_if<Box>(&collision_geometry.shape)) {
+					shapes.push_back(LinkShape{
+							.local_tf = collision_geometry.transform,
+							.object = std::make_unique<fcl::CollisionObjectd>(
+									std::make_shared<fcl::Boxd>(box->size.x(), box->size.y(), box->size.z()))
+					});
+				} else {
+					throw std::runtime_error("Only boxes are implemented for collision geometry.");
+				}
+			}
+		}
+
+		link_shape_offsets.push_back(shapes.size());
+
+		// Bound the distance from any link origin to any point on the geometry: the distance between two link origins is
+		// at most the sum of the lengths of all joint attachments, plus the furthest extent of any single shape.
+		for (const auto &joint: robot.getJoints()) {
+			max_point_radius += joint.attachmentA.translation.norm() + joint.attachmentB.translation.norm();
+		}
+
+		double max_shape_extent = 0.0;
+		for (const auto &link: robot.getLinks()) {
+			for (const auto &collision_geometry: link.collision_geometry) {
+				const auto &box = std::get<Box>(collision_geometry.shape);
+				max_shape_extent = std::max(max_shape_extent,
+											collision_geometry.transform.translation.norm() + box.size.norm() / 2.0);
+			}
+		}
+		max_point_radius += max_shape_extent;
+	}
+
+	RobotCollisionModel::~RobotCollisionModel() = default;
+
+	RobotCollisionModel::RobotCollisionModel(RobotCollisionModel &&) noexcept = default;
+
+	RobotCollisionModel &RobotCollisionModel::operator=(RobotCollisionModel &&) noexcept = default;
+
+	bool RobotCollisionModel::check_link_collision(robot_model::RobotModel::LinkId link,
+												   const fcl::CollisionObjectd &tree_trunk_object,
+												   const math::Transformd &link_tf) {
+		for (size_t shape_i = link_shape_offsets[link]; shape_i < link_shape_offsets[link + 1]; ++shape_i) {
+			auto &shape = shapes[shape_i];
+
+			// Only the transform changes; the geometry itself is reused.
+			shape.object->setTransform(to_fcl_transform(link_tf.then(shape.local_tf)));
+			shape.object->computeAABB();
+
+			// The result is reused, so that its contact vector keeps its capacity between queries.
+			const fcl::CollisionRequestd request;
+			collision_result->clear();
+			fcl::collide(&tree_trunk_object, shape.object.get(), request, *collision_result);
+
+			if (collision_result->isCollision()) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool RobotCollisionModel::collides(const fcl::CollisionObjectd &tree_trunk_object, const RobotState &state) {
+		++state_queries;
+
+		assert(state.joint_values.size() >= kinematic_plan.n_variables);
+		robot_model::forwardKinematics(kinematic_plan, state.joint_values.data(), state.base_tf, link_transforms.data());
+
+		for (size_t i = 0; i < link_transforms.size(); ++i) {
+			if (check_link_collision(i, tree_trunk_object, link_transforms[i])) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void RobotCollisionModel::update_obstacle_bounds(const fcl::CollisionObjectd &obstacle) {
+		const math::AABBd obstacle_aabb = to_math_aabb(obstacle.getAABB());
+
+		if (bounded_obstacle == &obstacle &&
+			bounded_geometry == obstacle.collisionGeometry().get() &&
+			bounded_obstacle_aabb.min() == obstacle_aabb.min() &&
+			bounded_obstacle_aabb.max() == obstacle_aabb.max()) {
+			return;
+		}
+
+		bounded_obstacle = &obstacle;
+		bounded_geometry = obstacle.collisionGeometry().get();
+		bounded_obstacle_aabb = obstacle_aabb;
+
+		// Fall back to the overall bounding box for obstacles that aren't a (supported) BVH.
+		if (!collect_bvh_bounds<fcl::OBBd>(obstacle, obstacle_bounds) &&
+			!collect_bvh_bounds<fcl::OBBRSSd>(obstacle, obstacle_bounds)) {
+			obstacle_bounds = {obstacle_aabb};
+		}
+	}
+
+	double RobotCollisionModel::clearance(const fcl::CollisionObjectd &tree_trunk_object, const RobotState &state) {
+		++state_queries;
+
+		update_obstacle_bounds(tree_trunk_object);
+
+		assert(state.joint_values.size() >= kinematic_plan.n_variables);
+		robot_model::forwardKinematics(kinematic_plan, state.joint_values.data(), state.base_tf, link_transforms.data());
+
+		double min_clearance = std::numeric_limits<double>::infinity();
+
+		for (size_t link = 0; link < link_transforms.size(); ++link) {
+			for (size_t shape_i = link_shape_offsets[link]; shape_i < link_shape_offsets[link + 1]; ++shape_i) {
+				auto &shape = shapes[shape_i];
+
+				shape.object->setTransform(to_fcl_transform(link_transforms[link].then(shape.local_tf)));
+				shape.object->computeAABB();
+
+				// Broadphase: the distance from the shape's bounding box to the nearest box covering the obstacle is a
+				// lower bound on the true distance.
+				const math::AABBd shape_aabb = to_math_aabb(shape.object->getAABB());
+				double shape_clearance = std::numeric_limits<double>::infinity();
+				for (const auto &bounds: obstacle_bounds) {
+					shape_clearance = std::min(shape_clearance, aabb_distance(shape_aabb, bounds));
+				}
+
+				// Only if the shape's bounding box overlaps one of them, we need an exact narrowphase distance query.
+				if (shape_clearance <= 0.0) {
+					fcl::DistanceRequestd request;
+					fcl::DistanceResultd result;
+					shape_clearance = fcl::distance(&tree_trunk_object, shape.object.get(), request, result);
+				}
+
+				min_clearance = std::min(min_clearance, shape_clearance);
+
+				// Possible contact; no point in looking further.
+				if (min_clearance <= 0.0) {
+					return min_clearance;
+				}
+			}
+		}
+
+		return min_clearance;
+	}
+
+	double RobotCollisionModel::max_displacement(const RobotState &state1, const RobotState &state2) const {
+		// Translation of the base moves all points equally.
+		double displacement = (state2.base_tf.translation - state1.base_tf.translation).norm();
+
+		// Rotation of the base (slerp, so constant angular velocity) moves points by at most angle * radius.
+		displacement += angular_distance(state1.base_tf.orientation, state2.base_tf.orientation) * max_point_radius;
+
+		// A joint rotation moves points by at most angle * distance-to-joint, which is at most twice the radius.
+		for (size_t i = 0; i < state1.joint_values.size(); ++i) {
+			displacement += std::abs(state2.joint_values[i] - state1.joint_values[i]) * 2.0 * max_point_radius;
+		}
+
+		return displacement;
+	}
+}
+
 bool mgodpl::check_link_collision(const mgodpl::robot_model::RobotModel::Link &link,
 								  const fcl::CollisionObjectd &tree_trunk_object,
 								  const math::Transformd &link_tf) {
@@ -57,26 +323,14 @@ bool mgodpl::check_link_collision(const mgodpl::robot_model::RobotModel::Link &l
 bool mgodpl::check_robot_collision(const mgodpl::robot_model::RobotModel &robot,
 								   const fcl::CollisionObjectd &tree_trunk_object,
 								   const mgodpl::RobotState &state) {
-	bool collision = false;
-
-	const auto &fk = robot_model::forwardKinematics(
-			robot,
-			state.joint_values,
-			robot.findLinkByName("flying_base"),
-			state.base_tf
-	);
-
-	for (size_t i = 0; i < fk.link_transforms.size(); ++i) {
-		const auto &link_tf = fk.link_transforms[i];
-
-		collision |= check_link_collision(robot.getLinks()[i], tree_trunk_object, link_tf);
-
-		if (collision) {
-			break;
-		}
-	}
+	RobotCollisionModel collision_model(robot);
+	return check_robot_collision(collision_model, tree_trunk_object, state);
+}
 
-	return collision;
+bool mgodpl::check_robot_collision(mgodpl::RobotCollisionModel &robot,
+								   const fcl::CollisionObjectd &tree_trunk_object,
+								   const mgodpl::RobotState &state) {
+	return robot.collides(tree_trunk_object, state);
 }
 
 bool mgodpl::check_motion_collides(const mgodpl::robot_model::RobotModel &robot,
@@ -84,19 +338,74 @@ bool mgodpl::check_motion_collides(const mgodpl::robot_model::RobotModel &robot,
 								   const mgodpl::RobotState &state1,
 								   const mgodpl::RobotState &state2,
 								   double &toi) {
+	RobotCollisionModel collision_model(robot);
+	return check_motion_collides(collision_model, tree_trunk_object, state1, state2, toi);
+}
+
+bool mgodpl::check_motion_collides(mgodpl::RobotCollisionModel &robot,
+								   const fcl::CollisionObjectd &tree_trunk_object,
+								   const mgodpl::RobotState &state1,
+								   const mgodpl::RobotState &state2,
+								   double &toi) {
+
+	// The step size used near contact; this matches the resolution of check_motion_collides_sampled.
+	const double MAX_STEP = 0.1;
+
+	// Compute the distance between the two, and how far any point on the robot moves during the motion.
+	double distance = equal_weights_distance(state1, state2);
+	double displacement = robot.max_displacement(state1, state2);
+
+	// If nothing moves, the motion collides if and only if the start state does.
+	if (distance <= 0.0 || displacement <= 0.0) {
+		toi = 0.0;
+		return robot.collides(tree_trunk_object, state1);
+	}
+
+	// Never take steps smaller than the fixed-resolution sampler would.
+	const double min_step = MAX_STEP / distance;
+
+	double t = 0.0;
+
+	while (true) {
+		auto interpolated_state = interpolate(state1, state2, t);
+
+		double clearance = robot.clearance(tree_trunk_object, interpolated_state);
+
+		// A non-positive clearance means possible contact; confirm with an actual collision check.
+		if (clearance <= 0.0 && robot.collides(tree_trunk_object, interpolated_state)) {
+			toi = t;
+			return true;
+		}
+
+		if (t >= 1.0) {
+			return false;
+		}
+
+		// No point on the robot can move further than the clearance within this step, so the motion in between is
+		// collision-free; the step is only limited by the fixed resolution near contact.
+		t = std::min(1.0, t + std::max(clearance / displacement, min_step));
+	}
+}
+
+bool mgodpl::check_motion_collides_sampled(mgodpl::RobotCollisionModel &robot,
+										   const fcl::CollisionObjectd &tree_trunk_object,
+										   const mgodpl::RobotState &state1,
+										   const mgodpl::RobotState &state2,
+										   double &toi) {
 
 	// Compute the distance between the two.
 	double distance = equal_weights_distance(state1, state2);
 	const double MAX_STEP = 0.1;
 
-	size_t n_steps = std::ceil(distance / MAX_STEP);
+	// At least one step, so that identical states don't produce a 0/0 interpolation parameter.
+	size_t n_steps = std::max((size_t) 1, (size_t) std::ceil(distance / MAX_STEP));
 
 	for (size_t step_i = 0; step_i <= n_steps; ++step_i) {
 		double t = (double) step_i / (double) n_steps;
 		auto interpolated_state = interpolate(state1, state2, t);
 
 		// Check if the robot is in collision at the interpolated state.
-		if (check_robot_collision(robot, tree_trunk_object, interpolated_state)) {
+		if (robot.collides(tree_trunk_object, interpolated_state)) {
 			toi = t;
 			return true;
 		}
@@ -104,10 +413,43 @@ bool mgodpl::check_motion_collides(const mgodpl::robot_model::RobotModel &robot,
 	return false;
 }
 
+bool mgodpl::check_motion_collides_bisection(mgodpl::RobotCollisionModel &robot,
+											 const fcl::CollisionObjectd &tree_trunk_object,
+											 const mgodpl::RobotState &state1,
+											 const mgodpl::RobotState &state2,
+											 double &toi) {
+	return check_motion_collides_bisection(state1,
+										   state2,
+										   [&](const RobotState &state) {
+											   return robot.collides(tree_trunk_object, state);
+										   },
+										   toi);
+}
+
+bool mgodpl::check_motion_collides_bisection(mgodpl::RobotCollisionModel &robot,
+											 const fcl::CollisionObjectd &tree_trunk_object,
+											 const mgodpl::RobotState &state1,
+											 const mgodpl::RobotState &state2) {
+	return check_motion_collides_bisection(state1,
+										   state2,
+										   [&](const RobotState &state) {
+											   return robot.collides(tree_trunk_object, state);
+										   },
+										   nullptr);
+}
+
 bool mgodpl::check_path_collides(const mgodpl::robot_model::RobotModel &robot,
 								 const fcl::CollisionObjectd &tree_trunk_object,
 								 const mgodpl::RobotPath &path,
 								 mgodpl::PathPoint &collision_point) {
+	RobotCollisionModel collision_model(robot);
+	return check_path_collides(collision_model, tree_trunk_object, path, collision_point);
+}
+
+bool mgodpl::check_path_collides(mgodpl::RobotCollisionModel &robot,
+								 const fcl::CollisionObjectd &tree_trunk_object,
+								 const mgodpl::RobotPath &path,
+								 mgodpl::PathPoint &collision_point) {
 	for (size_t segment_i = 0; segment_i + 1 < path.states.size(); ++segment_i) {
 		const auto &state1 = path.states[segment_i];
 		const auto &state2 = path.states[segment_i + 1];
@@ -1,6 +1,7 @@
 module;
 
 #include <functional>
+#include <memory>
 #include "collision_detection.h"
 
 // Copyright (c) 2024 University College Roosevelt
@@ -27,40 +28,57 @@ export namespace mgodpl {
 	/**
 	 * @brief Creates a collision checking function for a given robot state.
 	 *
+	 * The function owns a precompiled RobotCollisionModel, shared between its copies; it must therefore
+	 * not be invoked from multiple threads concurrently.
+	 *
 	 * @param env The collision environment, which includes the robot model and the collision object.
 	 * @return A function that takes a RobotState and checks for collisions in the given environment.
 	 */
 	CollisionDetectionFn collision_check_fn_in_environment(const CollisionEnvironment &env) {
-		return [&](const RobotState &from) {
-			return check_robot_collision(env.robot, env.tree_collision, from);
+		auto collision_model = std::make_shared<RobotCollisionModel>(env.robot);
+		return [env, collision_model](const RobotState &from) {
+			return check_robot_collision(*collision_model, env.tree_collision, from);
 		};
 	}
 
 	/**
 	 * @brief Creates a motion collision checking function for a given robot state.
 	 *
+	 * The function owns a precompiled RobotCollisionModel, shared between its copies; it must therefore
+	 * not be invoked from multiple threads concurrently.
+	 *
 	 * @param env The collision environment, which includes the robot model and the collision object.
+	 * @param order The order in which to validate the states along the motion.
 	 * @return A function that takes two RobotState objects and checks for collisions during the motion in the given environment.
 	 */
-	MotionCollisionDetectionFn motion_collision_check_fn_in_environment(const CollisionEnvironment &env) {
-		return [&](const RobotState &from, const RobotState &to) {
-			return check_motion_collides(env.robot, env.tree_collision, from, to);
+	MotionCollisionDetectionFn motion_collision_check_fn_in_environment(const CollisionEnvironment &env,
+																		MotionValidationOrder order = MotionValidationOrder::LINEAR) {
+		auto collision_model = std::make_shared<RobotCollisionModel>(env.robot);
+		return [env, collision_model, order](const RobotState &from, const RobotState &to) {
+			return check_motion_collides_in_order(*collision_model, env.tree_collision, from, to, order);
 		};
 	}
 
 	/**
 	 * @brief Creates a motion collision function from a state collision function.
 	 *
-	 * This works by simply sampling at regular intervals along the path between the two states.
+	 * This works by simply sampling at regular intervals along the path between the two states,
+	 * visiting the samples either linearly or in bisection order (see `check_motion_collides_bisection`).
+	 * (LINEAR and LINEAR_FIXED_RESOLUTION are the same here, since there is no clearance to advance by.)
 	 */
 	template <typename StateCollisionFn>
-	MotionCollisionDetectionFn motion_collision_check_fn_from_state_collision(StateCollisionFn state_collision_fn) {
-		return [state_collision_fn](const RobotState &from, const RobotState &to) {
+	MotionCollisionDetectionFn motion_collision_check_fn_from_state_collision(StateCollisionFn state_collision_fn,
+																			  MotionValidationOrder order = MotionValidationOrder::LINEAR) {
+		return [state_collision_fn, order](const RobotState &from, const RobotState &to) {
+			if (order == MotionValidationOrder::BISECTION) {
+				return check_motion_collides_bisection(from, to, state_collision_fn, nullptr);
+			}
+
 			// Compute the distance between the two.
 			double distance = equal_weights_distance(from, to);
 			const double MAX_STEP = 0.1;
 
-			size_t n_steps = std::ceil(distance / MAX_STEP);
+			size_t n_steps = std::max((size_t) 1, (size_t) std::ceil(distance / MAX_STEP));
 
 			for (size_t step_i = 0; step_i <= n_steps; ++step_i) {
 				double t = (double) step_i / (double) n_steps;
@@ -91,12 +109,14 @@ export namespace mgodpl {
 	 * Note: these keep a reference to the environment, so the environment must outlive the returned functions.
 	 *
 	 * @param env The collision environment, which includes the robot model and the collision object.
+	 * @param order The order in which the motion collision checking function validates the states along a motion.
 	 * @return A CollisionFunctions object that contains both the collision checking function and the motion collision checking function.
 	 */
-	CollisionFunctions collision_functions_in_environment(const CollisionEnvironment &env) {
+	CollisionFunctions collision_functions_in_environment(const CollisionEnvironment &env,
+														  MotionValidationOrder order = MotionValidationOrder::LINEAR) {
 		return CollisionFunctions{
 			collision_check_fn_in_environment(env),
-			motion_collision_check_fn_in_environment(env)
+			motion_collision_check_fn_in_environment(env, order)
 		};
 	}
 
@@ -9,8 +9,12 @@
 #ifndef MGODPL_COLLISION_DETECTION_H
 #define MGODPL_COLLISION_DETECTION_H
 
+#include <algorithm>
+#include <cmath>
+#include <memory>
 #include <vector>
 #include "fcl_forward_declarations.h"
+#include "../math/AABB.h"
 #include "../math/Transform.h"
 #include "RobotModel.h"
 #include "RobotState.h"
@@ -18,9 +22,144 @@
 
 namespace mgodpl {
 
+	/**
+	 * @brief A precompiled collision model of a robot, built once from a RobotModel.
+	 *
+	 * The FCL shapes and collision objects for every collision box of every link are created up-front, so that a
+	 * collision check only needs to update their transforms rather than allocating fresh geometry on every query.
+	 *
+	 * Forward kinematics run from a precompiled KinematicPlan into an internal buffer, so that a collision check does
+	 * not allocate at all.
+	 *
+	 * Note: a collision check mutates the transforms of the internal collision objects; an instance must therefore
+	 * not be shared between threads. Create one per thread instead (construction is cheap).
+	 */
+	class RobotCollisionModel {
+	public:
+		/**
+		 * @brief Build the collision model for the given robot.
+		 *
+		 * @param robot 	The robot model; must outlive this object.
+		 *
+		 * @throws std::runtime_error if the robot has collision geometry other than boxes.
+		 */
+		explicit RobotCollisionModel(const robot_model::RobotModel &robot);
+
+		~RobotCollisionModel();
+
+		RobotCollisionModel(RobotCollisionModel &&) noexcept;
+
+		RobotCollisionModel &operator=(RobotCollisionModel &&) noexcept;
+
+		/// The robot model that this collision model was built from.
+		[[nodiscard]] const robot_model::RobotModel &getRobot() const {
+			return *robot;
+		}
+
+		/// The ID of the "flying_base" link, looked up once at construction.
+		[[nodiscard]] robot_model::RobotModel::LinkId getBaseLink() const {
+			return base_link;
+		}
+
+		/**
+		 * @brief Check for collisions of a single robot link with a given fcl collision object.
+		 *
+		 * @param link 					The ID of the link to check.
+		 * @param tree_trunk_object 	The collision object to check against.
+		 * @param link_tf 				The transform of the link.
+		 * @return 						True if there is a collision, false otherwise.
+		 */
+		bool check_link_collision(robot_model::RobotModel::LinkId link,
+								  const fcl::CollisionObjectd &tree_trunk_object,
+								  const math::Transformd &link_tf);
+
+		/**
+		 * @brief Check for collisions between the whole robot in the given state and the obstacle.
+		 *
+		 * @param tree_trunk_object 	The collision object to check against.
+		 * @param state 				The state of the robot.
+		 * @return 						True if there is a collision, false otherwise.
+		 */
+		bool collides(const fcl::CollisionObjectd &tree_trunk_object, const RobotState &state);
+
+		/**
+		 * @brief Compute a conservative lower bound on the distance between the robot and the obstacle.
+		 *
+		 * Shapes are culled with the (cheap) distance from their bounding box to the nearest of a few boxes that cover
+		 * the obstacle, taken from a cut through its bounding volume hierarchy; only shapes that overlap one of those
+		 * boxes are queried with an exact FCL distance query. Inside the canopy, where every shape overlaps the
+		 * obstacle's overall bounding box, most shapes are thereby still culled.
+		 *
+		 * @param tree_trunk_object 	The collision object to measure the distance to.
+		 * @param state 				The state of the robot.
+		 * @return 						The lower bound; zero or negative if the robot may be in contact with the obstacle.
+		 */
+		double clearance(const fcl::CollisionObjectd &tree_trunk_object, const RobotState &state);
+
+		/**
+		 * @brief Compute an upper bound on the distance that any point on the robot's collision geometry travels
+		 * during the linearly-interpolated motion between two states.
+		 *
+		 * @param state1 	The state to start from.
+		 * @param state2 	The state to end at.
+		 * @return 			The upper bound on the displacement.
+		 */
+		[[nodiscard]] double max_displacement(const RobotState &state1, const RobotState &state2) const;
+
+		/// The number of states evaluated with `collides` or `clearance` so far; used to compare motion checkers.
+		[[nodiscard]] size_t getStateQueries() const {
+			return state_queries;
+		}
+
+	private:
+		/// A single collision shape of a link, with its persistent FCL object; defined in the source file.
+		struct LinkShape;
+
+		/// The robot model that this collision model was built from.
+		const robot_model::RobotModel *robot;
+
+		/// The ID of the "flying_base" link.
+		robot_model::RobotModel::LinkId base_link;
+
+		/// The kinematic traversal from the base link, compiled once.
+		robot_model::KinematicPlan kinematic_plan;
+
+		/// Scratch buffer for the link transforms, reused by every query.
+		std::vector<math::Transformd> link_transforms;
+
+		/// Scratch collision result, cleared and reused by every narrowphase query.
+		std::unique_ptr<fcl::CollisionResultd> collision_result;
+
+		/// The shapes of all links, grouped by link.
+		std::vector<LinkShape> shapes;
+
+		/// For every link, the index of its first shape in `shapes`; the last entry is `shapes.size()`.
+		std::vector<size_t> link_shape_offsets;
+
+		/// An upper bound on the distance from the origin of any link to any point on the collision geometry.
+		double max_point_radius = 0.0;
+
+		/// The obstacle and geometry that `obstacle_bounds` were computed for, and its bounding box at the time.
+		const fcl::CollisionObjectd *bounded_obstacle = nullptr;
+		const void *bounded_geometry = nullptr;
+		math::AABBd bounded_obstacle_aabb = math::AABBd::inverted_infinity();
+
+		/// World-space boxes that together cover the obstacle, used by `clearance` to cull shapes.
+		std::vector<math::AABBd> obstacle_bounds;
+
+		/// Recompute `obstacle_bounds` if the obstacle differs from the last one, or has moved.
+		void update_obstacle_bounds(const fcl::CollisionObjectd &obstacle);
+
+		/// The number of states evaluated so far.
+		size_t state_queries = 0;
+	};
+
 	/**
 	 * Check for collisions of a single robot link with a given fcl collision object.
 	 *
+	 * Note: this allocates fresh FCL geometry on every call; prefer `RobotCollisionModel::check_link_collision`
+	 * in any loop.
+	 *
 	 * @param link 					The link to check.
 	 * @param tree_trunk_object 	The collision object to check against.
 	 * @param link_tf 				The transform of the link.
@@ -42,6 +181,18 @@ namespace mgodpl {
 							   const fcl::CollisionObjectd &tree_trunk_object,
 							   const RobotState &state);
 
+	/**
+	 * Check for collisions between a whole robot and a single FCL collision object, using a precompiled collision model.
+	 *
+	 * @param robot 					The collision model of the robot to check.
+	 * @param tree_trunk_object 		The collision object to check against.
+	 * @param state 					The state of the robot.
+	 * @return 							True if there is a collision, false otherwise.
+	 */
+	bool check_robot_collision(RobotCollisionModel &robot,
+							   const fcl::CollisionObjectd &tree_trunk_object,
+							   const RobotState &state);
+
 	/**
 	 * Check whether a motion from one state to another (assuming linear interpolation in the configuration space)
 	 * collides with the given CollisionObjectd.
@@ -61,6 +212,207 @@ namespace mgodpl {
 							   const RobotState &state2,
 							   double &toi);
 
+	/**
+	 * Variant of `check_motion_collides` that uses a precompiled collision model.
+	 *
+	 * Rather than sampling at a fixed resolution, this uses conservative advancement: at every sampled state, the
+	 * clearance between the robot and the obstacle bounds how far the robot may move before it could possibly touch
+	 * the obstacle, allowing large steps far from the tree. Near contact, the step size falls back to the fixed
+	 * resolution of `check_motion_collides_sampled`; steps are never finer than that.
+	 *
+	 * @param robot 				The collision model of the robot.
+	 * @param tree_trunk_object 	The tree trunk that the robot must not collide with.
+	 * @param state1 				The state to start from.
+	 * @param state2 				The state to end at.
+	 * @param toi 					The linear interpolation parameter of the last known state to not collide. (Undefined if the function returns false.)
+	 * @return 						True if the motion collides, false otherwise.
+	 */
+	bool check_motion_collides(RobotCollisionModel &robot,
+							   const fcl::CollisionObjectd &tree_trunk_object,
+							   const RobotState &state1,
+							   const RobotState &state2,
+							   double &toi);
+
+	/**
+	 * Check whether a motion collides by sampling states at a fixed resolution of 0.1 units of `equal_weights_distance`.
+	 *
+	 * @param robot 				The collision model of the robot.
+	 * @param tree_trunk_object 	The tree trunk that the robot must not collide with.
+	 * @param state1 				The state to start from.
+	 * @param state2 				The state to end at.
+	 * @param toi 					The linear interpolation parameter of the first sample found to collide. (Undefined if the function returns false.)
+	 * @return 						True if the motion collides, false otherwise.
+	 */
+	bool check_motion_collides_sampled(RobotCollisionModel &robot,
+									   const fcl::CollisionObjectd &tree_trunk_object,
+									   const RobotState &state1,
+									   const RobotState &state2,
+									   double &toi);
+
+	/**
+	 * @brief The order in which the states along a motion are validated.
+	 */
+	enum class MotionValidationOrder {
+		/// Walk from the start state to the end state (by conservative advancement, where clearance is available).
+		LINEAR,
+		/// Walk from the start state to the end state at the fixed resolution of `check_motion_collides_sampled`;
+		/// this differs from BISECTION only in the order of the samples.
+		LINEAR_FIXED_RESOLUTION,
+		/// Check both end states first, then recursively bisect the motion (van der Corput order).
+		BISECTION
+	};
+
+	/**
+	 * @brief Check whether a motion collides, sampling at the same fixed resolution as `check_motion_collides_sampled`,
+	 * but visiting the samples in bisection order.
+	 *
+	 * Both end states are checked first; after that, the midpoint, then the quarter points, and so on. On motions
+	 * that collide somewhere in the middle, the collision is thereby found after a logarithmic rather than a linear
+	 * number of checks.
+	 *
+	 * @param state1 				The state to start from.
+	 * @param state2 				The state to end at.
+	 * @param state_collides 		A function that checks whether a single state collides.
+	 * @param toi 					If not null: once a collision is found, the unchecked samples before it are refined
+	 * 								linearly, and this is set to the first colliding sample in linear order, as with
+	 * 								the linear sampler. (Undefined if the function returns false.) If null, the
+	 * 								function returns as soon as any collision is found.
+	 * @return 						True if the motion collides, false otherwise.
+	 */
+	template<typename StateCollidesFn>
+	bool check_motion_collides_bisection(const RobotState &state1,
+										 const RobotState &state2,
+										 const StateCollidesFn &state_collides,
+										 double *toi) {
+		const double MAX_STEP = 0.1;
+
+		// The motion is split into n_steps segments; the samples are the indices [0, n_steps].
+		size_t n_steps = std::max((size_t) 1, (size_t) std::ceil(equal_weights_distance(state1, state2) / MAX_STEP));
+
+		auto collides_at = [&](size_t step_i) {
+			return state_collides(interpolate(state1, state2, (double) step_i / (double) n_steps));
+		};
+
+		// Given a collision at sample `hit`, where every multiple of `stride` below it is known to be collision-free,
+		// find the first colliding sample in linear order.
+		auto refine = [&](size_t hit, size_t stride) {
+			if (toi == nullptr) {
+				return;
+			}
+			for (size_t step_i = 1; step_i < hit; ++step_i) {
+				if (step_i % stride != 0 && collides_at(step_i)) {
+					*toi = (double) step_i / (double) n_steps;
+					return;
+				}
+			}
+			*toi = (double) hit / (double) n_steps;
+		};
+
+		// End states first.
+		if (collides_at(0)) {
+			refine(0, 1);
+			return true;
+		}
+
+		if (collides_at(n_steps)) {
+			refine(n_steps, n_steps);
+			return true;
+		}
+
+		// The largest power of two below n_steps: the stride of the first bisection level.
+		size_t stride = 1;
+		while (stride * 2 < n_steps) {
+			stride *= 2;
+		}
+
+		// Every level visits the odd multiples of its stride; all even multiples were visited by the levels before.
+		for (; stride >= 1; stride /= 2) {
+			for (size_t step_i = stride; step_i < n_steps; step_i += 2 * stride) {
+				if (collides_at(step_i)) {
+					refine(step_i, stride);
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+	/**
+	 * Variant of `check_motion_collides_bisection` that refines the first colliding sample into `toi`.
+	 */
+	template<typename StateCollidesFn>
+	bool check_motion_collides_bisection(const RobotState &state1,
+										 const RobotState &state2,
+										 const StateCollidesFn &state_collides,
+										 double &toi) {
+		return check_motion_collides_bisection(state1, state2, state_collides, &toi);
+	}
+
+	/**
+	 * Variant of `check_motion_collides_bisection` that uses a precompiled collision model.
+	 *
+	 * @param robot 				The collision model of the robot.
+	 * @param tree_trunk_object 	The tree trunk that the robot must not collide with.
+	 * @param state1 				The state to start from.
+	 * @param state2 				The state to end at.
+	 * @param toi 					The linear interpolation parameter of the first sample found to collide. (Undefined if the function returns false.)
+	 * @return 						True if the motion collides, false otherwise.
+	 */
+	bool check_motion_collides_bisection(RobotCollisionModel &robot,
+										 const fcl::CollisionObjectd &tree_trunk_object,
+										 const RobotState &state1,
+										 const RobotState &state2,
+										 double &toi);
+
+	/**
+	 * Variant of `check_motion_collides_bisection` that uses a precompiled collision model, without the time of impact;
+	 * it returns as soon as any collision is found, rather than searching for the first one.
+	 */
+	bool check_motion_collides_bisection(RobotCollisionModel &robot,
+										 const fcl::CollisionObjectd &tree_trunk_object,
+										 const RobotState &state1,
+										 const RobotState &state2);
+
+	/**
+	 * Check whether a motion collides using a precompiled collision model, validating states in the given order.
+	 *
+	 * @param robot 				The collision model of the robot.
+	 * @param tree_trunk_object 	The tree trunk that the robot must not collide with.
+	 * @param state1 				The state to start from.
+	 * @param state2 				The state to end at.
+	 * @param order 				The order in which to validate the states along the motion.
+	 * @return 						True if the motion collides, false otherwise.
+	 */
+	inline bool check_motion_collides_in_order(RobotCollisionModel &robot,
+											   const fcl::CollisionObjectd &tree_trunk_object,
+											   const RobotState &state1,
+											   const RobotState &state2,
+											   MotionValidationOrder order) {
+		double dummy_toi;
+		switch (order) {
+			case MotionValidationOrder::LINEAR:
+				return check_motion_collides(robot, tree_trunk_object, state1, state2, dummy_toi);
+			case MotionValidationOrder::LINEAR_FIXED_RESOLUTION:
+				return check_motion_collides_sampled(robot, tree_trunk_object, state1, state2, dummy_toi);
+			case MotionValidationOrder::BISECTION:
+				return check_motion_collides_bisection(robot, tree_trunk_object, state1, state2);
+			default:
+				throw std::runtime_error("Unknown motion validation order");
+		}
+	}
+
+	/**
+	 * Variant of `check_motion_collides` that uses a precompiled collision model, without the time of impact.
+	 */
+	inline bool check_motion_collides(RobotCollisionModel &robot,
+									  const fcl::CollisionObjectd &tree_trunk_object,
+									  const RobotState &state1,
+									  const RobotState &state2) {
+		double dummy_toi;
+		return check_motion_collides(robot, tree_trunk_object, state1, state2, dummy_toi);
+	}
+
 	/**
 	 * Check whether a motion from one state to another (assuming linear interpolation in the configuration space)
 	 * collides with the given CollisionObjectd.
@@ -95,6 +447,20 @@ namespace mgodpl {
 							 const RobotPath &path,
 							 PathPoint &collision_point);
 
+	/**
+	 * Variant of `check_path_collides` that uses a precompiled collision model.
+	 *
+	 * @param robot 				The collision model of the robot.
+	 * @param tree_trunk_object		The tree trunk that the robot must not collide with.
+	 * @param path					The path to check for collisions.
+	 * @param collision_point		Return param for the point along the path that was last-known to be valid.
+	 * @return						True if the path collides, false otherwise.
+	 */
+	bool check_path_collides(RobotCollisionModel &robot,
+							 const fcl::CollisionObjectd &tree_trunk_object,
+							 const RobotPath &path,
+							 PathPoint &collision_point);
+
 	/**
 	 * Check whether the given path collides. (Version without the collision point.)
 	 *
@@ -109,6 +475,16 @@ namespace mgodpl {
 		PathPoint dummy_collision_point{};
 		return check_path_collides(robot, tree_trunk_object, path, dummy_collision_point);
 	}
+
+	/**
+	 * Variant of `check_path_collides` that uses a precompiled collision model, without the collision point.
+	 */
+	inline bool check_path_collides(RobotCollisionModel &robot,
+									const fcl::CollisionObjectd &tree_trunk_object,
+									const RobotPath &path) {
+		PathPoint dummy_collision_point{};
+		return check_path_collides(robot, tree_trunk_object, path, dummy_collision_point);
+	}
 }
 
 #endif //MGODPL_COLLISION_DETECTION_H
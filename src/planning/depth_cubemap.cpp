@@ -0,0 +1,249 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include "depth_cubemap.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <tbb/task_arena.h>
+
+namespace mgodpl {
+
+	namespace {
+		/// Geometry closer to the eye than this (along a face axis) is clipped away.
+		constexpr double NEAR_PLANE = 1.0e-4;
+
+		/// The cube faces: the major axis, and whether they look along its positive or negative direction.
+		struct Face {
+			size_t axis;
+			double sign;
+		};
+
+		constexpr std::array<Face, 6> FACES = {{
+				{0, 1.0}, {0, -1.0},
+				{1, 1.0}, {1, -1.0},
+				{2, 1.0}, {2, -1.0}
+		}};
+
+		/// Transform a vector relative to the eye into the view space of a face: (u, v, depth).
+		math::Vec3d to_face_view(const Face &face, const math::Vec3d &d) {
+			return {d[(face.axis + 1) % 3], d[(face.axis + 2) % 3], face.sign * d[face.axis]};
+		}
+
+		/// The face that a direction falls into.
+		size_t face_of(const math::Vec3d &d) {
+			const double ax = std::abs(d.x()), ay = std::abs(d.y()), az = std::abs(d.z());
+			if (ax >= ay && ax >= az) {
+				return d.x() >= 0.0 ? 0 : 1;
+			} else if (ay >= az) {
+				return d.y() >= 0.0 ? 2 : 3;
+			} else {
+				return d.z() >= 0.0 ? 4 : 5;
+			}
+		}
+	}
+
+	DepthCubemap::DepthCubemap(size_t resolution, double margin)
+		: resolution(resolution),
+		  tiles_per_side((resolution + TILE_SIZE - 1) / TILE_SIZE),
+		  margin(margin),
+		  depth(6 * resolution * resolution, std::numeric_limits<float>::infinity()) {
+		for (auto &face_bins: bins) {
+			face_bins.resize(tiles_per_side * tiles_per_side);
+		}
+	}
+
+	void DepthCubemap::render(const Mesh &mesh, const math::Vec3d &eye_position) {
+		eye = eye_position;
+
+		// Isolated, so that a thread waiting on these loops does not pick up unrelated outer tasks; callers may be
+		// inside a parallel loop of their own, with thread-local state that must not be re-entered.
+		tbb::this_task_arena::isolate([&]() {
+			std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::infinity());
+
+			// Bin the triangles into tiles; each face is independent.
+			tbb::parallel_for(size_t(0), size_t(6), [&](size_t face_i) {
+				projected[face_i].clear();
+				for (auto &bin: bins[face_i]) {
+					bin.clear();
+				}
+
+				for (const auto &triangle: mesh.triangles) {
+					bin_triangle(face_i, {
+							to_face_view(FACES[face_i], mesh.vertices[triangle[0]] - eye),
+							to_face_view(FACES[face_i], mesh.vertices[triangle[1]] - eye),
+							to_face_view(FACES[face_i], mesh.vertices[triangle[2]] - eye)
+					});
+				}
+			});
+
+			// Rasterize the tiles; each tile writes only to its own texels, so this is race-free and deterministic.
+			const size_t tiles_per_face = tiles_per_side * tiles_per_side;
+			tbb::parallel_for(tbb::blocked_range<size_t>(0, 6 * tiles_per_face), [&](const auto &range) {
+				for (size_t i = range.begin(); i < range.end(); ++i) {
+					const size_t face_i = i / tiles_per_face;
+					const size_t tile_i = i % tiles_per_face;
+					rasterize_tile(face_i, tile_i % tiles_per_side, tile_i / tiles_per_side);
+				}
+			});
+		});
+	}
+
+	void DepthCubemap::bin_triangle(size_t face, const std::array<math::Vec3d, 3> &view_triangle) {
+
+		// Quick reject: entirely behind the near plane.
+		if (view_triangle[0].z() < NEAR_PLANE && view_triangle[1].z() < NEAR_PLANE &&
+		    view_triangle[2].z() < NEAR_PLANE) {
+			return;
+		}
+
+		// Clip against the near plane (Sutherland-Hodgman); the result has at most four vertices.
+		std::array<math::Vec3d, 4> polygon;
+		size_t n_vertices = 0;
+		for (size_t i = 0; i < 3; ++i) {
+			const math::Vec3d &a = view_triangle[i];
+			const math::Vec3d &b = view_triangle[(i + 1) % 3];
+			const bool a_in = a.z() >= NEAR_PLANE;
+			const bool b_in = b.z() >= NEAR_PLANE;
+			if (a_in) {
+				polygon[n_vertices++] = a;
+			}
+			if (a_in != b_in) {
+				const double t = (NEAR_PLANE - a.z()) / (b.z() - a.z());
+				polygon[n_vertices++] = a + (b - a) * t;
+			}
+		}
+
+		// Project onto the face, in texel coordinates.
+		const double half_resolution = (double) resolution / 2.0;
+		std::array<double, 4> xs{}, ys{}, inv_zs{};
+		for (size_t i = 0; i < n_vertices; ++i) {
+			inv_zs[i] = 1.0 / polygon[i].z();
+			xs[i] = (polygon[i].x() * inv_zs[i] + 1.0) * half_resolution;
+			ys[i] = (polygon[i].y() * inv_zs[i] + 1.0) * half_resolution;
+		}
+
+		// Fan-triangulate, and bin each triangle into the tiles its bounding box overlaps.
+		for (size_t i = 1; i + 1 < n_vertices; ++i) {
+			ProjectedTriangle triangle{
+					{xs[0], xs[i], xs[i + 1]},
+					{ys[0], ys[i], ys[i + 1]},
+					{inv_zs[0], inv_zs[i], inv_zs[i + 1]}
+			};
+
+			const double min_x = std::min({triangle.x[0], triangle.x[1], triangle.x[2]});
+			const double max_x = std::max({triangle.x[0], triangle.x[1], triangle.x[2]});
+			const double min_y = std::min({triangle.y[0], triangle.y[1], triangle.y[2]});
+			const double max_y = std::max({triangle.y[0], triangle.y[1], triangle.y[2]});
+
+			if (max_x < 0.0 || max_y < 0.0 || min_x >= (double) resolution || min_y >= (double) resolution) {
+				continue;
+			}
+
+			const double max_tile = (double) (tiles_per_side - 1);
+			const auto tile_x0 = (size_t) std::clamp(std::floor(min_x / TILE_SIZE), 0.0, max_tile);
+			const auto tile_x1 = (size_t) std::clamp(std::floor(max_x / TILE_SIZE), 0.0, max_tile);
+			const auto tile_y0 = (size_t) std::clamp(std::floor(min_y / TILE_SIZE), 0.0, max_tile);
+			const auto tile_y1 = (size_t) std::clamp(std::floor(max_y / TILE_SIZE), 0.0, max_tile);
+
+			const auto triangle_index = (uint32_t) projected[face].size();
+			projected[face].push_back(triangle);
+
+			for (size_t ty = tile_y0; ty <= tile_y1; ++ty) {
+				for (size_t tx = tile_x0; tx <= tile_x1; ++tx) {
+					bins[face][ty * tiles_per_side + tx].push_back(triangle_index);
+				}
+			}
+		}
+	}
+
+	void DepthCubemap::rasterize_tile(size_t face, size_t tile_x, size_t tile_y) {
+		float *face_depth = depth.data() + face * resolution * resolution;
+
+		const size_t tile_x0 = tile_x * TILE_SIZE;
+		const size_t tile_y0 = tile_y * TILE_SIZE;
+		const size_t tile_x1 = std::min(tile_x0 + TILE_SIZE, resolution);
+		const size_t tile_y1 = std::min(tile_y0 + TILE_SIZE, resolution);
+
+		for (uint32_t triangle_index: bins[face][tile_y * tiles_per_side + tile_x]) {
+			const ProjectedTriangle &tri = projected[face][triangle_index];
+
+			const double area = (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) -
+			                    (tri.x[2] - tri.x[0]) * (tri.y[1] - tri.y[0]);
+			if (area == 0.0) {
+				continue;
+			}
+
+			// Only visit the texels within both the tile and the triangle's bounding box.
+			const double min_x = std::min({tri.x[0], tri.x[1], tri.x[2]});
+			const double max_x = std::max({tri.x[0], tri.x[1], tri.x[2]});
+			const double min_y = std::min({tri.y[0], tri.y[1], tri.y[2]});
+			const double max_y = std::max({tri.y[0], tri.y[1], tri.y[2]});
+
+			const auto x0 = (size_t) std::max((double) tile_x0, std::ceil(min_x - 0.5));
+			const auto x1 = (size_t) std::min((double) tile_x1, std::floor(max_x - 0.5) + 1.0);
+			const auto y0 = (size_t) std::max((double) tile_y0, std::ceil(min_y - 0.5));
+			const auto y1 = (size_t) std::min((double) tile_y1, std::floor(max_y - 0.5) + 1.0);
+
+			const double inv_area = 1.0 / area;
+
+			for (size_t y = y0; y < y1; ++y) {
+				const double py = (double) y + 0.5;
+				for (size_t x = x0; x < x1; ++x) {
+					const double px = (double) x + 0.5;
+
+					// Barycentric coordinates of the texel center, through the edge functions.
+					const double w0 = ((tri.x[1] - px) * (tri.y[2] - py) - (tri.x[2] - px) * (tri.y[1] - py)) * inv_area;
+					const double w1 = ((tri.x[2] - px) * (tri.y[0] - py) - (tri.x[0] - px) * (tri.y[2] - py)) * inv_area;
+					const double w2 = 1.0 - w0 - w1;
+
+					if (w0 < 0.0 || w1 < 0.0 || w2 < 0.0) {
+						continue;
+					}
+
+					// The reciprocal depth is linear in screen space.
+					const double z = 1.0 / (w0 * tri.inv_z[0] + w1 * tri.inv_z[1] + w2 * tri.inv_z[2]);
+
+					float &texel = face_depth[y * resolution + x];
+					texel = std::min(texel, (float) z);
+				}
+			}
+		}
+	}
+
+	bool DepthCubemap::checkOcclusion(const math::Vec3d &point) const {
+		const math::Vec3d d = point - eye;
+		const double distance = d.norm();
+		if (distance <= margin) {
+			return false;
+		}
+
+		const size_t face = face_of(d);
+		const math::Vec3d view = to_face_view(FACES[face], d);
+
+		const double half_resolution = (double) resolution / 2.0;
+		const auto x = (size_t) std::clamp((view.x() / view.z() + 1.0) * half_resolution, 0.0, (double) resolution - 1);
+		const auto y = (size_t) std::clamp((view.y() / view.z() + 1.0) * half_resolution, 0.0, (double) resolution - 1);
+
+		// Shorten the segment by the margin; measured along the face axis, that is a factor of depth / distance.
+		const double limit = view.z() * (1.0 - margin / distance);
+
+		return (double) depth[(face * resolution + y) * resolution + x] < limit;
+	}
+
+	void DepthCubemap::checkOcclusion(const std::vector<math::Vec3d> &points,
+	                                  const math::Vec3d &viewpoint,
+	                                  std::vector<bool> &occluded) const {
+		assert(viewpoint == eye);
+		occluded.resize(points.size());
+		for (size_t i = 0; i < points.size(); ++i) {
+			occluded[i] = checkOcclusion(points[i]);
+		}
+	}
+}
@@ -0,0 +1,104 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#ifndef MGODPL_DEPTH_CUBEMAP_H
+#define MGODPL_DEPTH_CUBEMAP_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "../math/Vec3.h"
+#include "Mesh.h"
+
+namespace mgodpl {
+
+	/**
+	 * @brief An approximate occlusion model: a depth cube map of a mesh, as seen from a single eye position.
+	 *
+	 * The mesh is rasterized once per eye position (on the CPU, in tiles, in parallel) into six depth images, one
+	 * per cube face. After that, checking whether a point is occluded from the eye is a single depth lookup, rather
+	 * than a ray cast; this pays off when many points are checked from the same eye, as in scan path evaluation.
+	 *
+	 * The answers are exact up to the resolution of the cube map: every texel stores the depth of the nearest
+	 * triangle covering its center. The `margin` has the same meaning as in MeshOcclusionModel: a point counts as
+	 * occluded only if the mesh is in the way of the segment from the eye to `margin` short of the point.
+	 */
+	class DepthCubemap {
+	public:
+		/**
+		 * @brief Create an (empty) cube map; call render() before querying it.
+		 *
+		 * @param resolution 	The width and height, in texels, of each face.
+		 * @param margin 		The margin, see MeshOcclusionModel.
+		 */
+		explicit DepthCubemap(size_t resolution = 1024, double margin = 0.0);
+
+		/**
+		 * @brief Rasterize a mesh as seen from an eye position, replacing the previous contents of the cube map.
+		 *
+		 * Storage is reused between calls.
+		 *
+		 * @param mesh 		The mesh.
+		 * @param eye 		The eye position.
+		 */
+		void render(const Mesh &mesh, const math::Vec3d &eye);
+
+		/**
+		 * @brief Check whether a point is occluded from the eye the cube map was rendered from.
+		 *
+		 * @param point 	The point to check.
+		 * @return 			True if the point is occluded.
+		 */
+		[[nodiscard]] bool checkOcclusion(const math::Vec3d &point) const;
+
+		/**
+		 * @brief Check, for a batch of points, whether each is occluded from the eye; same interface as
+		 * MeshOcclusionModel::checkOcclusion.
+		 *
+		 * @param points 		The points to check.
+		 * @param viewpoint 	The viewpoint; must be the eye the cube map was rendered from.
+		 * @param occluded 		Output: one value per point, true if it is occluded.
+		 */
+		void checkOcclusion(const std::vector<math::Vec3d> &points,
+		                    const math::Vec3d &viewpoint,
+		                    std::vector<bool> &occluded) const;
+
+		/// The eye position the cube map was last rendered from.
+		[[nodiscard]] const math::Vec3d &eye_position() const {
+			return eye;
+		}
+
+	private:
+		/// The width/height of a tile, in texels; tiles are the unit of parallel work.
+		static constexpr size_t TILE_SIZE = 32;
+
+		/// A triangle projected onto a cube face: texel-space coordinates and the reciprocal depth per vertex.
+		struct ProjectedTriangle {
+			std::array<double, 3> x, y, inv_z;
+		};
+
+		/// Clip a triangle to the front of a face, project it, and add it to the face's tile bins.
+		void bin_triangle(size_t face, const std::array<math::Vec3d, 3> &view_triangle);
+
+		/// Rasterize all triangles binned into one tile.
+		void rasterize_tile(size_t face, size_t tile_x, size_t tile_y);
+
+		size_t resolution;
+		size_t tiles_per_side;
+		double margin;
+		math::Vec3d eye{0, 0, 0};
+
+		/// The depth (along the face axis) per texel, face-major, row-major within a face.
+		std::vector<float> depth;
+
+		/// Per face, the projected triangles.
+		std::array<std::vector<ProjectedTriangle>, 6> projected;
+
+		/// Per face, per tile, the indices of the projected triangles overlapping it.
+		std::array<std::vector<std::vector<uint32_t> >, 6> bins;
+	};
+}
+
+#endif //MGODPL_DEPTH_CUBEMAP_H
@@ -15,13 +15,7 @@ double mgodpl::base_distance(const RobotState &a, const RobotState &b, const dou
 }
 
 double mgodpl::equal_weights_distance(const RobotState &a, const RobotState &b) {
-	double d = (a.base_tf.translation - b.base_tf.translation).norm();
-	d += angular_distance(a.base_tf.orientation, b.base_tf.orientation);
-	for (size_t i = 0; i < a.joint_values.size(); ++i) {
-		d += std::abs(a.joint_values[i] - b.joint_values[i]);
-	}
-	assert(std::isfinite(d));
-	return d;
+	return EqualWeightsDistance{}(a, b);
 }
 
 double mgodpl::equal_weights_max_distance(const RobotState &a, const RobotState &b) {
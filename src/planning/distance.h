@@ -10,6 +10,8 @@
 #define MGODPL_DISTANCE_H
 
 #include "RobotState.h"
+#include <cassert>
+#include <cmath>
 #include <functional>
 
 namespace mgodpl {
@@ -50,6 +52,22 @@ namespace mgodpl {
 	 */
 	double equal_weights_distance(const RobotState &a, const RobotState &b);
 
+	/**
+	 * @brief equal_weights_distance as a function object, defined inline so that templated callers (such as the
+	 * spatial indices) can inline it rather than calling through a DistanceFn.
+	 */
+	struct EqualWeightsDistance {
+		double operator()(const RobotState &a, const RobotState &b) const {
+			double d = (a.base_tf.translation - b.base_tf.translation).norm();
+			d += angular_distance(a.base_tf.orientation, b.base_tf.orientation);
+			for (size_t i = 0; i < a.joint_values.size(); ++i) {
+				d += std::abs(a.joint_values[i] - b.joint_values[i]);
+			}
+			assert(std::isfinite(d));
+			return d;
+		}
+	};
+
 	/**
 	 * @brief Compute the distance between two states, assuming that all joint variables have equal weight.
 	 * As opposed to equal_weights_distance, this function returns the maximum of the distances,
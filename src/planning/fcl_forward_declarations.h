@@ -22,6 +22,11 @@ namespace fcl {
 	class CollisionObject;
 
 	using CollisionObjectd = CollisionObject<double>;
+
+	template<typename S>
+	struct CollisionResult;
+
+	using CollisionResultd = CollisionResult<double>;
 }
 
 #endif //MGODPL_FCL_FORWARD_DECLARATIONS_H
@@ -6,6 +6,11 @@
 // Created by werner on 1/22/24.
 //
 
+#include <limits>
+#include <random>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+
 #include "goal_sampling.h"
 #include "collision_detection.h"
 #include "state_tools.h"
@@ -87,15 +92,140 @@ std::optional<mgodpl::RobotState> mgodpl::findGoalStateByUniformSampling(const m
 																		 const fcl::CollisionObjectd &tree_trunk_object,
 																		 random_numbers::RandomNumberGenerator &rng,
 																		 size_t max_attempts) {
-	for (size_t i = 0; i < max_attempts; ++i) {
-		RobotState state = genGoalStateUniform(rng, target, robot, flying_base, end_effector);
+	// One collision model per thread, since the candidates are checked in parallel.
+	tbb::enumerable_thread_specific<RobotCollisionModel> collision_models([&robot]() {
+		return RobotCollisionModel(robot);
+	});
+
+	std::optional<RobotState> result;
+
+	sample_and_check_in_batches(
+			max_attempts,
+			rng,
+			[&](random_numbers::RandomNumberGenerator &candidate_rng) {
+				return genGoalStateUniform(candidate_rng, target, robot, flying_base, end_effector);
+			},
+			[&](const RobotState &state) {
+				return check_robot_collision(collision_models.local(), tree_trunk_object, state);
+			},
+			[&](const RobotState &state, bool valid) {
+				if (valid) {
+					result = state;
+				}
+				return valid;
+			});
+
+	return result;
+}
+
+size_t mgodpl::sample_and_check_in_batches(size_t max_attempts,
+										   random_numbers::RandomNumberGenerator &rng,
+										   const std::function<RobotState(random_numbers::RandomNumberGenerator &)> &
+										   sample,
+										   const std::function<bool(const RobotState &)> &state_collides,
+										   const std::function<bool(const RobotState &, bool)> &on_checked) {
+	// The candidates past the stopping point are wasted; drawing them from a derived generator keeps them from
+	// advancing the caller's.
+	random_numbers::RandomNumberGenerator candidate_rng(
+			(unsigned int) rng.uniformInteger(0, std::numeric_limits<int>::max()));
+
+	std::vector<RobotState> batch;
+	// Using char rather than bool, since std::vector<bool> is not thread-safe.
+	std::vector<char> valid;
+
+	size_t batch_size = 1;
+	size_t attempts = 0;
+
+	while (attempts < max_attempts) {
+		const size_t n_batch = std::min(batch_size, max_attempts - attempts);
+
+		// Draw the candidates serially, so the random number sequence does not depend on the batching.
+		batch.clear();
+		for (size_t i = 0; i < n_batch; ++i) {
+			batch.push_back(sample(candidate_rng));
+		}
+
+		valid.resize(n_batch);
+		tbb::parallel_for(size_t(0), n_batch, [&](size_t i) {
+			valid[i] = !state_collides(batch[i]);
+		});
+
+		for (size_t i = 0; i < n_batch; ++i) {
+			++attempts;
+			if (on_checked(batch[i], valid[i])) {
+				return attempts;
+			}
+		}
+
+		batch_size = std::min(batch_size * 2, MAX_GOAL_SAMPLE_BATCH_SIZE);
+	}
+
+	return attempts;
+}
+
+mgodpl::GoalSampleSet mgodpl::sample_goal_states_parallel(
+		size_t n_targets,
+		size_t max_valid_samples,
+		size_t max_attempts,
+		unsigned int master_seed,
+		const GoalCandidateFn &sample_candidate,
+		const std::function<bool(const RobotState &)> &state_collides,
+		const std::function<void(size_t target_index, const RobotState &state, bool valid)> &on_sample) {
+	// The goal states of every target, and (only if there's an on_sample callback) all of its candidates.
+	std::vector<std::vector<RobotState> > target_states(n_targets);
+	std::vector<std::vector<std::pair<RobotState, bool> > > target_candidates(n_targets);
+
+	GoalSampleSet result;
+	result.group_sizes.resize(n_targets);
+	result.attempts.resize(n_targets);
+
+	tbb::parallel_for(size_t(0), n_targets, [&](size_t target_index) {
+		// Derive the random number stream of this target from the master seed.
+		std::seed_seq seed_sequence{master_seed, (unsigned int) target_index};
+		unsigned int target_seed;
+		seed_sequence.generate(&target_seed, &target_seed + 1);
+		random_numbers::RandomNumberGenerator rng(target_seed);
 
-		if (!check_robot_collision(robot, tree_trunk_object, state)) {
-			return state;
+		auto &states = target_states[target_index];
+
+		if (max_valid_samples == 0) {
+			return;
+		}
+
+		result.attempts[target_index] = sample_and_check_in_batches(
+				max_attempts,
+				rng,
+				[&](random_numbers::RandomNumberGenerator &candidate_rng) {
+					return sample_candidate(target_index, candidate_rng);
+				},
+				state_collides,
+				[&](const RobotState &state, bool valid) {
+					if (on_sample) {
+						target_candidates[target_index].emplace_back(state, valid);
+					}
+					if (valid) {
+						states.push_back(state);
+					}
+					return states.size() >= max_valid_samples;
+				});
+
+		result.group_sizes[target_index] = states.size();
+	});
+
+	// Concatenate the goal states, and report the candidates, in target order.
+	for (size_t target_index = 0; target_index < n_targets; ++target_index) {
+		result.states.insert(result.states.end(),
+							 target_states[target_index].begin(),
+							 target_states[target_index].end());
+
+		if (on_sample) {
+			for (const auto &[state, valid]: target_candidates[target_index]) {
+				on_sample(target_index, state, valid);
+			}
 		}
 	}
 
-	return std::nullopt;
+	return result;
 }
 
 std::optional<mgodpl::RobotState> mgodpl::generateUniformRandomArmVectorState(
@@ -107,6 +237,8 @@ std::optional<mgodpl::RobotState> mgodpl::generateUniformRandomArmVectorState(
 		const double ee_distance) {
 	std::optional<RobotState> sample;
 
+	RobotCollisionModel collision_model(robot);
+
 	for (int attempt = 0; attempt < max_attempts; ++attempt) {
 		// Generate random arm vec.
 		math::Vec3d arm_vec(rng.gaussian01(), rng.gaussian01(), rng.gaussian01());
@@ -114,7 +246,7 @@ std::optional<mgodpl::RobotState> mgodpl::generateUniformRandomArmVectorState(
 
 		RobotState candidate = fromEndEffectorAndVector(robot, fruit_center - arm_vec * ee_distance, -arm_vec);
 
-		if (!check_robot_collision(robot, tree_trunk_object, candidate)) {
+		if (!check_robot_collision(collision_model, tree_trunk_object, candidate)) {
 			sample = candidate;
 			break;
 		}
@@ -9,7 +9,9 @@
 #ifndef MGODPL_GOAL_SAMPLING_H
 #define MGODPL_GOAL_SAMPLING_H
 
+#include <functional>
 #include <optional>
+#include <vector>
 #include "RobotState.h"
 #include "RobotModel.h"
 #include "fcl_forward_declarations.h"
@@ -94,6 +96,78 @@ namespace mgodpl {
 			random_numbers::RandomNumberGenerator &rng,
 			size_t max_attempts);
 
+	/// The largest number of candidate goal states that are collision-checked together.
+	constexpr size_t MAX_GOAL_SAMPLE_BATCH_SIZE = 64;
+
+	/**
+	 * @brief Draw candidate states, and check them for collisions in parallel batches.
+	 *
+	 * The candidates are drawn serially from a generator seeded by a single draw from `rng`, and `on_checked` is
+	 * called serially with every candidate and whether it is collision-free, in the order drawn, until it returns true
+	 * or `max_attempts` candidates were considered. The batches start at a single candidate and double up to
+	 * MAX_GOAL_SAMPLE_BATCH_SIZE, so at most as many checks are wasted past the stopping point as were needed to get
+	 * there.
+	 *
+	 * Since the candidates past the stopping point are drawn from the derived generator, `rng` always advances by
+	 * exactly one draw, however many candidates were drawn; the results are the same as those of a sequential loop
+	 * over the derived generator. (They differ from those of a sequential loop over `rng` itself.)
+	 *
+	 * @param max_attempts		The maximum number of candidates to consider.
+	 * @param rng				The generator to derive the candidates' generator from.
+	 * @param sample			A function that draws a candidate from the given generator; only called from the calling thread.
+	 * @param state_collides	A function that checks if a state collides; must be thread-safe.
+	 * @param on_checked		Called with each candidate and whether it is valid; returns true to stop.
+	 * @return The number of candidates considered.
+	 */
+	size_t sample_and_check_in_batches(
+			size_t max_attempts,
+			random_numbers::RandomNumberGenerator &rng,
+			const std::function<RobotState(random_numbers::RandomNumberGenerator &)> &sample,
+			const std::function<bool(const RobotState &)> &state_collides,
+			const std::function<bool(const RobotState &, bool)> &on_checked);
+
+	/**
+	 * @brief Collision-free goal states for a list of targets, grouped by target.
+	 */
+	struct GoalSampleSet {
+		/// The goal states of all targets, those of the first target first.
+		std::vector<RobotState> states;
+		/// The number of goal states per target; a GroupIndexTable built from these maps (target, sample) to an index in `states`.
+		std::vector<size_t> group_sizes;
+		/// The number of candidates considered per target.
+		std::vector<size_t> attempts;
+	};
+
+	/// A function that draws a candidate goal state for a target, given by its index, from the given random number generator.
+	using GoalCandidateFn = std::function<RobotState(size_t target_index, random_numbers::RandomNumberGenerator &rng)>;
+
+	/**
+	 * @brief Sample collision-free goal states for many targets at once.
+	 *
+	 * The targets are sampled in parallel, each from its own random number stream derived from the master seed and
+	 * the target index, with the candidates of every target checked in batches (see sample_and_check_in_batches).
+	 * Sampling for a target stops as soon as it has `max_valid_samples` goal states, or after `max_attempts`
+	 * candidates. The result only depends on the master seed, not on the number of threads or their scheduling.
+	 *
+	 * @param n_targets				The number of targets.
+	 * @param max_valid_samples		The maximum number of goal states per target.
+	 * @param max_attempts			The maximum number of candidates per target.
+	 * @param master_seed			The seed to derive the random number streams of the targets from.
+	 * @param sample_candidate		Draws a candidate goal state for a target; must be thread-safe (apart from the generator).
+	 * @param state_collides		Checks if a state collides; must be thread-safe.
+	 * @param on_sample				If given, called from the calling thread once sampling is done, for every candidate
+	 * 								with whether it was valid, in target order and then in the order drawn.
+	 * @return The goal states, grouped by target.
+	 */
+	GoalSampleSet sample_goal_states_parallel(
+			size_t n_targets,
+			size_t max_valid_samples,
+			size_t max_attempts,
+			unsigned int master_seed,
+			const GoalCandidateFn &sample_candidate,
+			const std::function<bool(const RobotState &)> &state_collides,
+			const std::function<void(size_t target_index, const RobotState &state, bool valid)> &on_sample = nullptr);
+
 	/**
 	 * @brief Attempts to generate a collision-free RobotState by uniformly sampling random arm vectors.
 	 *
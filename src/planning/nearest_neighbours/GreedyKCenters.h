@@ -68,17 +68,17 @@ struct GreedyKCentersHooks {
  *
  * @param data      The data points to cluster.
  * @param k         The number of centers to compute.
- * @param distFun   A function that computes the distance between two data points.
+ * @param distFun   A function that computes the distance between two data points; any callable, so that it can be inlined.
  * @param rng       A random number generator.
  * @param hooks     A set of hooks that can be used to observe the behavior of the algorithm.
  *
  * @returns     A vector of indices of the computed centers. If fewer than k data points are available, this vector may be smaller than k.
  */
-template<typename T>
+template<typename T, typename DistFun = std::function<double(const T &, const T &)> >
 std::vector<size_t> greedy_k_centers(
     const std::vector<T> &data,
     unsigned int k,
-    const std::function<double(const T &, const T &)> &distFun,
+    const DistFun &distFun,
     random_numbers::RandomNumberGenerator &rng,
     const std::optional<GreedyKCentersHooks> hooks = std::nullopt
 ) {
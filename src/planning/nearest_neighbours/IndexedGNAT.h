@@ -0,0 +1,403 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#ifndef MGODPL_INDEXEDGNAT_H
+#define MGODPL_INDEXEDGNAT_H
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "GreedyKCenters.h"
+#include "../RandomNumberGenerator.h"
+
+namespace mgodpl {
+
+	/**
+	 * @brief A Geometric Near-neighbor Access Tree over indices into an external array of points.
+	 *
+	 * This is the same structure as ompl::NearestNeighborsGNAT, but it stores only the indices of the points; the
+	 * points themselves stay wherever the caller keeps them (e.g. the vertex properties of a roadmap), and are looked
+	 * up through a `point_of(index) -> const Point &` function passed to every call. The distance metric is a template
+	 * parameter, so that it is inlined instead of being called through a std::function.
+	 *
+	 * The nodes are kept in a single vector, with the children of every node next to each other; there is no support
+	 * for removing points.
+	 *
+	 * Results are sorted by distance, with ties broken on the index, so they do not depend on insertion order quirks.
+	 * Queries are const and may run concurrently, as long as nothing is added in the meantime.
+	 *
+	 * @tparam Point 		The type of the points.
+	 * @tparam Distance 	A function object (const Point &, const Point &) -> double; must be a metric.
+	 */
+	template<typename Point, typename Distance>
+	class IndexedGNAT {
+	public:
+		/// The maximum number of children of a node.
+		static constexpr unsigned MAX_DEGREE = 12;
+
+		struct Parameters {
+			/// The number of children a node is split into, before it is adapted to the size of the subtree.
+			unsigned degree = 8;
+			unsigned min_degree = 4;
+			unsigned max_degree = MAX_DEGREE;
+			/// The number of points a leaf holds before it is split.
+			unsigned max_points_per_leaf = 50;
+		};
+
+		explicit IndexedGNAT(Distance distance = {}, Parameters parameters = {}, unsigned int seed = 42)
+			: distance(std::move(distance)), parameters(parameters), rng(seed) {
+			assert(parameters.min_degree <= parameters.degree && parameters.degree <= parameters.max_degree);
+			assert(parameters.max_degree <= MAX_DEGREE);
+		}
+
+		/**
+		 * Add a single point.
+		 *
+		 * @param index 	The index of the point.
+		 * @param point_of 	Maps indices to points; must return the same points for all calls on this index.
+		 */
+		template<typename PointOf>
+		void add(size_t index, const PointOf &point_of) {
+			if (nodes.empty()) {
+				nodes.push_back(Node{index, parameters.degree});
+				n_points = 1;
+				return;
+			}
+
+			const Point &point = point_of(index);
+
+			// Descend into the child with the nearest pivot, updating the ranges on the way.
+			size_t node_i = 0;
+			while (nodes[node_i].n_children > 0) {
+				const Node &node = nodes[node_i];
+				std::array<double, MAX_DEGREE> d{};
+				size_t nearest = 0;
+				for (size_t i = 0; i < node.n_children; ++i) {
+					d[i] = distance(point, point_of(nodes[node.first_child + i].pivot));
+					if (d[i] < d[nearest]) {
+						nearest = i;
+					}
+				}
+				for (size_t i = 0; i < node.n_children; ++i) {
+					nodes[node.first_child + i].ranges[nearest].update(d[i]);
+				}
+				node_i = node.first_child + nearest;
+				nodes[node_i].radius.update(d[nearest]);
+			}
+
+			nodes[node_i].bucket.push_back(index);
+			++n_points;
+
+			if (needs_split(nodes[node_i])) {
+				split(node_i, point_of);
+			}
+		}
+
+		/**
+		 * Bulk-build the index from a batch of points, replacing its contents; this is cheaper than adding the points
+		 * one by one, since every point is only assigned to a child when its node is split.
+		 */
+		template<typename PointOf>
+		void build(std::vector<size_t> indices, const PointOf &point_of) {
+			nodes.clear();
+			n_points = indices.size();
+			if (indices.empty()) {
+				return;
+			}
+
+			nodes.push_back(Node{indices.front(), parameters.degree});
+			nodes[0].bucket.assign(indices.begin() + 1, indices.end());
+
+			if (needs_split(nodes[0])) {
+				split(0, point_of);
+			}
+		}
+
+		/**
+		 * Find the k points nearest to a query point.
+		 *
+		 * @param query 	The query point; need not be in the index.
+		 * @param k 		The number of neighbours.
+		 * @param point_of 	Maps indices to points.
+		 * @param out 		The indices of the (up to) k nearest points, nearest first.
+		 */
+		template<typename PointOf>
+		void nearestK(const Point &query, size_t k, const PointOf &point_of, std::vector<size_t> &out) const {
+			search(query, k, std::numeric_limits<double>::infinity(), point_of, out);
+		}
+
+		/**
+		 * Find all points within a radius of a query point, nearest first.
+		 */
+		template<typename PointOf>
+		void nearestR(const Point &query, double radius, const PointOf &point_of, std::vector<size_t> &out) const {
+			search(query, std::numeric_limits<size_t>::max(), radius, point_of, out);
+		}
+
+		/// The index of the point nearest to the query point; the index must not be empty.
+		template<typename PointOf>
+		[[nodiscard]] size_t nearest(const Point &query, const PointOf &point_of) const {
+			assert(n_points > 0);
+			thread_local std::vector<size_t> result;
+			nearestK(query, 1, point_of, result);
+			return result.front();
+		}
+
+		[[nodiscard]] size_t size() const {
+			return n_points;
+		}
+
+		/// The heap memory used by the index itself, in bytes; the points are not included.
+		[[nodiscard]] size_t size_bytes() const {
+			size_t bytes = nodes.capacity() * sizeof(Node);
+			for (const Node &node: nodes) {
+				bytes += node.bucket.capacity() * sizeof(size_t) + node.ranges.capacity() * sizeof(Range);
+			}
+			return bytes;
+		}
+
+	private:
+		/// An interval of distances.
+		struct Range {
+			double min = std::numeric_limits<double>::infinity();
+			double max = -std::numeric_limits<double>::infinity();
+
+			void update(double d) {
+				min = std::min(min, d);
+				max = std::max(max, d);
+			}
+		};
+
+		struct Node {
+			/// The index of the pivot point.
+			size_t pivot;
+			/// The number of children the node is split into.
+			unsigned degree;
+			/// The distances from the pivot to the other points in the subtree.
+			Range radius{};
+			/// Per sibling (including this node itself), the distances from the pivot to the points of its subtree.
+			std::vector<Range> ranges{};
+			/// The points in a leaf, other than the pivot; empty once the node is split.
+			std::vector<size_t> bucket{};
+			/// The index of the first child in the node vector; the children are consecutive.
+			size_t first_child = 0;
+			size_t n_children = 0;
+		};
+
+		[[nodiscard]] bool needs_split(const Node &node) const {
+			return node.bucket.size() > parameters.max_points_per_leaf && node.bucket.size() > node.degree;
+		}
+
+		/// Split a leaf into children, and recursively split the children that are still too large.
+		template<typename PointOf>
+		void split(size_t node_i, const PointOf &point_of) {
+			assert(nodes[node_i].n_children == 0);
+
+			const auto pivots = greedy_k_centers<size_t>(nodes[node_i].bucket,
+														 nodes[node_i].degree,
+														 [&](size_t a, size_t b) {
+															 return distance(point_of(a), point_of(b));
+														 },
+														 rng);
+			const size_t n_children = pivots.size();
+
+			// If all points coincide, there is nothing to split on; keep it a leaf.
+			if (n_children < 2) {
+				return;
+			}
+
+			std::vector<size_t> bucket = std::move(nodes[node_i].bucket);
+			nodes[node_i].bucket = {};
+
+			const size_t first_child = nodes.size();
+			for (size_t pivot: pivots) {
+				nodes.push_back(Node{bucket[pivot], 0, {}, std::vector<Range>(n_children)});
+			}
+			nodes[node_i].first_child = first_child;
+			nodes[node_i].n_children = n_children;
+
+			// Assign every point to the child with the nearest pivot.
+			for (size_t j = 0; j < bucket.size(); ++j) {
+				const Point &point = point_of(bucket[j]);
+
+				std::array<double, MAX_DEGREE> d{};
+				size_t nearest = 0;
+				for (size_t i = 0; i < n_children; ++i) {
+					d[i] = distance(point, point_of(nodes[first_child + i].pivot));
+					if (d[i] < d[nearest]) {
+						nearest = i;
+					}
+				}
+
+				Node &child = nodes[first_child + nearest];
+				if (j != pivots[nearest]) {
+					child.bucket.push_back(bucket[j]);
+					child.radius.update(d[nearest]);
+				}
+				for (size_t i = 0; i < n_children; ++i) {
+					nodes[first_child + i].ranges[nearest].update(d[i]);
+				}
+			}
+
+			for (size_t i = first_child; i < first_child + n_children; ++i) {
+				Node &child = nodes[i];
+				child.degree = (unsigned) std::clamp(n_children * child.bucket.size() / bucket.size(),
+													 (size_t) parameters.min_degree,
+													 (size_t) parameters.max_degree);
+				// A singleton: the pivot is the only point.
+				if (child.bucket.empty()) {
+					child.radius = {0.0, 0.0};
+				}
+			}
+
+			for (size_t i = first_child; i < first_child + n_children; ++i) {
+				if (needs_split(nodes[i])) {
+					split(i, point_of);
+				}
+			}
+		}
+
+		/// A candidate neighbour, ordered by distance and then by index.
+		using Neighbour = std::pair<double, size_t>;
+
+		/// A node to visit, with the distance from the query to its pivot; the heap order visits the nodes in order of
+		/// their lower bound on that distance first.
+		struct OpenNode {
+			double lower_bound;
+			size_t node;
+			double distance;
+
+			bool operator<(const OpenNode &other) const {
+				return lower_bound > other.lower_bound;
+			}
+		};
+
+		/// The k nearest points within the radius.
+		template<typename PointOf>
+		void search(const Point &query,
+					size_t k,
+					double radius,
+					const PointOf &point_of,
+					std::vector<size_t> &out) const {
+			out.clear();
+			if (nodes.empty() || k == 0) {
+				return;
+			}
+
+			// A max-heap of the best candidates so far, and a min-heap of nodes to visit, by their lower bound.
+			thread_local std::vector<Neighbour> best;
+			thread_local std::vector<OpenNode> open;
+			best.clear();
+			open.clear();
+
+			// The distance beyond which points can no longer be among the results.
+			auto bound = [&]() {
+				return best.size() < k ? radius : std::min(radius, best.front().first);
+			};
+
+			auto consider = [&](size_t index, double d) {
+				if (d > radius) {
+					return;
+				}
+				if (best.size() < k) {
+					best.emplace_back(d, index);
+					std::push_heap(best.begin(), best.end());
+				} else if (Neighbour(d, index) < best.front()) {
+					std::pop_heap(best.begin(), best.end());
+					best.back() = {d, index};
+					std::push_heap(best.begin(), best.end());
+				}
+			};
+
+			auto visit = [&](size_t node_i) {
+				const Node &node = nodes[node_i];
+
+				// The points are scattered through the external array; fetch them a few iterations ahead.
+				constexpr size_t PREFETCH_DISTANCE = 4;
+				for (size_t i = 0; i < node.bucket.size(); ++i) {
+					if (i + PREFETCH_DISTANCE < node.bucket.size()) {
+						const char *ahead = (const char *) &point_of(node.bucket[i + PREFETCH_DISTANCE]);
+						for (size_t offset = 0; offset < sizeof(Point); offset += 64) {
+							__builtin_prefetch(ahead + offset);
+						}
+					}
+					consider(node.bucket[i], distance(query, point_of(node.bucket[i])));
+				}
+
+				if (node.n_children == 0) {
+					return;
+				}
+
+				std::array<double, MAX_DEGREE> d{};
+				std::array<bool, MAX_DEGREE> alive{};
+				std::fill_n(alive.begin(), node.n_children, true);
+
+				for (size_t i = 0; i < node.n_children; ++i) {
+					if (!alive[i]) {
+						continue;
+					}
+					const Node &child = nodes[node.first_child + i];
+					d[i] = distance(query, point_of(child.pivot));
+					consider(child.pivot, d[i]);
+
+					// Prune the siblings whose points are all provably further away than the bound.
+					const double r = bound();
+					for (size_t j = 0; j < node.n_children; ++j) {
+						if (alive[j] && j != i && (d[i] - r > child.ranges[j].max || d[i] + r < child.ranges[j].min)) {
+							alive[j] = false;
+						}
+					}
+				}
+
+				const double r = bound();
+				for (size_t i = 0; i < node.n_children; ++i) {
+					const Node &child = nodes[node.first_child + i];
+					if (alive[i] && d[i] - r <= child.radius.max && d[i] + r >= child.radius.min) {
+						open.push_back({d[i] - child.radius.max, node.first_child + i, d[i]});
+						std::push_heap(open.begin(), open.end());
+					}
+				}
+			};
+
+			consider(nodes[0].pivot, distance(query, point_of(nodes[0].pivot)));
+			visit(0);
+
+			while (!open.empty()) {
+				std::pop_heap(open.begin(), open.end());
+				const OpenNode next = open.back();
+				open.pop_back();
+
+				// The bound may have tightened since the node was queued.
+				const Node &node = nodes[next.node];
+				const double r = bound();
+				if (next.distance - r > node.radius.max || next.distance + r < node.radius.min) {
+					continue;
+				}
+				visit(next.node);
+			}
+
+			std::sort_heap(best.begin(), best.end());
+			out.reserve(best.size());
+			for (const auto &[d, index]: best) {
+				out.push_back(index);
+			}
+		}
+
+		Distance distance;
+		Parameters parameters;
+		/// Used for the first pivot of every split; seeded, so the index is deterministic.
+		random_numbers::RandomNumberGenerator rng;
+		std::vector<Node> nodes;
+		size_t n_points = 0;
+	};
+
+}
+
+#endif //MGODPL_INDEXEDGNAT_H
@@ -47,6 +47,7 @@
 
 #include <algorithm>
 #include <iostream>
+#include <memory>
 #include <queue>
 #include <random>
 #include <unordered_set>
@@ -397,11 +398,9 @@ namespace ompl {
                     // Find the index of the closest pivot to the data point.
                     unsigned int closest_pivot = std::min_element(pivots.begin(),
                                                                   pivots.end(),
-                                                                  [&](unsigned int i, unsigned int j) {
-                                                                      return gnat.distFun_(data_[i], data_[j]) < gnat.
-                                                                             distFun_(
-                                                                                 data_[j],
-                                                                                 data_[i]);
+                                                                  [&](size_t a, size_t b) {
+                                                                      return gnat.distFun_(data_[j], data_[a]) <
+                                                                             gnat.distFun_(data_[j], data_[b]);
                                                                   }) - pivots.begin();
 
                     // Copy the data point to the child that is closest to it; do not include the pivot itself.
@@ -0,0 +1,421 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include "occlusion_bvh.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include "../math/AABB.h"
+#include "simd_lanes.h"
+
+namespace mgodpl {
+
+	using simd::Lanes;
+	using simd::Mask;
+
+	namespace {
+		/// The number of bins for the binned SAH build.
+		constexpr size_t N_BINS = 12;
+
+		/// Below this number of triangles, a node always becomes a leaf.
+		constexpr size_t MIN_SPLIT_SIZE = 4;
+
+		/// The relative cost of a node traversal step versus a triangle test, for the SAH.
+		constexpr double TRAVERSAL_COST = 1.0;
+
+		/// A triangle during the build, with its bounds and centroid.
+		struct BuildItem {
+			size_t triangle;
+			math::AABBd bounds;
+			math::Vec3d centroid;
+		};
+
+		double surface_area(const math::AABBd &box) {
+			const math::Vec3d size = box.size();
+			return 2.0 * (size.x() * size.y() + size.y() * size.z() + size.z() * size.x());
+		}
+
+		/// Round a double to a float no greater than it.
+		float float_down(double x) {
+			float f = (float) x;
+			return (double) f > x ? std::nextafter(f, -INFINITY) : f;
+		}
+
+		/// Round a double to a float no smaller than it.
+		float float_up(double x) {
+			float f = (float) x;
+			return (double) f < x ? std::nextafter(f, INFINITY) : f;
+		}
+
+		/// Avoid divisions by zero (and the resulting NaNs) in the slab test.
+		double safe_inverse(double d) {
+			constexpr double TINY = 1.0e-30;
+			return 1.0 / (std::abs(d) < TINY ? std::copysign(TINY, d) : d);
+		}
+
+		/**
+		 * @brief Recursively build the tree over items [begin, end), appending nodes in depth-first order.
+		 *
+		 * Nodes at `max_allowed_depth` become leaves regardless of their size; `max_depth` is raised to the depth of
+		 * every node made.
+		 */
+		template<typename Node>
+		void build_recursive(std::vector<BuildItem> &items,
+		                     size_t begin,
+		                     size_t end,
+		                     size_t depth,
+		                     size_t max_allowed_depth,
+		                     size_t &max_depth,
+		                     std::vector<Node> &nodes) {
+			math::AABBd bounds = math::AABBd::inverted_infinity();
+			math::AABBd centroid_bounds = math::AABBd::inverted_infinity();
+			for (size_t i = begin; i < end; ++i) {
+				bounds = bounds.combined(items[i].bounds);
+				centroid_bounds.expand(items[i].centroid);
+			}
+
+			const size_t node_index = nodes.size();
+			nodes.push_back(Node{
+					.min = {float_down(bounds.min().x()), float_down(bounds.min().y()), float_down(bounds.min().z())},
+					.first = (uint32_t) begin,
+					.max = {float_up(bounds.max().x()), float_up(bounds.max().y()), float_up(bounds.max().z())},
+					.count = (uint32_t) (end - begin)
+			});
+
+			max_depth = std::max(max_depth, depth);
+
+			const size_t n = end - begin;
+			if (n < MIN_SPLIT_SIZE || depth >= max_allowed_depth) {
+				return;
+			}
+
+			// Find the best split along any axis by binning the centroids.
+			const double leaf_cost = (double) n;
+			double best_cost = INFINITY;
+			size_t best_axis = 0;
+			size_t best_split = 0;
+
+			for (size_t axis = 0; axis < 3; ++axis) {
+				const double lo = centroid_bounds.min()[axis];
+				const double extent = centroid_bounds.max()[axis] - lo;
+				if (extent <= 0.0) {
+					continue;
+				}
+
+				std::vector<math::AABBd> bin_bounds(N_BINS, math::AABBd::inverted_infinity());
+				std::array<size_t, N_BINS> bin_counts{};
+
+				for (size_t i = begin; i < end; ++i) {
+					size_t bin = std::min(N_BINS - 1, (size_t) ((items[i].centroid[axis] - lo) / extent * N_BINS));
+					bin_bounds[bin] = bin_bounds[bin].combined(items[i].bounds);
+					++bin_counts[bin];
+				}
+
+				// Sweep from the right to get the cost terms of the right-hand sides.
+				std::array<double, N_BINS> right_area_counts{};
+				math::AABBd right = math::AABBd::inverted_infinity();
+				size_t right_count = 0;
+				for (size_t bin = N_BINS - 1; bin > 0; --bin) {
+					right = right.combined(bin_bounds[bin]);
+					right_count += bin_counts[bin];
+					right_area_counts[bin] = right_count == 0 ? 0.0 : surface_area(right) * (double) right_count;
+				}
+
+				// Then from the left; splitting between bin - 1 and bin.
+				math::AABBd left = math::AABBd::inverted_infinity();
+				size_t left_count = 0;
+				for (size_t bin = 1; bin < N_BINS; ++bin) {
+					left = left.combined(bin_bounds[bin - 1]);
+					left_count += bin_counts[bin - 1];
+					if (left_count == 0 || left_count == n) {
+						continue;
+					}
+					double cost = TRAVERSAL_COST +
+					              (surface_area(left) * (double) left_count + right_area_counts[bin]) /
+					              surface_area(bounds);
+					if (cost < best_cost) {
+						best_cost = cost;
+						best_axis = axis;
+						best_split = bin;
+					}
+				}
+			}
+
+			if (best_cost >= leaf_cost) {
+				// Either splitting doesn't pay, or all centroids coincide.
+				return;
+			}
+
+			const double lo = centroid_bounds.min()[best_axis];
+			const double extent = centroid_bounds.max()[best_axis] - lo;
+			auto middle = std::partition(items.begin() + (long) begin, items.begin() + (long) end, [&](const auto &item) {
+				return std::min(N_BINS - 1, (size_t) ((item.centroid[best_axis] - lo) / extent * N_BINS)) < best_split;
+			});
+			const size_t mid = middle - items.begin();
+			assert(mid > begin && mid < end);
+
+			// Make this an inner node.
+			nodes[node_index].count = 0;
+
+			build_recursive(items, begin, mid, depth + 1, max_allowed_depth, max_depth, nodes);
+			nodes[node_index].first = (uint32_t) nodes.size();
+			build_recursive(items, mid, end, depth + 1, max_allowed_depth, max_depth, nodes);
+		}
+	}
+
+	OcclusionBvh::OcclusionBvh(const Mesh &mesh) {
+		std::vector<Triangle> all_triangles;
+		std::vector<BuildItem> items;
+
+		for (const auto &triangle: mesh.triangles) {
+			const auto &a = mesh.vertices[triangle[0]];
+			const auto &b = mesh.vertices[triangle[1]];
+			const auto &c = mesh.vertices[triangle[2]];
+
+			const Triangle t{a, b - a, c - a};
+
+			// Skip degenerate triangles:
+			if (t.edge1.cross(t.edge2).squaredNorm() == 0.0) {
+				continue;
+			}
+
+			math::AABBd bounds(a, a);
+			bounds.expand(b);
+			bounds.expand(c);
+
+			items.push_back({all_triangles.size(), bounds, (a + b + c) / 3.0});
+			all_triangles.push_back(t);
+		}
+
+		if (items.empty()) {
+			return;
+		}
+
+		nodes.reserve(2 * items.size());
+		build_recursive(items, 0, items.size(), 0, MAX_DEPTH, max_depth, nodes);
+
+		// Store the triangles in leaf order.
+		triangles.reserve(items.size());
+		for (const auto &item: items) {
+			triangles.push_back(all_triangles[item.triangle]);
+		}
+	}
+
+	bool OcclusionBvh::intersects(const Segment &segment) const {
+		return intersects_packet(&segment, 1) & 1;
+	}
+
+	void OcclusionBvh::intersects(const std::vector<Segment> &segments, std::vector<bool> &intersects) const {
+		intersects.assign(segments.size(), false);
+		for (size_t i = 0; i < segments.size(); i += Lanes::WIDTH) {
+			const size_t n = std::min(Lanes::WIDTH, segments.size() - i);
+			const unsigned hit = intersects_packet(segments.data() + i, n);
+			for (size_t lane = 0; lane < n; ++lane) {
+				intersects[i + lane] = (hit >> lane) & 1;
+			}
+		}
+	}
+
+	std::optional<double> OcclusionBvh::first_hit(const Segment &segment) const {
+		if (nodes.empty()) {
+			return std::nullopt;
+		}
+
+		const math::Vec3d origin = segment.start;
+		const math::Vec3d direction = segment.end - segment.start;
+		const math::Vec3d inverse_direction(safe_inverse(direction.x()),
+		                                    safe_inverse(direction.y()),
+		                                    safe_inverse(direction.z()));
+
+		// The closest hit so far; nodes and triangles beyond it are skipped.
+		double t_max = 1.0;
+		bool found = false;
+
+		TraversalStack stack;
+		size_t stack_size = 0;
+		stack[stack_size++] = 0;
+
+		while (stack_size > 0) {
+			const uint32_t node_index = stack[--stack_size];
+			const Node &node = nodes[node_index];
+
+			double t_enter = 0.0;
+			double t_exit = t_max;
+			for (size_t axis = 0; axis < 3; ++axis) {
+				const double t0 = ((double) node.min[axis] - origin[axis]) * inverse_direction[axis];
+				const double t1 = ((double) node.max[axis] - origin[axis]) * inverse_direction[axis];
+				t_enter = std::max(t_enter, std::min(t0, t1));
+				t_exit = std::min(t_exit, std::max(t0, t1));
+			}
+			if (t_enter > t_exit) {
+				continue;
+			}
+
+			if (node.count == 0) {
+				assert(stack_size + 2 <= stack.size());
+				stack[stack_size++] = node.first;
+				stack[stack_size++] = node_index + 1;
+				continue;
+			}
+
+			for (uint32_t tri_i = node.first; tri_i < node.first + node.count; ++tri_i) {
+				const Triangle &tri = triangles[tri_i];
+
+				const math::Vec3d p = direction.cross(tri.edge2);
+				const double det = tri.edge1.dot(p);
+				if (det * det < std::numeric_limits<double>::min()) {
+					continue;
+				}
+				const double inv_det = 1.0 / det;
+
+				const math::Vec3d s = origin - tri.v0;
+				const double u = s.dot(p) * inv_det;
+				if (u < 0.0 || u > 1.0) {
+					continue;
+				}
+
+				const math::Vec3d q = s.cross(tri.edge1);
+				const double v = direction.dot(q) * inv_det;
+				if (v < 0.0 || u + v > 1.0) {
+					continue;
+				}
+
+				const double t = tri.edge2.dot(q) * inv_det;
+				if (t >= 0.0 && t <= t_max) {
+					t_max = t;
+					found = true;
+				}
+			}
+		}
+
+		if (found) {
+			return t_max;
+		} else {
+			return std::nullopt;
+		}
+	}
+
+	unsigned OcclusionBvh::intersects_packet(const Segment *segments, size_t n) const {
+		assert(n >= 1 && n <= Lanes::WIDTH);
+
+		if (nodes.empty()) {
+			return 0;
+		}
+
+		// Transpose the packet; unused lanes repeat the last segment.
+		alignas(32) double start[3][Lanes::WIDTH];
+		alignas(32) double direction[3][Lanes::WIDTH];
+		alignas(32) double inverse_direction[3][Lanes::WIDTH];
+		for (size_t lane = 0; lane < Lanes::WIDTH; ++lane) {
+			const Segment &segment = segments[std::min(lane, n - 1)];
+			const math::Vec3d d = segment.end - segment.start;
+			for (size_t axis = 0; axis < 3; ++axis) {
+				start[axis][lane] = segment.start[axis];
+				direction[axis][lane] = d[axis];
+				inverse_direction[axis][lane] = safe_inverse(d[axis]);
+			}
+		}
+
+		const Lanes ox = Lanes::load(start[0]), oy = Lanes::load(start[1]), oz = Lanes::load(start[2]);
+		const Lanes dx = Lanes::load(direction[0]), dy = Lanes::load(direction[1]), dz = Lanes::load(direction[2]);
+		const Lanes ix = Lanes::load(inverse_direction[0]);
+		const Lanes iy = Lanes::load(inverse_direction[1]);
+		const Lanes iz = Lanes::load(inverse_direction[2]);
+
+		const Lanes zero = Lanes::broadcast(0.0);
+		const Lanes one = Lanes::broadcast(1.0);
+		const Lanes tiny = Lanes::broadcast(std::numeric_limits<double>::min());
+
+		const unsigned all_active = (1u << n) - 1;
+		unsigned hit = 0;
+
+		// Depth-first traversal with an explicit stack, bounded by the depth of the tree.
+		TraversalStack stack;
+		size_t stack_size = 0;
+		stack[stack_size++] = 0;
+
+		while (stack_size > 0) {
+			const uint32_t node_index = stack[--stack_size];
+			const Node &node = nodes[node_index];
+
+			// Slab test of the segments against the node bounds; only lanes that haven't hit anything yet matter.
+			const Lanes tx0 = (Lanes::broadcast(node.min[0]) - ox) * ix;
+			const Lanes tx1 = (Lanes::broadcast(node.max[0]) - ox) * ix;
+			const Lanes ty0 = (Lanes::broadcast(node.min[1]) - oy) * iy;
+			const Lanes ty1 = (Lanes::broadcast(node.max[1]) - oy) * iy;
+			const Lanes tz0 = (Lanes::broadcast(node.min[2]) - oz) * iz;
+			const Lanes tz1 = (Lanes::broadcast(node.max[2]) - oz) * iz;
+
+			const Lanes t_enter = Lanes::max(Lanes::max(Lanes::min(tx0, tx1), Lanes::min(ty0, ty1)),
+			                                 Lanes::max(Lanes::min(tz0, tz1), zero));
+			const Lanes t_exit = Lanes::min(Lanes::min(Lanes::max(tx0, tx1), Lanes::max(ty0, ty1)),
+			                                Lanes::min(Lanes::max(tz0, tz1), one));
+
+			const unsigned lanes = (t_enter <= t_exit).bits() & all_active & ~hit;
+			if (lanes == 0) {
+				continue;
+			}
+
+			if (node.count == 0) {
+				assert(stack_size + 2 <= stack.size());
+				stack[stack_size++] = node.first;
+				stack[stack_size++] = node_index + 1;
+				continue;
+			}
+
+			// Möller-Trumbore, for every triangle in the leaf against all lanes at once.
+			for (uint32_t tri_i = node.first; tri_i < node.first + node.count; ++tri_i) {
+				const Triangle &tri = triangles[tri_i];
+
+				const Lanes e1x = Lanes::broadcast(tri.edge1.x());
+				const Lanes e1y = Lanes::broadcast(tri.edge1.y());
+				const Lanes e1z = Lanes::broadcast(tri.edge1.z());
+				const Lanes e2x = Lanes::broadcast(tri.edge2.x());
+				const Lanes e2y = Lanes::broadcast(tri.edge2.y());
+				const Lanes e2z = Lanes::broadcast(tri.edge2.z());
+
+				// p = d x e2
+				const Lanes px = dy * e2z - dz * e2y;
+				const Lanes py = dz * e2x - dx * e2z;
+				const Lanes pz = dx * e2y - dy * e2x;
+
+				const Lanes det = e1x * px + e1y * py + e1z * pz;
+				const Lanes inv_det = one / det;
+
+				// s = o - v0
+				const Lanes sx = ox - Lanes::broadcast(tri.v0.x());
+				const Lanes sy = oy - Lanes::broadcast(tri.v0.y());
+				const Lanes sz = oz - Lanes::broadcast(tri.v0.z());
+
+				const Lanes u = (sx * px + sy * py + sz * pz) * inv_det;
+
+				// q = s x e1
+				const Lanes qx = sy * e1z - sz * e1y;
+				const Lanes qy = sz * e1x - sx * e1z;
+				const Lanes qz = sx * e1y - sy * e1x;
+
+				const Lanes v = (dx * qx + dy * qy + dz * qz) * inv_det;
+				const Lanes t = (e2x * qx + e2y * qy + e2z * qz) * inv_det;
+
+				// Segments parallel to the triangle plane are treated as misses.
+				const Mask intersects = (det * det >= tiny) &
+				                        (u >= zero) & (u <= one) &
+				                        (v >= zero) & (u + v <= one) &
+				                        (t >= zero) & (t <= one);
+
+				hit |= intersects.bits() & lanes;
+			}
+
+			if ((hit & all_active) == all_active) {
+				break;
+			}
+		}
+
+		return hit & all_active;
+	}
+}
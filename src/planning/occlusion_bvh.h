@@ -0,0 +1,120 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#ifndef MGODPL_OCCLUSION_BVH_H
+#define MGODPL_OCCLUSION_BVH_H
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "../math/Vec3.h"
+#include "Mesh.h"
+
+namespace mgodpl {
+
+	/**
+	 * @brief A bounding volume hierarchy over the triangles of a mesh, specialized for segment occlusion queries.
+	 *
+	 * The tree is built with a binned surface area heuristic and flattened in depth-first order into 32-byte nodes
+	 * with single-precision bounds (rounded outwards, so that no intersections are missed); the triangles themselves
+	 * are kept in double precision. Queries are any-hit: traversal stops as soon as any triangle is found.
+	 *
+	 * The depth of the tree is capped at MAX_DEPTH (deeper nodes become leaves), so that traversal can use a fixed-size
+	 * stack on the call stack rather than allocating one per query.
+	 *
+	 * Batches of segments are traversed as packets (four at a time with AVX2 enabled, see the MGODPL_AVX2 CMake
+	 * option), which pays off when consecutive segments are coherent, such as segments sharing an endpoint.
+	 */
+	class OcclusionBvh {
+	public:
+		/// The maximum depth of the tree; the root is at depth 0.
+		static constexpr size_t MAX_DEPTH = 48;
+
+		/// A line segment between two points.
+		struct Segment {
+			math::Vec3d start;
+			math::Vec3d end;
+		};
+
+		/**
+		 * @brief Build the hierarchy over the triangles of a mesh. Degenerate triangles are skipped.
+		 *
+		 * @param mesh 		The mesh.
+		 */
+		explicit OcclusionBvh(const Mesh &mesh);
+
+		/**
+		 * @brief Check whether a segment intersects any triangle.
+		 *
+		 * @param segment 	The segment.
+		 * @return 			True if the segment intersects the mesh.
+		 */
+		[[nodiscard]] bool intersects(const Segment &segment) const;
+
+		/**
+		 * @brief Check, for a batch of segments, whether each intersects any triangle.
+		 *
+		 * @param segments 		The segments.
+		 * @param intersects 	Output: one value per segment, true if it intersects the mesh.
+		 */
+		void intersects(const std::vector<Segment> &segments, std::vector<bool> &intersects) const;
+
+		/**
+		 * @brief Find the first intersection along a segment, rather than just any.
+		 *
+		 * @param segment 	The segment.
+		 * @return 			The parameter t in [0, 1] of the intersection closest to the start of the segment (at
+		 * 					start + t * (end - start)), or nullopt if the segment does not intersect the mesh.
+		 */
+		[[nodiscard]] std::optional<double> first_hit(const Segment &segment) const;
+
+		/// The number of (non-degenerate) triangles in the hierarchy.
+		[[nodiscard]] size_t n_triangles() const {
+			return triangles.size();
+		}
+
+		/// The depth of the deepest leaf; at most MAX_DEPTH.
+		[[nodiscard]] size_t depth() const {
+			return max_depth;
+		}
+
+	private:
+		/**
+		 * @brief A node of the flattened tree.
+		 *
+		 * Inner nodes have `count == 0`; their left child directly follows them, their right child is at `first`.
+		 * Leaves hold the triangles [first, first + count).
+		 */
+		struct Node {
+			float min[3];
+			uint32_t first;
+			float max[3];
+			uint32_t count;
+		};
+
+		static_assert(sizeof(Node) == 32);
+
+		/// A triangle, stored as a vertex and the two edges from it, as needed by the Möller-Trumbore test.
+		struct Triangle {
+			math::Vec3d v0;
+			math::Vec3d edge1;
+			math::Vec3d edge2;
+		};
+
+		/// Test up to the SIMD width of segments against the tree, from `segments[0]` on; returns one bit per segment.
+		[[nodiscard]] unsigned intersects_packet(const Segment *segments, size_t n) const;
+
+		/// A traversal stack: depth-first, a node is popped before its two children are pushed, so it never holds more
+		/// than one pending node per level below the root, plus one.
+		using TraversalStack = std::array<uint32_t, MAX_DEPTH + 1>;
+
+		std::vector<Node> nodes;
+		std::vector<Triangle> triangles;
+		size_t max_depth = 0;
+	};
+}
+
+#endif //MGODPL_OCCLUSION_BVH_H
@@ -0,0 +1,293 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include "occlusion_horizon_maps.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include <tbb/parallel_for.h>
+
+#include "occlusion_bvh.h"
+#include "spherical_geometry.h"
+
+namespace mgodpl {
+
+	namespace {
+		/// Identifies the file format; bump the version when it changes.
+		constexpr char MAGIC[8] = {'M', 'G', 'H', 'M', 'A', 'P', '0', '1'};
+
+		/// The largest quantized distance that still means "occluded"; see OcclusionHorizonMaps::UNOCCLUDED.
+		constexpr double MAX_QUANTIZED = 254.0;
+
+		/// 64-bit FNV-1a, fed incrementally.
+		struct Fnv1a {
+			uint64_t hash = 0xcbf29ce484222325ull;
+
+			void add_bytes(const void *data, size_t n) {
+				const auto *bytes = static_cast<const unsigned char *>(data);
+				for (size_t i = 0; i < n; ++i) {
+					hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+				}
+			}
+
+			template<typename T>
+			void add(const T &value) {
+				add_bytes(&value, sizeof(T));
+			}
+		};
+
+		template<typename T>
+		void write_value(std::ostream &out, const T &value) {
+			out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+		}
+
+		template<typename T>
+		bool read_value(std::istream &in, T &value) {
+			return (bool) in.read(reinterpret_cast<char *>(&value), sizeof(T));
+		}
+	}
+
+	size_t OcclusionHorizonMaps::cell_of(const math::Vec3d &direction) const {
+		const double latitude = spherical_geometry::latitude(direction);
+		const double longitude = spherical_geometry::longitude(direction);
+
+		const auto lat_i = (size_t) std::clamp(std::floor((latitude + M_PI / 2.0) / M_PI * (double) params.latitude_cells),
+		                                       0.0,
+		                                       (double) params.latitude_cells - 1);
+		const auto lon_i = (size_t) std::clamp(std::floor((longitude + M_PI) / (2.0 * M_PI) * (double) params.longitude_cells),
+		                                       0.0,
+		                                       (double) params.longitude_cells - 1);
+
+		return lat_i * params.longitude_cells + lon_i;
+	}
+
+	math::Vec3d OcclusionHorizonMaps::cell_direction(size_t cell) const {
+		const size_t lat_i = cell / params.longitude_cells;
+		const size_t lon_i = cell % params.longitude_cells;
+
+		const double latitude = ((double) lat_i + 0.5) / (double) params.latitude_cells * M_PI - M_PI / 2.0;
+		const double longitude = ((double) lon_i + 0.5) / (double) params.longitude_cells * 2.0 * M_PI - M_PI;
+
+		return {
+				std::cos(latitude) * std::cos(longitude),
+				std::cos(latitude) * std::sin(longitude),
+				std::sin(latitude)
+		};
+	}
+
+	OcclusionHorizonMaps OcclusionHorizonMaps::build(const std::vector<SurfacePointCloud> &point_clouds,
+	                                                 const Mesh &occluding_mesh,
+	                                                 const Parameters &parameters) {
+		OcclusionHorizonMaps maps;
+		maps.params = parameters;
+		maps.inputs_fingerprint = fingerprint(point_clouds, occluding_mesh, parameters);
+
+		maps.cloud_offsets.push_back(0);
+		for (const auto &cloud: point_clouds) {
+			maps.cloud_offsets.push_back(maps.cloud_offsets.back() + cloud.size);
+		}
+
+		const size_t n_cells = maps.cells_per_map();
+		maps.distances.assign(maps.cloud_offsets.back() * n_cells, UNOCCLUDED);
+
+		if (parameters.max_distance <= parameters.margin) {
+			// No segment is long enough to be occluded.
+			return maps;
+		}
+
+		const OcclusionBvh bvh(occluding_mesh);
+
+		std::vector<math::Vec3d> directions;
+		for (size_t cell = 0; cell < n_cells; ++cell) {
+			directions.push_back(maps.cell_direction(cell));
+		}
+
+		// A cell may pass the scan angle test if its center is within the scan angle plus half the cell diagonal.
+		const double cell_radius = 0.5 * std::hypot(M_PI / (double) parameters.latitude_cells,
+		                                            2.0 * M_PI / (double) parameters.longitude_cells);
+		const double min_cos_angle = std::cos(std::min(parameters.max_scan_angle + cell_radius, M_PI));
+
+		const double ray_length = parameters.max_distance - parameters.margin;
+
+		for (size_t cloud_i = 0; cloud_i < point_clouds.size(); ++cloud_i) {
+			const SurfacePointCloud &cloud = point_clouds[cloud_i];
+
+			tbb::parallel_for(size_t(0), cloud.size, [&](size_t point_i) {
+				const SurfacePoint point = cloud.get(point_i);
+				uint8_t *map = maps.distances.data() + (maps.cloud_offsets[cloud_i] + point_i) * n_cells;
+
+				for (size_t cell = 0; cell < n_cells; ++cell) {
+					if (point.normal.dot(directions[cell]) < min_cos_angle) {
+						continue;
+					}
+
+					// The segment from the eye to the point, shortened by the margin, seen from the point's end.
+					const auto hit = bvh.first_hit({
+							point.position + directions[cell] * parameters.margin,
+							point.position + directions[cell] * parameters.max_distance
+					});
+
+					if (hit.has_value()) {
+						// Round down, so that the stored distance never exceeds the actual one.
+						const double distance = parameters.margin + *hit * ray_length;
+						map[cell] = (uint8_t) std::clamp(std::floor(distance / parameters.max_distance * MAX_QUANTIZED),
+						                                 0.0,
+						                                 MAX_QUANTIZED);
+					}
+				}
+			});
+		}
+
+		return maps;
+	}
+
+	bool OcclusionHorizonMaps::checkOcclusion(size_t cloud_i,
+	                                          size_t point_i,
+	                                          const math::Vec3d &point,
+	                                          const math::Vec3d &eye) const {
+		const math::Vec3d delta = eye - point;
+		const size_t map_offset = (cloud_offsets[cloud_i] + point_i) * cells_per_map();
+		const uint8_t quantized = distances[map_offset + cell_of(delta)];
+
+		if (quantized == UNOCCLUDED) {
+			return false;
+		}
+
+		return delta.norm() > (double) quantized / MAX_QUANTIZED * params.max_distance;
+	}
+
+	uint64_t OcclusionHorizonMaps::fingerprint(const std::vector<SurfacePointCloud> &point_clouds,
+	                                           const Mesh &occluding_mesh,
+	                                           const Parameters &parameters) {
+		Fnv1a hash;
+
+		hash.add(parameters.latitude_cells);
+		hash.add(parameters.longitude_cells);
+		hash.add(parameters.max_distance);
+		hash.add(parameters.max_scan_angle);
+		hash.add(parameters.margin);
+
+		hash.add(point_clouds.size());
+		for (const auto &cloud: point_clouds) {
+			hash.add(cloud.size);
+			for (size_t c = 0; c < SurfacePointCloud::N_COMPONENTS; ++c) {
+				hash.add_bytes(cloud.component((SurfacePointCloud::Component) c), cloud.size * sizeof(double));
+			}
+		}
+
+		hash.add(occluding_mesh.vertices.size());
+		for (const auto &vertex: occluding_mesh.vertices) {
+			hash.add(vertex.x());
+			hash.add(vertex.y());
+			hash.add(vertex.z());
+		}
+		hash.add(occluding_mesh.triangles.size());
+		hash.add_bytes(occluding_mesh.triangles.data(), occluding_mesh.triangles.size() * sizeof(std::array<size_t, 3>));
+
+		return hash.hash;
+	}
+
+	bool OcclusionHorizonMaps::save(const std::string &path) const {
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		if (!out) {
+			return false;
+		}
+
+		out.write(MAGIC, sizeof(MAGIC));
+		write_value(out, inputs_fingerprint);
+		write_value(out, (uint64_t) params.latitude_cells);
+		write_value(out, (uint64_t) params.longitude_cells);
+		write_value(out, params.max_distance);
+		write_value(out, params.max_scan_angle);
+		write_value(out, params.margin);
+
+		write_value(out, (uint64_t) cloud_offsets.size());
+		for (size_t offset: cloud_offsets) {
+			write_value(out, (uint64_t) offset);
+		}
+
+		write_value(out, (uint64_t) distances.size());
+		out.write(reinterpret_cast<const char *>(distances.data()), (std::streamsize) distances.size());
+
+		return (bool) out;
+	}
+
+	std::optional<OcclusionHorizonMaps> OcclusionHorizonMaps::load(const std::string &path,
+	                                                               uint64_t expected_fingerprint) {
+		std::ifstream in(path, std::ios::binary);
+		if (!in) {
+			return std::nullopt;
+		}
+
+		char magic[sizeof(MAGIC)];
+		if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+			return std::nullopt;
+		}
+
+		OcclusionHorizonMaps maps;
+		uint64_t latitude_cells, longitude_cells, n_offsets, n_distances;
+
+		if (!read_value(in, maps.inputs_fingerprint) || maps.inputs_fingerprint != expected_fingerprint ||
+		    !read_value(in, latitude_cells) || !read_value(in, longitude_cells) ||
+		    !read_value(in, maps.params.max_distance) || !read_value(in, maps.params.max_scan_angle) ||
+		    !read_value(in, maps.params.margin) || !read_value(in, n_offsets)) {
+			return std::nullopt;
+		}
+		maps.params.latitude_cells = latitude_cells;
+		maps.params.longitude_cells = longitude_cells;
+
+		if (n_offsets == 0) {
+			return std::nullopt;
+		}
+		maps.cloud_offsets.resize(n_offsets);
+		for (auto &offset: maps.cloud_offsets) {
+			uint64_t value;
+			if (!read_value(in, value)) {
+				return std::nullopt;
+			}
+			offset = value;
+		}
+
+		if (!read_value(in, n_distances) || n_distances != maps.cloud_offsets.back() * maps.cells_per_map()) {
+			return std::nullopt;
+		}
+		maps.distances.resize(n_distances);
+		if (!in.read(reinterpret_cast<char *>(maps.distances.data()), (std::streamsize) n_distances)) {
+			return std::nullopt;
+		}
+
+		return maps;
+	}
+
+	OcclusionHorizonMaps OcclusionHorizonMaps::load_or_build(const std::string &cache_directory,
+	                                                         const std::vector<SurfacePointCloud> &point_clouds,
+	                                                         const Mesh &occluding_mesh,
+	                                                         const Parameters &parameters) {
+		const uint64_t key = fingerprint(point_clouds, occluding_mesh, parameters);
+
+		std::stringstream filename;
+		filename << "horizon_maps_" << std::hex << key << ".bin";
+		const std::filesystem::path path = std::filesystem::path(cache_directory) / filename.str();
+
+		if (auto cached = load(path.string(), key)) {
+			return std::move(*cached);
+		}
+
+		OcclusionHorizonMaps maps = build(point_clouds, occluding_mesh, parameters);
+
+		// Failing to write the cache is not fatal; the maps will simply be computed again next time.
+		std::error_code error;
+		std::filesystem::create_directories(cache_directory, error);
+		if (!error) {
+			maps.save(path.string());
+		}
+
+		return maps;
+	}
+}
@@ -0,0 +1,148 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#ifndef MGODPL_OCCLUSION_HORIZON_MAPS_H
+#define MGODPL_OCCLUSION_HORIZON_MAPS_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "../math/Vec3.h"
+#include "Mesh.h"
+#include "surface_point_cloud.h"
+
+namespace mgodpl {
+
+	/**
+	 * @brief Precomputed occlusion for a static set of points: per point, how far one can look in every direction.
+	 *
+	 * Every point gets a latitude/longitude grid over the sphere of directions around it (poles on the Z-axis, as in
+	 * spherical_geometry). Each cell stores the distance, along the ray through the cell center, to the first
+	 * triangle of the occluding mesh, quantized to a byte as a fraction of `max_distance`. A point is then occluded
+	 * from an eye iff the eye is further away than the stored distance in its direction: a table lookup instead of a
+	 * ray cast.
+	 *
+	 * The answer is approximate: all directions within a cell share the ray through its center. Only cells that
+	 * can pass the scan angle test (see `max_scan_angle`) are computed; the others are left unoccluded.
+	 */
+	class OcclusionHorizonMaps {
+	public:
+		/// The parameters that determine the contents of the maps.
+		struct Parameters {
+			/// The number of cells per map on the latitude axis.
+			size_t latitude_cells = 16;
+			/// The number of cells per map on the longitude axis.
+			size_t longitude_cells = 32;
+			/// The distance up to which occluders are recorded; typically the maximum view distance.
+			double max_distance = 1.0;
+			/// The maximum angle between the surface normal and the direction to the eye; cells beyond it are skipped.
+			double max_scan_angle = M_PI;
+			/// The margin, with the same meaning as in MeshOcclusionModel.
+			double margin = 0.0;
+		};
+
+		/**
+		 * @brief Compute the maps for all points in a number of point clouds, in parallel.
+		 *
+		 * @param point_clouds 		The point clouds (typically: one per fruit).
+		 * @param occluding_mesh 	The mesh that may occlude the points.
+		 * @param parameters 		The parameters.
+		 * @return 					The maps.
+		 */
+		static OcclusionHorizonMaps build(const std::vector<SurfacePointCloud> &point_clouds,
+		                                  const Mesh &occluding_mesh,
+		                                  const Parameters &parameters);
+
+		/**
+		 * @brief Load the maps from a cache directory if they were computed for the same inputs before, and otherwise
+		 * compute them and store them there.
+		 *
+		 * Files are named after a fingerprint of the points, the mesh and the parameters; a file whose contents
+		 * don't match is ignored and overwritten.
+		 *
+		 * @param cache_directory 	The directory to keep the cache files in; created if it doesn't exist.
+		 * @param point_clouds 		The point clouds (typically: one per fruit).
+		 * @param occluding_mesh 	The mesh that may occlude the points.
+		 * @param parameters 		The parameters.
+		 * @return 					The maps.
+		 */
+		static OcclusionHorizonMaps load_or_build(const std::string &cache_directory,
+		                                          const std::vector<SurfacePointCloud> &point_clouds,
+		                                          const Mesh &occluding_mesh,
+		                                          const Parameters &parameters);
+
+		/**
+		 * @brief Write the maps to a binary file.
+		 *
+		 * @param path 		The file to write to.
+		 * @return 			True if the file was written successfully.
+		 */
+		bool save(const std::string &path) const;
+
+		/**
+		 * @brief Read maps from a binary file written by save().
+		 *
+		 * @param path 					The file to read from.
+		 * @param expected_fingerprint 	The fingerprint that the maps must have been computed for.
+		 * @return 						The maps, or nullopt if the file is missing, malformed, or has a different fingerprint.
+		 */
+		static std::optional<OcclusionHorizonMaps> load(const std::string &path, uint64_t expected_fingerprint);
+
+		/// A hash of everything the maps are computed from: the points, the mesh and the parameters.
+		static uint64_t fingerprint(const std::vector<SurfacePointCloud> &point_clouds,
+		                            const Mesh &occluding_mesh,
+		                            const Parameters &parameters);
+
+		/**
+		 * @brief Check whether a point is occluded from an eye position.
+		 *
+		 * @param cloud_i 	The index of the point cloud.
+		 * @param point_i 	The index of the point within it.
+		 * @param point 	The position of the point (as passed to build()).
+		 * @param eye 		The eye position.
+		 * @return 			True if the point is occluded.
+		 */
+		[[nodiscard]] bool checkOcclusion(size_t cloud_i,
+		                                  size_t point_i,
+		                                  const math::Vec3d &point,
+		                                  const math::Vec3d &eye) const;
+
+		/// The parameters the maps were computed with.
+		[[nodiscard]] const Parameters &parameters() const {
+			return params;
+		}
+
+		/// The memory used by the maps themselves, in bytes.
+		[[nodiscard]] size_t size_bytes() const {
+			return distances.size();
+		}
+
+	private:
+		/// A quantized distance meaning "nothing within max_distance".
+		static constexpr uint8_t UNOCCLUDED = 255;
+
+		/// The index of the cell containing a direction.
+		[[nodiscard]] size_t cell_of(const math::Vec3d &direction) const;
+
+		/// The unit direction through the center of a cell.
+		[[nodiscard]] math::Vec3d cell_direction(size_t cell) const;
+
+		[[nodiscard]] size_t cells_per_map() const {
+			return params.latitude_cells * params.longitude_cells;
+		}
+
+		Parameters params;
+		uint64_t inputs_fingerprint = 0;
+
+		/// Per point cloud, the index of its first point in the flattened list of points.
+		std::vector<size_t> cloud_offsets;
+
+		/// The quantized first-hit distance per cell, point-major.
+		std::vector<uint8_t> distances;
+	};
+}
+
+#endif //MGODPL_OCCLUSION_HORIZON_MAPS_H
@@ -4,12 +4,20 @@ module;
 //
 // All rights reserved.
 
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <cstddef>
+#include <functional>
+#include <limits>
 #include <vector>
 #include <optional>
 
 #include "RobotState.h"
 #include "RobotPath.h"
+#include "RandomNumberGenerator.h"
+#include "nearest_neighbours/GreedyKCenters.h"
+#include "nearest_neighbours/NearestNeighborsGNAT.h"
 
 export module rrt;
 
@@ -25,28 +33,74 @@ namespace mgodpl {
 	};
 
 	/**
-	 * \brief Finds the nearest node in the tree to the new state.
+	 * \brief An incrementally built spatial index over the states in an RRT, for nearest-neighbour queries.
 	 *
-	 * \param nodes A vector of RRTNode representing the nodes in the tree.
-	 * \param new_state The new state to find the nearest node to.
-	 * \param distance A function that computes the distance between two states.
-	 * \return The index of the nearest node in the tree.
+	 * This is a GNAT over the indices of the nodes; the states themselves stay in the tree's node vector, which may
+	 * grow (and reallocate) freely, as long as every new node is added to the index as well.
+	 *
+	 * Query cost grows roughly logarithmically with the size of the tree, rather than linearly as with a full scan.
 	 */
-	size_t linear_nearest(const std::vector<RRTNode> &nodes, const RobotState &new_state, const DistanceFn &distance) {
-		assert(!nodes.empty());
+	export class RRTNearestNeighbours {
+		/// The index standing for the state being queried, which is not in the tree.
+		static constexpr size_t QUERY_INDEX = std::numeric_limits<size_t>::max();
 
-		size_t nearest_index = 0; // Find the nearest node in the tree to the new state
-		double nearest_distance = distance(new_state, nodes[0].state);
+		const std::vector<RRTNode> &nodes;
+		const DistanceFn &distance;
 
-		for (size_t i = 1; i < nodes.size(); ++i) {
-			double d = distance(new_state, nodes[i].state);
-			if (d < nearest_distance) {
-				nearest_distance = d;
-				nearest_index = i;
-			}
+		/// The state currently being queried.
+		const RobotState *query = nullptr;
+
+		/// Used in pivot selection only; fixed seed, so that the index is deterministic.
+		random_numbers::RandomNumberGenerator rng{42};
+
+		ompl::NearestNeighborsGNAT<size_t> gnat;
+
+		[[nodiscard]] const RobotState &state_of(size_t index) const {
+			return index == QUERY_INDEX ? *query : nodes[index].state;
 		}
-		return nearest_index;
-	}
+
+	public:
+		/**
+		 * \brief Create an empty index over a tree.
+		 *
+		 * \param nodes The nodes of the tree; must outlive the index.
+		 * \param distance The distance function; must outlive the index.
+		 */
+		RRTNearestNeighbours(const std::vector<RRTNode> &nodes, const DistanceFn &distance)
+			: nodes(nodes),
+			  distance(distance),
+			  gnat([this](const std::vector<size_t> &data, size_t k) {
+				  return greedy_k_centers<size_t>(data,
+												  k,
+												  [this](size_t a, size_t b) {
+													  return this->distance(state_of(a), state_of(b));
+												  },
+												  rng,
+												  std::nullopt);
+			  }) {
+			gnat.setDistanceFunction([this](size_t a, size_t b) {
+				return this->distance(state_of(a), state_of(b));
+			});
+		}
+
+		// The functions in the GNAT refer back to this object.
+		RRTNearestNeighbours(const RRTNearestNeighbours &) = delete;
+		RRTNearestNeighbours &operator=(const RRTNearestNeighbours &) = delete;
+
+		/// Add the node at the given index in the tree.
+		void add(size_t index) {
+			gnat.add(index);
+		}
+
+		/// Find the index of the node in the tree nearest to the given state.
+		[[nodiscard]] size_t nearest(const RobotState &state) {
+			assert(gnat.size() > 0);
+			query = &state;
+			const size_t nearest_index = gnat.nearest(QUERY_INDEX);
+			query = nullptr;
+			return nearest_index;
+		}
+	};
 
 	/**
 	 * A callback function that is called after each iteration of the RRT algorithm when the tree is expanded.
@@ -93,6 +147,9 @@ namespace mgodpl {
 				{root, 0}
 		};
 
+		RRTNearestNeighbours nearest_neighbours(nodes, distance);
+		nearest_neighbours.add(0);
+
 		// Main loop of the RRT algorithm
 		for (int iteration = 0; iteration < max_iterations; ++iteration) {
 			// Sample a new random state
@@ -102,7 +159,7 @@ namespace mgodpl {
 				continue;
 			}
 
-			size_t nearest_index = linear_nearest(nodes, new_state, distance);
+			size_t nearest_index = nearest_neighbours.nearest(new_state);
 
 			auto nearest_state = nodes[nearest_index].state;
 
@@ -113,6 +170,7 @@ namespace mgodpl {
 
 			// Add to the tree and parent to the nearest node
 			nodes.push_back({new_state, nearest_index});
+			nearest_neighbours.add(nodes.size() - 1);
 
 			// Callback:
 			if (tree_expanded(nodes)) {
@@ -187,4 +245,103 @@ namespace mgodpl {
 		);
 		return path;
 	}
-}
\ No newline at end of file
+
+	/**
+	 * \brief Performs the bidirectional RRT-Connect algorithm to find a path between two states.
+	 *
+	 * Two trees are grown, one rooted in each state; they take turns being extended towards a random sample, after
+	 * which the other tree tries to connect to the new node. As in `rrt`, every extension goes all the way to the
+	 * sample: there is no step size.
+	 *
+	 * Hooking instructions are as in `rrt`: `tree_expanded` is called with the expanded tree after every expansion
+	 * of either tree (including the connecting one), with the new node last and the root first. Returning true
+	 * stops the algorithm; if the trees were not connected at that point, no path is returned.
+	 *
+	 * \param start The state the path should start at.
+	 * \param goal The state the path should end at.
+	 * \param sample_state A function that samples a random state.
+	 * \param collides A function that checks if a state is in collision.
+	 * \param motion_collides A function that checks if the motion between two states is in collision.
+	 * \param distance A function that computes the distance between two states.
+	 * \param max_iterations The maximum number of iterations (samples) to run the algorithm.
+	 * \param tree_expanded A callback function that is called after each expansion of either tree.
+	 * \return A path from the start to the goal, or nullopt if none was found.
+	 */
+	export std::optional<RobotPath> rrt_connect(const RobotState &start,
+												const RobotState &goal,
+												const std::function<RobotState()> &sample_state,
+												const std::function<bool(const RobotState &)> &collides,
+												const std::function<bool(const RobotState &,
+																		 const RobotState &)> &motion_collides,
+												const DistanceFn &distance,
+												size_t max_iterations,
+												const RRTCallbackFn &tree_expanded = [](const auto &) { return false; }) {
+
+		// Trivial case: the states can be connected directly.
+		if (!motion_collides(start, goal)) {
+			return RobotPath{.states = {start, goal}};
+		}
+
+		// The tree rooted in the start, and the one rooted in the goal.
+		std::array<std::vector<RRTNode>, 2> trees{
+				std::vector<RRTNode>{{start, 0}},
+				std::vector<RRTNode>{{goal, 0}}
+		};
+
+		RRTNearestNeighbours start_nn(trees[0], distance);
+		RRTNearestNeighbours goal_nn(trees[1], distance);
+		start_nn.add(0);
+		goal_nn.add(0);
+		std::array<RRTNearestNeighbours *, 2> nearest_neighbours{&start_nn, &goal_nn};
+
+		for (size_t iteration = 0; iteration < max_iterations; ++iteration) {
+			// Alternate which tree is extended towards the sample, and which one tries to connect.
+			const size_t extended = iteration % 2;
+			const size_t connecting = 1 - extended;
+
+			auto new_state = sample_state();
+
+			if (collides(new_state)) {
+				continue;
+			}
+
+			// Extend: add the sample to the one tree, if it can be reached from its nearest node.
+			const size_t nearest_index = nearest_neighbours[extended]->nearest(new_state);
+
+			if (motion_collides(trees[extended][nearest_index].state, new_state)) {
+				continue;
+			}
+
+			trees[extended].push_back({new_state, nearest_index});
+			nearest_neighbours[extended]->add(trees[extended].size() - 1);
+
+			if (tree_expanded(trees[extended])) {
+				return std::nullopt;
+			}
+
+			// Connect: try to reach the new node from the nearest node in the other tree.
+			const size_t other_nearest_index = nearest_neighbours[connecting]->nearest(new_state);
+
+			if (motion_collides(trees[connecting][other_nearest_index].state, new_state)) {
+				continue;
+			}
+
+			trees[connecting].push_back({new_state, other_nearest_index});
+			nearest_neighbours[connecting]->add(trees[connecting].size() - 1);
+
+			// The trees are connected, so the search stops whatever the callback returns.
+			tree_expanded(trees[connecting]);
+
+			// Both trees now end in the same state: join the path from the start with the one to the goal.
+			RobotPath path = retrace(trees[0]);
+			std::reverse(path.states.begin(), path.states.end());
+
+			const RobotPath to_goal = retrace(trees[1]);
+			path.states.insert(path.states.end(), to_goal.states.begin() + 1, to_goal.states.end());
+
+			return path;
+		}
+
+		return std::nullopt;
+	}
+}
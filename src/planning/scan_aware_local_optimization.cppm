@@ -175,8 +175,10 @@ export namespace mgodpl {
 
 		if (hooks) hooks->end_mapping_states_to_scan_points(scans_point);
 
+		RobotCollisionModel collision_model(robot_model);
+
 		const std::function motion_collides = [&](const RobotState &a, const RobotState &b) {
-			return check_motion_collides(robot_model, tree_collision, a, b);
+			return check_motion_collides(collision_model, tree_collision, a, b);
 		};
 
 		if (hooks) hooks->begin_deleting_unassociated_waypoints();
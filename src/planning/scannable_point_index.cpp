@@ -0,0 +1,123 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include "scannable_point_index.h"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+namespace mgodpl {
+
+	ScannablePointIndex::ScannablePointIndex(const std::vector<SurfacePointCloud> &clouds, double cell_size)
+		: cell_size(cell_size) {
+		assert(cell_size > 0.0);
+
+		// Gather all points, and the key of the cell they belong to.
+		std::vector<PointRef> all_points;
+		std::vector<uint64_t> keys;
+		for (size_t cloud_i = 0; cloud_i < clouds.size(); ++cloud_i) {
+			for (size_t point_i = 0; point_i < clouds[cloud_i].size; ++point_i) {
+				all_points.push_back({cloud_i, point_i});
+				keys.push_back(cell_key(cell_of(clouds[cloud_i].get(point_i).position)));
+			}
+		}
+
+		// Sort them by cell (stable, to keep the order within a cell deterministic).
+		std::vector<size_t> order(all_points.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+			return keys[a] < keys[b];
+		});
+
+		points = SurfacePointCloud(all_points.size());
+		origins.reserve(all_points.size());
+
+		for (size_t i = 0; i < order.size(); ++i) {
+			const PointRef &origin = all_points[order[i]];
+			points.set(i, clouds[origin.cloud_index].get(origin.point_index));
+			origins.push_back(origin);
+
+			// Extend the range of the current cell, or start a new one.
+			auto [it, inserted] = cells.try_emplace(keys[order[i]], i, i + 1);
+			if (!inserted) {
+				it->second.second = i + 1;
+			}
+		}
+	}
+
+	ScannablePointIndex::CellCoordinates ScannablePointIndex::cell_of(const math::Vec3d &point) const {
+		return {
+				(int64_t) std::floor(point.x() / cell_size),
+				(int64_t) std::floor(point.y() / cell_size),
+				(int64_t) std::floor(point.z() / cell_size)
+		};
+	}
+
+	uint64_t ScannablePointIndex::cell_key(const CellCoordinates &cell) {
+		// 21 bits per coordinate, offset to make them non-negative.
+		constexpr int64_t OFFSET = 1 << 20;
+		constexpr uint64_t MASK = (1 << 21) - 1;
+		return (((uint64_t) (cell.x + OFFSET) & MASK) << 42) |
+		       (((uint64_t) (cell.y + OFFSET) & MASK) << 21) |
+		       ((uint64_t) (cell.z + OFFSET) & MASK);
+	}
+
+	void ScannablePointIndex::query(const math::Vec3d &eye_position,
+	                                const math::Vec3d &eye_forward,
+	                                const VisibilityThresholds &thresholds,
+	                                std::vector<size_t> &candidates) const {
+		candidates.clear();
+
+		// A cell is skipped if its bounding sphere lies entirely outside the view cone.
+		const bool check_fov = thresholds.fov_angle < M_PI;
+		const double cell_radius = cell_size * std::sqrt(3.0) / 2.0;
+
+		auto visit_cell = [&](const CellCoordinates &cell, const std::pair<size_t, size_t> &range) {
+			if (check_fov) {
+				const math::Vec3d center = math::Vec3d((double) cell.x + 0.5, (double) cell.y + 0.5, (double) cell.z + 0.5) *
+				                           cell_size;
+				const math::Vec3d delta = center - eye_position;
+				const double distance = delta.norm();
+				if (distance > cell_radius) {
+					const double angle = std::acos(std::clamp(eye_forward.dot(delta) / distance, -1.0, 1.0));
+					if (angle - std::asin(cell_radius / distance) > thresholds.fov_angle) {
+						return;
+					}
+				}
+			}
+
+			visibility_candidates(points, range.first, range.second, eye_position, eye_forward, thresholds, candidates);
+		};
+
+		const math::Vec3d reach(thresholds.max_distance, thresholds.max_distance, thresholds.max_distance);
+		const math::Vec3d lower_corner = (eye_position - reach) / cell_size;
+		const math::Vec3d upper_corner = (eye_position + reach) / cell_size;
+
+		const double n_cells_in_range = (std::floor(upper_corner.x()) - std::floor(lower_corner.x()) + 1) *
+		                                (std::floor(upper_corner.y()) - std::floor(lower_corner.y()) + 1) *
+		                                (std::floor(upper_corner.z()) - std::floor(lower_corner.z()) + 1);
+
+		if (!(n_cells_in_range <= (double) cells.size())) {
+			// The sensor range covers more cells than there are non-empty ones (or is infinite); just visit them all.
+			for (const auto &[key, range]: cells) {
+				visit_cell(cell_of(points.get(range.first).position), range);
+			}
+		} else {
+			const CellCoordinates lower = cell_of(eye_position - reach);
+			const CellCoordinates upper = cell_of(eye_position + reach);
+
+			for (int64_t x = lower.x; x <= upper.x; ++x) {
+				for (int64_t y = lower.y; y <= upper.y; ++y) {
+					for (int64_t z = lower.z; z <= upper.z; ++z) {
+						auto it = cells.find(cell_key({x, y, z}));
+						if (it != cells.end()) {
+							visit_cell({x, y, z}, it->second);
+						}
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,100 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#ifndef MGODPL_SCANNABLE_POINT_INDEX_H
+#define MGODPL_SCANNABLE_POINT_INDEX_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "surface_point_cloud.h"
+
+namespace mgodpl {
+
+	/**
+	 * @brief A static spatial index over the scannable points of a whole scene, for per-frame visibility queries.
+	 *
+	 * The points of all clouds are bucketed into a uniform grid and stored cell by cell in a single SurfacePointCloud,
+	 * so that every cell is a contiguous range. A query only visits the cells that intersect the sensor's range and
+	 * view cone, and runs the vectorized visibility test (see visibility_candidates) on the points in those cells;
+	 * the cost thus scales with the number of points near the eye rather than the number of points in the scene.
+	 *
+	 * The cell size is best set to the maximum view distance, in which case a query visits at most 27 cells.
+	 * The index is read-only once built, so concurrent queries are safe.
+	 */
+	class ScannablePointIndex {
+	public:
+		/// A reference to a point: the index of its cloud, and the index of the point within that cloud.
+		struct PointRef {
+			size_t cloud_index;
+			size_t point_index;
+		};
+
+		/**
+		 * @brief Build the index.
+		 *
+		 * @param clouds 		The point clouds (typically, one per fruit).
+		 * @param cell_size 	The edge length of the grid cells.
+		 */
+		ScannablePointIndex(const std::vector<SurfacePointCloud> &clouds, double cell_size);
+
+		/**
+		 * @brief Find the points that pass the distance, surface-angle and field-of-view tests from a given eye pose.
+		 *
+		 * Occlusion is not checked.
+		 *
+		 * @param eye_position 	The position of the eye.
+		 * @param eye_forward 	The (unit) forward vector of the eye; ignored if the field-of-view test is disabled.
+		 * @param thresholds 	The sensor thresholds.
+		 * @param candidates 	Output: the indices (in this index; see origin() and point()) of the points that pass,
+		 * 						grouped by cell. Cleared first; storage is reused.
+		 */
+		void query(const math::Vec3d &eye_position,
+		           const math::Vec3d &eye_forward,
+		           const VisibilityThresholds &thresholds,
+		           std::vector<size_t> &candidates) const;
+
+		/// The cloud and point that the i-th point in the index came from.
+		[[nodiscard]] const PointRef &origin(size_t i) const {
+			return origins[i];
+		}
+
+		/// The i-th point in the index.
+		[[nodiscard]] SurfacePoint point(size_t i) const {
+			return points.get(i);
+		}
+
+		/// The total number of points in the index.
+		[[nodiscard]] size_t size() const {
+			return points.size;
+		}
+
+	private:
+		/// The integer coordinates of a grid cell.
+		struct CellCoordinates {
+			int64_t x, y, z;
+		};
+
+		/// The cell containing a given point.
+		[[nodiscard]] CellCoordinates cell_of(const math::Vec3d &point) const;
+
+		/// Pack cell coordinates into a single key.
+		static uint64_t cell_key(const CellCoordinates &cell);
+
+		/// The edge length of the grid cells.
+		double cell_size;
+
+		/// All points, sorted by cell.
+		SurfacePointCloud points;
+
+		/// For every point in `points`, where it came from.
+		std::vector<PointRef> origins;
+
+		/// For every non-empty cell, the range [first, second) of its points in `points`.
+		std::unordered_map<uint64_t, std::pair<size_t, size_t> > cells;
+	};
+}
+
+#endif //MGODPL_SCANNABLE_POINT_INDEX_H
@@ -5,24 +5,18 @@
 #ifndef MGODPL_SCANNABLE_POINTS_EXPERIMENTS_H
 #define MGODPL_SCANNABLE_POINTS_EXPERIMENTS_H
 
+#include <bit>
+#include <cassert>
 #include <memory>
 #include <vector>
 #include <optional>
+#include <utility>
 #include "../math/Vec3.h"
 #include "../math/AABB.h"
 #include "MeshOcclusionModel.h"
+#include "surface_point_cloud.h"
 
 namespace mgodpl {
-	/**
-	 * @brief A struct representing a point on a surface.
-	 *
-	 * This struct encapsulates the position and normal vector of a point on a surface.
-	 */
-	struct SurfacePoint {
-		math::Vec3d position; ///< The position of the point on the surface.
-		math::Vec3d normal; ///< The normal vector at the point on the surface.
-	};
-
 	/**
 	 * @brief A struct encapsulating scannable points parameters.
 	 *
@@ -37,6 +31,26 @@ namespace mgodpl {
 		///< The occlusion mesh to use for visibility checks.
 		std::vector<SurfacePoint> surface_points;
 		///< The vector of SurfacePoint objects for which scanning is to be performed.
+		SurfacePointCloud point_cloud;
+		///< The same points as `surface_points`, stored structure-of-arrays for the vectorized visibility test.
+
+		/**
+		 * @brief Creates a ScannablePoints object, deriving the point cloud from the surface points.
+		 *
+		 * This is the only way to construct one, so that `point_cloud` can never go out of sync with `surface_points`.
+		 */
+		ScannablePoints(double max_distance,
+		                double min_distance,
+		                double max_angle,
+		                std::optional<std::shared_ptr<MeshOcclusionModel> > occlusion_model,
+		                std::vector<SurfacePoint> surface_points)
+			: max_distance(max_distance),
+			  min_distance(min_distance),
+			  max_angle(max_angle),
+			  occlusion_model(std::move(occlusion_model)),
+			  surface_points(std::move(surface_points)),
+			  point_cloud(SurfacePointCloud::fromPoints(this->surface_points)) {
+		}
 
 		using PointId = size_t; ///< An identifier for a point in ScannablePoints.
 	};
@@ -62,56 +76,111 @@ namespace mgodpl {
 	std::vector<math::AABBd> computeAABBsForClusters(const std::vector<ScannablePoints> &clusters);
 
 	/**
-	 * @brief A struct encapsulating the visibility status of points.
+	 * @brief The visibility status of points: for each point in a ScannablePoints object, whether it has ever been seen.
+	 *
+	 * The status is stored as a packed bitset, together with a running count of seen points that is only updated
+	 * when a point flips from unseen to seen; counting is therefore constant-time rather than a pass over all points.
 	 *
-	 * This struct encapsulates a vector of booleans representing the visibility status of points.
-	 * Each boolean value in the vector corresponds to a point in a ScannablePoints object.
-	 * If the value is true, the point has ever been seen. If the value is false, the point has never been seen.
+	 * Optionally, a subset of the points can be classified as "interior" (see set_interior); the number of seen
+	 * interior points is then tracked in the same way.
 	 */
-	struct SeenPoints {
-		std::vector<bool> ever_seen; ///< The vector of booleans representing the visibility status of points.
+	class SeenPoints {
+	public:
+		SeenPoints() = default;
 
 		/**
-		 * @brief Creates a SeenPoints object with all points initially set to unseen.
+		 * @brief Creates a SeenPoints object for the given number of points, all unseen.
 		 *
-		 * This static function creates a SeenPoints object with all points initially set to unseen (false).
-		 * It initializes the ever_seen vector with a size equal to the number of points in the ScannablePoints object.
+		 * @param n_points 	The number of points.
+		 */
+		explicit SeenPoints(size_t n_points) : n_points(n_points), seen((n_points + 63) / 64, 0) {
+		}
+
+		/**
+		 * @brief Creates a SeenPoints object with all points initially set to unseen.
 		 *
 		 * @param scannable_points A ScannablePoints object. Each SurfacePoint object in ScannablePoints
 		 *                         represents a point in 3D space and has a position and a normal.
 		 * @return A SeenPoints object with all points initially set to unseen.
 		 */
 		static SeenPoints create_all_unseen(const ScannablePoints &scannable_points) {
-			SeenPoints seen_points;
-			seen_points.ever_seen.resize(scannable_points.surface_points.size(), false);
-			return seen_points;
+			return SeenPoints(scannable_points.surface_points.size());
 		}
 
 		/**
 		 * @brief Creates a SeenPoints object with all points initially set to unseen.
-		 *
-		 * This static function creates a SeenPoints object with all points initially set to unseen (false).
-		 * It initializes the ever_seen vector with a size equal to the number of points in the ScannablePoints object.
 	 	 *
 	  	 * @param scannable_points A vector of SurfacePoint.
 		 * @return A SeenPoints object with all points initially set to unseen.
 		 */
 		static SeenPoints create_all_unseen(const std::vector<SurfacePoint> &scannable_points) {
-			SeenPoints seen_points;
-			seen_points.ever_seen.resize(scannable_points.size(), false);
-			return seen_points;
+			return SeenPoints(scannable_points.size());
+		}
+
+		/// The number of points.
+		[[nodiscard]] size_t size() const {
+			return n_points;
+		}
+
+		/// Whether the point with the given index has ever been seen.
+		[[nodiscard]] bool is_seen(size_t i) const {
+			return (seen[i / 64] >> (i % 64)) & 1;
 		}
 
 		/**
-		 * @brief Counts the number of points that have been seen.
+		 * @brief Marks a point as seen, updating the counters if it wasn't seen before.
 		 *
-		 * This function counts the number of points that have been seen by checking the `ever_seen` vector.
-		 * Each value in the `ever_seen` vector corresponds to a point in the `ScannablePoints` object.
-		 * If the value is true, the point has ever been seen. If the value is false, the point has never been seen.
+		 * @param i 	The index of the point.
+		 * @return 		True if the point was not seen before.
+		 */
+		bool mark_seen(size_t i) {
+			const uint64_t bit = uint64_t(1) << (i % 64);
+			if (seen[i / 64] & bit) {
+				return false;
+			}
+			seen[i / 64] |= bit;
+			++n_seen;
+			if (!interior.empty() && (interior[i / 64] & bit)) {
+				++n_interior_seen;
+			}
+			return true;
+		}
+
+		/**
+		 * @brief Classify the points as interior or not; this is typically computed once per point, up front.
 		 *
-		 * @return The number of points that have been seen.
+		 * @param interior_points 	A mask over the points (one bit per point, see PointMask); set bits are interior.
 		 */
-		[[nodiscard]] size_t count_seen() const;
+		void set_interior(PointMask interior_points) {
+			assert(interior_points.size() == seen.size());
+			interior = std::move(interior_points);
+			n_interior_seen = 0;
+			for (size_t word_i = 0; word_i < seen.size(); ++word_i) {
+				n_interior_seen += std::popcount(seen[word_i] & interior[word_i]);
+			}
+		}
+
+		/// The number of points that have been seen.
+		[[nodiscard]] size_t count_seen() const {
+			return n_seen;
+		}
+
+		/// The number of interior points (see set_interior) that have been seen.
+		[[nodiscard]] size_t count_interior_seen() const {
+			return n_interior_seen;
+		}
+
+		/// The seen status of all points, one bit per point.
+		[[nodiscard]] const PointMask &bits() const {
+			return seen;
+		}
+
+	private:
+		size_t n_points = 0;
+		size_t n_seen = 0;
+		size_t n_interior_seen = 0;
+		PointMask seen;
+		PointMask interior;
 	};
 }
 
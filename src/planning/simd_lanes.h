@@ -0,0 +1,186 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#ifndef MGODPL_SIMD_LANES_H
+#define MGODPL_SIMD_LANES_H
+
+#include <cmath>
+#include <cstddef>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/**
+ * @file
+ * @brief A minimal SIMD abstraction for the vectorized kernels in the planning library.
+ *
+ * With AVX2 enabled (see the MGODPL_AVX2 CMake option), `Lanes` holds four doubles in an AVX register; otherwise it is
+ * a single double. Since the layout of these types depends on the compiler flags, this header must only be included
+ * from translation units of the planning library, never from public headers.
+ */
+namespace mgodpl::simd {
+
+#ifdef __AVX2__
+	/**
+	 * @brief The result of a lane-wise comparison: all-ones or all-zeros per lane.
+	 */
+	struct Mask {
+		__m256d v;
+
+		Mask operator&(const Mask &o) const {
+			return {_mm256_and_pd(v, o.v)};
+		}
+
+		Mask operator|(const Mask &o) const {
+			return {_mm256_or_pd(v, o.v)};
+		}
+
+		/// One bit per lane, lane 0 in the least significant bit.
+		[[nodiscard]] unsigned bits() const {
+			return (unsigned) _mm256_movemask_pd(v);
+		}
+	};
+
+	/**
+	 * @brief Four doubles in an AVX register.
+	 */
+	struct Lanes {
+		static constexpr size_t WIDTH = 4;
+
+		__m256d v;
+
+		static Lanes load(const double *p) {
+			return {_mm256_loadu_pd(p)};
+		}
+
+		static Lanes broadcast(double x) {
+			return {_mm256_set1_pd(x)};
+		}
+
+		void store(double *p) const {
+			_mm256_storeu_pd(p, v);
+		}
+
+		Lanes operator+(const Lanes &o) const {
+			return {_mm256_add_pd(v, o.v)};
+		}
+
+		Lanes operator-(const Lanes &o) const {
+			return {_mm256_sub_pd(v, o.v)};
+		}
+
+		Lanes operator*(const Lanes &o) const {
+			return {_mm256_mul_pd(v, o.v)};
+		}
+
+		Lanes operator/(const Lanes &o) const {
+			return {_mm256_div_pd(v, o.v)};
+		}
+
+		static Lanes min(const Lanes &a, const Lanes &b) {
+			return {_mm256_min_pd(a.v, b.v)};
+		}
+
+		static Lanes max(const Lanes &a, const Lanes &b) {
+			return {_mm256_max_pd(a.v, b.v)};
+		}
+
+		[[nodiscard]] Lanes sqrt() const {
+			return {_mm256_sqrt_pd(v)};
+		}
+
+		Mask operator<=(const Lanes &o) const {
+			return {_mm256_cmp_pd(v, o.v, _CMP_LE_OQ)};
+		}
+
+		Mask operator>=(const Lanes &o) const {
+			return {_mm256_cmp_pd(v, o.v, _CMP_GE_OQ)};
+		}
+	};
+#else
+	/**
+	 * @brief Scalar fallback: the result of a single comparison.
+	 */
+	struct Mask {
+		bool v;
+
+		Mask operator&(const Mask &o) const {
+			return {v && o.v};
+		}
+
+		Mask operator|(const Mask &o) const {
+			return {v || o.v};
+		}
+
+		[[nodiscard]] unsigned bits() const {
+			return v ? 1u : 0u;
+		}
+	};
+
+	/**
+	 * @brief Scalar fallback: a single double.
+	 */
+	struct Lanes {
+		static constexpr size_t WIDTH = 1;
+
+		double v;
+
+		static Lanes load(const double *p) {
+			return {*p};
+		}
+
+		static Lanes broadcast(double x) {
+			return {x};
+		}
+
+		void store(double *p) const {
+			*p = v;
+		}
+
+		Lanes operator+(const Lanes &o) const {
+			return {v + o.v};
+		}
+
+		Lanes operator-(const Lanes &o) const {
+			return {v - o.v};
+		}
+
+		Lanes operator*(const Lanes &o) const {
+			return {v * o.v};
+		}
+
+		Lanes operator/(const Lanes &o) const {
+			return {v / o.v};
+		}
+
+		static Lanes min(const Lanes &a, const Lanes &b) {
+			return {a.v < b.v ? a.v : b.v};
+		}
+
+		static Lanes max(const Lanes &a, const Lanes &b) {
+			return {a.v > b.v ? a.v : b.v};
+		}
+
+		[[nodiscard]] Lanes sqrt() const {
+			return {std::sqrt(v)};
+		}
+
+		Mask operator<=(const Lanes &o) const {
+			return {v <= o.v};
+		}
+
+		Mask operator>=(const Lanes &o) const {
+			return {v >= o.v};
+		}
+	};
+#endif
+
+	/// Round up to the SIMD width.
+	inline size_t padded_stride(size_t n) {
+		return (n + Lanes::WIDTH - 1) / Lanes::WIDTH * Lanes::WIDTH;
+	}
+}
+
+#endif //MGODPL_SIMD_LANES_H
@@ -8,10 +8,35 @@
 
 #include "geometry.h"
 #include "spherical_geometry.h"
+#include "RandomNumberGenerator.h"
+#include "../math/Quaternion.h"
 #include <algorithm>
+#include <cmath>
 
 namespace mgodpl::spherical_geometry {
 
+	std::vector<math::Vec3d> fibonacci_sphere(size_t n, unsigned int seed) {
+		random_numbers::RandomNumberGenerator rng(seed);
+		const math::Quaterniond rotation = math::Quaterniond::fromAxisAngle(rng.random_unit_vector(),
+																			 rng.uniformReal(0.0, 2.0 * M_PI));
+
+		// The golden angle: successive points are this far apart in longitude.
+		const double golden_angle = M_PI * (3.0 - std::sqrt(5.0));
+
+		std::vector<math::Vec3d> directions;
+		directions.reserve(n);
+		for (size_t i = 0; i < n; ++i) {
+			// Equal-area bands in z, one point per band.
+			const double z = 1.0 - (2.0 * (double) i + 1.0) / (double) n;
+			const double radius = std::sqrt(std::max(0.0, 1.0 - z * z));
+			const double longitude = golden_angle * (double) i;
+
+			directions.push_back(rotation.rotate({radius * std::cos(longitude), radius * std::sin(longitude), z}));
+		}
+
+		return directions;
+	}
+
 //	double latitude(const Edge &edge, double longitude)  {
 //		// Just like intersection_longitude, we can reduce this problem to linear algebra.
 //
@@ -11,6 +11,7 @@
 
 #include <array>
 #include <algorithm>
+#include <vector>
 #include "geometry.h"
 
 //
@@ -192,6 +193,19 @@ namespace mgodpl::spherical_geometry {
 		return difference;
 	}
 
+	/**
+	 * \brief Generate a set of unit vectors spread evenly over the sphere, as a Fibonacci lattice.
+	 *
+	 * Every vector stands for an equal area of the sphere, so the fraction of them that passes some test estimates the
+	 * fraction of all directions that would, with less variance than independent random directions.
+	 * The lattice is turned by a random rotation drawn from the seed; the same (n, seed) always gives the same set.
+	 *
+	 * \param n       The number of vectors.
+	 * \param seed    The seed of the rotation.
+	 * \return        The unit vectors.
+	 */
+	std::vector<math::Vec3d> fibonacci_sphere(size_t n, unsigned int seed = 0);
+
 
 	/**
 	 * \brief  Compute the longitude of the given point, relative to the given starting longitude.
@@ -0,0 +1,164 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include "surface_point_cloud.h"
+
+#include <cassert>
+
+#include "simd_lanes.h"
+
+namespace mgodpl {
+
+	using simd::Lanes;
+	using simd::Mask;
+
+	SurfacePointCloud::SurfacePointCloud(size_t size)
+		: size(size), stride(simd::padded_stride(size)), data(N_COMPONENTS * stride, 0.0) {
+	}
+
+	SurfacePointCloud SurfacePointCloud::fromPoints(const std::vector<SurfacePoint> &points) {
+		SurfacePointCloud cloud(points.size());
+		for (size_t i = 0; i < points.size(); ++i) {
+			cloud.set(i, points[i]);
+		}
+		return cloud;
+	}
+
+	void SurfacePointCloud::set(size_t i, const SurfacePoint &point) {
+		component(PX)[i] = point.position.x();
+		component(PY)[i] = point.position.y();
+		component(PZ)[i] = point.position.z();
+		component(NX)[i] = point.normal.x();
+		component(NY)[i] = point.normal.y();
+		component(NZ)[i] = point.normal.z();
+	}
+
+	/**
+	 * @brief The visibility test kernel, over the points in [begin, end).
+	 *
+	 * For every block of Lanes::WIDTH points starting at a multiple of the width, calls `sink(first_index, bits)` with
+	 * one bit per lane, set iff the point passes the tests; lanes outside of the range are always cleared.
+	 */
+	template<bool CHECK_FOV, typename Sink>
+	static void visibility_candidates_kernel(const SurfacePointCloud &points,
+	                                         size_t begin,
+	                                         size_t end,
+	                                         const math::Vec3d &eye_position,
+	                                         const math::Vec3d &eye_forward,
+	                                         const VisibilityThresholds &thresholds,
+	                                         Sink &&sink) {
+		using C = SurfacePointCloud::Component;
+
+		const double *px = points.component(C::PX);
+		const double *py = points.component(C::PY);
+		const double *pz = points.component(C::PZ);
+		const double *nx = points.component(C::NX);
+		const double *ny = points.component(C::NY);
+		const double *nz = points.component(C::NZ);
+
+		const Lanes eye_x = Lanes::broadcast(eye_position.x());
+		const Lanes eye_y = Lanes::broadcast(eye_position.y());
+		const Lanes eye_z = Lanes::broadcast(eye_position.z());
+		const Lanes forward_x = Lanes::broadcast(eye_forward.x());
+		const Lanes forward_y = Lanes::broadcast(eye_forward.y());
+		const Lanes forward_z = Lanes::broadcast(eye_forward.z());
+
+		// Compare squared distances, so we only need the square root for the angle tests.
+		const Lanes min_distance_sq = Lanes::broadcast(thresholds.min_distance * thresholds.min_distance);
+		const Lanes max_distance_sq = Lanes::broadcast(thresholds.max_distance * thresholds.max_distance);
+
+		// acos(a / d) <= theta  <=>  a >= cos(theta) * d, for theta in [0, pi] and d > 0.
+		const Lanes cos_max_scan_angle = Lanes::broadcast(std::cos(thresholds.max_scan_angle));
+		const Lanes cos_fov_angle = Lanes::broadcast(std::cos(thresholds.fov_angle));
+
+		constexpr unsigned ALL_LANES = (1u << Lanes::WIDTH) - 1;
+
+		// The stride is padded, so the last block never reads out of bounds.
+		for (size_t i = begin / Lanes::WIDTH * Lanes::WIDTH; i < end; i += Lanes::WIDTH) {
+			// The vector from the point to the eye.
+			const Lanes dx = eye_x - Lanes::load(px + i);
+			const Lanes dy = eye_y - Lanes::load(py + i);
+			const Lanes dz = eye_z - Lanes::load(pz + i);
+
+			const Lanes distance_sq = dx * dx + dy * dy + dz * dz;
+			Mask visible = (distance_sq <= max_distance_sq) & (distance_sq >= min_distance_sq);
+
+			const Lanes distance = distance_sq.sqrt();
+
+			const Lanes normal_dot = Lanes::load(nx + i) * dx + Lanes::load(ny + i) * dy + Lanes::load(nz + i) * dz;
+			visible = visible & (normal_dot >= cos_max_scan_angle * distance);
+
+			if constexpr (CHECK_FOV) {
+				// The forward vector against the vector from the eye to the point, hence the swapped operands.
+				const Lanes forward_dot = Lanes::broadcast(0.0) - (forward_x * dx + forward_y * dy + forward_z * dz);
+				visible = visible & (forward_dot >= cos_fov_angle * distance);
+			}
+
+			unsigned bits = visible.bits();
+
+			// Clear the lanes outside of the range (including the padding lanes).
+			if (i < begin) {
+				bits &= ALL_LANES << (begin - i);
+			}
+			if (i + Lanes::WIDTH > end) {
+				bits &= ALL_LANES >> (i + Lanes::WIDTH - end);
+			}
+
+			sink(i, bits);
+		}
+	}
+
+	/**
+	 * @brief Dispatch to the kernel with or without the field-of-view test.
+	 */
+	template<typename Sink>
+	static void visibility_candidates_dispatch(const SurfacePointCloud &points,
+	                                           size_t begin,
+	                                           size_t end,
+	                                           const math::Vec3d &eye_position,
+	                                           const math::Vec3d &eye_forward,
+	                                           const VisibilityThresholds &thresholds,
+	                                           Sink &&sink) {
+		assert(begin <= end && end <= points.size);
+
+		if (thresholds.fov_angle < M_PI) {
+			visibility_candidates_kernel<true>(points, begin, end, eye_position, eye_forward, thresholds, sink);
+		} else {
+			visibility_candidates_kernel<false>(points, begin, end, eye_position, eye_forward, thresholds, sink);
+		}
+	}
+
+	void visibility_candidates(const SurfacePointCloud &points,
+	                           const math::Vec3d &eye_position,
+	                           const math::Vec3d &eye_forward,
+	                           const VisibilityThresholds &thresholds,
+	                           PointMask &candidates) {
+
+		// Since 64 is a multiple of the SIMD width, every block of lanes falls within a single word.
+		static_assert(64 % Lanes::WIDTH == 0);
+
+		candidates.assign((points.size + 63) / 64, 0);
+
+		visibility_candidates_dispatch(points, 0, points.size, eye_position, eye_forward, thresholds,
+		                               [&](size_t i, unsigned bits) {
+			                               candidates[i / 64] |= (uint64_t) bits << (i % 64);
+		                               });
+	}
+
+	void visibility_candidates(const SurfacePointCloud &points,
+	                           size_t begin,
+	                           size_t end,
+	                           const math::Vec3d &eye_position,
+	                           const math::Vec3d &eye_forward,
+	                           const VisibilityThresholds &thresholds,
+	                           std::vector<size_t> &candidates) {
+		visibility_candidates_dispatch(points, begin, end, eye_position, eye_forward, thresholds,
+		                               [&](size_t i, unsigned bits) {
+			                               while (bits != 0) {
+				                               candidates.push_back(i + std::countr_zero(bits));
+				                               bits &= bits - 1;
+			                               }
+		                               });
+	}
+}
@@ -0,0 +1,158 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#ifndef MGODPL_SURFACE_POINT_CLOUD_H
+#define MGODPL_SURFACE_POINT_CLOUD_H
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../math/Vec3.h"
+
+namespace mgodpl {
+	/**
+	 * @brief A struct representing a point on a surface.
+	 *
+	 * This struct encapsulates the position and normal vector of a point on a surface.
+	 */
+	struct SurfacePoint {
+		math::Vec3d position; ///< The position of the point on the surface.
+		math::Vec3d normal; ///< The normal vector at the point on the surface.
+	};
+
+	/**
+	 * @brief A cloud of surface points, stored structure-of-arrays.
+	 *
+	 * The data holds six arrays (position x, y, z and normal x, y, z) of `stride` doubles each, back to back. The stride
+	 * is the size rounded up to the SIMD width, so that kernels never need a scalar tail; padding entries are zero.
+	 */
+	struct SurfacePointCloud {
+
+		/// The index of each component array in the data.
+		enum Component {
+			PX = 0, PY, PZ, NX, NY, NZ, N_COMPONENTS
+		};
+
+		/// The number of points in the cloud.
+		size_t size = 0;
+
+		/// The length of each component array; `size` rounded up to the SIMD width.
+		size_t stride = 0;
+
+		/// The component arrays, back to back.
+		std::vector<double> data;
+
+		/**
+		 * @brief Create a cloud of zero-initialized points.
+		 *
+		 * @param size 		The number of points.
+		 */
+		explicit SurfacePointCloud(size_t size = 0);
+
+		/**
+		 * @brief Transpose a vector of points into a cloud.
+		 *
+		 * @param points 	The points.
+		 * @return 			The cloud.
+		 */
+		static SurfacePointCloud fromPoints(const std::vector<SurfacePoint> &points);
+
+		/// The array of a single component.
+		[[nodiscard]] double *component(Component c) {
+			return data.data() + c * stride;
+		}
+
+		/// The array of a single component.
+		[[nodiscard]] const double *component(Component c) const {
+			return data.data() + c * stride;
+		}
+
+		/// Gather the i-th point.
+		[[nodiscard]] SurfacePoint get(size_t i) const {
+			return {
+					{component(PX)[i], component(PY)[i], component(PZ)[i]},
+					{component(NX)[i], component(NY)[i], component(NZ)[i]}
+			};
+		}
+
+		/// Scatter a point into the i-th position.
+		void set(size_t i, const SurfacePoint &point);
+	};
+
+	/**
+	 * @brief A bitmask over the points of a SurfacePointCloud: bit `i % 64` of word `i / 64` is set iff point `i` is.
+	 */
+	using PointMask = std::vector<uint64_t>;
+
+	/**
+	 * @brief Call a function with the index of every set bit in a PointMask, in increasing order.
+	 */
+	template<typename F>
+	void for_each_set_bit(const PointMask &mask, F &&f) {
+		for (size_t word_i = 0; word_i < mask.size(); ++word_i) {
+			uint64_t word = mask[word_i];
+			while (word != 0) {
+				f(word_i * 64 + std::countr_zero(word));
+				word &= word - 1;
+			}
+		}
+	}
+
+	/**
+	 * @brief The sensor thresholds for the (occlusion-free) visibility test of a surface point.
+	 */
+	struct VisibilityThresholds {
+		/// The minimum distance between the eye and the point.
+		double min_distance;
+		/// The maximum distance between the eye and the point.
+		double max_distance;
+		/// The maximum angle between the surface normal and the direction from the point to the eye.
+		double max_scan_angle;
+		/// The maximum angle between the eye forward vector and the direction from the eye to the point; M_PI (or
+		/// more) disables the field-of-view test entirely.
+		double fov_angle = M_PI;
+	};
+
+	/**
+	 * @brief Evaluate the distance, surface-angle and field-of-view tests for a whole point cloud at once.
+	 *
+	 * This is the same test as performed by the `is_visible` functions minus the occlusion check, vectorized across
+	 * points (see the MGODPL_AVX2 CMake option), and comparing cosines rather than angles so that no `acos` is needed.
+	 * Only the surviving candidates need to go through the (much more expensive) occlusion test.
+	 *
+	 * @param points 		The point cloud.
+	 * @param eye_position 	The position of the eye.
+	 * @param eye_forward 	The (unit) forward vector of the eye; ignored if the field-of-view test is disabled.
+	 * @param thresholds 	The sensor thresholds.
+	 * @param candidates 	Output: one bit per point, set iff the point passes all tests. Storage is reused.
+	 */
+	void visibility_candidates(const SurfacePointCloud &points,
+	                           const math::Vec3d &eye_position,
+	                           const math::Vec3d &eye_forward,
+	                           const VisibilityThresholds &thresholds,
+	                           PointMask &candidates);
+
+	/**
+	 * @brief Same as above, but only for the points with indices in [begin, end).
+	 *
+	 * @param points 		The point cloud.
+	 * @param begin 		The index of the first point to test.
+	 * @param end 			One past the index of the last point to test.
+	 * @param eye_position 	The position of the eye.
+	 * @param eye_forward 	The (unit) forward vector of the eye; ignored if the field-of-view test is disabled.
+	 * @param thresholds 	The sensor thresholds.
+	 * @param candidates 	Output: the indices of the points that pass all tests are appended, in increasing order.
+	 */
+	void visibility_candidates(const SurfacePointCloud &points,
+	                           size_t begin,
+	                           size_t end,
+	                           const math::Vec3d &eye_position,
+	                           const math::Vec3d &eye_forward,
+	                           const VisibilityThresholds &thresholds,
+	                           std::vector<size_t> &candidates);
+}
+
+#endif //MGODPL_SURFACE_POINT_CLOUD_H
@@ -8,6 +8,10 @@
 #include "ortools/constraint_solver/routing_enums.pb.h"
 #include "ortools/constraint_solver/routing_parameters.h"
 
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <optional>
 #include <utility>
 #include <boost/range/irange.hpp>
 
@@ -29,7 +33,7 @@ const double DOUBLE_TO_INTEGER_MULTIPLER = 1000.0;
  */
 void fill_goal_to_goal_matrix(const std::function<double(size_t, size_t)> &between,
                               size_t n,
-                              Int64DistanceMatrix distance_matrix) {
+                              Int64DistanceMatrix &distance_matrix) {
 	// The top-left NxN part of the matrix is filled with goal-to-goal distances,
 	// where distance_matrix[i][j] contains the distance between apples[i] and apples[j].
 	// Distance is assumed symmetric
@@ -51,7 +55,7 @@ void fill_goal_to_goal_matrix(const std::function<double(size_t, size_t)> &betwe
  */
 void fill_start_distance_matrix(const std::function<double(size_t)> &from_start,
                                 size_t n,
-                                Int64DistanceMatrix distance_matrix) {
+                                Int64DistanceMatrix &distance_matrix) {
 	for (size_t i: boost::irange<size_t>(0, n)) {
 		distance_matrix[i][n] = (int64_t) (from_start(i) * DOUBLE_TO_INTEGER_MULTIPLER);
 		distance_matrix[n][i] = distance_matrix[i][n];
@@ -65,7 +69,7 @@ void fill_start_distance_matrix(const std::function<double(size_t)> &from_start,
  * @param distance_matrix	The distance matrix to fill in.
  * @param end_state_index	The index of the end state.
  */
-void fill_dummy_end_distances(size_t n, Int64DistanceMatrix distance_matrix, size_t end_state_index) {
+void fill_dummy_end_distances(size_t n, Int64DistanceMatrix &distance_matrix, size_t end_state_index) {
 	for (size_t i: boost::irange<size_t>(0, n + 2)) {
 		distance_matrix[i][end_state_index] = 0;
 		distance_matrix[end_state_index][i] = 0;
@@ -125,7 +129,7 @@ std::tuple<Int64DistanceMatrix, size_t, size_t> mkOpenEndedDistanceMatrix(
 }
 
 /**
- * Determine an approximately optimal ordering of a given set of items/indices, and distances between them.
+ * Determine an approximately optimal ordering of a given set of items/indices, and distances between them, using OR-tools.
  *
  * This function assumes that all items are to be visited, and that the tour starts from some implicit item,
  * visits all items in the set, and terminates at an arbitrary item in the set.
@@ -138,7 +142,7 @@ std::tuple<Int64DistanceMatrix, size_t, size_t> mkOpenEndedDistanceMatrix(
  * @param n				The number of goals in the set (all indices will be in the range 0..n-1).
  * @return				The tour, represented as a vector of indices.
  */
-std::vector<size_t> tsp_open_end(
+static std::vector<size_t> tsp_open_end_ortools(
 	const std::function<double(size_t)> &from_start,
 	const std::function<double(size_t, size_t)> &between,
 	size_t n) {
@@ -262,10 +266,13 @@ void build_disjunctions(const std::vector<size_t> &sizes, operations_research::R
 	}
 }
 
-std::vector<std::pair<size_t, size_t> >
-tsp_open_end_grouped(const std::function<double(std::pair<size_t, size_t>)> &from_start,
-                     const std::function<double(std::pair<size_t, size_t>, std::pair<size_t, size_t>)> &between,
-                     const std::vector<size_t> &sizes) {
+/**
+ * Solve the discrete neighborhood TSP problem using OR-tools; see tsp_open_end_grouped.
+ */
+static std::vector<std::pair<size_t, size_t> >
+tsp_open_end_grouped_ortools(const std::function<double(std::pair<size_t, size_t>)> &from_start,
+                             const std::function<double(std::pair<size_t, size_t>, std::pair<size_t, size_t>)> &between,
+                             const std::vector<size_t> &sizes) {
 	/*
 	 * In the discrete neighborhood TSP problem, we have a set of N neighborhoods, each with a certain number of items,
 	 * as well as a distance function between items (both within and across neighborhoods).
@@ -340,3 +347,384 @@ tsp_open_end_grouped(const std::function<double(std::pair<size_t, size_t>)> &fro
 	// Return our ordering.
 	return ordering;
 }
+
+/**
+ * A view of an open-ended TSP instance over a dense, row-major distance matrix, with the path cost evaluation
+ * shared by the native local search moves.
+ *
+ * The tour starts at an implicit start item (START) and ends anywhere, which is modelled as an implicit end item (END)
+ * at distance zero from every item.
+ */
+struct OpenTspInstance {
+	static constexpr size_t START = std::numeric_limits<size_t>::max();
+	static constexpr size_t END = std::numeric_limits<size_t>::max() - 1;
+
+	const double *from_start;
+	const double *between;
+	size_t n;
+
+	/// Entries at or above this (including infinity, NaN and DBL_MAX) are unreachable, and are replaced by it;
+	/// it is larger than any tour through reachable entries, yet small enough that tour lengths stay finite.
+	double unreachable;
+
+	/// Improvements smaller than this are ignored; it scales with the distances, since rounding errors do too.
+	double tolerance;
+
+	static OpenTspInstance make(const double *from_start, const double *between, size_t n);
+
+	/// The distance between two items, either of which may be START or END.
+	[[nodiscard]] double distance(size_t a, size_t b) const {
+		if (a == END || b == END) {
+			return 0.0;
+		}
+		if (a == START) {
+			return clamp(from_start[b]);
+		}
+		if (b == START) {
+			return clamp(from_start[a]);
+		}
+		return clamp(between[a * n + b]);
+	}
+
+	/// Replace an unreachable distance by the finite penalty; written such that NaN is replaced too.
+	[[nodiscard]] double clamp(double d) const {
+		return d < unreachable ? d : unreachable;
+	}
+
+	/// The total length of an open tour.
+	[[nodiscard]] double tour_length(const std::vector<size_t> &tour) const {
+		double length = 0.0;
+		size_t previous = START;
+		for (size_t item: tour) {
+			length += distance(previous, item);
+			previous = item;
+		}
+		return length;
+	}
+};
+
+/// Improvements smaller than this fraction of the distances are ignored, so that rounding errors cannot make the local
+/// search cycle.
+static const double LOCAL_SEARCH_EPSILON = 1.0e-9;
+
+OpenTspInstance OpenTspInstance::make(const double *from_start, const double *between, size_t n) {
+	// Leave room for a tour of n + 1 penalized edges, plus the intermediate sums of a move's delta.
+	const double max_unreachable = std::numeric_limits<double>::max() / (4.0 * (double) (n + 2));
+
+	double max_reachable = 0.0;
+	const auto consider = [&](double d) {
+		if (d < max_unreachable) {
+			max_reachable = std::max(max_reachable, d);
+		}
+	};
+	for (size_t i = 0; i < n; ++i) {
+		consider(from_start[i]);
+		for (size_t j = 0; j < n; ++j) {
+			consider(between[i * n + j]);
+		}
+	}
+
+	// Any tour through reachable entries is at most (n + 1) * max_reachable long, so one unreachable edge costs more.
+	const double unreachable = std::min(2.0 * (double) (n + 1) * max_reachable + 1.0, max_unreachable);
+
+	return {from_start, between, n, unreachable, LOCAL_SEARCH_EPSILON * std::max(1.0, unreachable)};
+}
+
+/**
+ * Build a tour through the given items by repeatedly moving to the nearest unvisited one.
+ */
+static std::vector<size_t> nearest_neighbour_tour(const OpenTspInstance &instance, std::vector<size_t> items) {
+	std::vector<size_t> tour;
+	tour.reserve(items.size());
+
+	size_t current = OpenTspInstance::START;
+	while (!items.empty()) {
+		size_t best_i = 0;
+		for (size_t i = 1; i < items.size(); ++i) {
+			if (instance.distance(current, items[i]) < instance.distance(current, items[best_i])) {
+				best_i = i;
+			}
+		}
+		current = items[best_i];
+		tour.push_back(current);
+		// Order of the remaining items does not matter; swap-and-pop.
+		items[best_i] = items.back();
+		items.pop_back();
+	}
+
+	return tour;
+}
+
+/**
+ * Try all 2-opt moves (reversal of a sub-sequence) on an open tour, applying every improving one.
+ *
+ * @return True if the tour was improved.
+ */
+static bool two_opt_pass(const OpenTspInstance &instance, std::vector<size_t> &tour) {
+	const size_t m = tour.size();
+	bool improved = false;
+
+	for (size_t i = 0; i + 1 < m; ++i) {
+		for (size_t j = i + 1; j < m; ++j) {
+			const size_t before = i == 0 ? OpenTspInstance::START : tour[i - 1];
+			const size_t after = j + 1 == m ? OpenTspInstance::END : tour[j + 1];
+
+			const double delta = instance.distance(before, tour[j]) + instance.distance(tour[i], after) -
+			                     instance.distance(before, tour[i]) - instance.distance(tour[j], after);
+
+			if (delta < -instance.tolerance) {
+				std::reverse(tour.begin() + (long) i, tour.begin() + (long) j + 1);
+				improved = true;
+			}
+		}
+	}
+
+	return improved;
+}
+
+/**
+ * Try all Or-opt moves (relocation of a segment of up to three consecutive items) on an open tour,
+ * applying every improving one.
+ *
+ * @return True if the tour was improved.
+ */
+static bool or_opt_pass(const OpenTspInstance &instance, std::vector<size_t> &tour) {
+	const size_t m = tour.size();
+	bool improved = false;
+
+	for (size_t length = 1; length <= 3; ++length) {
+		for (size_t i = 0; i + length <= m; ++i) {
+			const size_t first = tour[i];
+			const size_t last = tour[i + length - 1];
+			const size_t before = i == 0 ? OpenTspInstance::START : tour[i - 1];
+			const size_t after = i + length == m ? OpenTspInstance::END : tour[i + length];
+
+			const double removal_gain = instance.distance(before, first) + instance.distance(last, after) -
+			                            instance.distance(before, after);
+
+			// Try every gap between tour[k - 1] and tour[k], except the two next to the segment itself.
+			for (size_t k = 0; k <= m; ++k) {
+				if (k >= i && k <= i + length) {
+					continue;
+				}
+
+				const size_t a = k == 0 ? OpenTspInstance::START : tour[k - 1];
+				const size_t b = k == m ? OpenTspInstance::END : tour[k];
+
+				const double insertion_cost = instance.distance(a, first) + instance.distance(last, b) -
+				                              instance.distance(a, b);
+
+				if (insertion_cost - removal_gain < -instance.tolerance) {
+					if (k < i) {
+						std::rotate(tour.begin() + (long) k, tour.begin() + (long) i, tour.begin() + (long) (i + length));
+					} else {
+						std::rotate(tour.begin() + (long) i, tour.begin() + (long) (i + length), tour.begin() + (long) k);
+					}
+					improved = true;
+					break;
+				}
+			}
+		}
+	}
+
+	return improved;
+}
+
+/**
+ * Improve an open tour with 2-opt and Or-opt moves until neither finds an improvement.
+ */
+static void local_search(const OpenTspInstance &instance, std::vector<size_t> &tour) {
+	// The passes only accept strict improvements, so this terminates; the cap is a safeguard against pathological inputs.
+	const size_t MAX_PASSES = 1000;
+
+	for (size_t pass = 0; pass < MAX_PASSES; ++pass) {
+		bool improved = two_opt_pass(instance, tour);
+		improved |= or_opt_pass(instance, tour);
+		if (!improved) {
+			break;
+		}
+	}
+}
+
+std::vector<size_t> tsp_open_end_native(const double *from_start, const double *between, size_t n) {
+	const auto instance = OpenTspInstance::make(from_start, between, n);
+
+	std::vector<size_t> items(n);
+	std::iota(items.begin(), items.end(), 0);
+
+	std::vector<size_t> tour = nearest_neighbour_tour(instance, items);
+	local_search(instance, tour);
+
+	return tour;
+}
+
+/**
+ * For a fixed order of groups, pick the item of every group that minimizes the total tour length.
+ *
+ * This is a shortest path through the layered graph of the groups' items, solved exactly by dynamic programming.
+ *
+ * @param instance		The TSP instance.
+ * @param group_order	The groups, in visiting order.
+ * @param group_items	The flat item indices of every group.
+ * @return				The tour, as flat item indices.
+ */
+static std::vector<size_t> select_group_items(const OpenTspInstance &instance,
+                                              const std::vector<size_t> &group_order,
+                                              const std::vector<std::vector<size_t> > &group_items) {
+	const size_t m = group_order.size();
+
+	// For every layer and item in it: the best length to reach it, and the index of the item in the previous layer.
+	std::vector<std::vector<double> > best_length(m);
+	std::vector<std::vector<size_t> > best_previous(m);
+
+	for (size_t layer = 0; layer < m; ++layer) {
+		const auto &items = group_items[group_order[layer]];
+		best_length[layer].assign(items.size(), std::numeric_limits<double>::infinity());
+		best_previous[layer].assign(items.size(), 0);
+
+		for (size_t i = 0; i < items.size(); ++i) {
+			if (layer == 0) {
+				best_length[layer][i] = instance.distance(OpenTspInstance::START, items[i]);
+				continue;
+			}
+
+			const auto &previous_items = group_items[group_order[layer - 1]];
+			for (size_t p = 0; p < previous_items.size(); ++p) {
+				double length = best_length[layer - 1][p] + instance.distance(previous_items[p], items[i]);
+				if (length < best_length[layer][i]) {
+					best_length[layer][i] = length;
+					best_previous[layer][i] = p;
+				}
+			}
+		}
+	}
+
+	// Backtrack from the best item in the last layer.
+	std::vector<size_t> tour(m);
+	if (m == 0) {
+		return tour;
+	}
+
+	size_t choice = std::min_element(best_length[m - 1].begin(), best_length[m - 1].end()) - best_length[m - 1].begin();
+	for (size_t layer = m; layer-- > 0;) {
+		tour[layer] = group_items[group_order[layer]][choice];
+		choice = best_previous[layer][choice];
+	}
+
+	return tour;
+}
+
+std::vector<size_t> tsp_open_end_grouped_native(const double *from_start,
+                                                const double *between,
+                                                const std::vector<size_t> &sizes) {
+	// Build the flat item indices of every group, and the group of every item.
+	std::vector<std::vector<size_t> > group_items(sizes.size());
+	std::vector<size_t> group_of_item;
+	for (size_t group = 0; group < sizes.size(); ++group) {
+		for (size_t j = 0; j < sizes[group]; ++j) {
+			group_items[group].push_back(group_of_item.size());
+			group_of_item.push_back(group);
+		}
+	}
+
+	const auto instance = OpenTspInstance::make(from_start, between, group_of_item.size());
+
+	// Greedy construction: repeatedly move to the nearest item of any unvisited group.
+	std::vector<size_t> tour;
+	std::vector<bool> group_visited(sizes.size(), false);
+	size_t current = OpenTspInstance::START;
+	while (true) {
+		std::optional<size_t> best;
+		for (size_t item = 0; item < group_of_item.size(); ++item) {
+			if (!group_visited[group_of_item[item]] &&
+			    (!best || instance.distance(current, item) < instance.distance(current, *best))) {
+				best = item;
+			}
+		}
+		if (!best) {
+			break;
+		}
+		group_visited[group_of_item[*best]] = true;
+		tour.push_back(*best);
+		current = *best;
+	}
+
+	// Alternate between improving the order (with the chosen items fixed) and the choice of items (with the order
+	// fixed), until neither improves the tour. Every round strictly shortens the tour, so this terminates; the cap
+	// guards against rounds that each gain barely more than the tolerance.
+	const size_t MAX_ROUNDS = 100;
+
+	double length = instance.tour_length(tour);
+	for (size_t round = 0; round < MAX_ROUNDS; ++round) {
+		local_search(instance, tour);
+
+		std::vector<size_t> group_order;
+		group_order.reserve(tour.size());
+		for (size_t item: tour) {
+			group_order.push_back(group_of_item[item]);
+		}
+		tour = select_group_items(instance, group_order, group_items);
+
+		double new_length = instance.tour_length(tour);
+		// The improvement is relative, since a fixed epsilon vanishes in the rounding of long tours.
+		if (!(new_length < length - LOCAL_SEARCH_EPSILON * std::max(1.0, length))) {
+			break;
+		}
+		length = new_length;
+	}
+
+	return tour;
+}
+
+std::vector<size_t> tsp_open_end(
+	const std::function<double(size_t)> &from_start,
+	const std::function<double(size_t, size_t)> &between,
+	size_t n,
+	TspSolver solver) {
+	if (solver == TspSolver::OR_TOOLS) {
+		return tsp_open_end_ortools(from_start, between, n);
+	}
+
+	// Evaluate the callbacks once, into a flat matrix.
+	std::vector<double> start_distances(n);
+	std::vector<double> distance_matrix(n * n);
+	for (size_t i = 0; i < n; ++i) {
+		start_distances[i] = from_start(i);
+		for (size_t j = i; j < n; ++j) {
+			// Distance is assumed symmetric.
+			distance_matrix[i * n + j] = distance_matrix[j * n + i] = between(i, j);
+		}
+	}
+
+	return tsp_open_end_native(start_distances.data(), distance_matrix.data(), n);
+}
+
+std::vector<std::pair<size_t, size_t> >
+tsp_open_end_grouped(const std::function<double(std::pair<size_t, size_t>)> &from_start,
+                     const std::function<double(std::pair<size_t, size_t>, std::pair<size_t, size_t>)> &between,
+                     const std::vector<size_t> &sizes,
+                     TspSolver solver) {
+	if (solver == TspSolver::OR_TOOLS) {
+		return tsp_open_end_grouped_ortools(from_start, between, sizes);
+	}
+
+	auto index_lookup = flatten_indices(sizes);
+	size_t n = index_lookup.size();
+
+	// Evaluate the callbacks once, into a flat matrix.
+	std::vector<double> start_distances(n);
+	std::vector<double> distance_matrix(n * n);
+	for (size_t i = 0; i < n; ++i) {
+		start_distances[i] = from_start(index_lookup[i]);
+		for (size_t j = i; j < n; ++j) {
+			// Distance is assumed symmetric.
+			distance_matrix[i * n + j] = distance_matrix[j * n + i] = between(index_lookup[i], index_lookup[j]);
+		}
+	}
+
+	std::vector<std::pair<size_t, size_t> > ordering;
+	for (size_t item: tsp_open_end_grouped_native(start_distances.data(), distance_matrix.data(), sizes)) {
+		ordering.push_back(index_lookup[item]);
+	}
+	return ordering;
+}
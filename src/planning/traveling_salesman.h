@@ -3,6 +3,18 @@
 #define NEW_PLANNERS_TRAVELING_SALESMAN_H
 
 #include <functional>
+#include <vector>
+
+/**
+ * The solver backing the tsp_open_end functions.
+ */
+enum class TspSolver {
+	/// The in-house solver: nearest-neighbour construction, then 2-opt and Or-opt local search
+	/// (and, for the grouped variant, dynamic-programming re-selection of the item per group).
+	NATIVE,
+	/// Google OR-tools' routing solver.
+	OR_TOOLS
+};
 
 /**
  * Determine an approximately optimal ordering of a given set of items/indices.
@@ -21,7 +33,8 @@
 std::vector<size_t> tsp_open_end(
 	const std::function<double(size_t)> &from_start,
 	const std::function<double(size_t, size_t)> &between,
-	size_t n);
+	size_t n,
+	TspSolver solver = TspSolver::NATIVE);
 
 /**
  * Determine an approximately optimal ordering of a given set of items/indices, where items may be grouped together.
@@ -38,6 +51,38 @@ std::vector<size_t> tsp_open_end(
 std::vector<std::pair<size_t, size_t> >
 tsp_open_end_grouped(const std::function<double(std::pair<size_t, size_t>)> &from_start,
                      const std::function<double(std::pair<size_t, size_t>, std::pair<size_t, size_t>)> &between,
-                     const std::vector<size_t> &sizes);
+                     const std::vector<size_t> &sizes,
+                     TspSolver solver = TspSolver::NATIVE);
+
+/**
+ * Native open-ended TSP over a dense distance matrix, without any callbacks.
+ *
+ * The distances are assumed symmetric. Unreachable pairs may be marked by an infinite (or DBL_MAX) distance; such
+ * edges are only used when unavoidable.
+ *
+ * @param from_start	The distances from the implicit start to every item; n entries.
+ * @param between		The distances between items, row-major: the distance from i to j is at between[i * n + j].
+ * @param n				The number of items.
+ * @return				The tour, represented as a vector of indices.
+ */
+std::vector<size_t> tsp_open_end_native(const double *from_start, const double *between, size_t n);
+
+/**
+ * Native open-ended grouped (generalized) TSP over a dense distance matrix: exactly one item of every non-empty group
+ * is visited.
+ *
+ * Items are identified by flat indices, with the items of group 0 first, then those of group 1, and so on;
+ * this matches the global indices of mgodpl::GroupIndexTable. The distances are assumed symmetric.
+ *
+ * Unreachable pairs may be marked by an infinite (or DBL_MAX) distance; such edges are only used when unavoidable.
+ *
+ * @param from_start	The distances from the implicit start to every item.
+ * @param between		The distances between items, row-major over the flat indices.
+ * @param sizes			A vector of the number of items in each group.
+ * @return				The tour, represented as a vector of flat indices.
+ */
+std::vector<size_t> tsp_open_end_grouped_native(const double *from_start,
+                                                const double *between,
+                                                const std::vector<size_t> &sizes);
 
 #endif //NEW_PLANNERS_TRAVELING_SALESMAN_H
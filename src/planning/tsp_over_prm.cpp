@@ -8,16 +8,33 @@
 
 #include "tsp_over_prm.h"
 
-#include <boost/graph/dijkstra_shortest_paths.hpp>
+#include <cassert>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <boost/range/iterator_range.hpp>
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
 
 #include "collision_detection.h"
+#include "distance.h"
 #include "goal_sampling.h"
 #include "local_optimization.h"
 #include "state_tools.h"
 #include "traveling_salesman.h"
-#include "nearest_neighbours/GreedyKCenters.h"
 
 namespace mgodpl {
+
+	/**
+	 * @brief The function mapping the vertices of a roadmap to their states, for lookups in a PRMGraphSpatialIndex.
+	 */
+	auto prm_states(const PRMGraph &prm) {
+		return [&prm](size_t vertex) -> const RobotState & {
+			return prm[vertex];
+		};
+	}
 	/**
 	 * @brief Add a new node to the PRM, connecting it up to the nearest neighbors.
 	 *
@@ -41,14 +58,17 @@ namespace mgodpl {
 					const RobotState &)> &check_motion_collides,
 			const std::optional<AddRoadmapNodeHooks> &hooks
 	) {
-		std::vector<std::pair<RobotState, PRMGraph::vertex_descriptor> > k_nearest;
-		spatial_index.nearestK({state, 0}, k_neighbors, k_nearest);
+		std::vector<size_t> k_nearest;
+		spatial_index.nearestK(state, k_neighbors, prm_states(prm), k_nearest);
 
 		// Add the new node to the graph. (Note: we do this AFTER finding the neighbors, so we don't connect to ourselves.)
 		auto new_vertex = boost::add_vertex(state, prm);
 
 		// Then add the edges:
-		for (const auto &[neighbor_state, neighbor]: k_nearest) {
+		for (const PRMGraph::vertex_descriptor neighbor: k_nearest) {
+			// Adding edges does not move the vertices, so this reference stays valid.
+			const RobotState &neighbor_state = prm[neighbor];
+
 			// Check if the motion collides.
 			bool collides = check_motion_collides(neighbor_state, state);
 
@@ -65,35 +85,137 @@ namespace mgodpl {
 		return new_vertex;
 	}
 
+	/**
+	 * @brief Scratch space for repeated Dijkstra runs over the same graph; keeping one per thread means
+	 * that the heap and bookkeeping vectors keep their capacity between runs.
+	 */
+	struct DijkstraWorkspace {
+		/// The binary min-heap of (tentative distance, vertex) entries; stale entries are skipped when popped.
+		std::vector<std::pair<double, PRMGraph::vertex_descriptor> > heap;
+		/// Whether the final distance of a vertex is known.
+		std::vector<bool> settled;
+		/// Whether a vertex is one of the targets of an early-stopping search.
+		std::vector<bool> is_target;
+		/// Distances and predecessors, for searches whose full tables are not kept.
+		std::vector<double> distances;
+		std::vector<PRMGraph::vertex_descriptor> predecessors;
+	};
+
 	/**
 	 * @brief Run Dijkstra's algorithm on a graph, starting from a given node.
 	 *
-	 * This function abstracts over Boost, running Dijkstra on a (PRM) graph, returning the distance map and the predecessor map from the given start node.
-	 *
 	 * The distance map contains the distance to each node from the start node.
 	 * The predecessor map contains, for every node, the predecessor node on the shortest path from the start node.
+	 * As in Boost, unreachable nodes have a distance of `std::numeric_limits<double>::max()` and are their own predecessor.
+	 *
+	 * If targets are given, the search stops as soon as all of them are settled; only the entries of the targets
+	 * (and of the vertices on the shortest paths to them) are then final.
 	 *
 	 * @param graph			The graph to run Dijkstra on.
 	 * @param start_node	The node to start from.
-	 * @return				A pair of vectors: the first vector contains the distances to each node, the second vector contains the predecessor node for each node.
+	 * @param targets		If non-null, the vertices after whose settlement the search may stop.
+	 * @param workspace		The scratch space to use.
+	 * @param distances		The output distances, of size num_vertices(graph).
+	 * @param predecessors	The output predecessors, of size num_vertices(graph).
 	 */
-	std::pair<std::vector<double>, std::vector<PRMGraph::vertex_descriptor> > runDijkstra(
+	void runDijkstra(
 			const PRMGraph &graph,
-			PRMGraph::vertex_descriptor start_node
+			PRMGraph::vertex_descriptor start_node,
+			const std::vector<PRMGraph::vertex_descriptor> *targets,
+			DijkstraWorkspace &workspace,
+			double *distances,
+			PRMGraph::vertex_descriptor *predecessors
+	) {
+		const size_t n = boost::num_vertices(graph);
+
+		std::fill(distances, distances + n, std::numeric_limits<double>::max());
+		std::iota(predecessors, predecessors + n, 0);
+		workspace.settled.assign(n, false);
+
+		size_t targets_remaining = 0;
+		if (targets) {
+			workspace.is_target.assign(n, false);
+			for (const auto &target: *targets) {
+				if (!workspace.is_target[target]) {
+					workspace.is_target[target] = true;
+					++targets_remaining;
+				}
+			}
+		}
+
+		// Min-heap ordering; ties are broken on the vertex index, so the result only depends on the graph.
+		const auto heap_order = std::greater<>();
+
+		workspace.heap.clear();
+		workspace.heap.emplace_back(0.0, start_node);
+		distances[start_node] = 0.0;
+
+		const auto weights = boost::get(boost::edge_weight, graph);
+
+		while (!workspace.heap.empty()) {
+			std::pop_heap(workspace.heap.begin(), workspace.heap.end(), heap_order);
+			const auto [distance, vertex] = workspace.heap.back();
+			workspace.heap.pop_back();
+
+			// Skip stale entries.
+			if (workspace.settled[vertex]) {
+				continue;
+			}
+			workspace.settled[vertex] = true;
+
+			// Stop early once every target is settled.
+			if (targets && workspace.is_target[vertex] && --targets_remaining == 0) {
+				break;
+			}
+
+			for (const auto &edge: boost::make_iterator_range(boost::out_edges(vertex, graph))) {
+				const auto neighbor = boost::target(edge, graph);
+				const double new_distance = distance + boost::get(weights, edge);
+
+				if (new_distance < distances[neighbor]) {
+					distances[neighbor] = new_distance;
+					predecessors[neighbor] = vertex;
+					workspace.heap.emplace_back(new_distance, neighbor);
+					std::push_heap(workspace.heap.begin(), workspace.heap.end(), heap_order);
+				}
+			}
+		}
+	}
+
+	/**
+	 * @brief Retrace the vertices of a path through the predecessor map.
+	 *
+	 * @param	predecessor_lookup	The predecessor lookup table. (The start node is implied by the structure of the table.)
+	 * @param   goal_node			The goal node to retrace from.
+	 *
+	 * @return	The vertices from the start node to the goal node, both inclusive. The start node is whichever node in the
+	 * 			path has itself as a predecessor.
+	 */
+	std::vector<PRMGraph::vertex_descriptor> retrace_vertices(
+			const std::vector<PRMGraph::vertex_descriptor> &predecessor_lookup,
+			PRMGraph::vertex_descriptor goal_node
 	) {
-		std::vector<PRMGraph::vertex_descriptor> predecessors(num_vertices(graph));
-		std::vector<double> distances(num_vertices(graph));
-
-		dijkstra_shortest_paths(graph,
-								start_node,
-								predecessor_map(
-										make_iterator_property_map(predecessors.begin(),
-																   get(boost::vertex_index, graph)))
-										.distance_map(
-												make_iterator_property_map(distances.begin(),
-																		   get(boost::vertex_index, graph))));
-
-		return {distances, predecessors};
+		std::vector<PRMGraph::vertex_descriptor> vertices{goal_node};
+
+		while (predecessor_lookup[vertices.back()] != vertices.back()) {
+			vertices.push_back(predecessor_lookup[vertices.back()]);
+		}
+
+		// Reverse the path.
+		std::reverse(vertices.begin(), vertices.end());
+
+		return vertices;
+	}
+
+	/**
+	 * @brief Convert a sequence of vertices into a path, leaving out the first vertex (the one the path starts from).
+	 */
+	RobotPath vertices_to_path(const PRMGraph &graph, const std::vector<PRMGraph::vertex_descriptor> &vertices) {
+		RobotPath path;
+		for (size_t i = 1; i < vertices.size(); ++i) {
+			path.states.push_back(graph[vertices[i]]);
+		}
+		return path;
 	}
 
 	/**
@@ -105,26 +227,88 @@ namespace mgodpl {
 	 * @param	predecessor_lookup	The predecessor lookup table. (The start node is implied by the structure of the table.)
 	 * @param   goal_node			The goal node to retrace from.
 	 *
-	 * @return	The path from the start node to the goal node. The start node is whichever node in the path has itself as a predecessor.
+	 * @return	The path from the start node to the goal node, excluding the start node.
 	 */
 	RobotPath retrace_path(
 			const PRMGraph &graph,
 			const std::vector<PRMGraph::vertex_descriptor> &predecessor_lookup,
 			PRMGraph::vertex_descriptor goal_node
 	) {
-		RobotPath path;
+		return vertices_to_path(graph, retrace_vertices(predecessor_lookup, goal_node));
+	}
 
-		auto current_node = goal_node;
+	/**
+	 * @brief Find a shortest path between two vertices with A*, given its length.
+	 *
+	 * Since the edge weights are `equal_weights_distance` between the vertex states, which is a metric, that same
+	 * distance to the target is a consistent heuristic. Knowing the length of the shortest path (from the
+	 * goal-to-goal distance matrix), any vertex whose lower bound exceeds it is pruned.
+	 *
+	 * @param graph			The graph to search.
+	 * @param start_node	The vertex to start from.
+	 * @param goal_node		The vertex to find a path to.
+	 * @param bound			The length of the shortest path.
+	 * @param workspace		The scratch space to use.
+	 *
+	 * @return	The vertices of the path, in the same form as `retrace_vertices`.
+	 */
+	std::vector<PRMGraph::vertex_descriptor> find_bounded_shortest_path(
+			const PRMGraph &graph,
+			PRMGraph::vertex_descriptor start_node,
+			PRMGraph::vertex_descriptor goal_node,
+			double bound,
+			DijkstraWorkspace &workspace
+	) {
+		const size_t n = boost::num_vertices(graph);
 
-		while (predecessor_lookup[current_node] != current_node) {
-			path.states.push_back(graph[current_node]);
-			current_node = predecessor_lookup[current_node];
-		}
+		workspace.distances.assign(n, std::numeric_limits<double>::max());
+		workspace.predecessors.resize(n);
+		std::iota(workspace.predecessors.begin(), workspace.predecessors.end(), 0);
+		workspace.settled.assign(n, false);
 
-		// Reverse the path.
-		std::reverse(path.states.begin(), path.states.end());
+		// Allow for rounding differences between the summed edge weights and the bound.
+		const double pruning_bound = bound + 1.0e-9 * (1.0 + bound);
 
-		return path;
+		const auto heap_order = std::greater<>();
+		const auto weights = boost::get(boost::edge_weight, graph);
+
+		workspace.heap.clear();
+		workspace.heap.emplace_back(equal_weights_distance(graph[start_node], graph[goal_node]), start_node);
+		workspace.distances[start_node] = 0.0;
+
+		while (!workspace.heap.empty()) {
+			std::pop_heap(workspace.heap.begin(), workspace.heap.end(), heap_order);
+			const auto vertex = workspace.heap.back().second;
+			workspace.heap.pop_back();
+
+			if (workspace.settled[vertex]) {
+				continue;
+			}
+			workspace.settled[vertex] = true;
+
+			if (vertex == goal_node) {
+				break;
+			}
+
+			for (const auto &edge: boost::make_iterator_range(boost::out_edges(vertex, graph))) {
+				const auto neighbor = boost::target(edge, graph);
+				const double new_distance = workspace.distances[vertex] + boost::get(weights, edge);
+
+				if (new_distance < workspace.distances[neighbor]) {
+					const double lower_bound = new_distance + equal_weights_distance(graph[neighbor], graph[goal_node]);
+					if (lower_bound > pruning_bound) {
+						continue;
+					}
+
+					workspace.distances[neighbor] = new_distance;
+					workspace.predecessors[neighbor] = vertex;
+					workspace.heap.emplace_back(lower_bound, neighbor);
+					std::push_heap(workspace.heap.begin(), workspace.heap.end(), heap_order);
+				}
+			}
+		}
+
+		return retrace_vertices(workspace.predecessors, goal_node);
 	}
 
 	/**
@@ -152,33 +336,171 @@ namespace mgodpl {
 	 * @return The visitation order, expressed in terms of global goal sample indices.
 	 */
 	std::vector<size_t> pick_visitation_order(
-			const std::vector<std::vector<double> > &distance_lookup,
-			const std::vector<double> &start_to_goals_distances,
+			const GoalToGoalPathResults &goal_to_goal_paths,
 			const GroupIndexTable *group_index_table,
-			const std::vector<size_t> &group_sizes
+			const std::vector<size_t> &group_sizes,
+			TspSolver solver
 	) {
+		if (solver == TspSolver::NATIVE) {
+			// The global goal sample indices are exactly the flat indices of the native solver,
+			// so the distance matrix can be used as-is.
+			return tsp_open_end_grouped_native(goal_to_goal_paths.start_goal_distances.data(),
+											   goal_to_goal_paths.goal_distance_matrix.data(),
+											   group_sizes);
+		}
+
 		// Plan a TSP over the PRM.
 		auto tour = tsp_open_end_grouped(
 				[&](std::pair<size_t, size_t> a) {
-					return start_to_goals_distances[group_index_table->lookup(a.first, a.second)];
+					return goal_to_goal_paths.start_goal_distances[group_index_table->lookup(a.first, a.second)];
 				},
 				[&](std::pair<size_t, size_t> a, std::pair<size_t, size_t> b) {
-					return distance_lookup[group_index_table->lookup(a.first, a.second)][group_index_table->lookup(
-							b.first,
-							b.second)];
+					return goal_to_goal_paths.goal_to_goal_distance(group_index_table->lookup(a.first, a.second),
+																	group_index_table->lookup(b.first, b.second));
 				},
-				group_sizes
+				group_sizes,
+				solver
 		);
 
 		return convert_tour_to_global(*group_index_table, tour);
 	}
 
 	/**
-	 * @brief Construct the final path based on the TSP solution and predecessor lookup tables.
+	 * @brief Recover the vertices of the roadmap path between two consecutive stops of the tour.
+	 *
+	 * With full tables, the path is retraced through the predecessor table; in compact mode, it is searched for anew
+	 * with a bounded A* search.
+	 *
+	 * @param graph					The graph that the different vertices are in.
+	 * @param goal_to_goal_paths	The results of the goal-to-goal searches.
+	 * @param start_node			The start node.
+	 * @param goal_nodes			The graph vertices corresponding to the goal indices.
+	 * @param from_goal				The goal sample to start from, or nullopt for the start node.
+	 * @param to_goal				The goal sample to go to.
+	 * @param workspace				The scratch space for the search in compact mode.
+	 *
+	 * @return The vertices of the path, including the one it starts from; only the goal vertex if it is unreachable.
+	 */
+	std::vector<PRMGraph::vertex_descriptor> recover_goal_path_vertices(
+			const PRMGraph &graph,
+			const GoalToGoalPathResults &goal_to_goal_paths,
+			PRMGraph::vertex_descriptor start_node,
+			const std::vector<PRMGraph::vertex_descriptor> &goal_nodes,
+			std::optional<size_t> from_goal,
+			size_t to_goal,
+			DijkstraWorkspace &workspace
+	) {
+		const bool full_tables = !goal_to_goal_paths.start_to_goals_predecessors.empty();
+
+		if (full_tables) {
+			return retrace_vertices(from_goal
+									? goal_to_goal_paths.predecessor_lookup[*from_goal]
+									: goal_to_goal_paths.start_to_goals_predecessors,
+									goal_nodes[to_goal]);
+		}
+
+		const double distance = from_goal
+								? goal_to_goal_paths.goal_to_goal_distance(*from_goal, to_goal)
+								: goal_to_goal_paths.start_goal_distances[to_goal];
+
+		// Unreachable; return only the goal, as retrace_vertices would.
+		if (distance == std::numeric_limits<double>::max()) {
+			return {goal_nodes[to_goal]};
+		}
+
+		return find_bounded_shortest_path(graph,
+										  from_goal ? goal_nodes[*from_goal] : start_node,
+										  goal_nodes[to_goal],
+										  distance,
+										  workspace);
+	}
+
+	/**
+	 * @brief Recover the roadmap path between two consecutive stops of the tour; see `recover_goal_path_vertices`.
+	 *
+	 * @return The path, excluding the node it starts from.
+	 */
+	RobotPath recover_goal_path(
+			const PRMGraph &graph,
+			const GoalToGoalPathResults &goal_to_goal_paths,
+			PRMGraph::vertex_descriptor start_node,
+			const std::vector<PRMGraph::vertex_descriptor> &goal_nodes,
+			std::optional<size_t> from_goal,
+			size_t to_goal,
+			DijkstraWorkspace &workspace
+	) {
+		return vertices_to_path(graph,
+								recover_goal_path_vertices(graph,
+														   goal_to_goal_paths,
+														   start_node,
+														   goal_nodes,
+														   from_goal,
+														   to_goal,
+														   workspace));
+	}
+
+	/**
+	 * @brief Lazily validate the roadmap edges along a tour, removing those that turn out to collide.
+	 *
+	 * @param graph					The graph; colliding edges are removed from it.
+	 * @param goal_to_goal_paths	The results of the goal-to-goal searches on the graph.
+	 * @param start_node			The start node.
+	 * @param goal_nodes			The graph vertices corresponding to the goal indices.
+	 * @param tour					The tour, expressed in goal sample indices.
+	 * @param validated_edges		The edges known to be collision-free, as (lower, higher) vertex pairs; updated.
+	 * @param motion_collides		A function that checks if a motion between two states collides.
+	 *
+	 * @return True if all edges along the tour are collision-free, false if any were removed.
+	 */
+	bool validate_tour_edges(
+			PRMGraph &graph,
+			const GoalToGoalPathResults &goal_to_goal_paths,
+			PRMGraph::vertex_descriptor start_node,
+			const std::vector<PRMGraph::vertex_descriptor> &goal_nodes,
+			const std::vector<size_t> &tour,
+			std::set<std::pair<PRMGraph::vertex_descriptor, PRMGraph::vertex_descriptor> > &validated_edges,
+			const std::function<bool(const RobotState &, const RobotState &)> &motion_collides
+	) {
+		DijkstraWorkspace workspace;
+
+		bool all_valid = true;
+
+		for (size_t i = 0; i < tour.size(); ++i) {
+			auto vertices = recover_goal_path_vertices(graph,
+													   goal_to_goal_paths,
+													   start_node,
+													   goal_nodes,
+													   i == 0 ? std::nullopt : std::make_optional(tour[i - 1]),
+													   tour[i],
+													   workspace);
+
+			for (size_t j = 1; j < vertices.size(); ++j) {
+				std::pair<PRMGraph::vertex_descriptor, PRMGraph::vertex_descriptor> edge =
+						std::minmax(vertices[j - 1], vertices[j]);
+
+				if (validated_edges.contains(edge)) {
+					continue;
+				}
+
+				if (motion_collides(graph[edge.first], graph[edge.second])) {
+					// Removing edges does not invalidate vertex descriptors (vecS vertex storage).
+					boost::remove_edge(edge.first, edge.second, graph);
+					all_valid = false;
+				} else {
+					validated_edges.insert(edge);
+				}
+			}
+		}
+
+		return all_valid;
+	}
+
+	/**
+	 * @brief Construct the final path based on the TSP solution and the goal-to-goal search results.
 	 *
 	 * @param graph							The graph that the different vertices are in.
-	 * @param predecessor_lookup			The predecessor lookup tables; one for each goal sample.
-	 * @param start_to_goals_predecessors	The predecessor lookup table for the start-to-goal samples.
+	 * @param goal_to_goal_paths			The results of the goal-to-goal searches.
+	 * @param start_node					The start node.
 	 * @param goal_nodes					The graph vertices corresponding to the goal indices.
 	 * @param tour							The TSP solution, expressed in goal sample indices.
 	 *
@@ -186,19 +508,26 @@ namespace mgodpl {
 	 */
 	RobotPath construct_final_path(
 			const PRMGraph &graph,
-			const std::vector<std::vector<PRMGraph::vertex_descriptor> > &predecessor_lookup,
-			const std::vector<PRMGraph::vertex_descriptor> &start_to_goals_predecessors,
+			const GoalToGoalPathResults &goal_to_goal_paths,
+			PRMGraph::vertex_descriptor start_node,
 			const std::vector<PRMGraph::vertex_descriptor> &goal_nodes,
 			const std::vector<size_t> &tour,
 			const std::function<bool(RobotPath &)> &optimize_segment,
 			const std::optional<TspOverPrmHooks> &hooks = std::nullopt
 	) {
+		// Scratch space for recovering paths in compact mode.
+		DijkstraWorkspace workspace;
+
 		// Allocate a path object.
 		RobotPath path;
 		{
-			auto initial_path = retrace_path(graph,
-											 start_to_goals_predecessors,
-											 goal_nodes[tour[0]]);
+			auto initial_path = recover_goal_path(graph,
+												  goal_to_goal_paths,
+												  start_node,
+												  goal_nodes,
+												  std::nullopt,
+												  tour[0],
+												  workspace);
 
 			if (hooks) hooks->computed_initial_path(initial_path);
 
@@ -211,10 +540,14 @@ namespace mgodpl {
 		}
 
 		for (size_t i = 1; i < tour.size(); ++i) {
-			// Retrace the goal-to-goal path, and append it to the path.
-			// path.append(optimize_segment(retrace_path(graph, predecessor_lookup[tour[i - 1]], goal_nodes[tour[i]])));
-
-			auto goal_to_goal_path = retrace_path(graph, predecessor_lookup[tour[i - 1]], goal_nodes[tour[i]]);
+			// Recover the goal-to-goal path, and append it to the path.
+			auto goal_to_goal_path = recover_goal_path(graph,
+													   goal_to_goal_paths,
+													   start_node,
+													   goal_nodes,
+													   tour[i - 1],
+													   tour[i],
+													   workspace);
 
 			if (hooks) hooks->computed_goal_to_goal_path(goal_to_goal_path);
 
@@ -274,119 +607,22 @@ namespace mgodpl {
 													   hooks ? hooks->add_roadmap_node_hooks : std::nullopt);
 
 		// If it's not a goal sample, add it to the infrastructure nodes.
-		spatial_index.add({state, new_vertex});
+		spatial_index.add(new_vertex, prm_states(prm));
 
 
 		return true;
 	}
 
 	/**
-	 * Take a goal sample and connect it to the roadmap if it doesn't collide.
-	 *
-	 * @param prm						The PRM to add the node to.
-	 * @param spatial_index				The spatial index to use for nearest neighbor queries.
-	 * @param params					The parameters for sampling and connecting goal nodes.
-	 * @param goal_group_id				The index of the goal group.
-	 * @param sample_goal_state			A function that generates a random state from the goal region.
-	 * @param check_state_collides		A function that checks if a state collides with the environment.
-	 * @param check_motion_collides		A function that checks if a motion between two states collides.
-	 * @param hooks						Optional hooks for observing the process.
-	 *
-	 * @return The vertex IDs of the goal samples that were added to the roadmap.
-	 */
-	std::vector<PRMGraph::vertex_descriptor> sample_and_connect_goal_states(
-			PRMGraph &prm,
-			const PRMGraphSpatialIndex &spatial_index,
-			const GoalSampleParams &params,
-			size_t goal_group_id,
-			std::function<RobotState()> &sample_goal_state,
-			const std::function<bool(const RobotState &)> &
-			check_state_collides,
-			const std::function<bool(const RobotState &, const RobotState &)> &
-			check_motion_collides,
-			const std::optional<GoalSampleHooks> &
-			hooks
-	) {
-		// Reserve space for the valid samples.
-		std::vector<PRMGraph::vertex_descriptor> valid_samples;
-		valid_samples.reserve(params.max_valid_samples);
-
-		// Keep iterating until we have enough valid samples or we've tried too many times.
-		for (size_t attempt = 0; attempt < params.max_attempts && valid_samples.size() < params.max_valid_samples; ++
-				attempt) {
-			// Sample a goal state.
-			auto goal_state = sample_goal_state();
-
-			// Check if the robot collides with the tree.
-			bool collides = check_state_collides(goal_state);
-
-			// Call the hooks, if they exist.
-			if (hooks) hooks->on_sample(goal_state, !collides);
-
-			// If it doesn't collide, add it to the roadmap.
-			if (!collides) {
-				// Add the goal state to the roadmap.
-				auto new_vertex = add_and_connect_roadmap_node(goal_state,
-															   prm,
-															   spatial_index,
-															   params.k_neighbors,
-															   std::make_pair(goal_group_id, valid_samples.size()),
-															   check_motion_collides,
-															   hooks ? hooks->add_roadmap_node_hooks : std::nullopt);
-
-				// Add it to the list of valid samples.
-				valid_samples.push_back(new_vertex);
-			}
-		}
-
-		// Return the valid samples.
-		return valid_samples;
-	}
-
-	/// A combination of a RobotState and a PRMGraph vertex descriptor, used as entries into the GNAT spatial index.
-	/// The RobotState should be identical to the one stored in the PRMGraph.
-	/// (TODO: This creates potentially quite some redundancy, as the state is stored at least twice.)
-	using GNATPoint = std::pair<RobotState, PRMGraph::vertex_descriptor>;
-
-	/**
-	 * Initialize an empty GNAT spatial index over the robot states and graph vertex descriptors.
+	 * Initialize an empty GNAT spatial index over the graph vertex descriptors.
 	 *
-	 * @param rng	The random number generator to use for the GNAT index (must outlive the index)
+	 * @param rng	The random number generator to seed the pivot selection of the index with.
 	 * @return	The initialized GNAT index
 	 */
-	ompl::NearestNeighborsGNAT<GNATPoint> init_empty_spatial_index(
+	PRMGraphSpatialIndex init_empty_spatial_index(
 			random_numbers::RandomNumberGenerator &rng
 	) {
-		// The distance function for the GNAT index, which extracts the RobotState from the GNATPoint and measures the distance between them.
-		// TODO: don't hardcode equal_weights_distance here.
-		std::function gnat_dist_fn = [&](const GNATPoint &a, const GNATPoint &b) {
-			return equal_weights_distance(a.first, b.first);
-		};
-
-		// The pivot selection function for the GNAT index, which uses the greedy k-centers algorithm to select pivots.
-		// Note that it takes a reference to the rng, as greedy_k_centers requires a random number generator.
-		// NearestNeighborsGNAT itself is not aware of the RNG.
-		ompl::NearestNeighborsGNAT<GNATPoint>::SelectPivotFn select_pivots = [gnat_dist_fn, &rng](
-				const std::vector<GNATPoint> &data,
-				unsigned int k) {
-			return greedy_k_centers<GNATPoint>(data,
-											   k,
-											   gnat_dist_fn,
-											   rng,
-											   std::nullopt);
-		};
-
-		// Initialize the GNAT index.
-		ompl::NearestNeighborsGNAT gnat(select_pivots);
-
-		// Set the distance function. (TODO: make this a constructor argument)
-		gnat.setDistanceFunction(
-				[](const auto &a, const auto &b) {
-					return equal_weights_distance(a.first, b.first);
-				});
-
-		// Return the initialized GNAT index.
-		return gnat;
+		return PRMGraphSpatialIndex(EqualWeightsDistance{}, {}, rng.uniformInteger(0, std::numeric_limits<int>::max()));
 	}
 
 	/**
@@ -428,17 +664,163 @@ namespace mgodpl {
 		}
 	}
 
+	/**
+	 * Build the infrastructure roadmap in parallel, in batches of samples.
+	 *
+	 * Every batch goes through four phases:
+	 * - Sample the states serially (the random number generator is not thread-safe).
+	 * - In parallel, check the states for collisions, and find the k nearest neighbours of every valid state among a
+	 *   snapshot of the roadmap (the spatial index as it was at the start of the batch) and the valid states that
+	 *   precede it in the same batch.
+	 * - In parallel, validate all candidate edges.
+	 * - Serially and in sample order, commit the vertices and edges to the graph and spatial index, and call the hooks.
+	 *
+	 * Neighbour ties are broken on the vertex index, so the resulting roadmap only depends on the random seed and the
+	 * batch size, not on the number of threads or their scheduling.
+	 *
+	 * @param prm				The PRM to build the infrastructure roadmap on
+	 * @param spatial_index		The spatial index to use for nearest neighbor queries; new nodes are added to this index
+	 * @param max_samples		The number of samples to take
+	 * @param n_neighbours		The number of nearest neighbors to try to connect to
+	 * @param batch_size		The number of samples per batch
+	 * @param sample_uniform	A function to sample a random state; only called from the calling thread
+	 * @param state_collides	A function to check if a state collides with the tree; must be thread-safe
+	 * @param motion_collides	A function to check if a motion between two states collides with the tree; must be thread-safe
+	 * @param hooks				Optional hooks to observe the behavior of the algorithm; only called from the calling thread
+	 */
+	void build_infrastructure_roadmap_parallel(PRMGraph &prm,
+											   PRMGraphSpatialIndex &spatial_index,
+											   size_t max_samples,
+											   size_t n_neighbours,
+											   size_t batch_size,
+											   const std::function<RobotState()> &sample_uniform,
+											   const std::function<bool(const RobotState &)> &state_collides,
+											   const std::function<bool(const RobotState &, const RobotState &)> &
+											   motion_collides,
+											   const std::optional<PrmBuildHooks> &hooks) {
+		assert(batch_size > 0);
+
+		/// A candidate edge from a new sample to a neighbour (either already in the roadmap, or earlier in the batch).
+		struct CandidateEdge {
+			double distance;
+			PRMGraph::vertex_descriptor neighbor;
+			bool collides;
+		};
+
+		for (size_t batch_start = 0; batch_start < max_samples; batch_start += batch_size) {
+			const size_t n_batch = std::min(batch_size, max_samples - batch_start);
+
+			// Sample the states serially, to keep the random number sequence the same regardless of threading.
+			std::vector<RobotState> samples;
+			samples.reserve(n_batch);
+			for (size_t i = 0; i < n_batch; ++i) {
+				samples.push_back(sample_uniform());
+			}
+
+			// Check the states in parallel; using char rather than bool, since std::vector<bool> is not thread-safe.
+			std::vector<char> valid(n_batch);
+			tbb::parallel_for(size_t(0), n_batch, [&](size_t i) {
+				valid[i] = !state_collides(samples[i]);
+			});
+
+			// Assign the vertex descriptors that the valid samples will get on commit.
+			std::vector<PRMGraph::vertex_descriptor> vertex_ids(n_batch);
+			std::vector<size_t> valid_indices;
+			for (size_t i = 0; i < n_batch; ++i) {
+				if (valid[i]) {
+					vertex_ids[i] = boost::num_vertices(prm) + valid_indices.size();
+					valid_indices.push_back(i);
+				}
+			}
+
+			// Find the neighbours and validate the edges in parallel; the roadmap itself is only read.
+			std::vector<std::vector<CandidateEdge> > candidates(n_batch);
+			tbb::parallel_for(size_t(0), valid_indices.size(), [&](size_t valid_i) {
+				const size_t i = valid_indices[valid_i];
+				auto &edges = candidates[i];
+
+				std::vector<size_t> k_nearest;
+				spatial_index.nearestK(samples[i], n_neighbours, prm_states(prm), k_nearest);
+
+				for (const PRMGraph::vertex_descriptor neighbor: k_nearest) {
+					edges.push_back({equal_weights_distance(samples[i], prm[neighbor]), neighbor, false});
+				}
+				for (size_t valid_j = 0; valid_j < valid_i; ++valid_j) {
+					const size_t j = valid_indices[valid_j];
+					edges.push_back({equal_weights_distance(samples[i], samples[j]), vertex_ids[j], false});
+				}
+
+				// Keep the k nearest of both sets.
+				std::sort(edges.begin(), edges.end(), [](const CandidateEdge &a, const CandidateEdge &b) {
+					return std::tie(a.distance, a.neighbor) < std::tie(b.distance, b.neighbor);
+				});
+				if (edges.size() > n_neighbours) {
+					edges.resize(n_neighbours);
+				}
+			});
+
+			// Flatten the candidate edges, so that the (expensive) validation is balanced across threads.
+			std::vector<std::pair<size_t, size_t> > edge_refs;
+			for (size_t i: valid_indices) {
+				for (size_t e = 0; e < candidates[i].size(); ++e) {
+					edge_refs.emplace_back(i, e);
+				}
+			}
+
+			tbb::parallel_for(size_t(0), edge_refs.size(), [&](size_t edge_i) {
+				const auto &[i, e] = edge_refs[edge_i];
+				auto &edge = candidates[i][e];
+				const RobotState &neighbor_state = edge.neighbor < boost::num_vertices(prm)
+												   ? prm[edge.neighbor]
+												   : samples[valid_indices[edge.neighbor - boost::num_vertices(prm)]];
+				edge.collides = motion_collides(neighbor_state, samples[i]);
+			});
+
+			// Commit in sample order.
+			for (size_t i = 0; i < n_batch; ++i) {
+				if (hooks) hooks->on_sample(samples[i], valid[i]);
+
+				if (!valid[i]) {
+					continue;
+				}
+
+				auto new_vertex = boost::add_vertex(samples[i], prm);
+				assert(new_vertex == vertex_ids[i]);
+
+				for (const auto &edge: candidates[i]) {
+					if (hooks && hooks->add_roadmap_node_hooks) {
+						hooks->add_roadmap_node_hooks->on_edge_considered({samples[i], new_vertex},
+																		  {prm[edge.neighbor], edge.neighbor},
+																		  !edge.collides);
+					}
+
+					if (!edge.collides) {
+						boost::add_edge(new_vertex, edge.neighbor, edge.distance, prm);
+					}
+				}
+
+				spatial_index.add(new_vertex, prm_states(prm));
+			}
+		}
+	}
+
 	/**
 	 * Sample goal states for the TSP over PRM algorithm, and connect them to the roadmap.
 	 *
+	 * The goal states of all fruit are sampled in parallel (see sample_goal_states_parallel). Since goal states are
+	 * only connected to the infrastructure roadmap, never to each other, their neighbours and edges are then also
+	 * found and validated in parallel, before everything is committed to the graph in goal order. The hooks are called
+	 * from the calling thread: first on_sample for every candidate, then the edge hooks for every goal state.
+	 *
 	 * @param fruit_positions		The positions of the fruits to sample goal states for.
 	 * @param prm					The PRM to connect the goal states to.
 	 * @param spatial_index			The spatial index to use for nearest neighbor queries. Goal states are not added to this index.
 	 * @param parameters			The parameters for the TSP over PRM algorithm.
-	 * @param sample_goal_state		A function to sample a goal state for a given fruit index. (Does not check for collisions.)
-	 * @param state_collides		A function to check if a state collides with the tree.
-	 * @param motion_collides		A function to check if a motion between two states collides with the tree.
-	 * @param rng					The random number generator to use for sampling.
+	 * @param master_seed			The seed to derive the random number streams of the fruit from.
+	 * @param sample_goal_state		A function to sample a goal state for a given fruit index from a given random number
+	 * 								generator. (Does not check for collisions.) Must be thread-safe.
+	 * @param state_collides		A function to check if a state collides with the tree; must be thread-safe.
+	 * @param motion_collides		A function to check if a motion between two states collides with the tree; must be thread-safe.
 	 * @param hooks					Optional hooks to observe the behavior of the algorithm.
 	 * @return A pair of vectors: the goal nodes in the PRM, and the number of goal samples for each fruit.
 	 */
@@ -447,39 +829,85 @@ namespace mgodpl {
 			PRMGraph &prm,
 			const PRMGraphSpatialIndex &spatial_index,
 			const TspOverPrmParameters &parameters,
-			const std::function<RobotState(size_t)> &sample_goal_state,
+			unsigned int master_seed,
+			const GoalCandidateFn &sample_goal_state,
 			const std::function<bool(const RobotState &)> &state_collides,
 			const std::function<bool(const RobotState &, const RobotState &)> &motion_collides,
 			const std::optional<TspOverPrmHooks> &hooks
 	) {
-		// Store the goal sample vertex nodes, with a separate sub-vector for each goal.
-		// Start with a vector of empty vectors.
-		std::vector<PRMGraph::vertex_descriptor> goal_nodes;
+		const auto &goal_hooks = hooks ? hooks->goal_sample_hooks : std::nullopt;
+		const auto &params = parameters.goal_sample_params;
+
+		std::function<void(size_t, const RobotState &, bool)> on_sample;
+		if (goal_hooks && goal_hooks->on_sample) {
+			on_sample = [&](size_t, const RobotState &state, bool valid) {
+				goal_hooks->on_sample(state, valid);
+			};
+		}
 
-		std::vector<size_t> group_sizes(fruit_positions.size(), 0);
+		// Sample the goal states of all fruit.
+		GoalSampleSet goal_samples = sample_goal_states_parallel(fruit_positions.size(),
+																 params.max_valid_samples,
+																 params.max_attempts,
+																 master_seed,
+																 sample_goal_state,
+																 state_collides,
+																 on_sample);
+
+		/// A candidate edge from a goal state to an infrastructure node.
+		struct CandidateEdge {
+			PRMGraph::vertex_descriptor neighbor;
+			bool collides;
+		};
 
-		// Sample goal nodes.
-		for (size_t goal_index = 0; goal_index < fruit_positions.size(); ++goal_index) {
-			std::function goal_sample = [&]() { return sample_goal_state(goal_index); };
+		// Find the neighbours of all goal states; the roadmap itself is only read.
+		const size_t n_goal_states = goal_samples.states.size();
+		std::vector<std::vector<CandidateEdge> > candidates(n_goal_states);
+		tbb::parallel_for(size_t(0), n_goal_states, [&](size_t goal_i) {
+			std::vector<size_t> k_nearest;
+			spatial_index.nearestK(goal_samples.states[goal_i], params.k_neighbors, prm_states(prm), k_nearest);
+			for (const PRMGraph::vertex_descriptor neighbor: k_nearest) {
+				candidates[goal_i].push_back({neighbor, false});
+			}
+		});
 
-			auto goal_sample_states = sample_and_connect_goal_states(
-					prm,
-					spatial_index,
-					parameters.goal_sample_params,
-					goal_index,
-					goal_sample,
-					state_collides,
-					motion_collides,
-					hooks ? hooks->goal_sample_hooks : std::nullopt);
-
-			// Store the goal nodes.
-			goal_nodes.insert(goal_nodes.end(), goal_sample_states.begin(), goal_sample_states.end());
-
-			// Store the number of goal samples for this fruit.
-			group_sizes[goal_index] = goal_sample_states.size();
+		// Flatten the candidate edges, so that the (expensive) validation is balanced across threads.
+		std::vector<std::pair<size_t, size_t> > edge_refs;
+		for (size_t goal_i = 0; goal_i < n_goal_states; ++goal_i) {
+			for (size_t e = 0; e < candidates[goal_i].size(); ++e) {
+				edge_refs.emplace_back(goal_i, e);
+			}
 		}
 
-		return {goal_nodes, group_sizes};
+		tbb::parallel_for(size_t(0), edge_refs.size(), [&](size_t edge_i) {
+			const auto &[goal_i, e] = edge_refs[edge_i];
+			auto &edge = candidates[goal_i][e];
+			edge.collides = motion_collides(prm[edge.neighbor], goal_samples.states[goal_i]);
+		});
+
+		// Commit in goal order.
+		std::vector<PRMGraph::vertex_descriptor> goal_nodes;
+		goal_nodes.reserve(n_goal_states);
+		for (size_t goal_i = 0; goal_i < n_goal_states; ++goal_i) {
+			const RobotState &state = goal_samples.states[goal_i];
+			auto new_vertex = boost::add_vertex(state, prm);
+
+			for (const auto &edge: candidates[goal_i]) {
+				if (goal_hooks && goal_hooks->add_roadmap_node_hooks) {
+					goal_hooks->add_roadmap_node_hooks->on_edge_considered({state, new_vertex},
+																		   {prm[edge.neighbor], edge.neighbor},
+																		   !edge.collides);
+				}
+
+				if (!edge.collides) {
+					boost::add_edge(new_vertex, edge.neighbor, equal_weights_distance(state, prm[edge.neighbor]), prm);
+				}
+			}
+
+			goal_nodes.push_back(new_vertex);
+		}
+
+		return {goal_nodes, goal_samples.group_sizes};
 	}
 
 	/**
@@ -489,29 +917,79 @@ namespace mgodpl {
 	 * lookup tables for reconstructing the paths. It also runs Dijkstra's algorithm from the start node to
 	 * calculate the distances and predecessor lookup table for paths from the start to each goal node.
 	 *
+	 * The searches are independent, and are spread over the TBB thread pool, each thread reusing its own
+	 * scratch space. Every search writes only to its own tables, so the results do not depend on the scheduling.
+	 *
 	 * @param graph The PRM graph.
+	 * @param start_node The start node in the PRM graph.
 	 * @param goal_nodes The goal nodes in the PRM graph.
 	 * @param group_index_table The group index table for goal nodes.
-	 * @return A GoalToGoalPathResults structure containing the distance and predecessor lookup tables.
+	 * @param stop_when_goals_settled If true, each search stops once all goal nodes are settled; the tables are then
+	 * 								  only final for the goal nodes and the vertices on the shortest paths to them.
+	 * @param storage Whether to keep the full tables, or only the goal-to-goal distance matrix.
+	 * @return A GoalToGoalPathResults structure containing the distance (and predecessor) lookup tables.
 	 */
 	GoalToGoalPathResults calculate_goal_to_goal_paths(
 			const PRMGraph &graph,
+			PRMGraph::vertex_descriptor start_node,
 			const std::vector<PRMGraph::vertex_descriptor> &goal_nodes,
-			const GroupIndexTable &group_index_table
+			const GroupIndexTable &group_index_table,
+			bool stop_when_goals_settled,
+			GoalToGoalStorage storage
 	) {
-		GoalToGoalPathResults results;
-		results.distance_lookup.resize(group_index_table.total());
-		results.predecessor_lookup.resize(group_index_table.total());
+		const size_t n_vertices = boost::num_vertices(graph);
+		const size_t n_goals = group_index_table.total();
+		const bool full = storage == GoalToGoalStorage::FULL;
 
-		// Calculate the distances between all goal samples.
-		for (size_t i = 0; i < group_index_table.total(); ++i) {
-			// Run Dijkstra's algorithm from the goal node.
-			std::tie(results.distance_lookup[i], results.predecessor_lookup[i]) = runDijkstra(graph, goal_nodes[i]);
+		GoalToGoalPathResults results;
+		results.n_goals = n_goals;
+		results.goal_distance_matrix.resize(n_goals * n_goals);
+		results.start_goal_distances.resize(n_goals);
+
+		if (full) {
+			results.distance_lookup.resize(n_goals, std::vector<double>(n_vertices));
+			results.predecessor_lookup.resize(n_goals, std::vector<PRMGraph::vertex_descriptor>(n_vertices));
+			results.start_to_goals_distances.resize(n_vertices);
+			results.start_to_goals_predecessors.resize(n_vertices);
 		}
 
-		// Calculate the distances from the start to all goal samples.
-		// Run Dijkstra's algorithm from the start node.
-		std::tie(results.start_to_goals_distances, results.start_to_goals_predecessors) = runDijkstra(graph, 0);
+		// Only the goal entries are needed in compact mode, so it can always stop early.
+		const auto *targets = stop_when_goals_settled || !full ? &goal_nodes : nullptr;
+
+		tbb::enumerable_thread_specific<DijkstraWorkspace> workspaces;
+
+		// One search per goal sample, plus one (the last index) from the start node.
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, n_goals + 1), [&](const tbb::blocked_range<size_t> &range) {
+			auto &workspace = workspaces.local();
+
+			for (size_t i = range.begin(); i < range.end(); ++i) {
+				const bool from_start = i == n_goals;
+
+				double *distances;
+				PRMGraph::vertex_descriptor *predecessors;
+
+				if (full) {
+					distances = from_start ? results.start_to_goals_distances.data() : results.distance_lookup[i].data();
+					predecessors = from_start
+								   ? results.start_to_goals_predecessors.data()
+								   : results.predecessor_lookup[i].data();
+				} else {
+					// Search into the thread's scratch buffers; only the goal entries are extracted.
+					workspace.distances.resize(n_vertices);
+					workspace.predecessors.resize(n_vertices);
+					distances = workspace.distances.data();
+					predecessors = workspace.predecessors.data();
+				}
+
+				runDijkstra(graph, from_start ? start_node : goal_nodes[i], targets, workspace, distances, predecessors);
+
+				// Extract the row of the goal-to-goal distance matrix.
+				double *row = from_start ? results.start_goal_distances.data() : &results.goal_distance_matrix[i * n_goals];
+				for (size_t j = 0; j < n_goals; ++j) {
+					row[j] = distances[goal_nodes[j]];
+				}
+			}
+		});
 
 		return results;
 	}
@@ -524,6 +1002,7 @@ namespace mgodpl {
 	PRM build_prm(
 			const size_t &max_samples,
 			const size_t &n_neighbours,
+			size_t batch_size,
 			random_numbers::RandomNumberGenerator &rng,
 			std::function<RobotState()> sample_uniform,
 			std::function<bool(const RobotState &)> state_collides,
@@ -535,14 +1014,26 @@ namespace mgodpl {
 		PRMGraphSpatialIndex infrastructure_spatial_index = init_empty_spatial_index(rng);
 
 		// Build the infrastructure roadmap.
-		build_infrastructure_roadmap(prm,
-									 infrastructure_spatial_index,
-									 max_samples,
-									 n_neighbours,
-									 sample_uniform,
-									 state_collides,
-									 motion_collides,
-									 hooks);
+		if (batch_size == 0) {
+			build_infrastructure_roadmap(prm,
+										 infrastructure_spatial_index,
+										 max_samples,
+										 n_neighbours,
+										 sample_uniform,
+										 state_collides,
+										 motion_collides,
+										 hooks);
+		} else {
+			build_infrastructure_roadmap_parallel(prm,
+												  infrastructure_spatial_index,
+												  max_samples,
+												  n_neighbours,
+												  batch_size,
+												  sample_uniform,
+												  state_collides,
+												  motion_collides,
+												  hooks);
+		}
 
 		return {
 				prm,
@@ -570,20 +1061,40 @@ namespace mgodpl {
 			return generateUniformRandomState(robot, rng, 5.0, 10.0);
 		};
 
+		// Precompiled collision models, shared by both collision check functions; one per thread, so that the
+		// check functions are thread-safe.
+		tbb::enumerable_thread_specific<RobotCollisionModel> collision_models([&robot]() {
+			return RobotCollisionModel(robot);
+		});
+
+		// Serializes the on_motion_checked hook, which may be called from the roadmap construction threads.
+		std::mutex motion_hook_mutex;
+
 		// Collision check function:
 		std::function state_collides = [&](const RobotState &state) {
-			return check_robot_collision(robot, tree_collision, state);
+			return check_robot_collision(collision_models.local(), tree_collision, state);
 		};
 
 		// Motion collision check function:
 		std::function motion_collides = [&](const RobotState &a, const RobotState &b) {
-			return check_motion_collides(robot, tree_collision, a, b);
+			auto &collision_model = collision_models.local();
+			size_t queries_before = collision_model.getStateQueries();
+			bool collides = check_motion_collides_in_order(collision_model,
+														   tree_collision,
+														   a,
+														   b,
+														   parameters.motion_validation_order);
+			if (hooks) {
+				std::lock_guard lock(motion_hook_mutex);
+				hooks->on_motion_checked(collides, collision_model.getStateQueries() - queries_before);
+			}
+			return collides;
 		};
 
-		// Goal sampling function for a given goal index:
-		std::function sample_goal_state = [&](size_t goal_index) {
+		// Goal sampling function for a given goal index; called in parallel, each goal with its own generator.
+		GoalCandidateFn sample_goal_state = [&](size_t goal_index, random_numbers::RandomNumberGenerator &goal_rng) {
 			return genGoalStateUniform(
-					rng,
+					goal_rng,
 					fruit_positions[goal_index],
 					robot,
 					base_link,
@@ -613,14 +1124,21 @@ namespace mgodpl {
 
 		if (hooks) hooks->on_start();
 
+		// In lazy mode, roadmap edges are added without checking them; they are validated once they lie on the tour.
+		std::function no_motion_check = [](const RobotState &, const RobotState &) {
+			return false;
+		};
+		const auto &roadmap_motion_collides = parameters.lazy_edge_validation ? no_motion_check : motion_collides;
+
 		// Allocate an empty prm.
 		auto [prm, infrastructure_spatial_index] = build_prm(
 				parameters.max_samples,
 				parameters.n_neighbours,
+				parameters.roadmap_batch_size,
 				rng,
 				sample_uniform,
 				state_collides,
-				motion_collides,
+				roadmap_motion_collides,
 				hooks ? hooks->infrastructure_sample_hooks : std::nullopt
 		);
 
@@ -632,8 +1150,8 @@ namespace mgodpl {
 													   infrastructure_spatial_index,
 													   parameters.n_neighbours,
 													   std::nullopt,
-													   motion_collides,
-													   hooks
+													   roadmap_motion_collides,
+													   hooks && hooks->infrastructure_sample_hooks
 													   ? hooks->infrastructure_sample_hooks->add_roadmap_node_hooks
 													   : std::nullopt);
 
@@ -645,9 +1163,10 @@ namespace mgodpl {
 								   prm,
 								   infrastructure_spatial_index,
 								   parameters,
+								   rng.uniformInteger(0, std::numeric_limits<int>::max()),
 								   sample_goal_state,
 								   state_collides,
-								   motion_collides,
+								   roadmap_motion_collides,
 								   hooks);
 
 		if (hooks) hooks->on_goal_samples_added(goal_nodes);
@@ -655,28 +1174,48 @@ namespace mgodpl {
 		// Create a group index table.
 		GroupIndexTable group_index_table(group_sizes);
 
-		const auto &goal_to_goal_paths = calculate_goal_to_goal_paths(
-				prm,
-				goal_nodes,
-				group_index_table);
+		// The edges validated so far, in lazy mode.
+		std::set<std::pair<PRMGraph::vertex_descriptor, PRMGraph::vertex_descriptor> > validated_edges;
 
-		if (hooks) hooks->on_goal_to_goal_paths_calculated(goal_to_goal_paths);
+		GoalToGoalPathResults goal_to_goal_paths;
+		std::vector<size_t> visitation_order;
 
-		// Plan a visitation order based on the distance lookup tables.
-		auto visitation_order = pick_visitation_order(
-				goal_to_goal_paths.distance_lookup,
-				goal_to_goal_paths.start_to_goals_distances,
-				&group_index_table,
-				group_sizes
-		);
+		// Plan the tour; in lazy mode, re-plan until all edges on it are valid. (This terminates, since every
+		// iteration but the last removes at least one edge.)
+		do {
+			goal_to_goal_paths = calculate_goal_to_goal_paths(
+					prm,
+					start_node,
+					goal_nodes,
+					group_index_table,
+					parameters.stop_dijkstra_when_goals_settled,
+					parameters.goal_to_goal_storage);
+
+			if (hooks) hooks->on_goal_to_goal_paths_calculated(goal_to_goal_paths);
+
+			// Plan a visitation order based on the distance lookup tables.
+			visitation_order = pick_visitation_order(
+					goal_to_goal_paths,
+					&group_index_table,
+					group_sizes,
+					parameters.tsp_solver
+			);
 
-		if (hooks) hooks->on_visitation_order_picked(visitation_order);
+			if (hooks) hooks->on_visitation_order_picked(visitation_order);
+		} while (parameters.lazy_edge_validation &&
+				 !validate_tour_edges(prm,
+									  goal_to_goal_paths,
+									  start_node,
+									  goal_nodes,
+									  visitation_order,
+									  validated_edges,
+									  motion_collides));
 
 		// Construct the final path based on the TSP solution and predecessor lookup tables.
 		auto final_path = construct_final_path(
 				prm,
-				goal_to_goal_paths.predecessor_lookup,
-				goal_to_goal_paths.start_to_goals_predecessors,
+				goal_to_goal_paths,
+				start_node,
 				goal_nodes,
 				visitation_order,
 				optimize_path_segment,
@@ -17,7 +17,10 @@
 #include "RobotModel.h"
 #include "RobotPath.h"
 #include "RobotState.h"
-#include "nearest_neighbours/NearestNeighborsGNAT.h"
+#include "collision_detection.h"
+#include "distance.h"
+#include "traveling_salesman.h"
+#include "nearest_neighbours/IndexedGNAT.h"
 #include "fcl_forward_declarations.h"
 
 namespace mgodpl {
@@ -25,8 +28,8 @@ namespace mgodpl {
 	using PRMGraph = boost::adjacency_list<boost::vecS, boost::vecS, boost::undirectedS, RobotState,
 			boost::property<boost::edge_weight_t, double> >;
 
-	// A spatial index for nearest neighbors in the PRM graph.
-	using PRMGraphSpatialIndex = ompl::NearestNeighborsGNAT<std::pair<RobotState, PRMGraph::vertex_descriptor> >;
+	// A spatial index for nearest neighbors in the PRM graph, over the vertex descriptors; the states stay in the graph.
+	using PRMGraphSpatialIndex = IndexedGNAT<RobotState, EqualWeightsDistance>;
 
 	/**
 	 * A set of hooks for adding a roadmap node.
@@ -51,6 +54,9 @@ namespace mgodpl {
 
 	/**
 	 * A set of hooks for sampling and connecting goal nodes.
+	 *
+	 * The goal states are sampled and connected in parallel; the hooks are called afterwards from the planning thread,
+	 * with on_sample called for the samples of all goals before any edges are reported.
 	 */
 	struct GoalSampleHooks {
 		/// A callback for when a sample is taken, with the state and a boolean indicating whether it was added.
@@ -67,17 +73,45 @@ namespace mgodpl {
 		size_t k_neighbors = 5;
 		/// The maximum number of valid samples to take.
 		size_t max_valid_samples = 2;
-		/// The maximum number of attempts to take a valid sample. (Total; not affected by max_valid_samples.)
+		/// The maximum number of attempts to take a valid sample, per goal. (Sampling stops early once max_valid_samples are found.)
 		size_t max_attempts = 100;
 	};
 
+	/**
+	 * How the results of the goal-to-goal shortest path searches are stored.
+	 */
+	enum class GoalToGoalStorage {
+		/// Keep the full distance and predecessor tables over the whole roadmap, for every goal sample.
+		FULL,
+		/// Keep only the goal-to-goal distance matrix; the paths along the chosen tour are recovered afterwards
+		/// with a bounded A* search. Memory is then quadratic in the number of goal samples, rather than
+		/// proportional to goals × roadmap size.
+		COMPACT
+	};
+
 	struct TspOverPrmParameters {
 		/// The number of nearest neighbors to connect to.
 		size_t n_neighbours = 5;
 		/// The number of samples to take.
 		size_t max_samples = 100;
+		/// If nonzero, the infrastructure roadmap is built in parallel, in batches of this many samples. The result is
+		/// then deterministic for a given seed and batch size, but differs from the sequential (zero) construction.
+		size_t roadmap_batch_size = 0;
 		/// The number of samples to take per goal.
 		GoalSampleParams goal_sample_params;
+		/// The order in which states along roadmap edges are validated.
+		MotionValidationOrder motion_validation_order = MotionValidationOrder::LINEAR;
+		/// Whether each goal-to-goal Dijkstra search stops once all goal nodes are settled, rather than covering the
+		/// whole roadmap. (The lookup tables are then only final for the goal nodes and the paths to them.)
+		bool stop_dijkstra_when_goals_settled = false;
+		/// How to store the goal-to-goal shortest paths. (COMPACT always stops the searches early.)
+		GoalToGoalStorage goal_to_goal_storage = GoalToGoalStorage::FULL;
+		/// Lazy PRM: add roadmap edges without checking them for collisions, and only validate the edges that lie on
+		/// the chosen tour, re-planning around any that collide. The edge hooks then report unchecked edges as added,
+		/// and the goal-to-goal and visitation order hooks are called again on every re-plan.
+		bool lazy_edge_validation = false;
+		/// The solver for the visitation order.
+		TspSolver tsp_solver = TspSolver::NATIVE;
 	};
 
 	/**
@@ -85,6 +119,22 @@ namespace mgodpl {
 	 * necessary to reconstruct the paths between goals and from the start to the goals.
 	 */
 	struct GoalToGoalPathResults {
+		/// The number of goal samples.
+		size_t n_goals = 0;
+
+		/// The distances between goal samples, row-major: the distance from goal sample i to j is at [i * n_goals + j].
+		std::vector<double> goal_distance_matrix;
+		/// The distances from the start node to each goal sample.
+		std::vector<double> start_goal_distances;
+
+		/// The distance from goal sample i to goal sample j.
+		[[nodiscard]] double goal_to_goal_distance(size_t i, size_t j) const {
+			return goal_distance_matrix[i * n_goals + j];
+		}
+
+		// The full tables below, indexed by PRM graph vertex, are only kept with GoalToGoalStorage::FULL,
+		// and are empty otherwise. The outer index of the goal-to-goal tables is the global goal sample index.
+
 		/// Distance lookup tables between goal samples.
 		std::vector<std::vector<double> > distance_lookup; ///< Distance lookup table between goal samples.
 		/// Distance lookup table from the start node to each goal sample.
@@ -108,6 +158,11 @@ namespace mgodpl {
 		std::function<void(const RobotPath &path)> on_shortcut = [](const RobotPath &) {
 		};
 
+		/// Hook that is called after every motion collision check, with whether the motion collides
+		/// and the number of robot states that were evaluated to decide that.
+		std::function<void(bool collides, size_t states_checked)> on_motion_checked = [](bool, size_t) {
+		};
+
 		/// Hook for when the planning process starts; this is about equivalent
 		/// to just calling the function, but the hooks there just in case.
 		std::function<void()> on_start = []() {
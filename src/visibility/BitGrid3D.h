@@ -0,0 +1,346 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#ifndef MGODPL_BITGRID3D_H
+#define MGODPL_BITGRID3D_H
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "../math/grid_utils.h"
+#include "../math/Vec3.h"
+
+namespace mgodpl {
+
+	/**
+	 * @brief A 3D grid of booleans, packed one bit per cell.
+	 *
+	 * The grid is stored as rows of 64-bit words along the Z-axis: the row at (x, y) holds the cells (x, y, 0..nz-1),
+	 * padded to a whole number of words (padding bits are always zero). Rows with the same x are contiguous, forming
+	 * a "slab". This allows whole runs of cells along Z to be set or tested a word at a time, and whole grids or
+	 * slabs to be combined with word-wide OR/AND and counted with popcount; these loops are simple enough for the
+	 * compiler to vectorize.
+	 *
+	 * The interface is a superset of that of Grid3D; Grid3D<bool> is this type. Accesses through operator[] are
+	 * only bounds-checked in debug builds; get() and set() skip even that.
+	 */
+	class BitGrid3D {
+	public:
+		using Word = uint64_t;
+
+		static constexpr size_t WORD_BITS = 64;
+
+		/// A reference to a single cell, as returned by the non-const operator[].
+		class reference {
+			Word *word;
+			Word mask;
+
+		public:
+			reference(Word *word, Word mask) : word(word), mask(mask) {
+			}
+
+			operator bool() const {
+				return (*word & mask) != 0;
+			}
+
+			reference &operator=(bool value) {
+				if (value) {
+					*word |= mask;
+				} else {
+					*word &= ~mask;
+				}
+				return *this;
+			}
+
+			reference &operator=(const reference &other) {
+				return *this = (bool) other;
+			}
+		};
+
+		/**
+		 * Create a new grid, with all cells false.
+		 * @param nx The number of grid cells in the x direction.
+		 * @param ny The number of grid cells in the y direction.
+		 * @param nz The number of grid cells in the z direction.
+		 */
+		BitGrid3D(size_t nx, size_t ny, size_t nz) : BitGrid3D(nx, ny, nz, false) {
+		}
+
+		/**
+		 * Create a new grid, filled with the given value.
+		 */
+		BitGrid3D(size_t nx, size_t ny, size_t nz, bool value)
+			: nx(nx), ny(ny), nz(nz), row_words((nz + WORD_BITS - 1) / WORD_BITS), words(nx * ny * row_words, 0) {
+			if (value) {
+				fill(true);
+			}
+		}
+
+		/**
+		 * Create a new grid, filled with the given value.
+		 */
+		BitGrid3D(const math::Vec3<size_t> &size, bool value) : BitGrid3D(size.x(), size.y(), size.z(), value) {
+		}
+
+		/**
+		 * Get the value at the given grid coordinates.
+		 * @param coord The grid coordinates.
+		 * @return A reference to the value at the given grid coordinates.
+		 */
+		reference operator[](const math::Vec3i &coord) {
+			assert(in_bounds(coord));
+			return {&words[row_offset(coord.x(), coord.y()) + coord.z() / WORD_BITS], bit(coord.z())};
+		}
+
+		/**
+		 * Get the value at the given grid coordinates. (const)
+		 * @param coord The grid coordinates.
+		 * @return The value at the given grid coordinates.
+		 */
+		bool operator[](const math::Vec3i &coord) const {
+			assert(in_bounds(coord));
+			return get(coord.x(), coord.y(), coord.z());
+		}
+
+		/// Get the value of a cell, without bounds checks.
+		[[nodiscard]] bool get(size_t x, size_t y, size_t z) const {
+			return (words[row_offset(x, y) + z / WORD_BITS] & bit(z)) != 0;
+		}
+
+		/// Set a cell to true, without bounds checks.
+		void set(size_t x, size_t y, size_t z) {
+			words[row_offset(x, y) + z / WORD_BITS] |= bit(z);
+		}
+
+		/**
+		 * Get the size of the grid, in number of blocks per dimension.
+		 *
+		 * @return	The size of the grid, in number of blocks per dimension.
+		 */
+		[[nodiscard]] math::Vec3i size() const {
+			return {(int) nx, (int) ny, (int) nz};
+		}
+
+		/**
+		 * Check whether a given grid coordinate is within the grid bounds.
+		 * @param pt	The grid coordinate.
+		 * @return	True/false depending on whether the grid coordinate is within the grid bounds.
+		 */
+		[[nodiscard]] bool in_bounds(const math::Vec3i &pt) const {
+			return pt.x() >= 0 && pt.x() < (int) nx && pt.y() >= 0 && pt.y() < (int) ny && pt.z() >= 0 &&
+				   pt.z() < (int) nz;
+		}
+
+		/// The number of words per row (along Z).
+		[[nodiscard]] size_t words_per_row() const {
+			return row_words;
+		}
+
+		/// The words of the row at (x, y).
+		[[nodiscard]] Word *row(size_t x, size_t y) {
+			return words.data() + row_offset(x, y);
+		}
+
+		/// The words of the row at (x, y).
+		[[nodiscard]] const Word *row(size_t x, size_t y) const {
+			return words.data() + row_offset(x, y);
+		}
+
+		/// The number of words in a slab (all rows with the same x).
+		[[nodiscard]] size_t words_per_slab() const {
+			return ny * row_words;
+		}
+
+		/// All words of the grid, slab by slab.
+		[[nodiscard]] const std::vector<Word> &data() const {
+			return words;
+		}
+
+		/**
+		 * Set the cells (x, y, z_min..z_max) to true, a word at a time. Does nothing if z_min > z_max.
+		 */
+		void set_range(size_t x, size_t y, size_t z_min, size_t z_max) {
+			if (z_min > z_max) {
+				return;
+			}
+			assert(z_max < nz);
+			Word *r = row(x, y);
+			for_each_range_word(z_min, z_max, [&](size_t word_i, Word mask) {
+				r[word_i] |= mask;
+			});
+		}
+
+		/**
+		 * Check whether the cells (x, y, z_min..z_max) are all true, a word at a time. True if z_min > z_max.
+		 */
+		[[nodiscard]] bool all_in_range(size_t x, size_t y, size_t z_min, size_t z_max) const {
+			if (z_min > z_max) {
+				return true;
+			}
+			assert(z_max < nz);
+			const Word *r = row(x, y);
+			bool all = true;
+			for_each_range_word(z_min, z_max, [&](size_t word_i, Word mask) {
+				all &= (r[word_i] & mask) == mask;
+			});
+			return all;
+		}
+
+		/// Set all cells to the given value.
+		void fill(bool value) {
+			if (!value) {
+				std::fill(words.begin(), words.end(), 0);
+				return;
+			}
+			for (size_t x = 0; x < nx; ++x) {
+				for (size_t y = 0; y < ny; ++y) {
+					if (nz > 0) {
+						set_range(x, y, 0, nz - 1);
+					}
+				}
+			}
+		}
+
+		/// Cell-wise OR with a grid of the same size.
+		BitGrid3D &operator|=(const BitGrid3D &other) {
+			assert(same_shape(other));
+			for (size_t i = 0; i < words.size(); ++i) {
+				words[i] |= other.words[i];
+			}
+			return *this;
+		}
+
+		/// Cell-wise AND with a grid of the same size.
+		BitGrid3D &operator&=(const BitGrid3D &other) {
+			assert(same_shape(other));
+			for (size_t i = 0; i < words.size(); ++i) {
+				words[i] &= other.words[i];
+			}
+			return *this;
+		}
+
+		/// Cell-wise OR of a single slab (all cells with the given x) with the same slab of a grid of the same size.
+		void or_slab(size_t x, const BitGrid3D &other) {
+			assert(same_shape(other));
+			const size_t begin = x * words_per_slab();
+			for (size_t i = begin; i < begin + words_per_slab(); ++i) {
+				words[i] |= other.words[i];
+			}
+		}
+
+		/// The number of true cells.
+		[[nodiscard]] size_t count() const {
+			size_t n = 0;
+			for (Word word: words) {
+				n += std::popcount(word);
+			}
+			return n;
+		}
+
+		/// The number of true cells in a single slab (all cells with the given x).
+		[[nodiscard]] size_t count_slab(size_t x) const {
+			size_t n = 0;
+			const size_t begin = x * words_per_slab();
+			for (size_t i = begin; i < begin + words_per_slab(); ++i) {
+				n += std::popcount(words[i]);
+			}
+			return n;
+		}
+
+		bool operator==(const BitGrid3D &other) const {
+			return same_shape(other) && words == other.words;
+		}
+
+		/**
+		 * Given a coordinate and a grid, determine if the value at the coordinate is different from any of its neighbors.
+		 *
+		 * If a voxel is at the boundary of the grid, this function will always return true.
+		 *
+		 * @param coord 		The coordinate.
+		 * @return 				True/false depending on whether the voxel has a different neighbor, or is at the boundary.
+		 */
+		[[nodiscard]] bool voxel_has_different_neighbor(const math::Vec3i &coord) const {
+			const bool v_center = (*this)[coord];
+
+			for (const auto &neighbor: mgodpl::grid_utils::neighbors(coord)) {
+				if (!in_bounds(neighbor)) {
+					return true;
+				}
+
+				if ((*this)[neighbor] != v_center) {
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		/**
+		 * Given a coordinate and a grid, return the next grid coordinate in lexicographical order.
+		 *
+		 * This is to prevent triple-nested for loops.
+		 */
+		[[nodiscard]] std::optional<math::Vec3i> next_coord_lexicographical(const math::Vec3i &coord) const {
+			assert(in_bounds(coord));
+
+			if (coord.z() < (int) nz - 1) {
+				return {{coord.x(), coord.y(), coord.z() + 1}};
+			} else if (coord.y() < (int) ny - 1) {
+				return {{coord.x(), coord.y() + 1, 0}};
+			} else if (coord.x() < (int) nx - 1) {
+				return {{coord.x() + 1, 0, 0}};
+			} else {
+				return {};
+			}
+		}
+
+		[[nodiscard]] math::Vec3i first_lexicographical_coord() const {
+			return {0, 0, 0};
+		}
+
+	private:
+		[[nodiscard]] size_t row_offset(size_t x, size_t y) const {
+			return (x * ny + y) * row_words;
+		}
+
+		static Word bit(size_t z) {
+			return Word(1) << (z % WORD_BITS);
+		}
+
+		[[nodiscard]] bool same_shape(const BitGrid3D &other) const {
+			return nx == other.nx && ny == other.ny && nz == other.nz;
+		}
+
+		/// Call f(word_index, mask) for every word overlapping the bit range [z_min, z_max], with the bits in range.
+		template<typename F>
+		static void for_each_range_word(size_t z_min, size_t z_max, const F &f) {
+			const size_t first_word = z_min / WORD_BITS;
+			const size_t last_word = z_max / WORD_BITS;
+			const Word first_mask = ~Word(0) << (z_min % WORD_BITS);
+			const Word last_mask = ~Word(0) >> (WORD_BITS - 1 - z_max % WORD_BITS);
+
+			if (first_word == last_word) {
+				f(first_word, first_mask & last_mask);
+				return;
+			}
+
+			f(first_word, first_mask);
+			for (size_t word_i = first_word + 1; word_i < last_word; ++word_i) {
+				f(word_i, ~Word(0));
+			}
+			f(last_word, last_mask);
+		}
+
+		size_t nx, ny, nz;
+		size_t row_words;
+		std::vector<Word> words;
+	};
+}
+
+#endif //MGODPL_BITGRID3D_H
@@ -16,6 +16,7 @@
 #include <optional>
 #include "../math/grid_utils.h"
 #include "../math/Vec3.h"
+#include "BitGrid3D.h"
 
 namespace mgodpl {
 
@@ -152,7 +153,14 @@ namespace mgodpl {
 		}
 	};
 
-
+	/**
+	 * A 3D grid of booleans is stored packed, one bit per cell; see BitGrid3D.
+	 */
+	template<>
+	class Grid3D<bool> : public BitGrid3D {
+	public:
+		using BitGrid3D::BitGrid3D;
+	};
 
 }
 
@@ -9,33 +9,184 @@
 #ifndef MGODPL_OCTREE_H
 #define MGODPL_OCTREE_H
 
+#include <algorithm>
+#include <cassert>
 #include <cstddef>
-#include <variant>
-#include <array>
-#include <memory>
+#include <cstdint>
+#include <vector>
 
-namespace mgodpl::visibility {
+#include "../math/morton.h"
 
-	template<typename SD, typename LD>
-	class Octree {
+namespace mgodpl::visibility {
 
+	/**
+	 * @brief A linear octree: only the leaves are stored, in one contiguous array, sorted by Morton code.
+	 *
+	 * The octree subdivides a cube into at most 2^max_depth cells per side. Every leaf covers an aligned cube of
+	 * those cells, and is identified by the Morton code of its first cell plus its depth (0 being the root), so the
+	 * leaves tile the whole cube in Morton order. Lookups are a binary search, and there are no per-node
+	 * allocations or pointers.
+	 *
+	 * The tree is kept canonical: eight sibling leaves with equal data are always merged into their parent.
+	 * Trees are built in bulk, in Morton order, through a Builder.
+	 *
+	 * @tparam LD 	The data stored in the leaves; must be equality-comparable.
+	 */
+	template<typename LD>
+	class LinearOctree {
 	public:
-		struct LeafNode;
-		struct SplitNode;
-
-		using Node = std::variant<LeafNode, SplitNode>;
-
-		struct LeafNode {
+		struct Leaf {
+			/// The Morton code of the first (lowest) cell covered by the leaf, at the finest level.
+			uint64_t code;
+			/// The depth of the leaf; a leaf at depth d covers 2^(max_depth - d) cells per side.
+			uint8_t depth;
 			LD data;
 		};
 
-		struct SplitNode {
-			SD data;
-			std::unique_ptr<std::array<Node,8> > children;
+		/**
+		 * @brief Builds a tree from leaves appended in Morton order, merging equal siblings as they complete.
+		 */
+		class Builder {
+		public:
+			explicit Builder(unsigned max_depth) : max_depth(max_depth) {
+				assert(max_depth <= math::morton::MAX_BITS);
+			}
+
+			/**
+			 * Append a leaf. It must start right where the previous leaf ended, and be aligned to its own size.
+			 *
+			 * @param code 		The Morton code of the first cell covered by the leaf.
+			 * @param depth 	The depth of the leaf.
+			 * @param data 		The data.
+			 */
+			void push(uint64_t code, unsigned depth, const LD &data) {
+				assert(depth <= max_depth);
+				assert(code == next_code);
+				assert(code % cells_below(max_depth, depth) == 0);
+
+				leaves.push_back({code, (uint8_t) depth, data});
+				next_code = code + cells_below(max_depth, depth);
+
+				// If this completed a set of eight equal siblings, replace them by their parent; repeat upwards.
+				while (leaves.size() >= 8 && leaves.back().depth > 0) {
+					const size_t first_i = leaves.size() - 8;
+					const unsigned child_depth = leaves.back().depth;
+
+					if (leaves[first_i].code % cells_below(max_depth, child_depth - 1) != 0) {
+						break;
+					}
+
+					for (size_t i = first_i; i < leaves.size(); ++i) {
+						if (leaves[i].depth != child_depth || !(leaves[i].data == leaves[first_i].data)) {
+							return;
+						}
+					}
+
+					const Leaf parent{leaves[first_i].code, (uint8_t) (child_depth - 1), leaves[first_i].data};
+					leaves.resize(first_i);
+					leaves.push_back(parent);
+				}
+			}
+
+			/// Finish building; all cells must have been covered.
+			LinearOctree finish() && {
+				assert(next_code == cells_below(max_depth, 0));
+				return LinearOctree(max_depth, std::move(leaves));
+			}
+
+		private:
+			unsigned max_depth;
+			uint64_t next_code = 0;
+			std::vector<Leaf> leaves;
 		};
 
-		Node _root;
+		/**
+		 * Create an octree consisting of a single leaf.
+		 *
+		 * @param max_depth 	The maximum depth; the octree has 2^max_depth cells per side.
+		 * @param value 		The value of all cells.
+		 */
+		LinearOctree(unsigned max_depth, const LD &value) : _max_depth(max_depth), _leaves{{0, 0, value}} {
+			assert(max_depth <= math::morton::MAX_BITS);
+		}
+
+		/**
+		 * Build an octree from the values of all cells at the finest level, e.g. a dense grid.
+		 *
+		 * @param max_depth 	The maximum depth; the octree has 2^max_depth cells per side.
+		 * @param cell_value 	A function (x, y, z) -> LD giving the value of every cell.
+		 * @return 				The octree.
+		 */
+		template<typename F>
+		static LinearOctree from_cells(unsigned max_depth, const F &cell_value) {
+			Builder builder(max_depth);
+			const uint64_t n_cells = cells_below(max_depth, 0);
+			for (uint64_t code = 0; code < n_cells; ++code) {
+				const auto [x, y, z] = math::morton::decode(code);
+				builder.push(code, max_depth, cell_value(x, y, z));
+			}
+			return std::move(builder).finish();
+		}
+
+		/// The number of cells at the finest level, covered by a node at the given depth.
+		static uint64_t cells_below(unsigned max_depth, unsigned depth) {
+			return uint64_t(1) << (3 * (max_depth - depth));
+		}
+
+		[[nodiscard]] unsigned max_depth() const {
+			return _max_depth;
+		}
+
+		/// The number of cells per side, at the finest level.
+		[[nodiscard]] uint32_t resolution() const {
+			return uint32_t(1) << _max_depth;
+		}
+
+		/// The number of cells per side of a leaf, at the finest level.
+		[[nodiscard]] uint32_t side(const Leaf &leaf) const {
+			return uint32_t(1) << (_max_depth - leaf.depth);
+		}
+
+		[[nodiscard]] const std::vector<Leaf> &leaves() const {
+			return _leaves;
+		}
+
+		/// The index of the leaf containing the cell with the given Morton code.
+		[[nodiscard]] size_t find(uint64_t code) const {
+			const auto it = std::upper_bound(_leaves.begin(), _leaves.end(), code, [](uint64_t c, const Leaf &leaf) {
+				return c < leaf.code;
+			});
+			return (size_t) (it - _leaves.begin()) - 1;
+		}
+
+		/// The index of the first leaf in [begin, end) that starts at or after the given Morton code.
+		[[nodiscard]] size_t lower_bound(uint64_t code, size_t begin, size_t end) const {
+			const auto it = std::lower_bound(_leaves.begin() + (ptrdiff_t) begin,
+			                                 _leaves.begin() + (ptrdiff_t) end,
+			                                 code,
+			                                 [](const Leaf &leaf, uint64_t c) {
+				                                 return leaf.code < c;
+			                                 });
+			return (size_t) (it - _leaves.begin());
+		}
+
+		/// The value of a cell at the finest level.
+		[[nodiscard]] const LD &at(uint32_t x, uint32_t y, uint32_t z) const {
+			assert(x < resolution() && y < resolution() && z < resolution());
+			return _leaves[find(math::morton::encode(x, y, z))].data;
+		}
+
+		/// The memory used by the leaves, in bytes.
+		[[nodiscard]] size_t size_bytes() const {
+			return _leaves.size() * sizeof(Leaf);
+		}
+
+	private:
+		LinearOctree(unsigned max_depth, std::vector<Leaf> leaves) : _max_depth(max_depth), _leaves(std::move(leaves)) {
+		}
 
+		unsigned _max_depth;
+		std::vector<Leaf> _leaves;
 	};
 
 }
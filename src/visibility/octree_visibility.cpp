@@ -6,10 +6,15 @@
 // Created by werner on 10/23/23.
 //
 
-#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <optional>
+
 #include "octree_visibility.h"
 #include "Octree.h"
 #include "visibility_geometry.h"
+#include "../math/Plane.h"
 
 namespace mgodpl::visibility {
 
@@ -35,158 +40,293 @@ namespace mgodpl::visibility {
 
 	}
 
-	VisibilityOctree cast_occlusion_batch_sorting(const math::AABBd &base_volume,
-												  const std::vector<math::Triangle> &triangles,
-												  const math::Vec3d &eye) {
+	namespace {
+
+		/**
+		 * The volume occluded by a triangle: the infinite pyramid with the eye at its apex, cut off by the triangle.
+		 *
+		 * A point is inside if it is on the non-negative side of all four planes.
+		 */
+		struct ShadowVolume {
+			std::array<Plane, 4> planes;
+			/// The bounding box of the volume; unbounded on the sides the rays go towards.
+			AABBd bounds;
+		};
 
-		VisibilityOctree occluded;
+		std::optional<ShadowVolume> shadow_volume(const Triangle &triangle, const Vec3d &eye) {
+			const std::array<Vec3d, 3> vertices{triangle.a, triangle.b, triangle.c};
 
+			Vec3d normal = (triangle.b - triangle.a).cross(triangle.c - triangle.a);
+			const double eye_side = normal.dot(triangle.a - eye);
 
-		// Sort by distance from the viewpoint, then process in order.
-		for (const auto& [_distance, triangle] : sorted_by_distance(triangles, eye)) {
-			cast_occlusion(base_volume, occluded, *triangle, eye, 5);
-		}
+			// Degenerate triangles, and those seen edge-on, occlude nothing.
+			if (std::abs(eye_side) <= 1e-12 * normal.norm() * (triangle.a - eye).norm()) {
+				return std::nullopt;
+			}
+			if (eye_side < 0.0) {
+				normal = -normal;
+			}
 
-		return occluded;
+			// The side planes through the eye and each edge, facing the opposite vertex.
+			auto side_plane = [&](const Vec3d &p, const Vec3d &q, const Vec3d &r) {
+				Vec3d side_normal = (p - eye).cross(q - eye);
+				if (side_normal.dot(r - eye) < 0.0) {
+					side_normal = -side_normal;
+				}
+				return Plane::from_point_and_normal(eye, side_normal);
+			};
 
-	}
+			const std::array<Plane, 4> planes{
+					Plane::from_point_and_normal(triangle.a, normal),
+					side_plane(triangle.a, triangle.b, triangle.c),
+					side_plane(triangle.b, triangle.c, triangle.a),
+					side_plane(triangle.c, triangle.a, triangle.b)
+			};
 
-	bool is_leaf_with_value(const VisibilityOctree::Node &node, bool value) {
-		if (const auto& leaf = std::get_if<VisibilityOctree::LeafNode>(&node)) {
-			return leaf->data == value;
-		} else {
-			return false;
+			AABBd bounds = AABBd::inverted_infinity();
+			for (const Vec3d &vertex: vertices) {
+				bounds.expand(vertex);
+			}
+			Vec3d min = bounds.min(), max = bounds.max();
+			for (const Vec3d &vertex: vertices) {
+				const Vec3d direction = vertex - eye;
+				for (int dim: {0, 1, 2}) {
+					if (direction[dim] < 0.0) {
+						min[dim] = -INFINITY;
+					} else if (direction[dim] > 0.0) {
+						max[dim] = INFINITY;
+					}
+				}
+			}
+
+			return ShadowVolume{planes, AABBd(min, max)};
 		}
-	}
 
-	void try_merge(VisibilityOctree::Node &occluded) {// If the children are identical leaf nodes, then we can collapse them into a single leaf node.
-		bool all_same = true;
+		enum class Overlap {
+			NONE,
+			PARTIAL,
+			FULL
+		};
 
-		// All children must be leaf nodes.
-		for (size_t i = 0; i < 8; ++i) {
-			if (!std::holds_alternative<VisibilityOctree::LeafNode>(std::get<VisibilityOctree::SplitNode>(occluded).children->at(i))) {
-				return;
+		/**
+		 * Classify how a box overlaps a shadow volume. NONE and FULL are never wrong, but PARTIAL may also be returned
+		 * for boxes that are just outside the volume, near its edges.
+		 */
+		Overlap overlap(const ShadowVolume &shadow, const AABBd &box) {
+			if (!shadow.bounds.intersects(box)) {
+				return Overlap::NONE;
 			}
-		}
 
-		const auto& first_leaf = std::get<VisibilityOctree::SplitNode>(occluded).children->at(0);
+			bool all_inside = true;
+
+			for (const Plane &plane: shadow.planes) {
+				// The corners furthest along and against the normal.
+				Vec3d furthest, nearest;
+				for (int dim: {0, 1, 2}) {
+					const bool positive = plane.normal()[dim] >= 0.0;
+					furthest[dim] = positive ? box.max()[dim] : box.min()[dim];
+					nearest[dim] = positive ? box.min()[dim] : box.max()[dim];
+				}
 
-		for (size_t i = 1; i < 8; ++i) {
-			if (std::get<VisibilityOctree::LeafNode>(first_leaf).data != std::get<VisibilityOctree::LeafNode>(std::get<VisibilityOctree::SplitNode>(occluded).children->at(i)).data) {
-				all_same = false;
-				break;
+				if (plane.signed_distance(furthest) < 0.0) {
+					return Overlap::NONE;
+				}
+				if (plane.signed_distance(nearest) < 0.0) {
+					all_inside = false;
+				}
 			}
-		}
 
-		if (all_same) {
-			occluded = VisibilityOctree::LeafNode { std::get<VisibilityOctree::LeafNode>(first_leaf).data };
+			return all_inside ? Overlap::FULL : Overlap::PARTIAL;
 		}
-	}
 
-	void cast_occlusion_internal(
-			const math::AABBd &volume,
-			VisibilityOctree::Node &occluded,
-			const std::array<Ray,3> &rays,
-			const size_t max_depth) {
+		struct CastContext {
+			const VisibilityOctree &old;
+			const std::vector<ShadowVolume> &shadows;
+			VisibilityOctree::Builder &out;
+			/// Per depth, the shadows touching the node currently visited at that depth.
+			std::vector<std::vector<uint32_t>> touching;
+		};
 
-		// If it's already a leaf that is occluded, skip it.
-		if (is_leaf_with_value(occluded, true)) {
-			return;
-		}
+		/**
+		 * Emit the leaves of the new tree for a node, in Morton order.
+		 *
+		 * @param ctx 			The context.
+		 * @param volume 		The volume of the node.
+		 * @param code 			The Morton code of the first cell of the node.
+		 * @param depth 		The depth of the node.
+		 * @param old_begin 	The first leaf of the old tree overlapping the node.
+		 * @param old_end 		One past the last leaf of the old tree overlapping the node.
+		 * @param candidates 	The shadows that touch the parent node.
+		 */
+		void cast_occlusion_internal(CastContext &ctx,
+									 const AABBd &volume,
+									 uint64_t code,
+									 unsigned depth,
+									 size_t old_begin,
+									 size_t old_end,
+									 const std::vector<uint32_t> &candidates) {
+
+			const auto &old_leaves = ctx.old.leaves();
+			const unsigned max_depth = ctx.old.max_depth();
+
+			// Whether a single leaf of the old tree covers the whole node.
+			const bool covered = old_end - old_begin == 1 && old_leaves[old_begin].depth <= depth;
+
+			// If it's already occluded, skip it.
+			if (covered && old_leaves[old_begin].data) {
+				ctx.out.push(code, depth, true);
+				return;
+			}
 
-		// Grab the affected volume.
-		const auto& intersection_aabb = aabbInAABB(volume, rays, 0);
+			auto &touching = ctx.touching[depth];
+			touching.clear();
+
+			for (uint32_t shadow_i: candidates) {
+				switch (overlap(ctx.shadows[shadow_i], volume)) {
+					case Overlap::FULL:
+						ctx.out.push(code, depth, true);
+						return;
+					case Overlap::PARTIAL:
+						touching.push_back(shadow_i);
+						break;
+					case Overlap::NONE:
+						break;
+				}
+			}
 
-		// Three cases: no intersection, partial intersection, contained.
+			// No intersection: the old leaves are kept as they are.
+			if (touching.empty()) {
+				if (covered) {
+					ctx.out.push(code, depth, old_leaves[old_begin].data);
+				} else {
+					for (size_t i = old_begin; i < old_end; ++i) {
+						ctx.out.push(old_leaves[i].code, old_leaves[i].depth, old_leaves[i].data);
+					}
+				}
+				return;
+			}
 
-		// No intersection: nothing to do.
-		if (!intersection_aabb) {
-			return;
-		}
+			// At max depth, a partial intersection is treated as a full intersection.
+			if (depth == max_depth) {
+				ctx.out.push(code, depth, true);
+				return;
+			}
 
-		// If there's a full intersection, then the entire volume is occluded.
-		// At max n_variables_determined, a partial intersection is treated as a full intersection.
-		if (intersection_aabb->volume() - 1e-10 >= volume.volume() || max_depth == 0) {
-			occluded = VisibilityOctree::LeafNode { true };
-			return;
-		}
+			// Recurse on the children, splitting the old leaves between them.
+			const uint64_t child_cells = VisibilityOctree::cells_below(max_depth, depth + 1);
+			size_t child_begin = old_begin;
 
-		// There's a partial intersection; split the node if necessary.
-		if (const auto& leaf = std::get_if<VisibilityOctree::LeafNode>(&occluded)) {
+			for (size_t i = 0; i < 8; ++i) {
+				const uint64_t child_code = code + i * child_cells;
+				const size_t child_end = covered
+										 ? old_end
+										 : ctx.old.lower_bound(child_code + child_cells, child_begin, old_end);
 
-			occluded = VisibilityOctree::SplitNode {
-				// Can we use make_unique somehow?
-				.children = std::unique_ptr<std::array<VisibilityOctree::Node,8>>(new std::array<VisibilityOctree::Node,8> {VisibilityOctree::LeafNode{leaf->data}}) // NOLINT(*-make-unique)
-			};
+				cast_occlusion_internal(ctx, childAABB(volume, i), child_code, depth + 1, child_begin, child_end, touching);
 
+				if (!covered) {
+					child_begin = child_end;
+				}
+			}
 		}
+	}
+
+	VisibilityOctree cast_occlusion(const AABBd &base_volume,
+									const VisibilityOctree &occluded,
+									const std::vector<Triangle> &triangles,
+									const Vec3d &eye) {
 
-		// Recurse on the children.
-		for (size_t i = 0; i < 8; ++i) {
-			cast_occlusion_internal(childAABB(volume, i), std::get<VisibilityOctree::SplitNode>(occluded).children->at(i), rays, max_depth - 1);
+		std::vector<ShadowVolume> shadows;
+		shadows.reserve(triangles.size());
+		for (const auto &triangle: triangles) {
+			if (auto shadow = shadow_volume(triangle, eye)) {
+				shadows.push_back(*shadow);
+			}
 		}
 
-		try_merge(occluded);
+		std::vector<uint32_t> all_shadows(shadows.size());
+		std::iota(all_shadows.begin(), all_shadows.end(), 0);
+
+		VisibilityOctree::Builder builder(occluded.max_depth());
+		CastContext ctx{occluded, shadows, builder, std::vector<std::vector<uint32_t>>(occluded.max_depth() + 1)};
+
+		cast_occlusion_internal(ctx, base_volume, 0, 0, 0, occluded.leaves().size(), all_shadows);
 
+		return std::move(builder).finish();
 	}
 
-	void cast_occlusion(const math::AABBd &base_volume,
+	void cast_occlusion(const AABBd &base_volume,
 						VisibilityOctree &occluded,
-						const math::Triangle &triangle,
-						const math::Vec3d &eye,
-						int depth) {
+						const Triangle &triangle,
+						const Vec3d &eye) {
+		occluded = cast_occlusion(base_volume, occluded, std::vector<Triangle>{triangle}, eye);
+	}
 
-		// The occluded volume is the convex hull of the three rays, limited to the parent AABB.
-		// Rays are offset a bit to account for the idea of "boundary cells".
-		const std::array<Ray, 3> rays{occluded_ray(eye, triangle.a, 0.0),
-									  occluded_ray(eye, triangle.b, 0.0),
-									  occluded_ray(eye, triangle.c, 0.0)};
+	VisibilityOctree cast_occlusion_batch_sorting(const AABBd &base_volume,
+												  const std::vector<Triangle> &triangles,
+												  const Vec3d &eye,
+												  unsigned max_depth,
+												  size_t batch_size) {
 
-		cast_occlusion_internal(base_volume, occluded._root, rays,
-								depth);
+		VisibilityOctree occluded(max_depth, false);
 
-	}
+		auto by_distance = sorted_by_distance(triangles, eye);
+		std::sort(by_distance.begin(), by_distance.end(), [](const auto &a, const auto &b) {
+			return a.first < b.first;
+		});
 
-	struct RaySlice {
-		const Ray ray;
-		RangeInclusiveD t_range;
-	};
+		batch_size = std::max(batch_size, (size_t) 1);
 
-	VisibilityOctree::Node cast_occlusion_batch_internal_dnc(
-			const math::AABBd &volume,
-			const std::vector<std::array<RaySlice,3>>& rays,
-			const math::Vec3d &eye
-			) {
+		// Process in order of distance, one batch at a time.
+		std::vector<Triangle> batch;
+		for (size_t batch_start = 0; batch_start < by_distance.size(); batch_start += batch_size) {
+			batch.clear();
+			for (size_t i = batch_start; i < std::min(batch_start + batch_size, by_distance.size()); ++i) {
+				batch.push_back(*by_distance[i].second);
+			}
+			occluded = cast_occlusion(base_volume, occluded, batch, eye);
+		}
 
-		double x_min = volume.min().x();
-		double x_max = volume.max().x();
-		double x_split = (x_min + x_max) / 2.0;
+		return occluded;
 
-		std::vector<std::array<RaySlice,3>> rays_sub;
+	}
 
-		// Expanding AABB idea?! An expanding cube around the eye point, and maintain the density of stuff on the surface?
+	VisibilityOctree cast_occlusion_batch_dnc(const AABBd &base_volume,
+											  const std::vector<Triangle> &triangles,
+											  const Vec3d &eye,
+											  unsigned max_depth) {
+		return cast_occlusion(base_volume, VisibilityOctree(max_depth, false), triangles, eye);
+	}
 
-		for (const auto& ray_slice : rays) {
-			for (const auto& ray : ray_slice) {
-				double ox = ray.ray.origin().x();
-				double dx = ray.ray.direction().x();
-				double crossover_t = (x_split - ox) / dx;
+	Grid3D<bool> to_grid(const VisibilityOctree &occluded) {
+		const size_t resolution = occluded.resolution();
+		Grid3D<bool> grid(resolution, resolution, resolution, false);
 
-				if (ray.t_range.contains(crossover_t)) {
-					rays_sub.push_back(ray_slice);
-					break;
-				}
+		for (const auto &leaf: occluded.leaves()) {
+			if (!leaf.data) {
+				continue;
 			}
 
+			const auto [x0, y0, z0] = morton::decode(leaf.code);
+			const uint32_t side = occluded.side(leaf);
 
+			for (uint32_t x = x0; x < x0 + side; ++x) {
+				for (uint32_t y = y0; y < y0 + side; ++y) {
+					grid.set_range(x, y, z0, z0 + side - 1);
+				}
+			}
 		}
 
-	};
-
-	VisibilityOctree
-	cast_occlusion_batch_dnc(const math::AABBd &base_volume, std::vector<math::Triangle> triangles, const math::Vec3d &eye) {
-
-//		return VisibilityOctree { cast_occlusion_batch_internal_dnc(base_volume, triangles, eye) };
+		return grid;
+	}
 
+	size_t count_occluded(const VisibilityOctree &occluded) {
+		size_t n = 0;
+		for (const auto &leaf: occluded.leaves()) {
+			if (leaf.data) {
+				n += VisibilityOctree::cells_below(occluded.max_depth(), leaf.depth);
+			}
+		}
+		return n;
 	}
-}
\ No newline at end of file
+}
@@ -9,7 +9,7 @@
 #ifndef MGODPL_OCTREE_VISIBILITY_H
 #define MGODPL_OCTREE_VISIBILITY_H
 
-#include <variant>
+#include <vector>
 #include "../math/AABBGrid.h"
 #include "GridVec.h"
 #include "../math/Triangle.h"
@@ -17,45 +17,83 @@
 
 namespace mgodpl::visibility {
 
-	using VisibilityOctree = Octree<std::monostate, bool>;
+	/// An octree in which a leaf is true if its cells are occluded.
+	using VisibilityOctree = LinearOctree<bool>;
+
+	/// The default depth of occlusion octrees: 32 cells per side.
+	constexpr unsigned DEFAULT_OCCLUSION_DEPTH = 5;
 
 	math::AABBd childAABB(const math::AABBd &parent, size_t child_index);
 
+	/**
+	 * Mark all cells in an octree that are occluded by a set of triangles as occluded, in a single pass.
+	 *
+	 * The octree is rebuilt top-down in Morton order. Every node keeps only the triangles whose shadow touches it,
+	 * and becomes an occluded leaf as soon as one of them covers it entirely. Nodes that were already occluded
+	 * are copied without looking at any triangle. At the maximum depth, a partial intersection is treated
+	 * as a full one.
+	 *
+	 * @param base_volume 		The volume covered by the octree.
+	 * @param occluded 			The octree to add to; its maximum depth is kept.
+	 * @param triangles 		The triangles.
+	 * @param eye 				The eye point.
+	 * @return 					The new octree.
+	 */
+	VisibilityOctree cast_occlusion(const math::AABBd &base_volume,
+									const VisibilityOctree &occluded,
+									const std::vector<math::Triangle> &triangles,
+									const math::Vec3d &eye);
+
 	void cast_occlusion(const math::AABBd &base_volume,
 						VisibilityOctree &occluded,
 						const math::Triangle &triangle,
-						const math::Vec3d &eye,
-						int depth);
+						const math::Vec3d &eye);
 
 	/**
-	 * In a given octree, set all cells occluded by a set of triangles to true.
+	 * Build an octree with all cells occluded by a set of triangles set to true.
 	 *
-	 * In this algorithm, triangles are sorted by distance from the eye point,
-	 * then processed individually.
+	 * In this algorithm, triangles are sorted by distance from the eye point, then
+	 * processed in batches of increasing distance, so that the volume occluded by
+	 * nearer batches is skipped for farther ones.
 	 *
 	 * @param base_volume 		The base volume.
 	 * @param triangles 		The triangles.
 	 * @param eye 				The eye point.
+	 * @param max_depth 		The maximum depth of the octree.
+	 * @param batch_size 		The number of triangles per batch.
 	 * @return 					The occluded octree.
 	 */
 	VisibilityOctree cast_occlusion_batch_sorting(const math::AABBd &base_volume,
 												  const std::vector<math::Triangle>& triangles,
-												  const math::Vec3d &eye);
+												  const math::Vec3d &eye,
+												  unsigned max_depth = DEFAULT_OCCLUSION_DEPTH,
+												  size_t batch_size = 64);
 
 	/**
-	 * In a given octree, set all cells occluded by a set of triangles to true.
+	 * Build an octree with all cells occluded by a set of triangles set to true.
 	 *
 	 * In this algorithm, we use a divide-and-conquer approach, where we recursively
 	 * subdivide the octree, splitting the set of affected triangles each time as well.
 	 *
 	 * @param base_volume 		The base volume.
-	 * @param triangles 		The triangles. (Passes by value since we internally shuffle it around)
+	 * @param triangles 		The triangles.
 	 * @param eye 				The eye point.
+	 * @param max_depth 		The maximum depth of the octree.
 	 * @return 					The occluded octree.
 	 */
 	VisibilityOctree cast_occlusion_batch_dnc(const math::AABBd &base_volume,
-											  std::vector<math::Triangle> triangles,
-											  const math::Vec3d &eye);
+											  const std::vector<math::Triangle>& triangles,
+											  const math::Vec3d &eye,
+											  unsigned max_depth = DEFAULT_OCCLUSION_DEPTH);
+
+	/**
+	 * Convert an occlusion octree to a dense grid with one cell per finest-level cell of the octree,
+	 * indexed like an AABBGrid over the same volume.
+	 */
+	Grid3D<bool> to_grid(const VisibilityOctree &occluded);
+
+	/// The number of finest-level cells that are occluded.
+	size_t count_occluded(const VisibilityOctree &occluded);
 
 }
 
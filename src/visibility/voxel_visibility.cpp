@@ -6,8 +6,11 @@
 // Created by werner on 10/10/23.
 //
 
+#include <algorithm>
 #include <queue>
 
+#include <tbb/parallel_for.h>
+
 #include "../math/grid_utils.h"
 #include "../math/AABBGrid.h"
 #include "../math/Segment3d.h"
@@ -160,9 +163,11 @@ namespace mgodpl {
 				const int grid_zmin = grid.getCoordinateInDimension(zmin + margin, 2);
 				const int grid_zmax = grid.getCoordinateInDimension(zmax - margin, 2);
 
-				// Mark all affected grid cells as occluded.
-				for (int z = grid_zmin; z <= grid_zmax; ++z) {
-					occluded[{x, y, z}] = true;
+				// Mark all affected grid cells as occluded, a word at a time.
+				const int z_first = std::max(grid_zmin, 0);
+				const int z_last = std::min(grid_zmax, occluded.size().z() - 1);
+				if (z_first <= z_last) {
+					occluded.set_range(x, y, z_first, z_last);
 				}
 			}
 		}
@@ -180,11 +185,9 @@ namespace mgodpl {
 	) {
 		for (int x = aabb.min().x(); x <= aabb.max().x(); ++x) {
 			for (int y = aabb.min().y(); y <= aabb.max().y(); ++y) {
-				for (int z = aabb.min().z(); z <= aabb.max().z(); ++z) {
-					// If any of the voxels is not occluded, return false.
-					if (!occluded[{x, y, z}]) {
-						return false;
-					}
+				// If any of the voxels is not occluded, return false.
+				if (!occluded.all_in_range(x, y, aabb.min().z(), aabb.max().z())) {
+					return false;
 				}
 			}
 		}
@@ -194,22 +197,49 @@ namespace mgodpl {
 
 	Grid3D<bool> voxel_visibility::cast_occlusion(const AABBGrid &grid,
 												  const std::vector<math::Triangle> &triangles,
-												  const Vec3d &eye) {
+												  const Vec3d &eye,
+												  size_t n_chunks) {
+
+		// Nearest triangles first: they occlude the most, letting more of the later ones be skipped.
+		auto by_distance = sorted_by_distance(triangles, eye);
+		std::sort(by_distance.begin(), by_distance.end(), [](const auto &a, const auto &b) {
+			return a.first < b.first;
+		});
+
+		n_chunks = std::clamp(n_chunks, (size_t) 1, std::max(by_distance.size(), (size_t) 1));
+
+		// Every chunk of triangles (interleaved, so that each gets a share of the near ones) is cast into a partial
+		// grid of its own; the partial grids are then merged with a word-wide OR.
+		std::vector<Grid3D<bool>> partial_grids;
+		partial_grids.reserve(n_chunks);
+		for (size_t chunk_i = 0; chunk_i < n_chunks; ++chunk_i) {
+			partial_grids.emplace_back(grid.size().x(), grid.size().y(), grid.size().z(), false);
+		}
+
+		tbb::parallel_for(size_t(0), n_chunks, [&](size_t chunk_i) {
+			Grid3D<bool> &occluded = partial_grids[chunk_i];
 
-		Grid3D<bool> occluded(grid.size().x(), grid.size().y(), grid.size().z(), false);
+			for (size_t tri_i = chunk_i; tri_i < by_distance.size(); tri_i += n_chunks) {
+				const Triangle &triangle = *by_distance[tri_i].second;
 
-		// Then, perform per-triangle occlusion casting:
-		for (const auto& [distance, triangle] : sorted_by_distance(triangles, eye)) {
+				// Quick check: if the triangle is fully occluded, it will not contribute to further occlusion of the scene.
+				const auto &triangle_aabb = grid.touchedCoordinates(math::aabb_of(triangle));
+				if (triangle_aabb.has_value() && all_occluded(occluded, *triangle_aabb)) {
+					continue;
+				}
 
-			// Quick check: if the triangle is fully occluded, it will not contribute to further occlusion of the scene.
-			const auto& triangle_aabb = grid.touchedCoordinates(math::aabb_of(*triangle));
-			if (triangle_aabb.has_value() && all_occluded(occluded, *triangle_aabb)) {
-				continue;
+				// Perform the expensive occlusion casting.
+				cast_occlusion(grid, occluded, triangle, eye);
 			}
+		});
 
-			// Perform the expensive occlusion casting.
-			cast_occlusion(grid, occluded, *triangle, eye);
-		}
+		Grid3D<bool> occluded = std::move(partial_grids[0]);
+
+		tbb::parallel_for(size_t(0), (size_t) grid.size().x(), [&](size_t x) {
+			for (size_t chunk_i = 1; chunk_i < n_chunks; ++chunk_i) {
+				occluded.or_slab(x, partial_grids[chunk_i]);
+			}
+		});
 
 		return occluded;
 	}
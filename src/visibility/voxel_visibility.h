@@ -9,6 +9,9 @@
 #ifndef MGODPL_VOXEL_VISIBILITY_H
 #define MGODPL_VOXEL_VISIBILITY_H
 
+#include <cstddef>
+#include <vector>
+
 #include "../math/Vec3.h"
 
 namespace mgodpl {
@@ -47,18 +50,29 @@ namespace mgodpl {
 							const math::Triangle& triangle,
 							const math::Vec3d& eye);
 
+		/// The default number of chunks for the batch cast_occlusion: fixed, rather than one per worker thread, so that
+		/// the result does not depend on the machine.
+		constexpr size_t DEFAULT_OCCLUSION_CHUNKS = 16;
+
 		/**
 		 * In a given visibility grid, set all cells occluded by a set of triangles to false,
 		 * processing the triangles as a batch.
 		 *
+		 * The triangles are split into chunks that are cast in parallel, each into a partial grid of its own;
+		 * the partial grids are merged with a word-wide OR at the end. Triangles whose cells are already all occluded
+		 * are skipped, which is a heuristic that depends on the order of casting; so the result may differ slightly
+		 * with the number of chunks. It does not depend on the number of threads, however; pass
+		 * `tbb::this_task_arena::max_concurrency()` explicitly to trade that for one chunk per worker.
+		 *
 		 * @param grid 				The visibility grid.
-		 * @param occluded 			The occluded grid.
 		 * @param triangles 		The triangles.
 		 * @param eye 				The eye point.
+		 * @param n_chunks 			The number of chunks (and partial grids).
 		 */
 		Grid3D<bool> cast_occlusion(const math::AABBGrid& grid,
 							const std::vector<math::Triangle>& triangles,
-							const math::Vec3d& eye);
+							const math::Vec3d& eye,
+							size_t n_chunks = DEFAULT_OCCLUSION_CHUNKS);
 	}
 }
 
@@ -25,8 +25,8 @@ VtkLineSegmentsVisualization createFruitLinesVisualization(const mgodpl::Scannab
 
 std::vector<mgodpl::math::Vec3d> generateVisualizationColors(const SeenPoints &ever_seen) {
 	std::vector<math::Vec3d> vis_colors;
-	for (const auto &v: ever_seen.ever_seen) {
-		if (v) {
+	for (size_t i = 0; i < ever_seen.size(); ++i) {
+		if (ever_seen.is_seen(i)) {
 			vis_colors.emplace_back(0.0, 1.0, 0.0);
 		} else {
 			vis_colors.emplace_back(1.0, 0.0, 0.0);
@@ -0,0 +1,153 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "../../src/experiment_utils/point_scanning_evaluation.h"
+
+using namespace mgodpl;
+
+/**
+ * Points spread evenly over a sphere (a Fibonacci lattice), with outward normals.
+ */
+static std::vector<SurfacePoint> sphere_points(const math::Vec3d &center, double radius, size_t n) {
+	const double golden_angle = M_PI * (3.0 - std::sqrt(5.0));
+	std::vector<SurfacePoint> points;
+	for (size_t i = 0; i < n; ++i) {
+		const double z = 1.0 - 2.0 * ((double) i + 0.5) / (double) n;
+		const double r = std::sqrt(1.0 - z * z);
+		const math::Vec3d normal(r * std::cos(golden_angle * (double) i), r * std::sin(golden_angle * (double) i), z);
+		points.push_back({center + normal * radius, normal});
+	}
+	return points;
+}
+
+/**
+ * A few fruits among a soup of small leaf triangles, scanned with the ray-casting backend.
+ */
+static declarative::PointScanEnvironment small_environment(const declarative::SensorScalarParameters &sensor_params) {
+	std::mt19937 rng(42);
+
+	const std::vector<declarative::SphericalFruit> fruits{
+			{{0.0, 0.0, 0.0}, 0.05},
+			{{0.4, 0.1, 0.2}, 0.05},
+			{{-0.3, -0.2, -0.1}, 0.05}
+	};
+
+	std::vector<SurfacePointCloud> scannable_points;
+	std::vector<PointMask> interior_points;
+	for (const auto &fruit: fruits) {
+		const auto points = sphere_points(fruit.center, fruit.radius, 150);
+		scannable_points.push_back(SurfacePointCloud::fromPoints(points));
+
+		// Those facing towards the origin count as interior.
+		PointMask interior((points.size() + 63) / 64, 0);
+		for (size_t i = 0; i < points.size(); ++i) {
+			if (points[i].normal.dot(-fruit.center) > 0.0) {
+				interior[i / 64] |= uint64_t(1) << (i % 64);
+			}
+		}
+		interior_points.push_back(std::move(interior));
+	}
+
+	std::uniform_real_distribution<double> coordinate(-0.6, 0.6);
+	std::uniform_real_distribution<double> offset(-0.08, 0.08);
+	Mesh leaves;
+	for (size_t i = 0; i < 60; ++i) {
+		const math::Vec3d center(coordinate(rng), coordinate(rng), coordinate(rng));
+		const size_t first = leaves.vertices.size();
+		for (size_t j = 0; j < 3; ++j) {
+			leaves.vertices.push_back(center + math::Vec3d(offset(rng), offset(rng), offset(rng)));
+		}
+		leaves.triangles.push_back({first, first + 1, first + 2});
+	}
+
+	auto index = std::make_shared<const ScannablePointIndex>(scannable_points, sensor_params.maxViewDistance);
+	auto occlusion_model = std::make_shared<const MeshOcclusionModel>(leaves, 0.0);
+
+	return {
+			.robot = robot_model::RobotModel(),
+			.tree_model = nullptr,
+			.scaled_leaves = leaves,
+			.fruit_models = fruits,
+			.scannable_points = scannable_points,
+			.scannable_point_index = index,
+			.interior_points = interior_points,
+			.mesh_occlusion_model = occlusion_model,
+			.initial_state = {math::Transformd::identity(), {}},
+			.occlusion_backend = declarative::OcclusionBackend::RAY_CAST
+	};
+}
+
+/**
+ * Once around the fruits, looking inwards (the sensor looks along the local Y axis).
+ */
+static RobotPath orbit_path() {
+	RobotPath path;
+	for (size_t i = 0; i <= 8; ++i) {
+		const double angle = 2.0 * M_PI * (double) i / 8.0;
+		const math::Vec3d position(std::cos(angle), std::sin(angle), 0.1 * (double) i - 0.4);
+		path.append({
+				.base_tf = {
+						.translation = position,
+						.orientation = math::Quaterniond::fromAxisAngle({0.0, 0.0, 1.0}, angle + M_PI / 2.0)
+				},
+				.joint_values = {}
+		});
+	}
+	return path;
+}
+
+TEST(PointScanningEvaluationTest, ParallelMatchesSequential) {
+	const declarative::PointScanEvalParameters params{
+			.tree_params = {"none", 1.0, declarative::Unchanged{}, 0},
+			.sensor_params = {
+					.maxViewDistance = 1.5,
+					.minViewDistance = 0.0,
+					.fieldOfViewAngle = M_PI / 4.0,
+					.maxScanAngle = M_PI / 3.0
+			},
+			.n_scannable_points_per_fruit = 150
+	};
+	const auto env = small_environment(params.sensor_params);
+	const RobotPath path = orbit_path();
+	const double interpolation_speed = 0.1;
+
+	for (const TraceRecording recording: {TraceRecording::FULL, TraceRecording::DELTAS}) {
+		const EvaluationTrace sequential = eval_static_path(path, interpolation_speed, params, env, recording);
+		const Json::Value expected = toJson(sequential);
+
+		const size_t n_frames = sequential.frames.size();
+		ASSERT_GT(n_frames, 20);
+
+		// The points must be seen gradually, or there is nothing to merge across chunks.
+		const EvaluationTrace full = expand_deltas(sequential);
+		size_t n_frames_with_new_points = 0;
+		for (size_t frame_i = 0; frame_i < n_frames; ++frame_i) {
+			for (size_t fruit_i = 0; fruit_i < full.n_fruits; ++fruit_i) {
+				const size_t before = frame_i == 0 ? 0 : full.frames[frame_i - 1].pts_seen[fruit_i];
+				if (full.frames[frame_i].pts_seen[fruit_i] != before) {
+					++n_frames_with_new_points;
+					break;
+				}
+			}
+		}
+		EXPECT_GT(n_frames_with_new_points, 5);
+		EXPECT_LT(full.frames.back().pts_seen[0], 150);
+
+		for (const size_t n_chunks: {(size_t) 0, (size_t) 1, (size_t) 2, (size_t) 3, (size_t) 7, n_frames, n_frames + 5}) {
+			const EvaluationTrace parallel = eval_static_path_parallel(path,
+																	   interpolation_speed,
+																	   params,
+																	   env,
+																	   recording,
+																	   n_chunks);
+			EXPECT_EQ(toJson(parallel), expected) << "With " << n_chunks << " chunks, "
+												  << (recording == TraceRecording::FULL ? "full" : "deltas");
+		}
+	}
+}
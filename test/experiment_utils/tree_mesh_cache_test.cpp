@@ -0,0 +1,155 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+#include "../../src/experiment_utils/tree_mesh_cache.h"
+
+using namespace mgodpl;
+using namespace mgodpl::tree_meshes;
+
+static Mesh random_mesh(size_t n_vertices, size_t n_triangles, std::mt19937 &rng) {
+	std::uniform_real_distribution<double> coordinate(-1.0, 1.0);
+	std::uniform_int_distribution<size_t> vertex(0, n_vertices - 1);
+
+	Mesh mesh;
+	for (size_t i = 0; i < n_vertices; ++i) {
+		mesh.vertices.emplace_back(coordinate(rng), coordinate(rng), coordinate(rng));
+	}
+	for (size_t i = 0; i < n_triangles; ++i) {
+		mesh.triangles.push_back({vertex(rng), vertex(rng), vertex(rng)});
+	}
+	return mesh;
+}
+
+static CachedTreeModel random_model(std::mt19937 &rng) {
+	CachedTreeModel model;
+	model.meshes.leaves_mesh = random_mesh(300, 100, rng);
+	model.meshes.trunk_mesh = random_mesh(200, 150, rng);
+	for (size_t i = 0; i < 5; ++i) {
+		model.meshes.fruit_meshes.push_back(random_mesh(30, 40, rng));
+		model.fruit_centers.push_back(model.meshes.fruit_meshes.back().vertices.front());
+	}
+	model.leaf_root_points = model.meshes.leaves_mesh.vertices;
+	model.leaves_convex_hull = random_mesh(20, 36, rng);
+	return model;
+}
+
+static void expect_equal(const Mesh &a, const Mesh &b) {
+	EXPECT_EQ(a.vertices, b.vertices);
+	EXPECT_EQ(a.triangles, b.triangles);
+}
+
+/**
+ * A fresh, empty directory for the cache files of a single test, removed afterwards.
+ */
+class TreeMeshCacheTest : public ::testing::Test {
+protected:
+	std::filesystem::path directory;
+
+	void SetUp() override {
+		directory = std::filesystem::temp_directory_path() /
+					("mgodpl_tree_mesh_cache_test_" + std::to_string(std::random_device{}()));
+		std::filesystem::create_directories(directory);
+	}
+
+	void TearDown() override {
+		std::filesystem::remove_all(directory);
+	}
+};
+
+TEST_F(TreeMeshCacheTest, RoundTrip) {
+	std::mt19937 rng(42);
+	const CachedTreeModel model = random_model(rng);
+	const std::string path = directory / "tree.bin";
+	const uint64_t source_hash = 0x0123456789abcdefull;
+
+	write_tree_model_cache(path, source_hash, model);
+
+	// Only the final file remains; the temporary one was renamed.
+	EXPECT_EQ(std::distance(std::filesystem::directory_iterator(directory), std::filesystem::directory_iterator()), 1);
+
+	const auto read = read_tree_model_cache(path, source_hash);
+	ASSERT_TRUE(read.has_value());
+
+	expect_equal(read->meshes.leaves_mesh, model.meshes.leaves_mesh);
+	expect_equal(read->meshes.trunk_mesh, model.meshes.trunk_mesh);
+	ASSERT_EQ(read->meshes.fruit_meshes.size(), model.meshes.fruit_meshes.size());
+	for (size_t i = 0; i < model.meshes.fruit_meshes.size(); ++i) {
+		expect_equal(read->meshes.fruit_meshes[i], model.meshes.fruit_meshes[i]);
+	}
+	EXPECT_EQ(read->fruit_centers, model.fruit_centers);
+	EXPECT_EQ(read->leaf_root_points, model.leaf_root_points);
+	expect_equal(read->leaves_convex_hull, model.leaves_convex_hull);
+
+	// A cache made from other sources (or by other processing) is not used.
+	EXPECT_FALSE(read_tree_model_cache(path, source_hash + 1).has_value());
+}
+
+TEST_F(TreeMeshCacheTest, EmptyModelRoundTrips) {
+	const std::string path = directory / "empty.bin";
+
+	write_tree_model_cache(path, 0, CachedTreeModel{});
+
+	const auto read = read_tree_model_cache(path, 0);
+	ASSERT_TRUE(read.has_value());
+	EXPECT_TRUE(read->meshes.leaves_mesh.vertices.empty());
+	EXPECT_TRUE(read->meshes.fruit_meshes.empty());
+	EXPECT_TRUE(read->leaves_convex_hull.triangles.empty());
+}
+
+TEST_F(TreeMeshCacheTest, RejectsTruncatedAndCorruptFiles) {
+	std::mt19937 rng(43);
+	const CachedTreeModel model = random_model(rng);
+	const std::string path = directory / "tree.bin";
+	const uint64_t source_hash = 42;
+
+	write_tree_model_cache(path, source_hash, model);
+	const auto full_size = (size_t) std::filesystem::file_size(path);
+
+	std::vector<char> contents(full_size);
+	std::ifstream(path, std::ios::binary).read(contents.data(), (std::streamsize) full_size);
+
+	const std::string damaged_path = directory / "damaged.bin";
+	auto write_damaged = [&](const std::vector<char> &bytes) {
+		std::ofstream(damaged_path, std::ios::binary | std::ios::trunc).write(bytes.data(), (std::streamsize) bytes.size());
+	};
+
+	// Truncated anywhere: inside the header, at an array boundary, or in the middle of an array.
+	for (size_t size: {(size_t) 0, (size_t) 7, (size_t) 31, (size_t) 32, (size_t) 40, full_size / 2, full_size - 1}) {
+		write_damaged(std::vector<char>(contents.begin(), contents.begin() + (long) size));
+		EXPECT_FALSE(read_tree_model_cache(damaged_path, source_hash).has_value()) << "Truncated to " << size;
+	}
+
+	// Truncated, with the recorded file size patched to match, so that the arrays themselves must be found to overrun.
+	for (size_t size: {(size_t) 40, (size_t) 100, full_size / 2, full_size - 8}) {
+		std::vector<char> truncated(contents.begin(), contents.begin() + (long) size);
+		const uint64_t file_size = size;
+		std::memcpy(truncated.data() + 24, &file_size, sizeof(file_size));
+		write_damaged(truncated);
+		EXPECT_FALSE(read_tree_model_cache(damaged_path, source_hash).has_value()) << "Truncated to " << size;
+	}
+
+	// Trailing garbage.
+	std::vector<char> extended = contents;
+	extended.resize(full_size + 8, 0);
+	write_damaged(extended);
+	EXPECT_FALSE(read_tree_model_cache(damaged_path, source_hash).has_value());
+
+	// Another magic number.
+	std::vector<char> bad_magic = contents;
+	bad_magic[0] ^= 1;
+	write_damaged(bad_magic);
+	EXPECT_FALSE(read_tree_model_cache(damaged_path, source_hash).has_value());
+
+	// A missing file.
+	EXPECT_FALSE(read_tree_model_cache((directory / "missing.bin").string(), source_hash).has_value());
+
+	// The intact file is still fine.
+	EXPECT_TRUE(read_tree_model_cache(path, source_hash).has_value());
+}
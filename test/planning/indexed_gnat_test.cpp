@@ -0,0 +1,136 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "../../src/planning/nearest_neighbours/IndexedGNAT.h"
+#include "../../src/math/Vec3.h"
+
+using namespace mgodpl;
+
+struct EuclideanDistance {
+	double operator()(const math::Vec3d &a, const math::Vec3d &b) const {
+		return (a - b).norm();
+	}
+};
+
+using Index = IndexedGNAT<math::Vec3d, EuclideanDistance>;
+
+/**
+ * Random points, clustered around a few centers such that the tree gets some depth and uneven subtrees.
+ */
+static std::vector<math::Vec3d> random_points(size_t n, std::mt19937 &rng) {
+	std::uniform_real_distribution<double> center_coordinate(-10.0, 10.0);
+	std::normal_distribution<double> offset(0.0, 1.0);
+
+	std::vector<math::Vec3d> centers;
+	for (size_t i = 0; i < 5; ++i) {
+		centers.emplace_back(center_coordinate(rng), center_coordinate(rng), center_coordinate(rng));
+	}
+
+	std::vector<math::Vec3d> points;
+	for (size_t i = 0; i < n; ++i) {
+		const auto &center = centers[i % centers.size()];
+		points.push_back(center + math::Vec3d(offset(rng), offset(rng), offset(rng)));
+	}
+	return points;
+}
+
+/**
+ * The indices of all points, sorted by distance to the query, ties broken on the index as IndexedGNAT does.
+ */
+static std::vector<size_t> brute_force_order(const std::vector<math::Vec3d> &points, const math::Vec3d &query) {
+	std::vector<size_t> order(points.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(),
+	          order.end(),
+	          [&](size_t a, size_t b) {
+		          double da = (points[a] - query).norm();
+		          double db = (points[b] - query).norm();
+		          return da < db || (da == db && a < b);
+	          });
+	return order;
+}
+
+/**
+ * Compare nearestK and nearestR of the index against brute force, on random queries.
+ */
+static void expect_matches_brute_force(const Index &index, const std::vector<math::Vec3d> &points, std::mt19937 &rng) {
+	const auto point_of = [&](size_t i) -> const math::Vec3d & { return points[i]; };
+
+	std::uniform_real_distribution<double> coordinate(-12.0, 12.0);
+	std::uniform_real_distribution<double> radius(0.0, 5.0);
+
+	std::vector<size_t> result;
+
+	for (size_t query_i = 0; query_i < 200; ++query_i) {
+		const math::Vec3d query(coordinate(rng), coordinate(rng), coordinate(rng));
+		const auto expected = brute_force_order(points, query);
+
+		for (size_t k: {(size_t) 1, (size_t) 5, (size_t) 20, points.size() + 1}) {
+			index.nearestK(query, k, point_of, result);
+			const size_t n_expected = std::min(k, points.size());
+			ASSERT_EQ(result, std::vector<size_t>(expected.begin(), expected.begin() + (long) n_expected))
+				<< "nearestK mismatch for k = " << k;
+		}
+
+		const double r = radius(rng);
+		index.nearestR(query, r, point_of, result);
+		std::vector<size_t> within;
+		for (size_t i: expected) {
+			if ((points[i] - query).norm() <= r) {
+				within.push_back(i);
+			}
+		}
+		ASSERT_EQ(result, within) << "nearestR mismatch for r = " << r;
+
+		EXPECT_EQ(index.nearest(query, point_of), expected.front());
+	}
+}
+
+TEST(IndexedGNATTest, IncrementalAddMatchesBruteForce) {
+	std::mt19937 rng(42);
+	const auto points = random_points(2000, rng);
+	const auto point_of = [&](size_t i) -> const math::Vec3d & { return points[i]; };
+
+	Index index;
+	for (size_t i = 0; i < points.size(); ++i) {
+		index.add(i, point_of);
+	}
+	ASSERT_EQ(index.size(), points.size());
+
+	expect_matches_brute_force(index, points, rng);
+}
+
+TEST(IndexedGNATTest, BuildMatchesBruteForce) {
+	std::mt19937 rng(43);
+	const auto points = random_points(2000, rng);
+	const auto point_of = [&](size_t i) -> const math::Vec3d & { return points[i]; };
+
+	std::vector<size_t> indices(points.size());
+	std::iota(indices.begin(), indices.end(), 0);
+
+	Index index;
+	index.build(indices, point_of);
+	ASSERT_EQ(index.size(), points.size());
+
+	expect_matches_brute_force(index, points, rng);
+}
+
+TEST(IndexedGNATTest, SmallIndexMatchesBruteForce) {
+	// Fewer points than a leaf holds, so that the tree is a single node.
+	std::mt19937 rng(44);
+	const auto points = random_points(10, rng);
+	const auto point_of = [&](size_t i) -> const math::Vec3d & { return points[i]; };
+
+	Index index;
+	for (size_t i = 0; i < points.size(); ++i) {
+		index.add(i, point_of);
+	}
+
+	expect_matches_brute_force(index, points, rng);
+}
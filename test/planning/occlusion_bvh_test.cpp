@@ -0,0 +1,206 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <fcl/narrowphase/collision.h>
+#include <fcl/narrowphase/collision_object.h>
+
+#include "../../src/planning/Mesh.h"
+#include "../../src/planning/occlusion_bvh.h"
+#include "../../src/planning/fcl_utils.h"
+
+using namespace mgodpl;
+
+/**
+ * A canopy-like soup of small random triangles, with a few degenerate ones mixed in.
+ */
+static Mesh random_leaves(size_t n, std::mt19937 &rng) {
+	std::uniform_real_distribution<double> coordinate(-1.0, 1.0);
+	std::uniform_real_distribution<double> offset(-0.1, 0.1);
+
+	Mesh mesh;
+	for (size_t i = 0; i < n; ++i) {
+		const math::Vec3d center(coordinate(rng), coordinate(rng), coordinate(rng));
+		const size_t first = mesh.vertices.size();
+		mesh.vertices.push_back(center + math::Vec3d(offset(rng), offset(rng), offset(rng)));
+		mesh.vertices.push_back(center + math::Vec3d(offset(rng), offset(rng), offset(rng)));
+		if (i % 50 == 0) {
+			// Degenerate: a repeated vertex.
+			mesh.vertices.push_back(mesh.vertices[first]);
+		} else {
+			mesh.vertices.push_back(center + math::Vec3d(offset(rng), offset(rng), offset(rng)));
+		}
+		mesh.triangles.push_back({first, first + 1, first + 2});
+	}
+	return mesh;
+}
+
+/**
+ * Scalar Möller-Trumbore against every triangle of the mesh, without any hierarchy.
+ */
+static bool brute_force_intersects(const Mesh &mesh, const OcclusionBvh::Segment &segment) {
+	const math::Vec3d direction = segment.end - segment.start;
+	for (const auto &triangle: mesh.triangles) {
+		const math::Vec3d &v0 = mesh.vertices[triangle[0]];
+		const math::Vec3d edge1 = mesh.vertices[triangle[1]] - v0;
+		const math::Vec3d edge2 = mesh.vertices[triangle[2]] - v0;
+
+		const math::Vec3d p = direction.cross(edge2);
+		const double det = edge1.dot(p);
+		if (det * det < std::numeric_limits<double>::min()) {
+			continue;
+		}
+		const math::Vec3d s = segment.start - v0;
+		const double u = s.dot(p) / det;
+		const math::Vec3d q = s.cross(edge1);
+		const double v = direction.dot(q) / det;
+		const double t = edge2.dot(q) / det;
+		if (u >= 0.0 && u <= 1.0 && v >= 0.0 && u + v <= 1.0 && t >= 0.0 && t <= 1.0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Segments in fans sharing a start point, as in occlusion queries from a viewpoint, plus a few unrelated ones.
+ *
+ * The count is deliberately not a multiple of the SIMD width.
+ */
+static std::vector<OcclusionBvh::Segment> random_segments(std::mt19937 &rng) {
+	std::uniform_real_distribution<double> inside(-1.0, 1.0);
+	std::uniform_real_distribution<double> outside(-3.0, 3.0);
+
+	std::vector<OcclusionBvh::Segment> segments;
+	for (size_t fan_i = 0; fan_i < 20; ++fan_i) {
+		const math::Vec3d viewpoint(outside(rng), outside(rng), outside(rng));
+		for (size_t i = 0; i < 100; ++i) {
+			segments.push_back({viewpoint, {inside(rng), inside(rng), inside(rng)}});
+		}
+	}
+	for (size_t i = 0; i < 203; ++i) {
+		segments.push_back({{outside(rng), outside(rng), outside(rng)}, {inside(rng), inside(rng), inside(rng)}});
+	}
+	return segments;
+}
+
+TEST(OcclusionBvhTest, PacketAndScalarMatchBruteForce) {
+	std::mt19937 rng(42);
+	const Mesh mesh = random_leaves(500, rng);
+	const OcclusionBvh bvh(mesh);
+
+	EXPECT_EQ(bvh.n_triangles(), 490);
+
+	const auto segments = random_segments(rng);
+
+	std::vector<bool> packet_result;
+	bvh.intersects(segments, packet_result);
+	ASSERT_EQ(packet_result.size(), segments.size());
+
+	size_t n_hits = 0;
+	for (size_t i = 0; i < segments.size(); ++i) {
+		const bool expected = brute_force_intersects(mesh, segments[i]);
+		n_hits += expected;
+
+		ASSERT_EQ(packet_result[i], expected) << "Packet mismatch on segment " << i;
+		ASSERT_EQ(bvh.intersects(segments[i]), expected) << "Single-segment mismatch on segment " << i;
+
+		const auto t = bvh.first_hit(segments[i]);
+		ASSERT_EQ(t.has_value(), expected) << "first_hit mismatch on segment " << i;
+		if (t) {
+			EXPECT_GE(*t, 0.0);
+			EXPECT_LE(*t, 1.0);
+			// Nothing lies between the start and the first hit.
+			const OcclusionBvh::Segment before{segments[i].start,
+			                                   segments[i].start + (segments[i].end - segments[i].start) * (*t * 0.999)};
+			EXPECT_FALSE(brute_force_intersects(mesh, before)) << "first_hit is not the first, on segment " << i;
+		}
+	}
+
+	// Both outcomes should be well represented.
+	EXPECT_GT(n_hits, segments.size() / 10);
+	EXPECT_LT(n_hits, segments.size() * 9 / 10);
+}
+
+TEST(OcclusionBvhTest, DeepTreeMatchesBruteForce) {
+	// Triangles at exponentially growing distances along a line, which gives a deep and lopsided tree: the traversal
+	// stack must hold a pending node for nearly every level.
+	Mesh mesh;
+	for (size_t i = 0; i < 64; ++i) {
+		const double x = std::pow(4.0, (double) i);
+		const size_t first = mesh.vertices.size();
+		mesh.vertices.emplace_back(x, -1.0, -1.0);
+		mesh.vertices.emplace_back(x, 1.0, -1.0);
+		mesh.vertices.emplace_back(x, 0.0, 1.0);
+		mesh.triangles.push_back({first, first + 1, first + 2});
+	}
+
+	const OcclusionBvh bvh(mesh);
+	EXPECT_GT(bvh.depth(), 30);
+	EXPECT_LE(bvh.depth(), OcclusionBvh::MAX_DEPTH);
+
+	// Segments along the line from near the origin hit the triangles up to their end; those off the line hit none.
+	std::vector<OcclusionBvh::Segment> segments;
+	for (size_t i = 0; i < 63; ++i) {
+		const double x = std::pow(4.0, (double) i) * 1.1;
+		segments.push_back({{0.5, 0.0, 0.0}, {x, 0.0, 0.0}});
+		segments.push_back({{0.5, 5.0, 0.0}, {x, 5.0, 0.0}});
+	}
+
+	std::vector<bool> packet_result;
+	bvh.intersects(segments, packet_result);
+	for (size_t i = 0; i < segments.size(); ++i) {
+		const bool expected = brute_force_intersects(mesh, segments[i]);
+		ASSERT_EQ(packet_result[i], expected) << "Packet mismatch on segment " << i;
+		ASSERT_EQ(bvh.intersects(segments[i]), expected) << "Single-segment mismatch on segment " << i;
+		ASSERT_EQ(bvh.first_hit(segments[i]).has_value(), expected) << "first_hit mismatch on segment " << i;
+	}
+}
+
+TEST(OcclusionBvhTest, MatchesFcl) {
+	std::mt19937 rng(43);
+	const Mesh mesh = random_leaves(500, rng);
+	const OcclusionBvh bvh(mesh);
+
+	fcl::CollisionObjectd mesh_object(fcl_utils::meshToFclBVH(mesh));
+
+	const auto segments = random_segments(rng);
+
+	std::vector<bool> packet_result;
+	bvh.intersects(segments, packet_result);
+
+	size_t n_compared = 0;
+	for (size_t i = 0; i < segments.size(); ++i) {
+		const auto &segment = segments[i];
+
+		// FCL has no segment shape, so check against a very thin triangle along the segment instead; this agrees
+		// with the segment itself unless the segment grazes an edge, which is the case if its two sides differ.
+		const math::Vec3d direction = segment.end - segment.start;
+		const math::Vec3d side = direction.cross(std::abs(direction.x()) < 0.5 * direction.norm()
+		                                         ? math::Vec3d(1.0, 0.0, 0.0)
+		                                         : math::Vec3d(0.0, 1.0, 0.0)).normalized() * 1.0e-7;
+		if (brute_force_intersects(mesh, {segment.start, segment.end + side}) != packet_result[i]) {
+			continue;
+		}
+
+		Mesh sliver;
+		sliver.vertices = {segment.start, segment.end, segment.end + side};
+		sliver.triangles = {{0, 1, 2}};
+		fcl::CollisionObjectd sliver_object(fcl_utils::meshToFclBVH(sliver));
+
+		fcl::CollisionRequestd request;
+		fcl::CollisionResultd result;
+		fcl::collide(&mesh_object, &sliver_object, request, result);
+
+		++n_compared;
+		ASSERT_EQ(packet_result[i], result.isCollision()) << "FCL mismatch on segment " << i;
+	}
+
+	EXPECT_GT(n_compared, segments.size() * 99 / 100);
+}
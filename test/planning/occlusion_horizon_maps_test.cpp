@@ -0,0 +1,237 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#include "../../src/planning/MeshOcclusionModel.h"
+#include "../../src/planning/occlusion_horizon_maps.h"
+
+using namespace mgodpl;
+
+/**
+ * A few clusters of points with random normals, among a soup of small random triangles.
+ */
+static std::vector<SurfacePointCloud> random_point_clouds(std::mt19937 &rng) {
+	std::uniform_real_distribution<double> coordinate(-0.5, 0.5);
+	std::normal_distribution<double> normal_component(0.0, 1.0);
+
+	std::vector<SurfacePointCloud> clouds;
+	for (size_t cloud_i = 0; cloud_i < 3; ++cloud_i) {
+		const math::Vec3d center(coordinate(rng), coordinate(rng), coordinate(rng));
+		std::vector<SurfacePoint> points;
+		for (size_t i = 0; i < 20 + cloud_i * 7; ++i) {
+			const math::Vec3d normal = math::Vec3d(normal_component(rng),
+												   normal_component(rng),
+												   normal_component(rng)).normalized();
+			points.push_back({center + normal * 0.05, normal});
+		}
+		clouds.push_back(SurfacePointCloud::fromPoints(points));
+	}
+	return clouds;
+}
+
+static Mesh random_leaves(size_t n, std::mt19937 &rng) {
+	std::uniform_real_distribution<double> coordinate(-1.0, 1.0);
+	std::uniform_real_distribution<double> offset(-0.1, 0.1);
+
+	Mesh mesh;
+	for (size_t i = 0; i < n; ++i) {
+		const math::Vec3d center(coordinate(rng), coordinate(rng), coordinate(rng));
+		const size_t first = mesh.vertices.size();
+		for (size_t j = 0; j < 3; ++j) {
+			mesh.vertices.push_back(center + math::Vec3d(offset(rng), offset(rng), offset(rng)));
+		}
+		mesh.triangles.push_back({first, first + 1, first + 2});
+	}
+	return mesh;
+}
+
+/**
+ * Random data to build maps from, and a fresh, empty directory for the cache files of a single test, removed
+ * afterwards.
+ */
+class OcclusionHorizonMapsTest : public ::testing::Test {
+protected:
+	std::filesystem::path directory;
+	std::vector<SurfacePointCloud> clouds;
+	Mesh leaves;
+	OcclusionHorizonMaps::Parameters parameters{
+			.latitude_cells = 8,
+			.longitude_cells = 16,
+			.max_distance = 1.5,
+			.max_scan_angle = M_PI / 2.0,
+			.margin = 0.01
+	};
+
+	void SetUp() override {
+		directory = std::filesystem::temp_directory_path() /
+					("mgodpl_occlusion_horizon_maps_test_" + std::to_string(std::random_device{}()));
+		std::filesystem::create_directories(directory);
+
+		std::mt19937 rng(42);
+		clouds = random_point_clouds(rng);
+		leaves = random_leaves(200, rng);
+	}
+
+	void TearDown() override {
+		std::filesystem::remove_all(directory);
+	}
+
+	/**
+	 * Expect both maps to give the same answer for every point, from a number of random eyes.
+	 *
+	 * @return 	The number of occluded (point, eye) pairs, to check that both answers are represented.
+	 */
+	size_t expect_same_answers(const OcclusionHorizonMaps &expected, const OcclusionHorizonMaps &actual) const {
+		std::mt19937 rng(43);
+		std::uniform_real_distribution<double> coordinate(-1.0, 1.0);
+
+		size_t n_occluded = 0;
+		for (size_t eye_i = 0; eye_i < 50; ++eye_i) {
+			const math::Vec3d eye(coordinate(rng), coordinate(rng), coordinate(rng));
+			for (size_t cloud_i = 0; cloud_i < clouds.size(); ++cloud_i) {
+				for (size_t point_i = 0; point_i < clouds[cloud_i].size; ++point_i) {
+					const math::Vec3d point = clouds[cloud_i].get(point_i).position;
+					const bool occluded = expected.checkOcclusion(cloud_i, point_i, point, eye);
+					EXPECT_EQ(actual.checkOcclusion(cloud_i, point_i, point, eye), occluded);
+					n_occluded += occluded;
+				}
+			}
+		}
+		return n_occluded;
+	}
+};
+
+TEST_F(OcclusionHorizonMapsTest, SaveLoadRoundTrip) {
+	const OcclusionHorizonMaps maps = OcclusionHorizonMaps::build(clouds, leaves, parameters);
+	const std::string path = directory / "maps.bin";
+	ASSERT_TRUE(maps.save(path));
+
+	const auto loaded = OcclusionHorizonMaps::load(path, OcclusionHorizonMaps::fingerprint(clouds, leaves, parameters));
+	ASSERT_TRUE(loaded.has_value());
+
+	EXPECT_EQ(loaded->parameters().latitude_cells, parameters.latitude_cells);
+	EXPECT_EQ(loaded->parameters().longitude_cells, parameters.longitude_cells);
+	EXPECT_EQ(loaded->parameters().max_distance, parameters.max_distance);
+	EXPECT_EQ(loaded->parameters().max_scan_angle, parameters.max_scan_angle);
+	EXPECT_EQ(loaded->parameters().margin, parameters.margin);
+	EXPECT_EQ(loaded->size_bytes(), maps.size_bytes());
+
+	const size_t n_occluded = expect_same_answers(maps, *loaded);
+	EXPECT_GT(n_occluded, 0);
+}
+
+TEST_F(OcclusionHorizonMapsTest, RejectsOtherFingerprints) {
+	const uint64_t key = OcclusionHorizonMaps::fingerprint(clouds, leaves, parameters);
+	const std::string path = directory / "maps.bin";
+	ASSERT_TRUE(OcclusionHorizonMaps::build(clouds, leaves, parameters).save(path));
+
+	EXPECT_FALSE(OcclusionHorizonMaps::load(path, key + 1).has_value());
+
+	// Any change to the inputs changes the fingerprint.
+	OcclusionHorizonMaps::Parameters other_parameters = parameters;
+	other_parameters.margin = 0.02;
+	EXPECT_NE(OcclusionHorizonMaps::fingerprint(clouds, leaves, other_parameters), key);
+
+	Mesh other_leaves = leaves;
+	other_leaves.vertices[0].x() += 1.0e-9;
+	EXPECT_NE(OcclusionHorizonMaps::fingerprint(clouds, other_leaves, parameters), key);
+
+	std::vector<SurfacePointCloud> other_clouds(clouds.begin(), clouds.end() - 1);
+	EXPECT_NE(OcclusionHorizonMaps::fingerprint(other_clouds, leaves, parameters), key);
+
+	EXPECT_TRUE(OcclusionHorizonMaps::load(path, key).has_value());
+}
+
+TEST_F(OcclusionHorizonMapsTest, RejectsTruncatedFiles) {
+	const uint64_t key = OcclusionHorizonMaps::fingerprint(clouds, leaves, parameters);
+	const std::string path = directory / "maps.bin";
+	ASSERT_TRUE(OcclusionHorizonMaps::build(clouds, leaves, parameters).save(path));
+
+	const auto full_size = (size_t) std::filesystem::file_size(path);
+	std::vector<char> contents(full_size);
+	std::ifstream(path, std::ios::binary).read(contents.data(), (std::streamsize) full_size);
+
+	// Truncated anywhere: inside the magic number, the header, the cloud offsets, or the distances.
+	const std::string truncated_path = directory / "truncated.bin";
+	for (size_t size: {(size_t) 0, (size_t) 5, (size_t) 12, (size_t) 40, (size_t) 60, (size_t) 70, (size_t) 100,
+					   full_size / 2, full_size - 1}) {
+		std::ofstream(truncated_path, std::ios::binary | std::ios::trunc).write(contents.data(), (std::streamsize) size);
+		EXPECT_FALSE(OcclusionHorizonMaps::load(truncated_path, key).has_value()) << "Truncated to " << size;
+	}
+
+	EXPECT_FALSE(OcclusionHorizonMaps::load((directory / "missing.bin").string(), key).has_value());
+}
+
+TEST_F(OcclusionHorizonMapsTest, LoadOrBuildReusesTheCache) {
+	const std::filesystem::path cache_directory = directory / "cache";
+
+	// The first call creates the directory and stores the maps in it.
+	const OcclusionHorizonMaps built = OcclusionHorizonMaps::load_or_build(cache_directory, clouds, leaves, parameters);
+	ASSERT_TRUE(std::filesystem::is_directory(cache_directory));
+	const std::vector<std::filesystem::path> files(std::filesystem::directory_iterator(cache_directory), {});
+	ASSERT_EQ(files.size(), 1);
+	const auto key = OcclusionHorizonMaps::fingerprint(clouds, leaves, parameters);
+	EXPECT_TRUE(OcclusionHorizonMaps::load(files[0].string(), key).has_value());
+
+	// Mark the cached file, so that it shows whether the second call reads it rather than rebuilding: the last byte
+	// is the distance of the last cell of the last point.
+	{
+		std::fstream file(files[0], std::ios::binary | std::ios::in | std::ios::out);
+		file.seekp(-1, std::ios::end);
+		file.put((char) 0);
+	}
+	const OcclusionHorizonMaps cached = OcclusionHorizonMaps::load_or_build(cache_directory, clouds, leaves, parameters);
+	const size_t last_cloud = clouds.size() - 1;
+	const size_t last_point = clouds[last_cloud].size - 1;
+	const math::Vec3d point = clouds[last_cloud].get(last_point).position;
+	// The last cell is at the top latitude and the largest longitude.
+	const math::Vec3d eye = point + math::Vec3d(std::cos(M_PI - 0.1), std::sin(M_PI - 0.1), 20.0).normalized() * 0.5;
+	EXPECT_TRUE(cached.checkOcclusion(last_cloud, last_point, point, eye));
+
+	// A corrupt cache file is rebuilt and overwritten.
+	std::filesystem::resize_file(files[0], 10);
+	const OcclusionHorizonMaps rebuilt = OcclusionHorizonMaps::load_or_build(cache_directory, clouds, leaves, parameters);
+	expect_same_answers(built, rebuilt);
+	EXPECT_TRUE(OcclusionHorizonMaps::load(files[0].string(), key).has_value());
+}
+
+TEST(OcclusionHorizonMapsQuadTest, AgreesWithMeshOcclusionModel) {
+	// A large quad at z = 0.5, above some points on the plane z = 0 that face it.
+	Mesh quad;
+	quad.vertices = {{-2.0, -2.0, 0.5}, {2.0, -2.0, 0.5}, {2.0, 2.0, 0.5}, {-2.0, 2.0, 0.5}};
+	quad.triangles = {{0, 1, 2}, {0, 2, 3}};
+
+	std::vector<SurfacePoint> points;
+	for (const double x: {-0.13, 0.02, 0.21}) {
+		for (const double y: {-0.17, 0.09}) {
+			points.push_back({{x, y, 0.0}, {0.0, 0.0, 1.0}});
+		}
+	}
+	const std::vector<SurfacePointCloud> clouds{SurfacePointCloud::fromPoints(points)};
+
+	const OcclusionHorizonMaps maps = OcclusionHorizonMaps::build(clouds, quad, {.max_distance = 2.0});
+	const MeshOcclusionModel model(quad, 0.0);
+
+	for (size_t point_i = 0; point_i < points.size(); ++point_i) {
+		const math::Vec3d &point = points[point_i].position;
+		for (const double x: {-0.4, -0.05, 0.3}) {
+			for (const double y: {-0.35, 0.15, 0.4}) {
+				// Between the point and the quad: visible.
+				const math::Vec3d in_front(x, y, 0.3);
+				EXPECT_FALSE(model.checkOcclusion(point, in_front));
+				EXPECT_FALSE(maps.checkOcclusion(0, point_i, point, in_front)) << "Eye at " << in_front;
+
+				// Beyond the quad: occluded.
+				const math::Vec3d behind(x, y, 1.0);
+				EXPECT_TRUE(model.checkOcclusion(point, behind));
+				EXPECT_TRUE(maps.checkOcclusion(0, point_i, point, behind)) << "Eye at " << behind;
+			}
+		}
+	}
+}
@@ -0,0 +1,107 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+
+#include "../../src/planning/RobotState.h"
+#include "../../src/planning/RobotPath.h"
+#include "../../src/planning/RandomNumberGenerator.h"
+#include "../../src/planning/distance.h"
+
+import rrt;
+
+using namespace mgodpl;
+
+/**
+ * A state of a robot that only translates in the XY-plane, with a few joint values that do not affect collisions.
+ */
+static RobotState planar_state(double x, double y, JointValues joint_values = {}) {
+	return RobotState{
+		.base_tf = math::Transformd::fromTranslation({x, y, 0.0}),
+		.joint_values = std::move(joint_values)
+	};
+}
+
+TEST(RRTTest, NearestNeighboursMatchBruteForce) {
+	random_numbers::RandomNumberGenerator rng(42);
+
+	const DistanceFn distance = equal_weights_distance;
+
+	auto random_state = [&]() {
+		return planar_state(rng.uniformReal(-10.0, 10.0),
+		                    rng.uniformReal(-10.0, 10.0),
+		                    {rng.uniformReal(-M_PI, M_PI), rng.uniformReal(-M_PI, M_PI)});
+	};
+
+	// The tree grows while it is being queried, as it does in the RRT.
+	std::vector<RRTNode> nodes;
+	RRTNearestNeighbours nearest_neighbours(nodes, distance);
+
+	size_t mismatches = 0;
+
+	for (size_t query_i = 0; query_i < 3000; ++query_i) {
+		nodes.push_back({random_state(), 0});
+		nearest_neighbours.add(nodes.size() - 1);
+
+		const RobotState query = random_state();
+
+		double best_distance = INFINITY;
+		for (const auto &node: nodes) {
+			best_distance = std::min(best_distance, distance(node.state, query));
+		}
+
+		// Ties are allowed to go either way, so compare distances rather than indices.
+		if (distance(nodes[nearest_neighbours.nearest(query)].state, query) != best_distance) {
+			++mismatches;
+		}
+	}
+
+	EXPECT_EQ(mismatches, 0);
+}
+
+TEST(RRTTest, RRTConnectFindsPathAroundWall) {
+	random_numbers::RandomNumberGenerator rng(42);
+
+	// A wall across the straight line between the start and the goal, with room to pass on either side.
+	const auto in_wall = [](const RobotState &state) {
+		const auto &p = state.base_tf.translation;
+		return std::abs(p.x()) < 0.5 && std::abs(p.y()) < 3.0;
+	};
+
+	// Check motions at a resolution much finer than the wall is thick.
+	const auto motion_collides = [&](const RobotState &a, const RobotState &b) {
+		const size_t n_steps = std::max((size_t) 1, (size_t) std::ceil(equal_weights_distance(a, b) / 0.01));
+		for (size_t step_i = 0; step_i <= n_steps; ++step_i) {
+			if (in_wall(interpolate(a, b, (double) step_i / (double) n_steps))) {
+				return true;
+			}
+		}
+		return false;
+	};
+
+	const RobotState start = planar_state(-5.0, 0.0);
+	const RobotState goal = planar_state(5.0, 0.0);
+
+	ASSERT_TRUE(motion_collides(start, goal));
+
+	auto path = rrt_connect(
+		start,
+		goal,
+		[&]() { return planar_state(rng.uniformReal(-10.0, 10.0), rng.uniformReal(-10.0, 10.0)); },
+		in_wall,
+		motion_collides,
+		equal_weights_distance,
+		1000);
+
+	ASSERT_TRUE(path.has_value());
+	ASSERT_GE(path->states.size(), 3);
+	EXPECT_EQ(path->states.front(), start);
+	EXPECT_EQ(path->states.back(), goal);
+
+	for (size_t i = 0; i + 1 < path->states.size(); ++i) {
+		EXPECT_FALSE(motion_collides(path->states[i], path->states[i + 1])) << "Segment " << i << " collides";
+	}
+}
@@ -0,0 +1,140 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "../../src/planning/traveling_salesman.h"
+#include "../../src/math/Vec3.h"
+
+using namespace mgodpl;
+
+/**
+ * The length of an open tour from the origin through the given points.
+ */
+static double open_tour_length(const std::vector<math::Vec3d> &points, const std::vector<size_t> &tour) {
+	double length = 0.0;
+	math::Vec3d previous{0, 0, 0};
+	for (size_t i: tour) {
+		length += (points[i] - previous).norm();
+		previous = points[i];
+	}
+	return length;
+}
+
+TEST(TravelingSalesmanTest, NativeIsPermutationAndNearOptimal) {
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<double> coordinate(-10.0, 10.0);
+
+	for (size_t trial = 0; trial < 50; ++trial) {
+		const size_t n = 1 + trial % 8;
+
+		std::vector<math::Vec3d> points;
+		for (size_t i = 0; i < n; ++i) {
+			points.emplace_back(coordinate(rng), coordinate(rng), coordinate(rng));
+		}
+
+		auto tour = tsp_open_end(
+				[&](size_t i) { return points[i].norm(); },
+				[&](size_t i, size_t j) { return (points[i] - points[j]).norm(); },
+				n,
+				TspSolver::NATIVE);
+
+		// Must visit every point exactly once.
+		std::vector<size_t> sorted = tour;
+		std::sort(sorted.begin(), sorted.end());
+		std::vector<size_t> expected(n);
+		std::iota(expected.begin(), expected.end(), 0);
+		ASSERT_EQ(sorted, expected);
+
+		// Compare against the optimum, by brute force.
+		std::vector<size_t> permutation = expected;
+		double optimum = std::numeric_limits<double>::infinity();
+		do {
+			optimum = std::min(optimum, open_tour_length(points, permutation));
+		} while (std::next_permutation(permutation.begin(), permutation.end()));
+
+		EXPECT_LE(open_tour_length(points, tour), optimum * 1.25 + 1.0e-9);
+	}
+}
+
+TEST(TravelingSalesmanTest, NativeGroupedVisitsEveryNonEmptyGroupOnce) {
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<double> coordinate(-10.0, 10.0);
+
+	const std::vector<size_t> sizes = {2, 0, 3, 1, 2};
+
+	std::vector<std::vector<math::Vec3d> > points(sizes.size());
+	for (size_t group = 0; group < sizes.size(); ++group) {
+		for (size_t j = 0; j < sizes[group]; ++j) {
+			points[group].emplace_back(coordinate(rng), coordinate(rng), coordinate(rng));
+		}
+	}
+
+	auto tour = tsp_open_end_grouped(
+			[&](std::pair<size_t, size_t> a) { return points[a.first][a.second].norm(); },
+			[&](std::pair<size_t, size_t> a, std::pair<size_t, size_t> b) {
+				return (points[a.first][a.second] - points[b.first][b.second]).norm();
+			},
+			sizes,
+			TspSolver::NATIVE);
+
+	std::vector<size_t> groups;
+	for (const auto &[group, item]: tour) {
+		ASSERT_LT(item, sizes[group]);
+		groups.push_back(group);
+	}
+	std::sort(groups.begin(), groups.end());
+	EXPECT_EQ(groups, (std::vector<size_t>{0, 2, 3, 4}));
+}
+
+TEST(TravelingSalesmanTest, NativeGroupedTerminatesWithUnreachableGoal) {
+	// Goals 0 and 1 are close together; goal 2 is unreachable from everywhere.
+	for (double unreachable: {std::numeric_limits<double>::max(), std::numeric_limits<double>::infinity()}) {
+		const std::vector<double> from_start = {1.0, 2.0, unreachable};
+		const std::vector<double> between = {
+				0.0, 1.0, unreachable,
+				1.0, 0.0, unreachable,
+				unreachable, unreachable, 0.0
+		};
+
+		auto tour = tsp_open_end_grouped_native(from_start.data(), between.data(), {1, 1, 1});
+		EXPECT_EQ(tour, (std::vector<size_t>{0, 1, 2}));
+
+		auto ungrouped = tsp_open_end_native(from_start.data(), between.data(), 3);
+		EXPECT_EQ(ungrouped, (std::vector<size_t>{0, 1, 2}));
+	}
+}
+
+TEST(TravelingSalesmanTest, NativeGroupedTerminatesWithLargeCoordinates) {
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<double> coordinate(-3.0e7, 3.0e7);
+
+	const std::vector<size_t> sizes = {3, 2, 4, 1, 3, 2};
+
+	std::vector<std::vector<math::Vec3d> > points(sizes.size());
+	for (size_t group = 0; group < sizes.size(); ++group) {
+		for (size_t j = 0; j < sizes[group]; ++j) {
+			points[group].emplace_back(coordinate(rng), coordinate(rng), coordinate(rng));
+		}
+	}
+
+	auto tour = tsp_open_end_grouped(
+			[&](std::pair<size_t, size_t> a) { return points[a.first][a.second].norm(); },
+			[&](std::pair<size_t, size_t> a, std::pair<size_t, size_t> b) {
+				return (points[a.first][a.second] - points[b.first][b.second]).norm();
+			},
+			sizes,
+			TspSolver::NATIVE);
+
+	std::vector<size_t> groups;
+	for (const auto &[group, item]: tour) {
+		ASSERT_LT(item, sizes[group]);
+		groups.push_back(group);
+	}
+	std::sort(groups.begin(), groups.end());
+	EXPECT_EQ(groups, (std::vector<size_t>{0, 1, 2, 3, 4, 5}));
+}
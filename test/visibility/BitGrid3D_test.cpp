@@ -0,0 +1,226 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "../../src/visibility/BitGrid3D.h"
+
+using namespace mgodpl;
+
+/**
+ * A plain, one-bool-per-cell grid to compare the packed grid against.
+ */
+struct ReferenceGrid {
+	size_t nx, ny, nz;
+	std::vector<bool> cells;
+
+	ReferenceGrid(size_t nx, size_t ny, size_t nz) : nx(nx), ny(ny), nz(nz), cells(nx * ny * nz, false) {
+	}
+
+	std::vector<bool>::reference at(size_t x, size_t y, size_t z) {
+		return cells[(x * ny + y) * nz + z];
+	}
+
+	[[nodiscard]] size_t count() const {
+		return std::count(cells.begin(), cells.end(), true);
+	}
+};
+
+static void expect_equal(const BitGrid3D &grid, ReferenceGrid &reference) {
+	for (size_t x = 0; x < reference.nx; ++x) {
+		for (size_t y = 0; y < reference.ny; ++y) {
+			for (size_t z = 0; z < reference.nz; ++z) {
+				ASSERT_EQ(grid.get(x, y, z), reference.at(x, y, z)) << "at " << x << ", " << y << ", " << z;
+				ASSERT_EQ(grid[math::Vec3i((int) x, (int) y, (int) z)], reference.at(x, y, z));
+			}
+		}
+	}
+	EXPECT_EQ(grid.count(), reference.count());
+}
+
+/// Whether all padding bits (past nz in the last word of every row) are zero.
+static bool padding_is_zero(const BitGrid3D &grid) {
+	const size_t nz = grid.size().z();
+	if (nz % BitGrid3D::WORD_BITS == 0) {
+		return true;
+	}
+	const BitGrid3D::Word padding = ~BitGrid3D::Word(0) << (nz % BitGrid3D::WORD_BITS);
+	for (size_t row_i = 0; row_i < grid.data().size() / grid.words_per_row(); ++row_i) {
+		if ((grid.data()[(row_i + 1) * grid.words_per_row() - 1] & padding) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+TEST(BitGrid3DTest, SetRangeAcrossWordBoundaries) {
+	std::mt19937 rng(42);
+
+	// nz spans several words, and is not a multiple of the word size.
+	const size_t nx = 3, ny = 4, nz = 200;
+
+	BitGrid3D grid(nx, ny, nz);
+	ReferenceGrid reference(nx, ny, nz);
+
+	std::uniform_int_distribution<size_t> x_dist(0, nx - 1), y_dist(0, ny - 1), z_dist(0, nz - 1);
+
+	for (size_t i = 0; i < 100; ++i) {
+		const size_t x = x_dist(rng), y = y_dist(rng);
+		size_t z_min = z_dist(rng), z_max = z_dist(rng);
+		if (z_min > z_max) {
+			std::swap(z_min, z_max);
+		}
+
+		grid.set_range(x, y, z_min, z_max);
+		for (size_t z = z_min; z <= z_max; ++z) {
+			reference.at(x, y, z) = true;
+		}
+	}
+
+	// Ranges ending and starting exactly at word boundaries.
+	grid.set_range(0, 0, 63, 64);
+	grid.set_range(1, 1, 0, 63);
+	grid.set_range(2, 2, 128, nz - 1);
+	for (size_t z: {63, 64}) {
+		reference.at(0, 0, z) = true;
+	}
+	for (size_t z = 0; z <= 63; ++z) {
+		reference.at(1, 1, z) = true;
+	}
+	for (size_t z = 128; z < nz; ++z) {
+		reference.at(2, 2, z) = true;
+	}
+
+	expect_equal(grid, reference);
+	EXPECT_TRUE(padding_is_zero(grid));
+
+	// An empty range does nothing.
+	grid.set_range(0, 3, 10, 9);
+	expect_equal(grid, reference);
+}
+
+TEST(BitGrid3DTest, AllInRangeAcrossWordBoundaries) {
+	std::mt19937 rng(43);
+
+	const size_t nx = 2, ny = 2, nz = 150;
+
+	BitGrid3D grid(nx, ny, nz);
+	ReferenceGrid reference(nx, ny, nz);
+
+	// Set about 90% of the cells, so that both outcomes are common.
+	std::bernoulli_distribution set_cell(0.9);
+	for (size_t x = 0; x < nx; ++x) {
+		for (size_t y = 0; y < ny; ++y) {
+			for (size_t z = 0; z < nz; ++z) {
+				if (set_cell(rng)) {
+					grid.set(x, y, z);
+					reference.at(x, y, z) = true;
+				}
+			}
+		}
+	}
+
+	std::uniform_int_distribution<size_t> z_dist(0, nz - 1);
+
+	size_t n_true = 0;
+	for (size_t i = 0; i < 2000; ++i) {
+		const size_t x = i % nx, y = (i / nx) % ny;
+		size_t z_min = z_dist(rng), z_max = z_min + z_dist(rng) % 10;
+		z_max = std::min(z_max, nz - 1);
+
+		bool expected = true;
+		for (size_t z = z_min; z <= z_max; ++z) {
+			expected &= reference.at(x, y, z);
+		}
+
+		ASSERT_EQ(grid.all_in_range(x, y, z_min, z_max), expected) << z_min << ".." << z_max;
+		n_true += expected;
+	}
+	EXPECT_GT(n_true, 0);
+
+	// An empty range is vacuously all true.
+	EXPECT_TRUE(grid.all_in_range(0, 0, 10, 9));
+
+	// A full row, across all words.
+	grid.set_range(1, 1, 0, nz - 1);
+	EXPECT_TRUE(grid.all_in_range(1, 1, 0, nz - 1));
+}
+
+TEST(BitGrid3DTest, FillAndCountWithPartialWords) {
+	for (size_t nz: {1, 63, 64, 65, 100, 128, 130}) {
+		BitGrid3D grid(3, 5, nz, true);
+
+		EXPECT_EQ(grid.count(), 3 * 5 * nz) << "nz = " << nz;
+		EXPECT_TRUE(padding_is_zero(grid)) << "nz = " << nz;
+		EXPECT_TRUE(grid.all_in_range(2, 4, 0, nz - 1));
+
+		for (size_t x = 0; x < 3; ++x) {
+			EXPECT_EQ(grid.count_slab(x), 5 * nz);
+		}
+
+		grid[math::Vec3i(1, 2, (int) nz - 1)] = false;
+		EXPECT_EQ(grid.count(), 3 * 5 * nz - 1);
+		EXPECT_EQ(grid.count_slab(1), 5 * nz - 1);
+		EXPECT_FALSE(grid.all_in_range(1, 2, 0, nz - 1));
+
+		grid.fill(false);
+		EXPECT_EQ(grid.count(), 0);
+	}
+}
+
+TEST(BitGrid3DTest, OrSlabOnlyTouchesThatSlab) {
+	std::mt19937 rng(44);
+	std::bernoulli_distribution set_cell(0.3);
+
+	const size_t nx = 4, ny = 3, nz = 70;
+
+	BitGrid3D a(nx, ny, nz), b(nx, ny, nz);
+	ReferenceGrid reference_a(nx, ny, nz), reference_b(nx, ny, nz);
+
+	for (size_t x = 0; x < nx; ++x) {
+		for (size_t y = 0; y < ny; ++y) {
+			for (size_t z = 0; z < nz; ++z) {
+				if (set_cell(rng)) {
+					a.set(x, y, z);
+					reference_a.at(x, y, z) = true;
+				}
+				if (set_cell(rng)) {
+					b.set(x, y, z);
+					reference_b.at(x, y, z) = true;
+				}
+			}
+		}
+	}
+
+	a.or_slab(2, b);
+	for (size_t y = 0; y < ny; ++y) {
+		for (size_t z = 0; z < nz; ++z) {
+			reference_a.at(2, y, z) = reference_a.at(2, y, z) || reference_b.at(2, y, z);
+		}
+	}
+	expect_equal(a, reference_a);
+
+	// The whole-grid operators agree with the cell-wise ones.
+	BitGrid3D or_grid = a;
+	or_grid |= b;
+	BitGrid3D and_grid = a;
+	and_grid &= b;
+	for (size_t x = 0; x < nx; ++x) {
+		for (size_t y = 0; y < ny; ++y) {
+			for (size_t z = 0; z < nz; ++z) {
+				ASSERT_EQ(or_grid.get(x, y, z), reference_a.at(x, y, z) || reference_b.at(x, y, z));
+				ASSERT_EQ(and_grid.get(x, y, z), reference_a.at(x, y, z) && reference_b.at(x, y, z));
+			}
+		}
+	}
+
+	// OR-ing every slab is the same as the whole-grid OR.
+	for (size_t x = 0; x < nx; ++x) {
+		a.or_slab(x, b);
+	}
+	EXPECT_EQ(a, or_grid);
+}
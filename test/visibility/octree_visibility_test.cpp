@@ -0,0 +1,214 @@
+// Copyright (c) 2024 University College Roosevelt
+//
+// All rights reserved.
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include <tbb/task_arena.h>
+
+#include "../../src/math/AABBGrid.h"
+#include "../../src/math/Triangle.h"
+#include "../../src/visibility/GridVec.h"
+#include "../../src/visibility/Octree.h"
+#include "../../src/visibility/octree_visibility.h"
+#include "../../src/visibility/voxel_visibility.h"
+
+using namespace mgodpl;
+using namespace mgodpl::visibility;
+
+/**
+ * Whether the segment from a to b crosses the triangle (Möller-Trumbore), excluding its end points.
+ */
+static bool segment_crosses_triangle(const math::Vec3d &a, const math::Vec3d &b, const math::Triangle &triangle) {
+	const math::Vec3d direction = b - a;
+	const math::Vec3d edge1 = triangle.b - triangle.a;
+	const math::Vec3d edge2 = triangle.c - triangle.a;
+	const math::Vec3d h = direction.cross(edge2);
+	const double det = edge1.dot(h);
+	if (std::abs(det) < 1.0e-12) {
+		return false;
+	}
+	const math::Vec3d s = a - triangle.a;
+	const double u = s.dot(h) / det;
+	if (u < 0.0 || u > 1.0) {
+		return false;
+	}
+	const math::Vec3d q = s.cross(edge1);
+	const double v = direction.dot(q) / det;
+	if (v < 0.0 || u + v > 1.0) {
+		return false;
+	}
+	const double t = edge2.dot(q) / det;
+	return t > 0.0 && t < 1.0;
+}
+
+/**
+ * Whether any of a regular lattice of sample points inside a cell is hidden from the eye by one of the triangles.
+ */
+static bool cell_is_partly_occluded(const math::AABBd &cell,
+                                    const std::vector<math::Triangle> &triangles,
+                                    const math::Vec3d &eye) {
+	const int SAMPLES_PER_SIDE = 4;
+	for (int i = 0; i < SAMPLES_PER_SIDE; ++i) {
+		for (int j = 0; j < SAMPLES_PER_SIDE; ++j) {
+			for (int k = 0; k < SAMPLES_PER_SIDE; ++k) {
+				const math::Vec3d sample(
+					cell.min().x() + (i + 0.5) / SAMPLES_PER_SIDE * cell.size().x(),
+					cell.min().y() + (j + 0.5) / SAMPLES_PER_SIDE * cell.size().y(),
+					cell.min().z() + (k + 0.5) / SAMPLES_PER_SIDE * cell.size().z());
+				for (const auto &triangle: triangles) {
+					if (segment_crosses_triangle(eye, sample, triangle)) {
+						return true;
+					}
+				}
+			}
+		}
+	}
+	return false;
+}
+
+TEST(OctreeVisibilityTest, FromCellsRoundTripsThroughAt) {
+	std::mt19937 rng(42);
+
+	const unsigned max_depth = 4;
+	const uint32_t resolution = 1 << max_depth;
+
+	// Random cells, but with solid blocks, so that the builder has siblings to merge.
+	std::bernoulli_distribution solid_block(0.5), random_cell(0.5);
+	std::vector<bool> block_solid(64);
+	for (auto &&b: block_solid) {
+		b = solid_block(rng);
+	}
+	std::vector<bool> cells(resolution * resolution * resolution);
+	auto cell_index = [&](uint32_t x, uint32_t y, uint32_t z) {
+		return (x * resolution + y) * resolution + z;
+	};
+	for (uint32_t x = 0; x < resolution; ++x) {
+		for (uint32_t y = 0; y < resolution; ++y) {
+			for (uint32_t z = 0; z < resolution; ++z) {
+				const bool in_solid_block = block_solid[(x / 4) * 16 + (y / 4) * 4 + z / 4];
+				cells[cell_index(x, y, z)] = in_solid_block || random_cell(rng);
+			}
+		}
+	}
+
+	const auto octree = VisibilityOctree::from_cells(max_depth, [&](uint32_t x, uint32_t y, uint32_t z) {
+		return (bool) cells[cell_index(x, y, z)];
+	});
+
+	for (uint32_t x = 0; x < resolution; ++x) {
+		for (uint32_t y = 0; y < resolution; ++y) {
+			for (uint32_t z = 0; z < resolution; ++z) {
+				ASSERT_EQ(octree.at(x, y, z), cells[cell_index(x, y, z)]) << x << ", " << y << ", " << z;
+			}
+		}
+	}
+
+	// The solid blocks must have been merged into larger leaves.
+	EXPECT_LT(octree.leaves().size(), cells.size());
+
+	// The tree is canonical: no eight equal siblings remain.
+	for (size_t i = 0; i + 8 <= octree.leaves().size(); ++i) {
+		const auto &first = octree.leaves()[i];
+		if (first.depth == 0 || first.code % VisibilityOctree::cells_below(max_depth, first.depth - 1) != 0) {
+			continue;
+		}
+		bool all_equal = true;
+		for (size_t j = i; j < i + 8; ++j) {
+			all_equal &= octree.leaves()[j].depth == first.depth && octree.leaves()[j].data == first.data;
+		}
+		EXPECT_FALSE(all_equal) << "Unmerged siblings at leaf " << i;
+	}
+
+	// A uniform grid collapses into a single leaf.
+	const auto uniform = VisibilityOctree::from_cells(max_depth, [](uint32_t, uint32_t, uint32_t) { return true; });
+	EXPECT_EQ(uniform.leaves().size(), 1);
+}
+
+TEST(OctreeVisibilityTest, DivideAndConquerCoversOcclusion) {
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<double> coordinate(-0.6, 0.6);
+	std::uniform_real_distribution<double> offset(-0.3, 0.3);
+
+	const math::AABBd volume({-1.0, -1.0, -1.0}, {1.0, 1.0, 1.0});
+	const math::Vec3d eye(3.0, 0.1, 0.2);
+
+	// A handful of small random triangles inside the volume, like leaves in a canopy.
+	std::vector<math::Triangle> triangles;
+	for (size_t i = 0; i < 20; ++i) {
+		const math::Vec3d center(coordinate(rng), coordinate(rng), coordinate(rng));
+		triangles.emplace_back(center + math::Vec3d(offset(rng), offset(rng), offset(rng)),
+		                       center + math::Vec3d(offset(rng), offset(rng), offset(rng)),
+		                       center + math::Vec3d(offset(rng), offset(rng), offset(rng)));
+	}
+
+	for (unsigned depth: {3, 4}) {
+		const size_t resolution = size_t(1) << depth;
+		const math::AABBGrid grid(volume, resolution, resolution, resolution);
+
+		const Grid3D<bool> dense = voxel_visibility::cast_occlusion(grid, triangles, eye);
+		const auto dnc = cast_occlusion_batch_dnc(volume, triangles, eye, depth);
+		const Grid3D<bool> dnc_grid = to_grid(dnc);
+
+		EXPECT_EQ(count_occluded(dnc), dnc_grid.count());
+
+		// The dense grid bounds the shadows by axis-aligned slabs, so it is not exact in either direction. Compare
+		// both against sampling instead: the octree treats partially occluded cells at the finest level as occluded,
+		// so it must cover every cell that is even partly in a shadow; in particular, those the dense grid agrees on.
+		size_t n_occluded = 0, n_agreed = 0;
+		for (int x = 0; x < (int) resolution; ++x) {
+			for (int y = 0; y < (int) resolution; ++y) {
+				for (int z = 0; z < (int) resolution; ++z) {
+					const math::Vec3i cell(x, y, z);
+					if (!cell_is_partly_occluded(*grid.getAABB(cell), triangles, eye)) {
+						continue;
+					}
+					++n_occluded;
+					n_agreed += dense[cell];
+					ASSERT_TRUE(dnc_grid[cell]) << "depth " << depth << ", cell " << x << ", " << y << ", " << z;
+				}
+			}
+		}
+
+		ASSERT_GT(n_occluded, 0) << "The scene should occlude something";
+		EXPECT_GT(n_agreed, 0);
+
+		// Casting in sorted batches into an existing tree gives the same union of shadows.
+		const auto sorting = cast_occlusion_batch_sorting(volume, triangles, eye, depth, 4);
+		EXPECT_EQ(to_grid(sorting), dnc_grid) << "depth " << depth;
+	}
+}
+
+TEST(OctreeVisibilityTest, DenseCastIsIndependentOfThreadCount) {
+	std::mt19937 rng(43);
+	std::uniform_real_distribution<double> coordinate(-0.6, 0.6);
+	std::uniform_real_distribution<double> offset(-0.3, 0.3);
+
+	const math::AABBd volume({-1.0, -1.0, -1.0}, {1.0, 1.0, 1.0});
+	const math::AABBGrid grid(volume, 32, 32, 32);
+	const math::Vec3d eye(3.0, 0.1, 0.2);
+
+	std::vector<math::Triangle> triangles;
+	for (size_t i = 0; i < 200; ++i) {
+		const math::Vec3d center(coordinate(rng), coordinate(rng), coordinate(rng));
+		triangles.emplace_back(center + math::Vec3d(offset(rng), offset(rng), offset(rng)),
+		                       center + math::Vec3d(offset(rng), offset(rng), offset(rng)),
+		                       center + math::Vec3d(offset(rng), offset(rng), offset(rng)));
+	}
+
+	// With the default chunking, the (order-dependent) culling must not depend on how many threads there are.
+	std::optional<Grid3D<bool> > single_threaded, multi_threaded;
+	tbb::task_arena(1).execute([&]() {
+		single_threaded = voxel_visibility::cast_occlusion(grid, triangles, eye);
+	});
+	tbb::task_arena(4).execute([&]() {
+		multi_threaded = voxel_visibility::cast_occlusion(grid, triangles, eye);
+	});
+
+	EXPECT_GT(single_threaded->count(), 0);
+	EXPECT_EQ(*single_threaded, *multi_threaded);
+}